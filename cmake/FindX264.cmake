@@ -0,0 +1,15 @@
+# rules for finding the x264 library
+
+find_package(PkgConfig REQUIRED)
+pkg_check_modules(PC_X264 x264)
+
+find_path(X264_INCLUDE_DIR x264.h HINTS ${PC_X264_INCLUDEDIR} ${PC_X264_INCLUDE_DIRS})
+find_library(X264_LIBRARY NAMES x264 HINTS ${PC_X264_LIBDIR} ${PC_X264_LIBRARY_DIRS})
+
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(X264 DEFAULT_MSG X264_LIBRARY X264_INCLUDE_DIR)
+
+mark_as_advanced(X264_INCLUDE_DIR X264_LIBRARY)
+
+set(X264_INCLUDE_DIRS ${X264_INCLUDE_DIR})
+set(X264_LIBRARIES ${X264_LIBRARY})
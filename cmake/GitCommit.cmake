@@ -0,0 +1,20 @@
+# writes the current git commit to a header, this runs at build time so the commit in benchmark reports is never stale
+# the header is only rewritten when the commit changes, so other builds don't recompile anything
+
+set(SSR_GIT_COMMIT "")
+if(GIT_EXECUTABLE)
+	execute_process(COMMAND ${GIT_EXECUTABLE} describe --always --dirty
+		WORKING_DIRECTORY ${SOURCE_DIR}
+		OUTPUT_VARIABLE SSR_GIT_COMMIT
+		OUTPUT_STRIP_TRAILING_WHITESPACE
+		ERROR_QUIET)
+endif()
+
+set(CONTENT "#pragma once\n#define SSR_GIT_COMMIT \"${SSR_GIT_COMMIT}\"\n")
+set(OLD_CONTENT "")
+if(EXISTS ${OUTPUT_FILE})
+	file(READ ${OUTPUT_FILE} OLD_CONTENT)
+endif()
+if(NOT "${CONTENT}" STREQUAL "${OLD_CONTENT}")
+	file(WRITE ${OUTPUT_FILE} "${CONTENT}")
+endif()
@@ -55,6 +55,7 @@ public:
 
 AVFrameWrapper::AVFrameWrapper(const std::shared_ptr<AVFrameData>& refcounted_data) {
 	m_refcounted_data = refcounted_data;
+	m_hints = AVFrameHints();
 #if SSR_USE_AV_FRAME_ALLOC
 	m_frame = av_frame_alloc();
 #else
@@ -136,6 +137,132 @@ AVPacketWrapper::~AVPacketWrapper() {
 #endif
 }
 
+std::unique_ptr<AVFrameWrapper> CreateVideoFrame(unsigned int width, unsigned int height, AVPixelFormat pixel_format, const std::shared_ptr<AVFrameData>& reuse_data) {
+
+	// get required planes
+	unsigned int planes = 0;
+	size_t linesize[3] = {0}, planesize[3] = {0};
+	switch(pixel_format) {
+		case AV_PIX_FMT_YUV444P: {
+			// Y/U/V = 1 byte per pixel
+			planes = 3;
+			linesize[0]  = grow_align16(width); planesize[0] = linesize[0] * height;
+			linesize[1]  = grow_align16(width); planesize[1] = linesize[1] * height;
+			linesize[2]  = grow_align16(width); planesize[2] = linesize[2] * height;
+			break;
+		}
+		case AV_PIX_FMT_YUV422P: {
+			// Y = 1 byte per pixel, U/V = 1 byte per 2x1 pixels
+			assert(width % 2 == 0);
+			planes = 3;
+			linesize[0]  = grow_align16(width    ); planesize[0] = linesize[0] * height;
+			linesize[1]  = grow_align16(width / 2); planesize[1] = linesize[1] * height;
+			linesize[2]  = grow_align16(width / 2); planesize[2] = linesize[2] * height;
+			break;
+		}
+		case AV_PIX_FMT_YUV420P: {
+			// Y = 1 byte per pixel, U/V = 1 byte per 2x2 pixels
+			assert(width % 2 == 0);
+			assert(height % 2 == 0);
+			planes = 3;
+			linesize[0]  = grow_align16(width    ); planesize[0] = linesize[0] * height    ;
+			linesize[1]  = grow_align16(width / 2); planesize[1] = linesize[1] * height / 2;
+			linesize[2]  = grow_align16(width / 2); planesize[2] = linesize[2] * height / 2;
+			break;
+		}
+		case AV_PIX_FMT_NV12: {
+			assert(width % 2 == 0);
+			assert(height % 2 == 0);
+			// planar YUV 4:2:0, 12bpp, 1 plane for Y and 1 plane for the UV components, which are interleaved
+			// Y = 1 byte per pixel, U/V = 1 byte per 2x2 pixels
+			planes = 2;
+			linesize[0]  = grow_align16(width); planesize[0] = linesize[0] * height    ;
+			linesize[1]  = grow_align16(width); planesize[1] = linesize[1] * height / 2;
+			break;
+		}
+		case AV_PIX_FMT_BGRA: {
+			// BGRA = 4 bytes per pixel
+			planes = 1;
+			linesize[0] = grow_align16(width * 4); planesize[0] = linesize[0] * height;
+			break;
+		}
+		case AV_PIX_FMT_BGR24:
+		case AV_PIX_FMT_RGB24: {
+			// BGR/RGB = 3 bytes per pixel
+			planes = 1;
+			linesize[0] = grow_align16(width * 3); planesize[0] = linesize[0] * height;
+			break;
+		}
+		default: assert(false); break;
+	}
+
+	// create the frame
+	size_t totalsize = 0;
+	for(unsigned int p = 0; p < planes; ++p) {
+		totalsize += planesize[p];
+	}
+	std::shared_ptr<AVFrameData> frame_data = (reuse_data == NULL)? std::make_shared<AVFrameData>(totalsize) : reuse_data;
+	std::unique_ptr<AVFrameWrapper> frame(new AVFrameWrapper(frame_data));
+	uint8_t *data = frame->GetRawData();
+	for(unsigned int p = 0; p < planes; ++p) {
+		frame->GetFrame()->data[p] = data;
+		frame->GetFrame()->linesize[p] = linesize[p];
+		data += planesize[p];
+	}
+#if SSR_USE_AVFRAME_WIDTH_HEIGHT
+	frame->GetFrame()->width = width;
+	frame->GetFrame()->height = height;
+#endif
+#if SSR_USE_AVFRAME_FORMAT
+	frame->GetFrame()->format = pixel_format;
+#endif
+#if SSR_USE_AVFRAME_SAR
+	frame->GetFrame()->sample_aspect_ratio.num = 1;
+	frame->GetFrame()->sample_aspect_ratio.den = 1;
+#endif
+
+	return frame;
+
+}
+
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+
+AVRegionOfInterest MakeRegionOfInterest(int left, int top, int right, int bottom, AVRational qoffset) {
+	AVRegionOfInterest roi = {};
+	roi.self_size = sizeof(AVRegionOfInterest);
+	roi.top = top;
+	roi.bottom = bottom;
+	roi.left = left;
+	roi.right = right;
+	roi.qoffset = qoffset;
+	return roi;
+}
+
+void AddFrameRegionsOfInterest(AVFrame* frame, const std::vector<AVRegionOfInterest>& regions) {
+	if(regions.empty())
+		return;
+
+	// a frame can only have one array of regions, so merge the existing regions with the new ones
+	std::vector<AVRegionOfInterest> merged;
+	AVFrameSideData *old_side_data = av_frame_get_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+	if(old_side_data != NULL && old_side_data->size >= sizeof(AVRegionOfInterest)) {
+		const AVRegionOfInterest *old_regions = (const AVRegionOfInterest*) old_side_data->data;
+		size_t count = old_side_data->size / old_regions[0].self_size;
+		for(size_t i = 0; i < count; ++i) {
+			merged.push_back(*(const AVRegionOfInterest*) (old_side_data->data + old_regions[0].self_size * i));
+		}
+	}
+	merged.insert(merged.end(), regions.begin(), regions.end());
+	av_frame_remove_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+
+	AVFrameSideData *side_data = av_frame_new_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST, sizeof(AVRegionOfInterest) * merged.size());
+	if(side_data == NULL)
+		throw std::bad_alloc();
+	memcpy(side_data->data, merged.data(), sizeof(AVRegionOfInterest) * merged.size());
+}
+
+#endif
+
 bool AVFormatIsInstalled(const QString& format_name) {
 	return (av_guess_format(format_name.toUtf8().constData(), NULL, NULL) != NULL);
 }
@@ -77,6 +77,16 @@ public:
 	}
 };
 
+// Information about the content of a video frame, measured before the frame was converted. Encoders can use this to make better decisions.
+// All coordinates are in pixels of the encoded frame.
+struct AVFrameHints {
+	bool m_valid; // false if nothing is known about the frame
+	bool m_static; // the frame is identical to the previous frame
+	bool m_scene_cut; // the content changed completely, so this is a good place for a keyframe
+	double m_changed_fraction; // the fraction of the frame that changed since the previous frame
+	unsigned int m_changed_x1, m_changed_y1, m_changed_x2, m_changed_y2; // bounding box of the changes
+};
+
 // A wrapper around AVFrame to manage memory allocation and reference counting.
 // Note: This reference counting mechanism is unrelated to the mechanism added in later versions of ffmpeg/libav.
 class AVFrameWrapper {
@@ -84,6 +94,7 @@ class AVFrameWrapper {
 private:
 	AVFrame *m_frame;
 	std::shared_ptr<AVFrameData> m_refcounted_data;
+	AVFrameHints m_hints;
 
 public:
 	AVFrameWrapper(const std::shared_ptr<AVFrameData>& refcounted_data);
@@ -103,6 +114,7 @@ public:
 	inline AVFrame* GetFrame() { return m_frame; }
 	inline uint8_t* GetRawData() { return m_refcounted_data->GetData(); }
 	inline std::shared_ptr<AVFrameData> GetFrameData() { return m_refcounted_data; }
+	inline AVFrameHints& GetHints() { return m_hints; }
 
 };
 
@@ -133,6 +145,19 @@ public:
 
 };
 
+// Allocates a video frame with the plane layout used by the encoders (every line is aligned to 16 bytes).
+// If 'reuse_data' is not NULL, the frame will point to that data instead of allocating new data.
+std::unique_ptr<AVFrameWrapper> CreateVideoFrame(unsigned int width, unsigned int height, AVPixelFormat pixel_format, const std::shared_ptr<AVFrameData>& reuse_data);
+
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+// Creates a region of interest. The quantizer offset ranges from -1 to 1, negative values result in higher quality.
+AVRegionOfInterest MakeRegionOfInterest(int left, int top, int right, int bottom, AVRational qoffset);
+
+// Adds regions of interest to a frame, after the regions that the frame already has. Where regions overlap,
+// the region that was added first takes precedence.
+void AddFrameRegionsOfInterest(AVFrame* frame, const std::vector<AVRegionOfInterest>& regions);
+#endif
+
 bool AVFormatIsInstalled(const QString& format_name);
 bool AVCodecIsInstalled(const QString& codec_name);
 bool AVCodecSupportsPixelFormat(const AVCodec* codec, AVPixelFormat pixel_fmt);
@@ -0,0 +1,413 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "Calibration.h"
+
+#include "AVWrapper.h"
+#include "BenchmarkCapture.h"
+#include "BenchmarkEncoder.h"
+#include "CommandLineOptions.h"
+#include "FastScaler.h"
+#include "Logger.h"
+#include "TempBuffer.h"
+#include "X11Input.h"
+
+// The presets that are tested, from fast to slow. Slower presets are hardly ever fast enough for live recording, and testing them
+// would take a long time.
+static const char* const CALIBRATION_PRESETS[] = {"ultrafast", "superfast", "veryfast", "faster", "fast", "medium"};
+
+// Time used to let the input thread reach a steady state before measuring.
+static const int64_t CALIBRATION_CAPTURE_WARMUP = 500000;
+
+// Measurement time for the capture and conversion steps (in microseconds).
+static const int64_t CALIBRATION_CAPTURE_TIME = 2000000;
+static const int64_t CALIBRATION_CONVERT_TIME = 500000;
+
+// Length of the clip used to measure the encoder (in seconds of video). The minimum of the encoder benchmark still applies.
+static const unsigned int CALIBRATION_ENCODER_SECONDS = 4;
+
+// A stage is considered fast enough if it is faster than the target frame rate by at least this factor, since the stages
+// compete with each other (and with the rest of the system) for CPU time during a real recording.
+static const double CALIBRATION_HEADROOM = 1.25;
+
+static QString GetCalibrationFile() {
+	return GetApplicationUserDir() + "/calibration.conf";
+}
+
+static std::vector<unsigned int> GetCalibrationThreadCounts() {
+	std::vector<unsigned int> thread_counts;
+	unsigned int max_threads = std::max(1u, std::thread::hardware_concurrency());
+	for(unsigned int t = 1; t < max_threads; t *= 2) {
+		thread_counts.push_back(t);
+	}
+	thread_counts.push_back(max_threads);
+	return thread_counts;
+}
+
+static void ConversionWorker(const CalibrationSettings* settings, const uint8_t* in_data, int in_stride, int64_t end_time, uint64_t* frames) {
+	FastScaler fast_scaler;
+	std::unique_ptr<AVFrameWrapper> frame = CreateVideoFrame(settings->m_output_width, settings->m_output_height, AV_PIX_FMT_NV12, NULL);
+	uint64_t count = 0;
+	while(hrt_time_micro() < end_time) {
+		fast_scaler.Scale(settings->m_width, settings->m_height, AV_PIX_FMT_BGRA, SWS_CS_DEFAULT, &in_data, &in_stride,
+						  settings->m_output_width, settings->m_output_height, AV_PIX_FMT_NV12, SWS_CS_ITU709,
+						  frame->GetFrame()->data, frame->GetFrame()->linesize);
+		++count;
+	}
+	*frames = count;
+}
+
+Calibration::Calibration(const CalibrationSettings& settings) {
+
+	m_settings = settings;
+
+	try {
+		Init();
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+}
+
+Calibration::~Calibration() {
+
+	// tell the thread to stop
+	if(m_thread.joinable()) {
+		Logger::LogInfo("[Calibration::~Calibration] " + Logger::tr("Stopping calibration thread ..."));
+		m_should_stop = true;
+		m_thread.join();
+	}
+
+	// free everything
+	Free();
+
+}
+
+double Calibration::GetProgress(QString* status) {
+	SharedLock lock(&m_shared_data);
+	*status = lock->m_status;
+	return (lock->m_total_steps == 0)? 0.0 : (double) lock->m_step / (double) lock->m_total_steps;
+}
+
+CalibrationResults Calibration::GetResults() {
+	SharedLock lock(&m_shared_data);
+	return lock->m_results;
+}
+
+QString Calibration::GetSummary(const CalibrationResults& results) {
+	QString summary;
+	summary += Logger::tr("Recording %1x%2 at %3 fps, encoded at %4x%5.").arg(results.m_settings.m_width).arg(results.m_settings.m_height)
+			   .arg(results.m_settings.m_frame_rate).arg(results.m_settings.m_output_width).arg(results.m_settings.m_output_height) + "\n";
+	if(results.m_grab_time != 0.0)
+		summary += Logger::tr("Capture: %1 ms per frame.").arg(results.m_grab_time * 0.001, 0, 'f', 2) + "\n";
+	for(const std::pair<unsigned int, double> &convert : results.m_convert_fps) {
+		summary += Logger::tr("Conversion with %1 thread(s): %2 fps.").arg(convert.first).arg(convert.second, 0, 'f', 1) + "\n";
+	}
+	for(const std::pair<QString, double> &encoder : results.m_encoder_fps) {
+		summary += Logger::tr("Encoder preset %1: %2 fps.").arg(encoder.first).arg(encoder.second, 0, 'f', 1) + "\n";
+	}
+	if(results.m_input_fps < (double) results.m_settings.m_frame_rate * CALIBRATION_HEADROOM) {
+		summary += Logger::tr("Warning: Capturing and converting is limited to about %1 fps. Consider reducing the frame rate, "
+							  "recording a smaller area or scaling the video down.").arg(results.m_input_fps, 0, 'f', 0) + "\n";
+	}
+	if(results.m_convert_threads == 0) {
+		summary += Logger::tr("Suggested conversion: in the input thread.") + "\n";
+	} else if(results.m_convert_threads > 0) {
+		summary += Logger::tr("Suggested conversion: %1 thread(s).").arg(results.m_convert_threads) + "\n";
+	}
+	if(results.m_preset.isEmpty()) {
+		summary += Logger::tr("Warning: None of the presets can sustain the frame rate. Consider reducing the frame rate or the video size.");
+	} else {
+		summary += Logger::tr("Suggested preset: %1").arg(results.m_preset);
+	}
+	return summary;
+}
+
+bool Calibration::Load(CalibrationResults* results) {
+	QSettings settings(GetCalibrationFile(), QSettings::IniFormat);
+	if(!settings.contains("calibration/time"))
+		return false;
+	results->m_settings.m_x = settings.value("calibration/x", 0).toUInt();
+	results->m_settings.m_y = settings.value("calibration/y", 0).toUInt();
+	results->m_settings.m_width = settings.value("calibration/width", 0).toUInt();
+	results->m_settings.m_height = settings.value("calibration/height", 0).toUInt();
+	results->m_settings.m_output_width = settings.value("calibration/output_width", 0).toUInt();
+	results->m_settings.m_output_height = settings.value("calibration/output_height", 0).toUInt();
+	results->m_settings.m_frame_rate = settings.value("calibration/frame_rate", 0).toUInt();
+	results->m_settings.m_record_cursor = settings.value("calibration/record_cursor", false).toBool();
+	results->m_settings.m_crf = settings.value("calibration/crf", 23).toUInt();
+	results->m_display = settings.value("calibration/display", QString()).toString();
+	results->m_time = settings.value("calibration/time", QDateTime()).toDateTime();
+	results->m_grab_time = settings.value("calibration/grab_time", 0.0).toDouble();
+	results->m_input_fps = settings.value("calibration/input_fps", 0.0).toDouble();
+	results->m_convert_threads = settings.value("calibration/convert_threads", -1).toInt();
+	results->m_preset = settings.value("calibration/preset", QString()).toString();
+	results->m_convert_fps.clear();
+	int convert_size = settings.beginReadArray("convert");
+	for(int i = 0; i < convert_size; ++i) {
+		settings.setArrayIndex(i);
+		results->m_convert_fps.emplace_back(settings.value("threads", 1).toUInt(), settings.value("fps", 0.0).toDouble());
+	}
+	settings.endArray();
+	results->m_encoder_fps.clear();
+	int encoder_size = settings.beginReadArray("encoder");
+	for(int i = 0; i < encoder_size; ++i) {
+		settings.setArrayIndex(i);
+		results->m_encoder_fps.emplace_back(settings.value("preset", QString()).toString(), settings.value("fps", 0.0).toDouble());
+	}
+	settings.endArray();
+	return true;
+}
+
+void Calibration::Save(const CalibrationResults& results) {
+	QSettings settings(GetCalibrationFile(), QSettings::IniFormat);
+	settings.clear();
+	settings.setValue("calibration/x", results.m_settings.m_x);
+	settings.setValue("calibration/y", results.m_settings.m_y);
+	settings.setValue("calibration/width", results.m_settings.m_width);
+	settings.setValue("calibration/height", results.m_settings.m_height);
+	settings.setValue("calibration/output_width", results.m_settings.m_output_width);
+	settings.setValue("calibration/output_height", results.m_settings.m_output_height);
+	settings.setValue("calibration/frame_rate", results.m_settings.m_frame_rate);
+	settings.setValue("calibration/record_cursor", results.m_settings.m_record_cursor);
+	settings.setValue("calibration/crf", results.m_settings.m_crf);
+	settings.setValue("calibration/display", results.m_display);
+	settings.setValue("calibration/time", results.m_time);
+	settings.setValue("calibration/grab_time", results.m_grab_time);
+	settings.setValue("calibration/input_fps", results.m_input_fps);
+	settings.setValue("calibration/convert_threads", results.m_convert_threads);
+	settings.setValue("calibration/preset", results.m_preset);
+	settings.beginWriteArray("convert", results.m_convert_fps.size());
+	for(unsigned int i = 0; i < results.m_convert_fps.size(); ++i) {
+		settings.setArrayIndex(i);
+		settings.setValue("threads", results.m_convert_fps[i].first);
+		settings.setValue("fps", results.m_convert_fps[i].second);
+	}
+	settings.endArray();
+	settings.beginWriteArray("encoder", results.m_encoder_fps.size());
+	for(unsigned int i = 0; i < results.m_encoder_fps.size(); ++i) {
+		settings.setArrayIndex(i);
+		settings.setValue("preset", results.m_encoder_fps[i].first);
+		settings.setValue("fps", results.m_encoder_fps[i].second);
+	}
+	settings.endArray();
+}
+
+void Calibration::Init() {
+
+	if(m_settings.m_output_width == 0 || m_settings.m_output_height == 0 || m_settings.m_frame_rate == 0) {
+		Logger::LogError("[Calibration::Init] " + Logger::tr("Error: Invalid output size or frame rate!"));
+		throw CalibrationException();
+	}
+
+	// the output size must be even because of the chroma subsampling
+	m_settings.m_output_width = m_settings.m_output_width / 2 * 2;
+	m_settings.m_output_height = m_settings.m_output_height / 2 * 2;
+	// X11Input can't be used on other platforms, in that case only the conversion and encoder are measured
+	m_measure_capture = (IsPlatformX11() && m_settings.m_width != 0 && m_settings.m_height != 0);
+	if(m_settings.m_width == 0 || m_settings.m_height == 0) {
+		m_settings.m_width = m_settings.m_output_width;
+		m_settings.m_height = m_settings.m_output_height;
+		m_settings.m_x = 0;
+		m_settings.m_y = 0;
+	}
+
+	{
+		SharedLock lock(&m_shared_data);
+		lock->m_step = 0;
+		lock->m_total_steps = 0;
+		lock->m_results = CalibrationResults();
+		lock->m_results.m_settings = m_settings;
+		lock->m_results.m_grab_time = 0.0;
+		lock->m_results.m_input_fps = 0.0;
+		lock->m_results.m_convert_threads = -1;
+	}
+
+	// start the calibration thread
+	m_should_stop = false;
+	m_is_done = false;
+	m_error_occurred = false;
+	m_thread = std::thread(&Calibration::CalibrationThread, this);
+
+}
+
+void Calibration::Free() {
+	// nothing
+}
+
+void Calibration::SetStep(const QString& status) {
+	Logger::LogInfo("[Calibration::CalibrationThread] " + status);
+	SharedLock lock(&m_shared_data);
+	++lock->m_step;
+	lock->m_status = status;
+}
+
+void Calibration::MeasureCapture(CalibrationResults* results) {
+
+	SetStep(Logger::tr("Measuring capture speed ..."));
+
+	CaptureBenchmarkSink sink;
+	X11Input input(m_settings.m_x, m_settings.m_y, m_settings.m_width, m_settings.m_height, m_settings.m_record_cursor, false, false);
+	sink.ConnectVideoSource(&input);
+	usleep(CALIBRATION_CAPTURE_WARMUP);
+	uint64_t grabs1, grabs2;
+	int64_t grab_time_sum1, grab_time_sum2, grab_time_max;
+	input.GetGrabStats(&grabs1, &grab_time_sum1, &grab_time_max);
+	usleep(CALIBRATION_CAPTURE_TIME);
+	input.GetGrabStats(&grabs2, &grab_time_sum2, &grab_time_max);
+	sink.ConnectVideoSource(NULL);
+	if(input.HasErrorOccurred())
+		throw X11Exception();
+
+	results->m_grab_time = (grabs2 == grabs1)? (double) CALIBRATION_CAPTURE_TIME : (double) (grab_time_sum2 - grab_time_sum1) / (double) (grabs2 - grabs1);
+	Logger::LogInfo("[Calibration::MeasureCapture] " + Logger::tr("Grab time: %1 us (max %2 us).").arg(results->m_grab_time, 0, 'f', 0).arg(grab_time_max));
+
+}
+
+void Calibration::MeasureConversion(CalibrationResults* results) {
+
+	// generate a simple test image, the speed of the converter doesn't depend on the content
+	int in_stride = grow_align16(m_settings.m_width * 4);
+	TempBuffer<uint8_t> in_buffer;
+	in_buffer.Alloc(in_stride * m_settings.m_height);
+	for(unsigned int y = 0; y < m_settings.m_height; ++y) {
+		uint32_t *row = (uint32_t*) (in_buffer.GetData() + (size_t) in_stride * y);
+		for(unsigned int x = 0; x < m_settings.m_width; ++x) {
+			row[x] = 0xff000000 | ((x & 0xff) << 16) | ((y & 0xff) << 8) | ((x + y) & 0xff);
+		}
+	}
+
+	for(unsigned int thread_count : GetCalibrationThreadCounts()) {
+		if(m_should_stop)
+			return;
+		SetStep(Logger::tr("Measuring conversion speed with %1 thread(s) ...").arg(thread_count));
+		std::vector<std::thread> threads;
+		std::vector<uint64_t> frames(thread_count, 0);
+		int64_t t1 = hrt_time_micro();
+		for(unsigned int t = 0; t < thread_count; ++t) {
+			threads.emplace_back(ConversionWorker, &m_settings, in_buffer.GetData(), in_stride, t1 + CALIBRATION_CONVERT_TIME, &frames[t]);
+		}
+		for(std::thread &thread : threads) {
+			thread.join();
+		}
+		int64_t t2 = hrt_time_micro();
+		uint64_t total_frames = 0;
+		for(uint64_t f : frames) {
+			total_frames += f;
+		}
+		double fps = (double) total_frames * 1.0e6 / (double) std::max<int64_t>(1, t2 - t1);
+		results->m_convert_fps.emplace_back(thread_count, fps);
+		Logger::LogInfo("[Calibration::MeasureConversion] " + Logger::tr("Conversion with %1 thread(s): %2 fps.").arg(thread_count).arg(fps, 0, 'f', 1));
+	}
+
+}
+
+void Calibration::MeasureEncoder(CalibrationResults* results) {
+
+	std::vector<std::pair<QString, QString> > codec_options;
+	codec_options.push_back(std::make_pair(QString("crf"), QString::number(m_settings.m_crf)));
+	unsigned int frames = m_settings.m_frame_rate * CALIBRATION_ENCODER_SECONDS;
+
+	for(const char *preset : CALIBRATION_PRESETS) {
+		if(m_should_stop)
+			return;
+		SetStep(Logger::tr("Measuring encoder speed with preset %1 ...").arg(preset));
+		std::vector<std::pair<QString, QString> > options = codec_options;
+		options.push_back(std::make_pair(QString("preset"), QString(preset)));
+		EncoderBenchmarkResult result = EncoderBenchmarkRun("libx264", options, m_settings.m_output_width, m_settings.m_output_height,
+															m_settings.m_frame_rate, frames);
+		results->m_encoder_fps.emplace_back(QString(preset), result.m_fps);
+		Logger::LogInfo("[Calibration::MeasureEncoder] " + Logger::tr("Encoder preset %1: %2 fps, CPU %3%.").arg(preset).arg(result.m_fps, 0, 'f', 1).arg(result.m_cpu, 0, 'f', 1));
+
+		// slower presets won't be faster, so there is no point in testing them
+		if(result.m_fps < (double) m_settings.m_frame_rate * CALIBRATION_HEADROOM)
+			break;
+		results->m_preset = preset;
+	}
+
+}
+
+void Calibration::CalibrationThread() {
+	try {
+
+		Logger::LogInfo("[Calibration::CalibrationThread] " + Logger::tr("Calibration thread started."));
+
+		{
+			SharedLock lock(&m_shared_data);
+			lock->m_total_steps = ((m_measure_capture)? 1 : 0) + GetCalibrationThreadCounts().size() + sizeof(CALIBRATION_PRESETS) / sizeof(CALIBRATION_PRESETS[0]);
+		}
+
+		CalibrationResults results;
+		results.m_settings = m_settings;
+		results.m_display = QString::fromLocal8Bit(qgetenv("DISPLAY"));
+		results.m_time = QDateTime::currentDateTimeUtc();
+		results.m_grab_time = 0.0;
+		results.m_input_fps = 0.0;
+		results.m_convert_threads = -1;
+
+		if(m_measure_capture)
+			MeasureCapture(&results);
+		MeasureConversion(&results);
+		MeasureEncoder(&results);
+
+		// the input thread grabs and converts every frame by itself
+		double convert_time = (results.m_convert_fps.empty() || results.m_convert_fps[0].second == 0.0)? 0.0 : 1.0e6 / results.m_convert_fps[0].second;
+		results.m_input_fps = 1.0e6 / std::max(1.0, results.m_grab_time + convert_time);
+
+		// if the input thread is too slow, use the smallest number of conversion threads that is fast enough (or the fastest)
+		if(!results.m_convert_fps.empty()) {
+			double target_fps = (double) m_settings.m_frame_rate * CALIBRATION_HEADROOM;
+			results.m_convert_threads = 0;
+			if(results.m_input_fps < target_fps) {
+				double best_fps = 0.0;
+				for(const std::pair<unsigned int, double> &convert : results.m_convert_fps) {
+					if(convert.second >= target_fps) {
+						results.m_convert_threads = convert.first;
+						break;
+					}
+					if(convert.second > best_fps) {
+						best_fps = convert.second;
+						results.m_convert_threads = convert.first;
+					}
+				}
+			}
+		}
+
+		if(!m_should_stop) {
+			Save(results);
+			Logger::LogInfo("[Calibration::CalibrationThread] " + Logger::tr("Calibration finished.") + "\n" + GetSummary(results));
+		}
+
+		{
+			SharedLock lock(&m_shared_data);
+			lock->m_step = lock->m_total_steps;
+			lock->m_status = Logger::tr("Done.");
+			lock->m_results = results;
+		}
+		m_is_done = true;
+
+	} catch(const std::exception& e) {
+		m_error_occurred = true;
+		Logger::LogError("[Calibration::CalibrationThread] " + Logger::tr("Exception '%1' in calibration thread.").arg(e.what()));
+	} catch(...) {
+		m_error_occurred = true;
+		Logger::LogError("[Calibration::CalibrationThread] " + Logger::tr("Unknown exception in calibration thread."));
+	}
+}
@@ -0,0 +1,113 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "MutexDataPair.h"
+
+class CalibrationException : public std::exception {
+public:
+	inline virtual const char* what() const throw() override {
+		return "CalibrationException";
+	}
+};
+
+struct CalibrationSettings {
+	unsigned int m_x, m_y, m_width, m_height; // recording area, a width of zero skips the capture measurement
+	unsigned int m_output_width, m_output_height;
+	unsigned int m_frame_rate;
+	bool m_record_cursor;
+	unsigned int m_crf;
+};
+
+struct CalibrationResults {
+	CalibrationSettings m_settings;
+	QString m_display;
+	QDateTime m_time;
+	double m_grab_time; // average time needed to grab one frame (in microseconds), zero if not measured
+	std::vector<std::pair<unsigned int, double> > m_convert_fps; // conversion speed (frames per second, all threads combined) for every thread count
+	std::vector<std::pair<QString, double> > m_encoder_fps; // encoding speed (frames per second) for every preset that was tested
+	double m_input_fps; // estimated maximum frame rate of the input thread, which grabs and converts every frame
+	int m_convert_threads; // suggested number of conversion threads, 0 if the input thread can convert by itself, -1 if unknown
+	QString m_preset; // the slowest preset that can sustain the frame rate, or empty if none can
+};
+
+// Measures the speed of the capture, conversion and encoding stages on the actual machine and display, and picks the slowest x264
+// preset that can sustain the configured frame rate. The measurements run in a separate thread and take about a minute.
+// The results are stored in the user directory so they can be shown again later.
+class Calibration {
+
+private:
+	struct SharedData {
+		unsigned int m_step, m_total_steps;
+		QString m_status;
+		CalibrationResults m_results;
+	};
+	typedef MutexDataPair<SharedData>::Lock SharedLock;
+
+private:
+	CalibrationSettings m_settings;
+	bool m_measure_capture;
+
+	std::thread m_thread;
+	MutexDataPair<SharedData> m_shared_data;
+	std::atomic<bool> m_should_stop, m_is_done, m_error_occurred;
+
+public:
+	Calibration(const CalibrationSettings& settings);
+	~Calibration();
+
+	// Returns the progress as a number between 0 and 1, and a description of the current step.
+	// This function is thread-safe.
+	double GetProgress(QString* status);
+
+	// Returns the results. Only valid after IsDone() returns true.
+	// This function is thread-safe.
+	CalibrationResults GetResults();
+
+	// Returns whether the calibration is done.
+	// This function is thread-safe and lock-free.
+	inline bool IsDone() { return m_is_done; }
+
+	// Returns whether an error has occurred in the calibration thread.
+	// This function is thread-safe and lock-free.
+	inline bool HasErrorOccurred() { return m_error_occurred; }
+
+public:
+	// Returns a human-readable summary of the results.
+	static QString GetSummary(const CalibrationResults& results);
+
+	// Loads or saves the results of the last calibration. Load returns false if there are no results.
+	static bool Load(CalibrationResults* results);
+	static void Save(const CalibrationResults& results);
+
+private:
+	void Init();
+	void Free();
+
+	void SetStep(const QString& status);
+
+	void MeasureCapture(CalibrationResults* results);
+	void MeasureConversion(CalibrationResults* results);
+	void MeasureEncoder(CalibrationResults* results);
+
+	void CalibrationThread();
+
+};
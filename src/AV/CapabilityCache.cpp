@@ -0,0 +1,138 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "CapabilityCache.h"
+
+#include "AVWrapper.h"
+#include "Logger.h"
+#include "VideoEncoder.h"
+#include "AudioEncoder.h"
+
+CapabilityCache *CapabilityCache::s_instance = NULL;
+
+CapabilityCache::CapabilityCache(const QString& file) {
+	assert(s_instance == NULL);
+
+	m_file = file;
+	m_key = GetCacheKey();
+	m_loaded = false;
+	m_changed = false;
+	m_stats.m_hits = 0;
+	m_stats.m_misses = 0;
+
+	// load the cache, but only if it was created with the same libraries
+	QSettings settings(m_file, QSettings::IniFormat);
+	if(settings.value("cache/key").toString() == m_key) {
+		settings.beginGroup("capabilities");
+		QStringList keys = settings.childKeys();
+		for(const QString &key : keys) {
+			m_entries[key] = settings.value(key).toBool();
+		}
+		settings.endGroup();
+		m_loaded = true;
+		Logger::LogInfo("[CapabilityCache::CapabilityCache] " + Logger::tr("Loaded %1 cached capabilities.").arg(m_entries.size()));
+	}
+
+	s_instance = this;
+}
+
+CapabilityCache::~CapabilityCache() {
+	assert(s_instance == this);
+	s_instance = NULL;
+	Save();
+}
+
+void CapabilityCache::Save() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(!m_changed)
+		return;
+	QSettings settings(m_file, QSettings::IniFormat);
+	settings.clear();
+	settings.setValue("cache/key", m_key);
+	settings.beginGroup("capabilities");
+	for(auto &entry : m_entries) {
+		settings.setValue(entry.first, entry.second);
+	}
+	settings.endGroup();
+	settings.sync();
+	if(settings.status() != QSettings::NoError) {
+		Logger::LogWarning("[CapabilityCache::Save] " + Logger::tr("Warning: Could not write capability cache!"));
+		return;
+	}
+	m_changed = false;
+}
+
+CapabilityCache::Stats CapabilityCache::GetStats() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+bool CapabilityCache::FormatIsInstalled(const QString& format_name) {
+	if(s_instance == NULL)
+		return AVFormatIsInstalled(format_name);
+	return s_instance->Lookup("format_" + format_name, &AVFormatIsInstalled, format_name);
+}
+
+bool CapabilityCache::CodecIsInstalled(const QString& codec_name) {
+	if(s_instance == NULL)
+		return AVCodecIsInstalled(codec_name);
+	return s_instance->Lookup("codec_" + codec_name, &AVCodecIsInstalled, codec_name);
+}
+
+bool CapabilityCache::VideoCodecIsSupported(const QString& codec_name) {
+	if(s_instance == NULL)
+		return VideoEncoder::AVCodecIsSupported(codec_name);
+	return s_instance->Lookup("video_" + codec_name, &VideoEncoder::AVCodecIsSupported, codec_name);
+}
+
+bool CapabilityCache::AudioCodecIsSupported(const QString& codec_name) {
+	if(s_instance == NULL)
+		return AudioEncoder::AVCodecIsSupported(codec_name);
+	return s_instance->Lookup("audio_" + codec_name, &AudioEncoder::AVCodecIsSupported, codec_name);
+}
+
+QString CapabilityCache::GetCacheKey() {
+	// The version numbers alone are not enough, distributions often build the same version with different options.
+	// The SSR version is included as well because the list of supported pixel and sample formats can change.
+	QByteArray configuration;
+	configuration += avformat_configuration();
+	configuration += avcodec_configuration();
+	configuration += avutil_configuration();
+	return QString() + SSR_VERSION + "-" + QString::number(avformat_version()) + "-" + QString::number(avcodec_version())
+			+ "-" + QString::number(avutil_version()) + "-" + QString::fromLatin1(QCryptographicHash::hash(configuration, QCryptographicHash::Md5).toHex());
+}
+
+bool CapabilityCache::Lookup(const QString& key, bool (*function)(const QString&), const QString& name) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(key);
+		if(it != m_entries.end()) {
+			++m_stats.m_hits;
+			return it->second;
+		}
+	}
+	bool result = function(name);
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_entries[key] = result;
+		m_changed = true;
+		++m_stats.m_misses;
+	}
+	return result;
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+// Caches the results of the libav capability checks (AVFormatIsInstalled, AVCodecIsInstalled and the encoders'
+// AVCodecIsSupported) on disk. Checking every codec is surprisingly slow because it has to walk the pixel and sample
+// format lists of every encoder, and the results only change when libav or SSR itself changes. The cache is keyed by the
+// library versions and configurations, so it is discarded automatically when the libraries are upgraded.
+// If no cache object exists, the static functions simply forward to the real checks.
+class CapabilityCache {
+
+public:
+	struct Stats {
+		unsigned int m_hits, m_misses;
+	};
+
+private:
+	QString m_file;
+	QString m_key;
+	bool m_loaded, m_changed;
+
+	std::mutex m_mutex;
+	std::map<QString, bool> m_entries;
+	Stats m_stats;
+
+	static CapabilityCache *s_instance;
+
+public:
+	CapabilityCache(const QString& file);
+	~CapabilityCache();
+
+	// Writes the cache to disk if anything has changed.
+	void Save();
+
+	// Returns whether a valid cache was loaded from disk (i.e. whether this is a 'warm' start).
+	inline bool IsLoaded() { return m_loaded; }
+
+	Stats GetStats();
+
+	static bool FormatIsInstalled(const QString& format_name);
+	static bool CodecIsInstalled(const QString& codec_name);
+	static bool VideoCodecIsSupported(const QString& codec_name);
+	static bool AudioCodecIsSupported(const QString& codec_name);
+
+	inline static CapabilityCache* GetInstance() { return s_instance; }
+
+private:
+	static QString GetCacheKey();
+	bool Lookup(const QString& key, bool (*function)(const QString&), const QString& name);
+
+};
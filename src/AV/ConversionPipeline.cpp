@@ -0,0 +1,280 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ConversionPipeline.h"
+
+#include "Logger.h"
+
+// The pipeline is only used for large frames. For small frames, the conversion is so fast that the extra copy doesn't pay off.
+static const unsigned int PIPELINE_MIN_PIXELS = 1920 * 1080;
+
+// The maximum number of frames that are converted at the same time. The encoder needs most of the CPU, so there is no point in using more.
+static const unsigned int PIPELINE_MAX_THREADS = 3;
+
+ConversionPipeline::ConversionPipeline(unsigned int threads, unsigned int max_jobs, unsigned int out_width, unsigned int out_height, AVPixelFormat out_format, int out_colorspace,
+									   const DeliverCallback& deliver_callback) {
+
+	m_max_jobs = std::max(1u, max_jobs);
+	m_out_width = out_width;
+	m_out_height = out_height;
+	m_out_format = out_format;
+	m_out_colorspace = out_colorspace;
+	m_deliver_callback = deliver_callback;
+
+	m_max_tasks = std::max(1u, threads);
+	m_pending_jobs = 0;
+	m_running_tasks = 0;
+
+	m_stats_frames = 0;
+	m_stats_time_copy = 0;
+	m_stats_time_wait = 0;
+	m_stats_time_convert = 0;
+
+}
+
+ConversionPipeline::~ConversionPipeline() {
+
+	// deliver the remaining frames
+	Flush();
+	m_tasks.Wait();
+
+	if(m_stats_frames != 0) {
+		double frames = (double) m_stats_frames;
+		Logger::LogInfo("[ConversionPipeline::~ConversionPipeline] " + Logger::tr("Conversion pipeline: %1 frames on %2 threads, per frame: copy %3 ms, waiting %4 ms, conversion %5 ms.")
+						.arg((uint64_t) m_stats_frames).arg(m_max_tasks)
+						.arg((double) m_stats_time_copy * 1.0e-3 / frames, 0, 'f', 2)
+						.arg((double) m_stats_time_wait * 1.0e-3 / frames, 0, 'f', 2)
+						.arg((double) m_stats_time_convert * 1.0e-3 / frames, 0, 'f', 2));
+	}
+
+}
+
+void ConversionPipeline::AddFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp,
+								  const AVFrameHints& hints, std::unique_ptr<AVFrameWrapper> converted_frame, bool reuse, bool letterbox) {
+
+	// wait until there is room for another frame
+	int64_t t1 = hrt_time_micro();
+	std::unique_ptr<Job> job;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(m_jobs.size() >= m_max_jobs) {
+			m_condition_done.wait(lock);
+		}
+		job = NewJob(lock);
+	}
+	int64_t t2 = hrt_time_micro();
+
+	job->m_ping = false;
+	job->m_reuse = reuse;
+	job->m_timestamp = timestamp;
+	job->m_hints = hints;
+	job->m_frame = std::move(converted_frame);
+	job->m_claimed = reuse;
+	job->m_done = reuse;
+
+	// copy the input frame, this is the only thing the caller has to wait for
+	if(!reuse) {
+		int linesizes[4];
+		const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(format);
+		if(desc == NULL || av_image_fill_linesizes(linesizes, format, width) < 0) {
+			Logger::LogError("[ConversionPipeline::AddFrame] " + Logger::tr("Error: Unsupported pixel format!"));
+			throw LibavException();
+		}
+		job->m_width = width;
+		job->m_height = height;
+		job->m_format = format;
+		job->m_colorspace = colorspace;
+		job->m_letterbox = letterbox;
+		int planes = av_pix_fmt_count_planes(format);
+		for(int p = 0; p < 4; ++p) {
+			if(p >= planes) {
+				job->m_strides[p] = 0;
+				continue;
+			}
+			unsigned int rows = (p == 1 || p == 2)? -((-(int) height) >> desc->log2_chroma_h) : height;
+			job->m_strides[p] = grow_align16(linesizes[p]);
+			job->m_planes[p].Alloc(job->m_strides[p] * rows);
+			av_image_copy_plane(job->m_planes[p].GetData(), job->m_strides[p], data[p], stride[p], linesizes[p], rows);
+		}
+	}
+	int64_t t3 = hrt_time_micro();
+
+	m_stats_time_wait += t2 - t1;
+	m_stats_time_copy += t3 - t2;
+	++m_stats_frames;
+
+	AddJob(std::move(job));
+
+}
+
+void ConversionPipeline::AddPing(int64_t timestamp) {
+
+	// pings count as jobs too, otherwise an input that only sends pings could fill the queue without limit
+	std::unique_ptr<Job> job;
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while(m_jobs.size() >= m_max_jobs) {
+			m_condition_done.wait(lock);
+		}
+		job = NewJob(lock);
+	}
+	job->m_ping = true;
+	job->m_reuse = false;
+	job->m_timestamp = timestamp;
+	job->m_hints = AVFrameHints();
+	job->m_claimed = true;
+	job->m_done = true;
+	AddJob(std::move(job));
+
+}
+
+void ConversionPipeline::Flush() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(!m_jobs.empty()) {
+		m_condition_done.wait(lock);
+	}
+}
+
+unsigned int ConversionPipeline::GetRecommendedThreads(unsigned int width, unsigned int height) {
+	if((uint64_t) width * (uint64_t) height < PIPELINE_MIN_PIXELS)
+		return 0;
+	unsigned int threads = TaskScheduler::GetInstance()->GetThreadCount();
+	if(threads < 4)
+		return 0;
+	return std::min(PIPELINE_MAX_THREADS, threads / 2);
+}
+
+std::unique_ptr<ConversionPipeline::Job> ConversionPipeline::NewJob(std::unique_lock<std::mutex>& lock) {
+	assert(lock.owns_lock());
+	if(m_free_jobs.empty())
+		return std::unique_ptr<Job>(new Job());
+	std::unique_ptr<Job> job = std::move(m_free_jobs.back());
+	m_free_jobs.pop_back();
+	return job;
+}
+
+void ConversionPipeline::AddJob(std::unique_ptr<Job> job) {
+	bool done = job->m_done, start_task = false;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(!done) {
+			++m_pending_jobs;
+			if(m_running_tasks < m_max_tasks) {
+				++m_running_tasks;
+				start_task = true;
+			}
+		}
+		m_jobs.push_back(std::move(job));
+	}
+	if(done) {
+		DeliverJobs();
+	} else if(start_task) {
+		m_tasks.Submit(TaskScheduler::PRIORITY_HIGH, [this]() { ConversionTask(); });
+	}
+}
+
+// Delivers all finished jobs at the front of the queue. Jobs that are finished out of order stay in the queue until
+// the jobs before them are finished too.
+void ConversionPipeline::DeliverJobs() {
+	std::lock_guard<std::mutex> deliver_lock(m_deliver_mutex);
+	for( ; ; ) {
+		std::unique_ptr<Job> job;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(m_jobs.empty() || !m_jobs.front()->m_done)
+				break;
+			job = std::move(m_jobs.front());
+			m_jobs.pop_front();
+		}
+		m_deliver_callback(job.get());
+		job->m_frame.reset();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free_jobs.push_back(std::move(job));
+		}
+		m_condition_done.notify_all();
+	}
+}
+
+// Converts frames until there are no unclaimed jobs left. Tasks are only started when there is work, so no task has to wait.
+void ConversionPipeline::ConversionTask() {
+
+	// get a scaler, they are kept because they have to allocate some memory
+	std::unique_ptr<FastScaler> fast_scaler;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if(m_free_scalers.empty()) {
+			fast_scaler.reset(new FastScaler());
+		} else {
+			fast_scaler = std::move(m_free_scalers.back());
+			m_free_scalers.pop_back();
+		}
+	}
+
+	for( ; ; ) {
+
+		// get the oldest job that hasn't been claimed yet
+		Job *job = NULL;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if(m_pending_jobs == 0) {
+				--m_running_tasks;
+				m_free_scalers.push_back(std::move(fast_scaler));
+				break;
+			}
+			for(std::unique_ptr<Job> &j : m_jobs) {
+				if(!j->m_claimed) {
+					job = j.get();
+					break;
+				}
+			}
+			assert(job != NULL);
+			job->m_claimed = true;
+			--m_pending_jobs;
+		}
+
+		// convert the frame
+		int64_t t1 = hrt_time_micro();
+		try {
+			const uint8_t *in_data[4] = {job->m_planes[0].GetData(), job->m_planes[1].GetData(), job->m_planes[2].GetData(), job->m_planes[3].GetData()};
+			if(job->m_letterbox) {
+				fast_scaler->ScaleLetterbox(job->m_width, job->m_height, job->m_format, job->m_colorspace, in_data, job->m_strides,
+											m_out_width, m_out_height, m_out_format, m_out_colorspace, job->m_frame->GetFrame()->data, job->m_frame->GetFrame()->linesize);
+			} else {
+				fast_scaler->Scale(job->m_width, job->m_height, job->m_format, job->m_colorspace, in_data, job->m_strides,
+								   m_out_width, m_out_height, m_out_format, m_out_colorspace, job->m_frame->GetFrame()->data, job->m_frame->GetFrame()->linesize);
+			}
+		} catch(const std::exception& e) {
+			Logger::LogError("[ConversionPipeline::ConversionTask] " + Logger::tr("Exception '%1' while converting a frame, the frame will be dropped.").arg(e.what()));
+			job->m_frame.reset();
+		} catch(...) {
+			Logger::LogError("[ConversionPipeline::ConversionTask] " + Logger::tr("Unknown exception while converting a frame, the frame will be dropped."));
+			job->m_frame.reset();
+		}
+		m_stats_time_convert += hrt_time_micro() - t1;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			job->m_done = true;
+		}
+		DeliverJobs();
+
+	}
+
+}
@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "AVWrapper.h"
+#include "FastScaler.h"
+#include "TaskScheduler.h"
+#include "TempBuffer.h"
+
+// Converts video frames with tasks on the task scheduler, so the thread that captures the frames only has to pay for a copy of
+// the image rather than the complete conversion. Several frames can be converted at the same time, but the results are always
+// delivered in the order in which the frames were added. Pings are delivered in the same order, so they can't overtake frames
+// that are still being converted. If too many frames are in flight, AddFrame blocks until the oldest frame is done.
+class ConversionPipeline {
+
+public:
+	struct Job {
+
+		bool m_ping; // this is a ping rather than a frame
+		bool m_reuse; // the frame is identical to the previous converted frame, so it wasn't converted
+		int64_t m_timestamp;
+		AVFrameHints m_hints;
+
+		// The converted frame, NULL for pings, reused frames and frames that could not be converted.
+		std::unique_ptr<AVFrameWrapper> m_frame;
+
+		// copy of the input frame
+		unsigned int m_width, m_height;
+		AVPixelFormat m_format;
+		int m_colorspace;
+		bool m_letterbox; // preserve the aspect ratio instead of stretching the frame
+		TempBuffer<uint8_t> m_planes[4];
+		int m_strides[4];
+
+		bool m_claimed, m_done;
+
+	};
+
+	// Called for every job in the order in which they were added. The callback is never called by two threads at the same time.
+	typedef std::function<void(Job* job)> DeliverCallback;
+
+private:
+	unsigned int m_max_jobs;
+	unsigned int m_out_width, m_out_height;
+	AVPixelFormat m_out_format;
+	int m_out_colorspace;
+	DeliverCallback m_deliver_callback;
+
+	unsigned int m_max_tasks;
+
+	std::mutex m_mutex, m_deliver_mutex;
+	std::condition_variable m_condition_done;
+	std::deque<std::unique_ptr<Job> > m_jobs; // all jobs that have not been delivered yet, in order
+	std::vector<std::unique_ptr<Job> > m_free_jobs;
+	std::vector<std::unique_ptr<FastScaler> > m_free_scalers;
+	size_t m_pending_jobs; // the number of jobs that have not been claimed by a task yet
+	unsigned int m_running_tasks;
+
+	TaskScheduler::Group m_tasks; // must be destroyed first
+
+	std::atomic<uint64_t> m_stats_frames, m_stats_time_copy, m_stats_time_wait, m_stats_time_convert;
+
+public:
+	// 'threads' is the maximum number of frames that are converted at the same time.
+	ConversionPipeline(unsigned int threads, unsigned int max_jobs, unsigned int out_width, unsigned int out_height, AVPixelFormat out_format, int out_colorspace,
+					   const DeliverCallback& deliver_callback);
+	~ConversionPipeline();
+
+	// Copies a frame and adds it to the pipeline. The frame is converted into 'converted_frame', which should already have
+	// the output size and format. If 'reuse' is true, the frame is not converted or copied at all. If 'letterbox' is true,
+	// the aspect ratio of the frame is preserved and the remaining area is filled with black.
+	// This function is thread-safe, but frames are only kept in order if they are added by one thread.
+	void AddFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp,
+				  const AVFrameHints& hints, std::unique_ptr<AVFrameWrapper> converted_frame, bool reuse, bool letterbox = false);
+
+	// Adds a ping to the pipeline. Like AddFrame, this blocks if too many jobs are in flight.
+	// This function is thread-safe.
+	void AddPing(int64_t timestamp);
+
+	// Returns the CPU time used by the conversion tasks (in microseconds).
+	// This function is thread-safe.
+	inline int64_t GetCPUTime() { return m_tasks.GetCPUTime(); }
+
+	// Waits until all jobs have been delivered.
+	// This function is thread-safe.
+	void Flush();
+
+	// Returns the number of frames that should be converted at the same time for frames of the given size, or zero if the
+	// pipeline won't help.
+	static unsigned int GetRecommendedThreads(unsigned int width, unsigned int height);
+
+private:
+	std::unique_ptr<Job> NewJob(std::unique_lock<std::mutex>& lock);
+	void AddJob(std::unique_ptr<Job> job);
+	void DeliverJobs();
+
+	void ConversionTask();
+
+};
@@ -36,6 +36,13 @@ FastScaler::FastScaler() {
 	m_warn_swscale = true;
 	m_sws_context = NULL;
 
+	m_letterbox_width = 0;
+	m_letterbox_height = 0;
+	m_letterbox_box_x = 0;
+	m_letterbox_box_y = 0;
+	m_letterbox_box_width = 0;
+	m_letterbox_box_height = 0;
+
 }
 
 FastScaler::~FastScaler() {
@@ -146,6 +153,61 @@ void FastScaler::Scale(unsigned int in_width, unsigned int in_height, AVPixelFor
 
 }
 
+void FastScaler::ScaleLetterbox(unsigned int in_width, unsigned int in_height, AVPixelFormat in_format, int in_colorspace, const uint8_t* const* in_data, const int* in_stride,
+								unsigned int out_width, unsigned int out_height, AVPixelFormat out_format, int out_colorspace, uint8_t* const* out_data, const int* out_stride) {
+
+	unsigned int box_x, box_y, box_width, box_height;
+	GetLetterboxRectangle(in_width, in_height, out_width, out_height, &box_x, &box_y, &box_width, &box_height);
+
+	// if the aspect ratio already matches, there is nothing to fill
+	if(box_width == out_width && box_height == out_height) {
+		Scale(in_width, in_height, in_format, in_colorspace, in_data, in_stride, out_width, out_height, out_format, out_colorspace, out_data, out_stride);
+		return;
+	}
+
+	// clear the borders when the geometry changes, the box itself is overwritten by every frame
+	int letterbox_stride = grow_align16(out_width * 4);
+	if(m_letterbox_width != out_width || m_letterbox_height != out_height || m_letterbox_box_x != box_x || m_letterbox_box_y != box_y ||
+			m_letterbox_box_width != box_width || m_letterbox_box_height != box_height) {
+		m_letterbox_buffer.Alloc(letterbox_stride * out_height);
+		memset(m_letterbox_buffer.GetData(), 0, letterbox_stride * out_height);
+		m_letterbox_width = out_width;
+		m_letterbox_height = out_height;
+		m_letterbox_box_x = box_x;
+		m_letterbox_box_y = box_y;
+		m_letterbox_box_width = box_width;
+		m_letterbox_box_height = box_height;
+	}
+
+	// scale the input into the box, then convert the complete frame (this doesn't need any scaling anymore)
+	uint8_t *box_data = m_letterbox_buffer.GetData() + box_x * 4 + box_y * letterbox_stride;
+	Scale(in_width, in_height, in_format, in_colorspace, in_data, in_stride, box_width, box_height, AV_PIX_FMT_BGRA, out_colorspace, &box_data, &letterbox_stride);
+	const uint8_t *letterbox_data = m_letterbox_buffer.GetData();
+	Scale(out_width, out_height, AV_PIX_FMT_BGRA, out_colorspace, &letterbox_data, &letterbox_stride, out_width, out_height, out_format, out_colorspace, out_data, out_stride);
+
+}
+
+void FastScaler::GetLetterboxRectangle(unsigned int in_width, unsigned int in_height, unsigned int out_width, unsigned int out_height,
+									   unsigned int* box_x, unsigned int* box_y, unsigned int* box_width, unsigned int* box_height) {
+
+	// The box is a multiple of 4 pixels wide and starts at a multiple of 4 pixels, so the BGRA rows stay aligned for SSE.
+	// The height is even because some pixel formats (e.g. YUV420) require this.
+	if((uint64_t) in_width * out_height > (uint64_t) in_height * out_width) {
+		*box_width = out_width;
+		*box_height = std::min(out_height, std::max(2u, (unsigned int) ((uint64_t) in_height * out_width / in_width) / 2 * 2));
+	} else {
+		*box_width = std::min(out_width, std::max(4u, (unsigned int) ((uint64_t) in_width * out_height / in_height) / 4 * 4));
+		*box_height = out_height;
+	}
+	if(*box_width + 4 > out_width)
+		*box_width = out_width;
+	if(*box_height + 2 > out_height)
+		*box_height = out_height;
+	*box_x = (out_width - *box_width) / 2 / 4 * 4;
+	*box_y = (out_height - *box_height) / 2;
+
+}
+
 void FastScaler::Convert_BGRA_YUV444(unsigned int width, unsigned int height, const uint8_t* in_data, int in_stride, uint8_t* const out_data[3], const int out_stride[3]) {
 
 #if SSR_USE_X86_ASM
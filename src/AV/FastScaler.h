@@ -21,6 +21,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Global.h"
 
 #include "AVWrapper.h"
+#include "TempBuffer.h"
 
 class FastScaler {
 
@@ -32,12 +33,24 @@ private:
 	bool m_warn_swscale;
 	SwsContext *m_sws_context;
 
+	// BGRA frame with black borders for letterboxing, the borders are only cleared when the geometry changes
+	TempBuffer<uint8_t> m_letterbox_buffer;
+	unsigned int m_letterbox_width, m_letterbox_height, m_letterbox_box_x, m_letterbox_box_y, m_letterbox_box_width, m_letterbox_box_height;
+
 public:
 	FastScaler();
 	~FastScaler();
 	void Scale(unsigned int in_width, unsigned int in_height, AVPixelFormat in_format, int in_colorspace, const uint8_t* const* in_data, const int* in_stride,
 			   unsigned int out_width, unsigned int out_height, AVPixelFormat out_format, int out_colorspace, uint8_t* const* out_data, const int* out_stride);
 
+	// Like Scale, but preserves the aspect ratio of the input and fills the remaining area with black.
+	void ScaleLetterbox(unsigned int in_width, unsigned int in_height, AVPixelFormat in_format, int in_colorspace, const uint8_t* const* in_data, const int* in_stride,
+						unsigned int out_width, unsigned int out_height, AVPixelFormat out_format, int out_colorspace, uint8_t* const* out_data, const int* out_stride);
+
+	// Calculates the area of the output frame that is used by ScaleLetterbox.
+	static void GetLetterboxRectangle(unsigned int in_width, unsigned int in_height, unsigned int out_width, unsigned int out_height,
+									  unsigned int* box_x, unsigned int* box_y, unsigned int* box_width, unsigned int* box_height);
+
 private:
 	void Convert_BGRA_YUV444(unsigned int width, unsigned int height, const uint8_t* in_data, int in_stride, uint8_t* const out_data[3], const int out_stride[3]);
 	void Convert_BGRA_YUV422(unsigned int width, unsigned int height, const uint8_t* in_data, int in_stride, uint8_t* const out_data[3], const int out_stride[3]);
@@ -0,0 +1,169 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FrameChangeDetector.h"
+
+// The size of the blocks (in pixels). Smaller blocks give a more accurate bounding box, but use more memory.
+const unsigned int FrameChangeDetector::BLOCK_SIZE = 16;
+
+// Only one out of this many rows is hashed per frame. This is a trade-off between the cost per frame and the delay before
+// a change in the rows that weren't hashed is detected. Should divide BLOCK_SIZE.
+const unsigned int FrameChangeDetector::HASH_ROW_STEP = 4;
+
+// A frame is considered a scene cut if at least this fraction of the blocks changed, and the average brightness of the blocks
+// changed by at least this amount (on a scale of 0-255).
+const double FrameChangeDetector::SCENE_CUT_FRACTION = 0.5;
+const unsigned int FrameChangeDetector::SCENE_CUT_BRIGHTNESS = 20;
+
+FrameChangeDetector::FrameChangeDetector() {
+	m_width = 0;
+	m_height = 0;
+	m_blocks_x = 0;
+	m_blocks_y = 0;
+	m_has_previous = false;
+	m_hash_phase = 0;
+}
+
+void FrameChangeDetector::Reset() {
+	m_has_previous = false;
+}
+
+FrameChangeInfo FrameChangeDetector::Analyze(unsigned int width, unsigned int height, const uint8_t* data, int stride) {
+
+	// reset everything if the size changed
+	if(width != m_width || height != m_height) {
+		m_width = width;
+		m_height = height;
+		m_blocks_x = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		m_blocks_y = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+		m_hashes.assign(m_blocks_x * m_blocks_y * HASH_ROW_STEP, 0);
+		m_new_hashes.assign(m_blocks_x * m_blocks_y, 0);
+		m_brightness.assign(m_blocks_x * m_blocks_y, 0);
+		m_previous_brightness.assign(m_blocks_x * m_blocks_y, 0);
+		m_has_previous = false;
+	}
+
+	// calculate the hash and brightness of every block
+	// The hash is FNV-1a applied to 32-bit pixels. Without a previous frame, all row phases are hashed directly into m_hashes.
+	// Otherwise only the rows of the current phase are hashed into m_new_hashes, so they can be compared with the old hashes.
+	// The brightness is only sampled at every fourth pixel of every fourth row, that's good enough.
+	unsigned int phase = m_hash_phase;
+	m_hash_phase = (m_hash_phase + 1) % HASH_ROW_STEP;
+	if(m_has_previous)
+		std::fill(m_new_hashes.begin(), m_new_hashes.end(), UINT64_C(14695981039346656037));
+	else
+		std::fill(m_hashes.begin(), m_hashes.end(), UINT64_C(14695981039346656037));
+	std::fill(m_brightness.begin(), m_brightness.end(), 0);
+	for(unsigned int y = 0; y < height; ++y) {
+		bool do_hash = (!m_has_previous || y % HASH_ROW_STEP == phase), do_brightness = (y % 4 == 0);
+		if(!do_hash && !do_brightness)
+			continue;
+		const uint32_t *row = (const uint32_t*) (data + (ptrdiff_t) stride * y);
+		unsigned int block_row = (y / BLOCK_SIZE) * m_blocks_x;
+		uint32_t *brightness = m_brightness.data() + block_row;
+		for(unsigned int bx = 0; bx < m_blocks_x; ++bx) {
+			unsigned int x1 = bx * BLOCK_SIZE, x2 = std::min(x1 + BLOCK_SIZE, width);
+			if(do_hash) {
+				uint64_t *hash_ptr = (m_has_previous)? &m_new_hashes[block_row + bx] : &m_hashes[(block_row + bx) * HASH_ROW_STEP + y % HASH_ROW_STEP];
+				uint64_t hash = *hash_ptr;
+				for(unsigned int x = x1; x < x2; ++x) {
+					hash = (hash ^ row[x]) * UINT64_C(1099511628211);
+				}
+				*hash_ptr = hash;
+			}
+			if(do_brightness) {
+				uint32_t sum = 0;
+				for(unsigned int x = x1; x < x2; x += 4) {
+					uint32_t c = row[x];
+					sum += ((c >> 16) & 0xff) * 2 + ((c >> 8) & 0xff) * 5 + (c & 0xff); // approximately 8 * luma
+				}
+				brightness[bx] += sum;
+			}
+		}
+	}
+
+	// normalize the brightness to a scale of 0-255
+	for(unsigned int by = 0; by < m_blocks_y; ++by) {
+		unsigned int rows = (std::min((by + 1) * BLOCK_SIZE, height) - by * BLOCK_SIZE + 3) / 4;
+		for(unsigned int bx = 0; bx < m_blocks_x; ++bx) {
+			unsigned int columns = (std::min((bx + 1) * BLOCK_SIZE, width) - bx * BLOCK_SIZE + 3) / 4;
+			m_brightness[by * m_blocks_x + bx] /= rows * columns * 8;
+		}
+	}
+
+	// compare with the previous frame
+	FrameChangeInfo info;
+	if(!m_has_previous) {
+		info.m_changed_fraction = 1.0;
+		info.m_x1 = 0;
+		info.m_y1 = 0;
+		info.m_x2 = width;
+		info.m_y2 = height;
+		info.m_scene_cut = true;
+	} else {
+		unsigned int changed = 0, bx1 = m_blocks_x, by1 = m_blocks_y, bx2 = 0, by2 = 0;
+		uint64_t brightness_diff = 0;
+		for(unsigned int by = 0; by < m_blocks_y; ++by) {
+			for(unsigned int bx = 0; bx < m_blocks_x; ++bx) {
+				unsigned int i = by * m_blocks_x + bx;
+				uint64_t &old_hash = m_hashes[i * HASH_ROW_STEP + phase];
+				if(m_new_hashes[i] != old_hash) {
+					old_hash = m_new_hashes[i];
+					++changed;
+					bx1 = std::min(bx1, bx);
+					by1 = std::min(by1, by);
+					bx2 = std::max(bx2, bx + 1);
+					by2 = std::max(by2, by + 1);
+				}
+				brightness_diff += (uint64_t) abs((int) m_brightness[i] - (int) m_previous_brightness[i]);
+			}
+		}
+		unsigned int blocks = m_blocks_x * m_blocks_y;
+		info.m_changed_fraction = (double) changed / (double) blocks;
+		if(changed == 0) {
+			info.m_x1 = info.m_y1 = info.m_x2 = info.m_y2 = 0;
+		} else {
+			info.m_x1 = bx1 * BLOCK_SIZE;
+			info.m_y1 = by1 * BLOCK_SIZE;
+			info.m_x2 = std::min(bx2 * BLOCK_SIZE, width);
+			info.m_y2 = std::min(by2 * BLOCK_SIZE, height);
+		}
+		info.m_scene_cut = (info.m_changed_fraction >= SCENE_CUT_FRACTION && brightness_diff >= (uint64_t) SCENE_CUT_BRIGHTNESS * blocks);
+	}
+
+	// keep the current frame for the next comparison (the new hashes have already been stored)
+	std::swap(m_brightness, m_previous_brightness);
+	m_has_previous = true;
+
+	return info;
+
+}
+
+AVFrameHints FrameChangeHints(const FrameChangeInfo& info, unsigned int in_width, unsigned int in_height, unsigned int out_width, unsigned int out_height) {
+	AVFrameHints hints = AVFrameHints();
+	hints.m_valid = true;
+	hints.m_static = (info.m_changed_fraction == 0.0);
+	hints.m_scene_cut = info.m_scene_cut;
+	hints.m_changed_fraction = info.m_changed_fraction;
+	hints.m_changed_x1 = (uint64_t) info.m_x1 * out_width / in_width;
+	hints.m_changed_y1 = (uint64_t) info.m_y1 * out_height / in_height;
+	hints.m_changed_x2 = ((uint64_t) info.m_x2 * out_width + in_width - 1) / in_width;
+	hints.m_changed_y2 = ((uint64_t) info.m_y2 * out_height + in_height - 1) / in_height;
+	return hints;
+}
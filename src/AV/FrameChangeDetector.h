@@ -0,0 +1,66 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "AVWrapper.h"
+
+struct FrameChangeInfo {
+	double m_changed_fraction; // the fraction of the frame that changed since the previous frame (0 = static, 1 = everything changed)
+	unsigned int m_x1, m_y1, m_x2, m_y2; // bounding box of the changes (in pixels), empty if nothing changed
+	bool m_scene_cut; // whether the content changed completely (e.g. switching to a different window or desktop)
+};
+
+// Detects which parts of a BGRA frame changed since the previous frame. The frame is divided into blocks, and only a hash and the
+// average brightness of every block are stored, so this is a lot cheaper than keeping a copy of the previous frame.
+// Scrolling changes every block, but it doesn't change the brightness of the blocks much, so it isn't considered a scene cut.
+// To keep the cost low on the capture thread, every frame only hashes one out of every HASH_ROW_STEP rows, and the rows rotate from
+// one frame to the next. The hash is compared with the hash of the same rows from HASH_ROW_STEP frames ago, so a change that
+// only affects rows that weren't hashed is detected a few frames later rather than not at all.
+class FrameChangeDetector {
+
+private:
+	static const unsigned int BLOCK_SIZE;
+	static const unsigned int HASH_ROW_STEP;
+	static const double SCENE_CUT_FRACTION;
+	static const unsigned int SCENE_CUT_BRIGHTNESS;
+
+private:
+	unsigned int m_width, m_height;
+	unsigned int m_blocks_x, m_blocks_y;
+	bool m_has_previous;
+	unsigned int m_hash_phase;
+	std::vector<uint64_t> m_hashes, m_new_hashes; // the last hash of every block for every row phase, and the new hash for the current phase
+	std::vector<uint32_t> m_brightness, m_previous_brightness;
+
+public:
+	FrameChangeDetector();
+
+	// Forgets the previous frame, the next frame will be considered a scene cut.
+	void Reset();
+
+	// Compares a frame with the previous frame. A change in frame size is considered a scene cut.
+	FrameChangeInfo Analyze(unsigned int width, unsigned int height, const uint8_t* data, int stride);
+
+};
+
+// Converts the result of FrameChangeDetector::Analyze to hints for the encoder. The bounding box is scaled from the size of the analyzed
+// frame to the size of the encoded frame (rounded outwards).
+AVFrameHints FrameChangeHints(const FrameChangeInfo& info, unsigned int in_width, unsigned int in_height, unsigned int out_width, unsigned int out_height);
@@ -0,0 +1,62 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "FrameSignature.h"
+
+// The number of samples per cell in each direction.
+static const unsigned int SIGNATURE_SAMPLES = 4;
+
+FrameSignature ComputeFrameSignature(const AVFrame* frame) {
+	FrameSignature signature;
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get((AVPixelFormat) frame->format);
+	if(desc == NULL || (desc->flags & AV_PIX_FMT_FLAG_HWACCEL) || frame->data[0] == NULL || frame->width <= 0 || frame->height <= 0)
+		return signature;
+
+	// for packed formats, only the first byte of every pixel is used (e.g. blue for BGRA)
+	unsigned int step = (desc->flags & AV_PIX_FMT_FLAG_PLANAR)? 1 : std::max(1, av_get_bits_per_pixel(desc) / 8);
+
+	unsigned int width = frame->width, height = frame->height;
+	for(unsigned int cy = 0; cy < FrameSignature::GRID_HEIGHT; ++cy) {
+		for(unsigned int cx = 0; cx < FrameSignature::GRID_WIDTH; ++cx) {
+			unsigned int sum = 0;
+			for(unsigned int sy = 0; sy < SIGNATURE_SAMPLES; ++sy) {
+				unsigned int y = ((cy * SIGNATURE_SAMPLES + sy) * 2 + 1) * height / (FrameSignature::GRID_HEIGHT * SIGNATURE_SAMPLES * 2);
+				const uint8_t *row = frame->data[0] + (ptrdiff_t) frame->linesize[0] * y;
+				for(unsigned int sx = 0; sx < SIGNATURE_SAMPLES; ++sx) {
+					unsigned int x = ((cx * SIGNATURE_SAMPLES + sx) * 2 + 1) * width / (FrameSignature::GRID_WIDTH * SIGNATURE_SAMPLES * 2);
+					sum += row[x * step];
+				}
+			}
+			signature.m_cells[cy * FrameSignature::GRID_WIDTH + cx] = (sum + SIGNATURE_SAMPLES * SIGNATURE_SAMPLES / 2) / (SIGNATURE_SAMPLES * SIGNATURE_SAMPLES);
+		}
+	}
+	signature.m_valid = true;
+
+	return signature;
+}
+
+double FrameSignatureDifference(const FrameSignature& a, const FrameSignature& b) {
+	if(!a.m_valid || !b.m_valid)
+		return 255.0;
+	unsigned int sum = 0;
+	for(size_t i = 0; i < a.m_cells.size(); ++i) {
+		sum += abs((int) a.m_cells[i] - (int) b.m_cells[i]);
+	}
+	return (double) sum / (double) a.m_cells.size();
+}
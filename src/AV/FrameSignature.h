@@ -0,0 +1,42 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+// A tiny thumbnail of the first plane of a frame (the luma plane for YUV formats), used to estimate how different two frames
+// are without keeping a copy of either frame. Every cell is the average of a few samples, so computing a signature only reads
+// a few thousand bytes regardless of the frame size.
+struct FrameSignature {
+
+	static const unsigned int GRID_WIDTH = 32, GRID_HEIGHT = 18;
+
+	bool m_valid;
+	std::array<uint8_t, GRID_WIDTH * GRID_HEIGHT> m_cells;
+
+	inline FrameSignature() : m_valid(false) {}
+
+};
+
+// Calculates the signature of a frame. Returns an invalid signature if the pixel format isn't supported.
+FrameSignature ComputeFrameSignature(const AVFrame* frame);
+
+// Returns the mean absolute difference between two signatures (0 = identical, 255 = completely different).
+// If one of the signatures is invalid, the frames are assumed to be completely different.
+double FrameSignatureDifference(const FrameSignature& a, const FrameSignature& b);
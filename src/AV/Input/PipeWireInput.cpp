@@ -29,6 +29,13 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include <spa/pod/builder.h>
 #include <spa/utils/result.h>
 
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <linux/dma-buf.h>
+
+// The maximum number of damage regions per buffer.
+static const unsigned int MAX_DAMAGE_REGIONS = 16;
+
 PipeWireInput::PipeWireInput(const QString& node_id, unsigned int width, unsigned int height, unsigned int frame_rate) {
 
 	m_node_id = node_id;
@@ -42,6 +49,18 @@ PipeWireInput::PipeWireInput(const QString& node_id, unsigned int width, unsigne
 	m_loop = nullptr;
 	m_stream = nullptr;
 
+	m_persistent_width = 0;
+	m_persistent_height = 0;
+	m_persistent_pixel_format = AV_PIX_FMT_NONE;
+	m_persistent_valid = false;
+	m_damage_trusted = false;
+
+	m_stats_full_frames = 0;
+	m_stats_damaged_frames = 0;
+	m_stats_repeated_frames = 0;
+	m_stats_bytes_copied = 0;
+	m_stats_bytes_total = 0;
+
 	if(m_width == 0 || m_height == 0) {
 		Logger::LogError("[PipeWireInput::Init] " + Logger::tr("Error: Width or height is zero!"));
 		throw PipeWireException();
@@ -73,6 +92,14 @@ PipeWireInput::~PipeWireInput() {
 		m_thread.join();
 	}
 
+	// report how much was saved by the damage tracking
+	uint64_t frames = m_stats_full_frames + m_stats_damaged_frames + m_stats_repeated_frames;
+	if(frames != 0) {
+		Logger::LogInfo("[PipeWireInput::~PipeWireInput] " + Logger::tr("Damage tracking: %1 direct frames, %2 partial frames, %3 repeated frames, the partial frames copied %4% of the image data.")
+						.arg(m_stats_full_frames).arg(m_stats_damaged_frames).arg(m_stats_repeated_frames)
+						.arg((m_stats_bytes_total == 0)? 0.0 : 100.0 * (double) m_stats_bytes_copied / (double) m_stats_bytes_total, 0, 'f', 1));
+	}
+
 	// free everything
 	Free();
 
@@ -110,6 +137,8 @@ void PipeWireInput::Init() {
 	m_stream_events.version = PW_VERSION_STREAM_EVENTS;
 	m_stream_events.process = &PipeWireInput::OnProcess;
 	m_stream_events.param_changed = &PipeWireInput::OnParamChange;
+	m_stream_events.add_buffer = &PipeWireInput::OnAddBuffer;
+	m_stream_events.remove_buffer = &PipeWireInput::OnRemoveBuffer;
 
 	m_stream = pw_stream_new_simple(
 		pw_main_loop_get_loop(m_loop),
@@ -162,7 +191,7 @@ void PipeWireInput::Init() {
 	int res = pw_stream_connect(m_stream,
 		PW_DIRECTION_INPUT,
 		pw_properties_parse_int(m_node_id.toUtf8().constData()),
-		(pw_stream_flags) (PW_STREAM_FLAG_AUTOCONNECT | PW_STREAM_FLAG_MAP_BUFFERS),
+		PW_STREAM_FLAG_AUTOCONNECT, // the buffers are mapped in OnAddBuffer
 		params, 1);
 	if(res != 0) {
 		Logger::LogError("[PipeWireInput::Init] " + Logger::tr("Error: Failed to connect stream!"));
@@ -194,6 +223,139 @@ void PipeWireInput::Free() {
 	pw_deinit();
 }
 
+void PipeWireInput::UpdateStreamParams() {
+
+	uint8_t buffer[1024];
+	spa_pod_builder b = SPA_POD_BUILDER_INIT(buffer, sizeof(buffer));
+
+	// we can read shared memory and linear DMA-BUFs directly, and we want to know which parts of the image have changed
+	const struct spa_pod *params[2];
+	params[0] = (const struct spa_pod*) spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_ParamBuffers, SPA_PARAM_Buffers,
+		SPA_PARAM_BUFFERS_buffers, SPA_POD_CHOICE_RANGE_Int(m_buffers, 2, 16),
+		SPA_PARAM_BUFFERS_dataType, SPA_POD_CHOICE_FLAGS_Int((1 << SPA_DATA_MemPtr) | (1 << SPA_DATA_MemFd) | (1 << SPA_DATA_DmaBuf)));
+	params[1] = (const struct spa_pod*) spa_pod_builder_add_object(&b,
+		SPA_TYPE_OBJECT_ParamMeta, SPA_PARAM_Meta,
+		SPA_PARAM_META_type, SPA_POD_Id(SPA_META_VideoDamage),
+		SPA_PARAM_META_size, SPA_POD_CHOICE_RANGE_Int(sizeof(struct spa_meta_region) * MAX_DAMAGE_REGIONS,
+													  sizeof(struct spa_meta_region) * 1, sizeof(struct spa_meta_region) * MAX_DAMAGE_REGIONS));
+
+	pw_stream_update_params(m_stream, params, 2);
+
+}
+
+// Decides how the buffer should be pushed. The persistent frame is only used when the producer reports partial damage: the damaged
+// rows are copied, so the rest of the buffer is never read. Without (trustworthy) damage information the buffer is pushed directly,
+// since copying it first would only add a full-frame memcpy.
+PipeWireInput::enum_frame_update PipeWireInput::UpdatePersistentFrame(spa_buffer* buf, PipeWireBuffer* pw_buffer) {
+
+	const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(m_pixel_format);
+	unsigned int planes = std::min((size_t) buf->n_datas, pw_buffer->m_mappings.size());
+	for(unsigned int p = 0; p < planes; ++p) {
+		if(pw_buffer->m_mappings[p].m_data == NULL || buf->datas[p].chunk->stride <= 0)
+			return FRAME_UPDATE_UNCHANGED;
+	}
+
+	// a buffer without any video data only updates metadata (e.g. the cursor)
+	if(buf->datas[0].chunk->size == 0) {
+		++m_stats_repeated_frames;
+		return FRAME_UPDATE_UNCHANGED;
+	}
+
+	// get the damaged rows
+	std::vector<std::pair<unsigned int, unsigned int> > damage;
+	bool partial = false;
+	spa_meta *meta = spa_buffer_find_meta(buf, SPA_META_VideoDamage);
+	if(meta != NULL) {
+		spa_meta_region *region;
+		spa_meta_for_each(region, meta) {
+			if(!spa_meta_region_is_valid(region))
+				break;
+			int64_t y1 = clamp<int64_t>(region->region.position.y, 0, m_height);
+			int64_t y2 = clamp<int64_t>((int64_t) region->region.position.y + (int64_t) region->region.size.height, 0, m_height);
+			if(y1 < y2)
+				damage.emplace_back(y1, y2);
+			if(region->region.size.width < m_width || region->region.size.height < m_height) {
+				m_damage_trusted = true;
+				partial = true;
+			}
+		}
+	}
+
+	// producers that don't support damage leave the regions empty, so an empty list only means 'unchanged' once the
+	// producer has shown that it actually reports damage
+	if(meta != NULL && damage.empty() && m_damage_trusted) {
+		++m_stats_repeated_frames;
+		return FRAME_UPDATE_UNCHANGED;
+	}
+
+	// without partial damage, the whole buffer has to be read anyway
+	if(!partial) {
+		m_persistent_valid = false;
+		++m_stats_full_frames;
+		return FRAME_UPDATE_DIRECT;
+	}
+
+	// check whether the persistent frame still matches the stream
+	bool full = (!m_persistent_valid || m_persistent_width != m_width || m_persistent_height != m_height ||
+				 m_persistent_pixel_format != m_pixel_format || m_persistent_planes.size() != planes);
+	if(!full) {
+		for(unsigned int p = 0; p < planes; ++p) {
+			if(m_persistent_planes[p].m_stride != buf->datas[p].chunk->stride) {
+				full = true;
+				break;
+			}
+		}
+	}
+
+	// (re)allocate the persistent frame, the first copy has to be complete
+	if(full) {
+		m_persistent_planes.resize(planes);
+		for(unsigned int p = 0; p < planes; ++p) {
+			PersistentPlane &plane = m_persistent_planes[p];
+			plane.m_stride = buf->datas[p].chunk->stride;
+			plane.m_rows = (p == 0 || desc == NULL)? m_height : -((-(int) m_height) >> desc->log2_chroma_h);
+			plane.m_data.resize((size_t) plane.m_stride * (size_t) plane.m_rows);
+		}
+		m_persistent_width = m_width;
+		m_persistent_height = m_height;
+		m_persistent_pixel_format = m_pixel_format;
+		m_persistent_valid = true;
+		damage.clear();
+		damage.emplace_back(0, m_height);
+	} else {
+		std::sort(damage.begin(), damage.end());
+		size_t merged = 0;
+		for(size_t i = 1; i < damage.size(); ++i) {
+			if(damage[i].first <= damage[merged].second) {
+				damage[merged].second = std::max(damage[merged].second, damage[i].second);
+			} else {
+				damage[++merged] = damage[i];
+			}
+		}
+		damage.resize(merged + 1);
+	}
+
+	// copy the damaged rows of every plane
+	for(unsigned int p = 0; p < planes; ++p) {
+		PersistentPlane &plane = m_persistent_planes[p];
+		size_t row_size = plane.m_stride;
+		const uint8_t *source = pw_buffer->m_mappings[p].m_data + buf->datas[p].chunk->offset % buf->datas[p].maxsize;
+		unsigned int shift = (p == 0 || desc == NULL)? 0 : desc->log2_chroma_h;
+		for(auto &range : damage) {
+			unsigned int y1 = range.first >> shift, y2 = std::min(plane.m_rows, (range.second + (1u << shift) - 1) >> shift);
+			if(y1 < y2) {
+				memcpy(plane.m_data.data() + row_size * y1, source + row_size * y1, row_size * (y2 - y1));
+				m_stats_bytes_copied += row_size * (y2 - y1);
+			}
+		}
+		m_stats_bytes_total += row_size * plane.m_rows;
+	}
+	++m_stats_damaged_frames;
+
+	return FRAME_UPDATE_PERSISTENT;
+}
+
 void PipeWireInput::InputThread() {
 	try {
 		Logger::LogInfo("[PipeWireInput::InputThread] " + Logger::tr("Input thread started."));
@@ -232,8 +394,11 @@ void PipeWireInput::OnProcess(void *userdata) {
 	}
 
 	buf = b->buffer;
-	if(buf->datas[0].data == nullptr)
+	PipeWireBuffer *pw_buffer = static_cast<PipeWireBuffer*>(b->user_data);
+	if(pw_buffer == nullptr || buf->n_datas == 0 || (buf->datas[0].chunk->flags & SPA_CHUNK_FLAG_CORRUPTED)) {
+		pw_stream_queue_buffer(input->m_stream, b);
 		return;
+	}
 
 	int64_t timestamp = hrt_time_micro();
 	++input->m_frame_counter;
@@ -241,16 +406,51 @@ void PipeWireInput::OnProcess(void *userdata) {
 	if(input->m_pixel_format == AV_PIX_FMT_NONE) {
 		Logger::LogError("[PipeWireInput::OnProcess] " + Logger::tr("Error: Unknown pixel format!"));
 	} else {
-		std::vector<const uint8_t*> image_data(buf->n_datas);
-		std::vector<int> image_stride(buf->n_datas);
-		for(size_t i = 0; i < buf->n_datas; ++i) {
-			image_data[i] = (uint8_t*) buf->datas[i].data + buf->datas[i].chunk->offset % buf->datas[i].maxsize;
-			image_stride[i] = buf->datas[i].chunk->stride;
+
+		// the buffer is read until the frame has been pushed
+		for(PipeWireMapping &mapping : pw_buffer->m_mappings) {
+			if(mapping.m_dmabuf_fd != -1) {
+				struct dma_buf_sync sync = {DMA_BUF_SYNC_START | DMA_BUF_SYNC_READ};
+				ioctl(mapping.m_dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync);
+			}
+		}
+
+		// an unchanged frame is just a repeat, the synchronizer will duplicate the previous frame
+		enum_frame_update update = input->UpdatePersistentFrame(buf, pw_buffer);
+		if(update == FRAME_UPDATE_DIRECT) {
+			unsigned int planes = std::min((size_t) buf->n_datas, pw_buffer->m_mappings.size());
+			std::vector<const uint8_t*> image_data(planes);
+			std::vector<int> image_stride(planes);
+			for(size_t i = 0; i < planes; ++i) {
+				image_data[i] = pw_buffer->m_mappings[i].m_data + buf->datas[i].chunk->offset % buf->datas[i].maxsize;
+				image_stride[i] = buf->datas[i].chunk->stride;
+			}
+			input->PushVideoFrame(
+				input->m_width, input->m_height,
+				image_data.data(), image_stride.data(),
+				input->m_pixel_format, input->m_colorspace, timestamp);
+		} else if(update == FRAME_UPDATE_PERSISTENT) {
+			std::vector<const uint8_t*> image_data(input->m_persistent_planes.size());
+			std::vector<int> image_stride(input->m_persistent_planes.size());
+			for(size_t i = 0; i < input->m_persistent_planes.size(); ++i) {
+				image_data[i] = input->m_persistent_planes[i].m_data.data();
+				image_stride[i] = input->m_persistent_planes[i].m_stride;
+			}
+			input->PushVideoFrame(
+				input->m_width, input->m_height,
+				image_data.data(), image_stride.data(),
+				input->m_pixel_format, input->m_colorspace, timestamp);
+		} else {
+			input->PushVideoPing(timestamp);
+		}
+
+		for(PipeWireMapping &mapping : pw_buffer->m_mappings) {
+			if(mapping.m_dmabuf_fd != -1) {
+				struct dma_buf_sync sync = {DMA_BUF_SYNC_END | DMA_BUF_SYNC_READ};
+				ioctl(mapping.m_dmabuf_fd, DMA_BUF_IOCTL_SYNC, &sync);
+			}
 		}
-		input->PushVideoFrame(
-			input->m_width, input->m_height,
-			image_data.data(), image_stride.data(),
-			input->m_pixel_format, input->m_colorspace, timestamp);
+
 	}
 
 	pw_stream_queue_buffer(input->m_stream, b);
@@ -302,6 +502,59 @@ void PipeWireInput::OnParamChange(void *userdata, uint32_t id, const struct spa_
 		.arg(info.info.raw.size.height)
 		.arg(spa_debug_type_find_name(spa_type_video_format, info.info.raw.format)));
 
+	// the persistent frame has to be copied completely after a format change
+	input->m_persistent_valid = false;
+	input->UpdateStreamParams();
+
+}
+
+void PipeWireInput::OnAddBuffer(void* userdata, pw_buffer* buffer) {
+	spa_buffer *buf = buffer->buffer;
+
+	// map the buffer once, so we don't have to do it for every frame
+	std::unique_ptr<PipeWireBuffer> pw_buffer(new PipeWireBuffer());
+	pw_buffer->m_mappings.resize(buf->n_datas);
+	for(size_t i = 0; i < buf->n_datas; ++i) {
+		spa_data &data = buf->datas[i];
+		PipeWireMapping &mapping = pw_buffer->m_mappings[i];
+		mapping.m_data = NULL;
+		mapping.m_map_data = NULL;
+		mapping.m_map_size = 0;
+		mapping.m_dmabuf_fd = -1;
+		if(data.type == SPA_DATA_MemPtr) {
+			mapping.m_data = (uint8_t*) data.data;
+		} else if(data.type == SPA_DATA_MemFd || data.type == SPA_DATA_DmaBuf) {
+			size_t size = data.mapoffset + data.maxsize;
+			void *map_data = mmap(NULL, size, PROT_READ, MAP_SHARED, data.fd, 0);
+			if(map_data == MAP_FAILED) {
+				Logger::LogWarning("[PipeWireInput::OnAddBuffer] " + Logger::tr("Warning: Failed to map buffer memory!"));
+				continue;
+			}
+			mapping.m_data = (uint8_t*) map_data + data.mapoffset;
+			mapping.m_map_data = map_data;
+			mapping.m_map_size = size;
+			if(data.type == SPA_DATA_DmaBuf)
+				mapping.m_dmabuf_fd = data.fd;
+		} else {
+			Logger::LogWarning("[PipeWireInput::OnAddBuffer] " + Logger::tr("Warning: Unsupported buffer type %1!").arg(data.type));
+		}
+	}
+	buffer->user_data = pw_buffer.release();
+
+	Q_UNUSED(userdata);
+}
+
+void PipeWireInput::OnRemoveBuffer(void* userdata, pw_buffer* buffer) {
+	PipeWireBuffer *pw_buffer = static_cast<PipeWireBuffer*>(buffer->user_data);
+	if(pw_buffer == nullptr)
+		return;
+	for(PipeWireMapping &mapping : pw_buffer->m_mappings) {
+		if(mapping.m_map_data != NULL)
+			munmap(mapping.m_map_data, mapping.m_map_size);
+	}
+	delete pw_buffer;
+	buffer->user_data = nullptr;
+	Q_UNUSED(userdata);
 }
 
 #endif
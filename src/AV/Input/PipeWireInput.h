@@ -28,14 +28,31 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include <pipewire/pipewire.h>
 #include <spa/param/video/format-utils.h>
 #include <spa/param/props.h>
+#include <spa/param/param.h>
+#include <spa/buffer/meta.h>
 #include <spa/debug/types.h>
 
 class PipeWireInput : public VideoSource {
 
 private:
+	enum enum_frame_update {
+		FRAME_UPDATE_UNCHANGED, // nothing has changed, the previous frame should be repeated
+		FRAME_UPDATE_DIRECT, // the buffer should be pushed directly
+		FRAME_UPDATE_PERSISTENT, // the damaged regions were copied, the persistent frame should be pushed
+	};
+	struct PipeWireMapping {
+		uint8_t *m_data; // start of the mapped data (including the map offset), or NULL if the data can't be read
+		void *m_map_data; // the mapping that has to be unmapped, or NULL if the memory is not owned by us
+		size_t m_map_size;
+		int m_dmabuf_fd; // file descriptor for DMA-BUF synchronization, or -1
+	};
 	struct PipeWireBuffer {
-		void *m_data;
-		size_t m_size;
+		std::vector<PipeWireMapping> m_mappings;
+	};
+	struct PersistentPlane {
+		std::vector<uint8_t> m_data;
+		int m_stride;
+		unsigned int m_rows;
 	};
 
 private:
@@ -54,7 +71,16 @@ private:
 	pw_stream_events m_stream_events;
 	pw_stream *m_stream;
 	spa_hook m_stream_listener;
-	std::vector<PipeWireBuffer> m_pw_buffers;
+
+	// persistent copy of the last frame, only used while the producer reports partial damage
+	std::vector<PersistentPlane> m_persistent_planes;
+	unsigned int m_persistent_width, m_persistent_height;
+	AVPixelFormat m_persistent_pixel_format;
+	bool m_persistent_valid;
+	bool m_damage_trusted; // whether the producer has sent damage regions that didn't cover the whole frame
+
+	uint64_t m_stats_full_frames, m_stats_damaged_frames, m_stats_repeated_frames;
+	uint64_t m_stats_bytes_copied, m_stats_bytes_total;
 
 	std::thread m_thread;
 	std::atomic<bool> m_should_stop, m_error_occurred;
@@ -80,13 +106,15 @@ private:
 	void Free();
 
 private:
-	void AllocateBuffers(unsigned int width, unsigned int height);
-	void FreeBuffers();
+	void UpdateStreamParams();
+	enum_frame_update UpdatePersistentFrame(spa_buffer *buf, PipeWireBuffer *pw_buffer);
 
 private:
 	void InputThread();
 	static void OnProcess(void *userdata);
 	static void OnParamChange(void *userdata, uint32_t id, const struct spa_pod *param);
+	static void OnAddBuffer(void *userdata, pw_buffer *buffer);
+	static void OnRemoveBuffer(void *userdata, pw_buffer *buffer);
 
 };
 
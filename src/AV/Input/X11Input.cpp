@@ -161,6 +161,97 @@ static void X11ImageDrawCursor(Display* dpy, XImage* image, int recording_area_x
 
 }
 
+// Calculates a hash of the image to detect whether it has changed. Every row is used, because small changes (e.g. a blinking
+// caret) can be confined to a few rows and the input would otherwise keep sending pings instead of the new image.
+// This is still much cheaper than the conversion.
+static uint64_t X11ImageHash(XImage* image) {
+	size_t row_bytes = (size_t) image->width * (size_t) (image->bits_per_pixel / 8);
+	uint64_t hash = 0xcbf29ce484222325ull;
+	for(int y = 0; y < image->height; ++y) {
+		const uint8_t *row = (const uint8_t*) image->data + (size_t) y * (size_t) image->bytes_per_line;
+		size_t i = 0;
+		for( ; i + 8 <= row_bytes; i += 8) {
+			uint64_t v;
+			memcpy(&v, row + i, 8);
+			hash = (hash ^ v) * 0x100000001b3ull;
+		}
+		for( ; i < row_bytes; ++i) {
+			hash = (hash ^ row[i]) * 0x100000001b3ull;
+		}
+	}
+	return hash;
+}
+
+// With the adaptive frame rate, the input becomes idle after this many unchanged frames.
+static const unsigned int IDLE_FRAME_THRESHOLD = 10;
+
+// While idle, the interval between captured frames starts at the initial value and doubles after every unchanged frame,
+// until it reaches the maximum (in microseconds). The maximum is the floor of the capture frame rate.
+static const int64_t IDLE_INITIAL_INTERVAL = 100000, IDLE_MAX_INTERVAL = 1000000;
+
+// While idle, the cursor position is checked at this interval (in microseconds), and a ping is sent to the sinks.
+static const int64_t IDLE_POLL_INTERVAL = 20000;
+
+// The active window is only checked at this interval (in microseconds), since this takes several round trips to the X server.
+static const int64_t FOCUS_WINDOW_INTERVAL = 200000;
+
+// The active window can be destroyed at any time, and the default error handler of Xlib terminates the program,
+// so errors are caught with a temporary error handler. Error handlers are global, hence the mutex.
+static std::mutex g_x11_error_mutex;
+static bool g_x11_error_occurred = false;
+static int X11RecordErrorHandler(Display* dpy, XErrorEvent* error) {
+	Q_UNUSED(dpy);
+	Q_UNUSED(error);
+	g_x11_error_occurred = true;
+	return 0;
+}
+
+// Gets the rectangle of the active window (including decorations), relative to the root window. Requires a window manager
+// that supports _NET_ACTIVE_WINDOW. Returns false if there is no active window.
+static bool X11GetActiveWindowRect(Display* dpy, Window root, Atom net_active_window, int* x1, int* y1, int* x2, int* y2) {
+
+	if(net_active_window == None)
+		return false;
+
+	std::lock_guard<std::mutex> lock(g_x11_error_mutex);
+	XSync(dpy, false);
+	g_x11_error_occurred = false;
+	int (*old_handler)(Display*, XErrorEvent*) = XSetErrorHandler(&X11RecordErrorHandler);
+
+	// get the active window
+	Window window = None;
+	Atom actual_type;
+	int actual_format;
+	unsigned long items, bytes_left;
+	unsigned char *data = NULL;
+	if(XGetWindowProperty(dpy, root, net_active_window, 0, 1, false, XA_WINDOW, &actual_type, &actual_format, &items, &bytes_left, &data) == Success) {
+		if(actual_type == XA_WINDOW && actual_format == 32 && items == 1)
+			window = *(Window*) data; // format 32 means 'long', even if long is 64-bit ...
+	}
+	if(data != NULL)
+		XFree(data);
+
+	// get the rectangle
+	bool success = false;
+	if(window != None) {
+		XWindowAttributes attributes;
+		Window child;
+		int x, y;
+		if(XGetWindowAttributes(dpy, window, &attributes) && XTranslateCoordinates(dpy, window, root, 0, 0, &x, &y, &child)) {
+			*x1 = x - attributes.border_width;
+			*y1 = y - attributes.border_width;
+			*x2 = x + attributes.width + attributes.border_width;
+			*y2 = y + attributes.height + attributes.border_width;
+			success = true;
+		}
+	}
+
+	XSync(dpy, false);
+	XSetErrorHandler(old_handler);
+	return (success && !g_x11_error_occurred);
+
+}
+
 X11Input::X11Input(unsigned int x, unsigned int y, unsigned int width, unsigned int height, bool record_cursor, bool follow_cursor, bool follow_full_screen) {
 
 	m_x = x;
@@ -170,6 +261,7 @@ X11Input::X11Input(unsigned int x, unsigned int y, unsigned int width, unsigned
 	m_record_cursor = record_cursor;
 	m_follow_cursor = follow_cursor;
 	m_follow_fullscreen = follow_full_screen;
+	m_adaptive_frame_rate = false;
 
 	m_x11_display = NULL;
 	m_x11_image = NULL;
@@ -187,7 +279,13 @@ X11Input::X11Input(unsigned int x, unsigned int y, unsigned int width, unsigned
 		lock->m_current_y = m_y;
 		lock->m_current_width = m_width;
 		lock->m_current_height = m_height;
+		lock->m_requested_x = m_x;
+		lock->m_requested_y = m_y;
+		lock->m_requested_width = m_width;
+		lock->m_requested_height = m_height;
+		lock->m_requested_time = 0;
 	}
+	m_rectangle_requested = false;
 
 	if(m_width == 0 || m_height == 0) {
 		Logger::LogError("[X11Input::Init] " + Logger::tr("Error: Width or height is zero!"));
@@ -229,6 +327,33 @@ void X11Input::GetCurrentRectangle(unsigned int *x, unsigned int *y, unsigned in
 	*height = lock->m_current_height;
 }
 
+bool X11Input::SetRectangle(unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height) {
+	if(m_follow_cursor && m_follow_fullscreen) {
+		Logger::LogWarning("[X11Input::SetRectangle] " + Logger::tr("Warning: The recording area can't be changed while following the cursor between screens."));
+		return false;
+	}
+	if(*width == 0 || *height == 0 || *width > SSR_MAX_IMAGE_SIZE || *height > SSR_MAX_IMAGE_SIZE) {
+		Logger::LogWarning("[X11Input::SetRectangle] " + Logger::tr("Warning: Invalid recording area size %1x%2!").arg(*width).arg(*height));
+		return false;
+	}
+	// the rectangle has to stay inside the screen, otherwise the image can't be captured
+	// the screen configuration doesn't change after Init, so this is safe without locking
+	*width = std::min(*width, m_screen_bbox.m_x2 - m_screen_bbox.m_x1);
+	*height = std::min(*height, m_screen_bbox.m_y2 - m_screen_bbox.m_y1);
+	*x = clamp(*x, m_screen_bbox.m_x1, m_screen_bbox.m_x2 - *width);
+	*y = clamp(*y, m_screen_bbox.m_y1, m_screen_bbox.m_y2 - *height);
+	{
+		SharedLock lock(&m_shared_data);
+		lock->m_requested_x = *x;
+		lock->m_requested_y = *y;
+		lock->m_requested_width = *width;
+		lock->m_requested_height = *height;
+		lock->m_requested_time = hrt_time_micro();
+	}
+	m_rectangle_requested = true;
+	return true;
+}
+
 void X11Input::GetCurrentSize(unsigned int *width, unsigned int *height) {
 	SharedLock lock(&m_shared_data);
 	*width = lock->m_current_width;
@@ -248,6 +373,12 @@ double X11Input::GetFPS() {
 	return m_fps_current;
 }
 
+void X11Input::GetGrabStats(uint64_t* grabs, int64_t* time_sum, int64_t* time_max) {
+	*grabs = m_grab_counter;
+	*time_sum = m_grab_time_sum;
+	*time_max = m_grab_time_max.exchange(0);
+}
+
 void X11Input::Init() {
 
 	// do the X11 stuff
@@ -277,6 +408,9 @@ void X11Input::Init() {
 		}
 	}
 
+	// this is only used when a sink wants to know where the active window is
+	m_x11_net_active_window = XInternAtom(m_x11_display, "_NET_ACTIVE_WINDOW", true);
+
 	// get screen configuration information, so we can replace the unused areas with black rectangles (rather than showing random uninitialized memory)
 	// this is also used by the mouse following code to make sure that the rectangle stays on the screen
 	UpdateScreenConfiguration();
@@ -286,6 +420,9 @@ void X11Input::Init() {
 	m_fps_last_timestamp = hrt_time_micro();
 	m_fps_last_counter = 0;
 	m_fps_current = 0.0;
+	m_grab_counter = 0;
+	m_grab_time_sum = 0;
+	m_grab_time_max = 0;
 
 	// start input thread
 	m_should_stop = false;
@@ -467,6 +604,18 @@ void X11Input::InputThread() {
 		unsigned int grab_x = m_x, grab_y = m_y, grab_width = m_width, grab_height = m_height;
 		bool has_initial_cursor = false;
 		int64_t last_timestamp = hrt_time_micro();
+		int64_t next_focus_window_check = 0;
+		bool has_focus_window = false;
+		int focus_window_x1 = 0, focus_window_y1 = 0, focus_window_x2 = 0, focus_window_y2 = 0;
+
+		// adaptive frame rate state
+		uint64_t idle_last_hash = 0;
+		unsigned int idle_unchanged_frames = 0;
+		int64_t idle_interval = 0, idle_next_grab = 0; // idle_next_grab is zero when the input is not idle
+		int idle_mouse_x = 0, idle_mouse_y = 0;
+		int64_t idle_stats_last_time = last_timestamp, idle_stats_last_cpu = this_thread_cpu_time_micro();
+		int64_t idle_stats_time[2] = {0, 0}, idle_stats_cpu[2] = {0, 0}; // active and idle
+		uint64_t idle_stats_frames = 0, idle_stats_pings = 0;
 
 		while(!m_should_stop) {
 
@@ -488,6 +637,56 @@ void X11Input::InputThread() {
 				}
 			}
 
+			// adaptive frame rate statistics
+			if(m_adaptive_frame_rate) {
+				int64_t cpu = this_thread_cpu_time_micro();
+				unsigned int state = (idle_next_grab != 0)? 1 : 0;
+				idle_stats_time[state] += timestamp - idle_stats_last_time;
+				idle_stats_cpu[state] += cpu - idle_stats_last_cpu;
+				idle_stats_last_time = timestamp;
+				idle_stats_last_cpu = cpu;
+			}
+
+			// switch to the requested rectangle, this happens between two frames so the next frame is the first one with the new rectangle
+			if(m_rectangle_requested) {
+				m_rectangle_requested = false;
+				int64_t requested_time;
+				{
+					SharedLock lock(&m_shared_data);
+					grab_x = lock->m_requested_x;
+					grab_y = lock->m_requested_y;
+					grab_width = lock->m_requested_width;
+					grab_height = lock->m_requested_height;
+					requested_time = lock->m_requested_time;
+				}
+				has_initial_cursor = false;
+				idle_unchanged_frames = 0;
+				idle_next_grab = 0;
+				Logger::LogInfo("[X11Input::InputThread] " + Logger::tr("Recording area changed to %1x%2 at %3,%4 after %5 ms.")
+								.arg(grab_width).arg(grab_height).arg(grab_x).arg(grab_y).arg((double) (hrt_time_micro() - requested_time) * 1.0e-3, 0, 'f', 1));
+			}
+
+			// While idle, only check whether the cursor has moved until it is time for the next capture. This is a lot cheaper
+			// than capturing the image. The ping tells the sinks that time has passed, so they can repeat the previous frame if needed.
+			if(idle_next_grab != 0) {
+				if(!m_adaptive_frame_rate) {
+					idle_next_grab = 0;
+				} else if(timestamp < idle_next_grab) {
+					int mouse_x, mouse_y, dummy;
+					Window dummy_win;
+					unsigned int dummy_mask;
+					if(XQueryPointer(m_x11_display, m_x11_root, &dummy_win, &dummy_win, &dummy, &dummy, &mouse_x, &mouse_y, &dummy_mask) &&
+							mouse_x == idle_mouse_x && mouse_y == idle_mouse_y) {
+						PushVideoPing(timestamp);
+						++idle_stats_pings;
+						usleep(std::min(IDLE_POLL_INTERVAL, idle_next_grab - timestamp));
+						continue;
+					}
+					idle_unchanged_frames = 0;
+					idle_next_grab = 0;
+				}
+			}
+
 			// follow the cursor
 			if(m_follow_cursor) {
 				int mouse_x, mouse_y, dummy;
@@ -530,6 +729,7 @@ void X11Input::InputThread() {
 			}
 
 			// get the image
+			int64_t grab_start = hrt_time_micro();
 			if(m_x11_use_shm) {
 				AllocateImage(grab_width, grab_height);
 				if(!XShmGetImage(m_x11_display, m_x11_root, m_x11_image, grab_x, grab_y, AllPlanes)) {
@@ -549,6 +749,11 @@ void X11Input::InputThread() {
 					throw X11Exception();
 				}
 			}
+			int64_t grab_time = hrt_time_micro() - grab_start;
+			++m_grab_counter;
+			m_grab_time_sum += grab_time;
+			if(grab_time > m_grab_time_max)
+				m_grab_time_max = grab_time;
 
 			// clear the dead space
 			for(size_t i = 0; i < m_screen_dead_space.size(); ++i) {
@@ -570,6 +775,69 @@ void X11Input::InputThread() {
 				X11ImageDrawCursor(m_x11_display, m_x11_image, grab_x, grab_y);
 			}
 
+			// tell the sinks which part of the frame is important, if they want to know
+			unsigned int focus_flags = CalculateVideoFocusFlags();
+			if(focus_flags != 0) {
+				VideoFocus focus = VideoFocus();
+				if(focus_flags & VIDEO_FOCUS_CURSOR) {
+					int mouse_x, mouse_y, dummy;
+					Window dummy_win;
+					unsigned int dummy_mask;
+					if(XQueryPointer(m_x11_display, m_x11_root, &dummy_win, &dummy_win, &dummy, &dummy, &mouse_x, &mouse_y, &dummy_mask)) {
+						focus.m_has_cursor = true;
+						focus.m_cursor_x = mouse_x - (int) grab_x;
+						focus.m_cursor_y = mouse_y - (int) grab_y;
+					}
+				}
+				if(focus_flags & VIDEO_FOCUS_WINDOW) {
+					if(timestamp >= next_focus_window_check) {
+						has_focus_window = X11GetActiveWindowRect(m_x11_display, m_x11_root, m_x11_net_active_window,
+																  &focus_window_x1, &focus_window_y1, &focus_window_x2, &focus_window_y2);
+						next_focus_window_check = timestamp + FOCUS_WINDOW_INTERVAL;
+					}
+					if(has_focus_window) {
+						focus.m_has_window = true;
+						focus.m_window_x1 = focus_window_x1 - (int) grab_x;
+						focus.m_window_y1 = focus_window_y1 - (int) grab_y;
+						focus.m_window_x2 = focus_window_x2 - (int) grab_x;
+						focus.m_window_y2 = focus_window_y2 - (int) grab_y;
+					}
+				}
+				PushVideoFocus(focus);
+			}
+
+			// detect whether the image has changed
+			if(m_adaptive_frame_rate) {
+				uint64_t hash = X11ImageHash(m_x11_image);
+				bool was_idle = (idle_next_grab != 0);
+				if(hash == idle_last_hash) {
+					++idle_unchanged_frames;
+				} else {
+					idle_unchanged_frames = 0;
+				}
+				idle_last_hash = hash;
+				if(idle_unchanged_frames >= IDLE_FRAME_THRESHOLD) {
+					idle_interval = (was_idle)? std::min(idle_interval * 2, IDLE_MAX_INTERVAL) : IDLE_INITIAL_INTERVAL;
+					idle_next_grab = timestamp + idle_interval;
+					int dummy;
+					Window dummy_win;
+					unsigned int dummy_mask;
+					if(!XQueryPointer(m_x11_display, m_x11_root, &dummy_win, &dummy_win, &dummy, &dummy, &idle_mouse_x, &idle_mouse_y, &dummy_mask))
+						idle_next_grab = 0;
+				} else {
+					idle_next_grab = 0;
+				}
+
+				// the sinks already have this image, so a ping is enough
+				if(was_idle && idle_unchanged_frames > IDLE_FRAME_THRESHOLD) {
+					PushVideoPing(timestamp);
+					++idle_stats_pings;
+					last_timestamp = timestamp;
+					continue;
+				}
+				++idle_stats_frames;
+			}
+
 			// increase the frame counter
 			++m_frame_counter;
 
@@ -582,6 +850,19 @@ void X11Input::InputThread() {
 
 		}
 
+		// Report how much the adaptive frame rate helped. The CPU time that was saved is estimated by assuming
+		// that the input would have used as much CPU time while idle as it did while it was active.
+		if(idle_stats_time[0] + idle_stats_time[1] > 0 && idle_stats_frames != 0) {
+			double time_active = (double) idle_stats_time[0] * 1.0e-6, time_idle = (double) idle_stats_time[1] * 1.0e-6;
+			double cpu_active = (double) idle_stats_cpu[0] * 1.0e-6, cpu_idle = (double) idle_stats_cpu[1] * 1.0e-6;
+			double cpu_saved = (time_active > 0.0)? std::max(0.0, time_idle * cpu_active / time_active - cpu_idle) : 0.0;
+			Logger::LogInfo("[X11Input::InputThread] " + Logger::tr("Adaptive frame rate: idle %1% of the time, average capture rate %2 fps, %3 frames replaced by pings, "
+																	 "estimated CPU time saved %4 s.")
+							.arg(100.0 * time_idle / (time_active + time_idle), 0, 'f', 1)
+							.arg((double) idle_stats_frames / (time_active + time_idle), 0, 'f', 2)
+							.arg(idle_stats_pings).arg(cpu_saved, 0, 'f', 1));
+		}
+
 		Logger::LogInfo("[X11Input::InputThread] " + Logger::tr("Input thread stopped."));
 
 	} catch(const std::exception& e) {
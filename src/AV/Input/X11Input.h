@@ -34,6 +34,8 @@ private:
 	};
 	struct SharedData {
 		unsigned int m_current_x, m_current_y, m_current_width, m_current_height;
+		unsigned int m_requested_x, m_requested_y, m_requested_width, m_requested_height;
+		int64_t m_requested_time;
 	};
 	typedef MutexDataPair<SharedData>::Lock SharedLock;
 
@@ -42,6 +44,8 @@ private:
 	bool m_record_cursor, m_follow_cursor, m_follow_fullscreen;
 
 	std::atomic<uint32_t> m_frame_counter;
+	std::atomic<uint64_t> m_grab_counter;
+	std::atomic<int64_t> m_grab_time_sum, m_grab_time_max;
 	int64_t m_fps_last_timestamp;
 	uint32_t m_fps_last_counter;
 	double m_fps_current;
@@ -55,6 +59,7 @@ private:
 	XImage *m_x11_image;
 	XShmSegmentInfo m_x11_shm_info;
 	bool m_x11_shm_server_attached;
+	Atom m_x11_net_active_window;
 
 	Rect m_screen_bbox;
 	std::vector<Rect> m_screen_rects;
@@ -63,6 +68,8 @@ private:
 	std::thread m_thread;
 	MutexDataPair<SharedData> m_shared_data;
 	std::atomic<bool> m_should_stop, m_error_occurred;
+	std::atomic<bool> m_adaptive_frame_rate;
+	std::atomic<bool> m_rectangle_requested;
 
 public:
 	X11Input(unsigned int x, unsigned int y, unsigned int width, unsigned int height, bool record_cursor, bool follow_cursor, bool follow_fullscreen);
@@ -72,6 +79,13 @@ public:
 	// This function is thread-safe.
 	void GetCurrentRectangle(unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height);
 
+	// Changes the recording rectangle while recording. The input thread switches to the new rectangle before capturing the next frame,
+	// so the change takes effect within one frame interval. The rectangle is shrunk and moved inside the screen if needed, the arguments
+	// are changed to the rectangle that will actually be used. When following the cursor, only the size is used. This fails (and returns
+	// false) if the size is invalid or the input follows the cursor between screens.
+	// This function is thread-safe.
+	bool SetRectangle(unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height);
+
 	// Reads the current size of the stream.
 	// This function is thread-safe.
 	void GetCurrentSize(unsigned int* width, unsigned int* height);
@@ -80,6 +94,22 @@ public:
 	// This function is thread-safe.
 	double GetFPS();
 
+	// Enables or disables the adaptive frame rate. When enabled, the input captures fewer frames while the image doesn't change,
+	// and goes back to the full frame rate as soon as it changes or the cursor moves. The sinks receive pings instead of the
+	// skipped frames, so the synchronizer can still fill the gaps.
+	// This function is thread-safe.
+	inline void SetAdaptiveFrameRate(bool enable) { m_adaptive_frame_rate = enable; }
+
+	// Reads the number of grabbed images and the total time spent grabbing them (in microseconds), and the longest grab since
+	// the previous call. Only the image transfer from the X server is timed, so the difference between two calls measures the
+	// grab time itself rather than the frame interval.
+	// This function is thread-safe.
+	void GetGrabStats(uint64_t* grabs, int64_t* time_sum, int64_t* time_max);
+
+	// Returns the CPU time used by the input thread (in microseconds).
+	// This function is thread-safe.
+	inline int64_t GetCPUTime() { return thread_cpu_time_micro(m_thread); }
+
 	// Returns whether an error has occurred in the input thread.
 	// This function is thread-safe.
 	inline bool HasErrorOccurred() { return m_error_occurred; }
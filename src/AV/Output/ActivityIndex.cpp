@@ -0,0 +1,181 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ActivityIndex.h"
+
+#include "Logger.h"
+
+// The size of the blocks (in pixels of the encoded frame).
+const unsigned int ActivityIndex::BLOCK_SIZE = 16;
+
+// A block has changed if its average brightness changed by at least this amount (on a scale of 0-255). Screen content has no noise,
+// so this can be quite low. A single typed character still changes the average of the block by much more than this.
+const unsigned int ActivityIndex::CHANGE_THRESHOLD = 2;
+
+// The file is flushed after this many seconds, so most of the index survives a crash.
+const unsigned int ActivityIndex::FLUSH_INTERVAL = 10;
+
+ActivityIndex::ActivityIndex(const QString& file_name, unsigned int width, unsigned int height, unsigned int frame_rate, AVPixelFormat pixel_format) {
+
+	m_file_name = file_name;
+
+	m_width = width;
+	m_height = height;
+	m_frame_rate = frame_rate;
+	m_pixel_format = pixel_format;
+	m_blocks_x = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+	m_blocks_y = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	m_has_previous = false;
+	m_changed_blocks = 0;
+	m_current_second = 0;
+	m_unflushed_seconds = 0;
+
+	try {
+		Init();
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+}
+
+ActivityIndex::~ActivityIndex() {
+
+	// write the last second
+	if(m_file.isOpen())
+		WriteSeconds(m_current_second + 1);
+
+	Free();
+
+}
+
+void ActivityIndex::AddFrame(int64_t pts, const AVFrame* frame) {
+
+	if(!m_file.isOpen())
+		return;
+
+	// write the seconds that are complete
+	int64_t second = pts / (int64_t) m_frame_rate;
+	if(second > m_current_second)
+		WriteSeconds(second);
+
+	if(frame == NULL)
+		return;
+
+	// compare the blocks with the previous frame
+	CalculateBrightness(frame);
+	if(m_has_previous) {
+		for(size_t i = 0; i < m_brightness.size(); ++i) {
+			if(!m_changed[i] && (unsigned int) abs((int) m_brightness[i] - (int) m_previous_brightness[i]) >= CHANGE_THRESHOLD * BLOCK_SIZE * BLOCK_SIZE) {
+				m_changed[i] = 1;
+				++m_changed_blocks;
+			}
+		}
+	}
+	std::swap(m_brightness, m_previous_brightness);
+	m_has_previous = true;
+
+}
+
+QString ActivityIndex::GetFileName(const QString& output_file) {
+	return output_file + ".activity";
+}
+
+void ActivityIndex::Init() {
+
+	m_brightness.assign(m_blocks_x * m_blocks_y, 0);
+	m_previous_brightness.assign(m_blocks_x * m_blocks_y, 0);
+	m_changed.assign(m_blocks_x * m_blocks_y, 0);
+
+	// The index is optional, so failing to write it is not an error.
+	m_file.setFileName(m_file_name);
+	if(!m_file.open(QFile::WriteOnly | QFile::Truncate | QFile::Text)) {
+		Logger::LogWarning("[ActivityIndex::Init] " + Logger::tr("Warning: Can't create activity index file '%1'!").arg(m_file_name));
+		return;
+	}
+	m_file.write("# SimpleScreenRecorder activity index\n"
+				 "# time (s)\tchanged fraction (0.01%)\n");
+
+	Logger::LogInfo("[ActivityIndex::Init] " + Logger::tr("Writing activity index to '%1'.").arg(m_file_name));
+
+}
+
+void ActivityIndex::Free() {
+	if(m_file.isOpen())
+		m_file.close();
+}
+
+void ActivityIndex::CalculateBrightness(const AVFrame* frame) {
+
+	// The first plane of YUV formats is the luma. For RGB formats, the green channel is close enough.
+	unsigned int pixel_step, offset;
+	switch(m_pixel_format) {
+		case AV_PIX_FMT_BGRA: pixel_step = 4; offset = 1; break;
+		case AV_PIX_FMT_BGR24:
+		case AV_PIX_FMT_RGB24: pixel_step = 3; offset = 1; break;
+		default: pixel_step = 1; offset = 0; break;
+	}
+
+	// Partial blocks at the right and bottom edges are scaled up so they can use the same threshold.
+	std::fill(m_brightness.begin(), m_brightness.end(), 0);
+	for(unsigned int y = 0; y < m_height; ++y) {
+		const uint8_t *row = frame->data[0] + (ptrdiff_t) frame->linesize[0] * y + offset;
+		uint32_t *block_row = m_brightness.data() + (y / BLOCK_SIZE) * m_blocks_x;
+		for(unsigned int x = 0; x < m_width; ++x) {
+			block_row[x / BLOCK_SIZE] += row[x * pixel_step];
+		}
+	}
+	unsigned int edge_x = m_width % BLOCK_SIZE, edge_y = m_height % BLOCK_SIZE;
+	if(edge_x != 0) {
+		for(unsigned int by = 0; by < m_blocks_y; ++by) {
+			uint32_t &b = m_brightness[by * m_blocks_x + m_blocks_x - 1];
+			b = b * BLOCK_SIZE / edge_x;
+		}
+	}
+	if(edge_y != 0) {
+		for(unsigned int bx = 0; bx < m_blocks_x; ++bx) {
+			uint32_t &b = m_brightness[(m_blocks_y - 1) * m_blocks_x + bx];
+			b = b * BLOCK_SIZE / edge_y;
+		}
+	}
+
+}
+
+void ActivityIndex::WriteSeconds(int64_t second) {
+
+	// write the current second, and zeros for the seconds without frames
+	QByteArray lines;
+	unsigned int activity = (unsigned int) ((uint64_t) m_changed_blocks * 10000 / std::max<size_t>(1, m_changed.size()));
+	for( ; m_current_second < second; ++m_current_second) {
+		lines += QByteArray::number((qlonglong) m_current_second) + '\t' + QByteArray::number(activity) + '\n';
+		activity = 0;
+		++m_unflushed_seconds;
+	}
+	m_file.write(lines);
+	if(m_unflushed_seconds >= FLUSH_INTERVAL) {
+		m_file.flush();
+		m_unflushed_seconds = 0;
+	}
+
+	// start a new second
+	std::fill(m_changed.begin(), m_changed.end(), 0);
+	m_changed_blocks = 0;
+
+}
@@ -0,0 +1,69 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+// Writes a sidecar file with the amount of activity in every second of the recording, so long recordings can be skimmed
+// without decoding them. The activity is measured on the frames that are sent to the encoder (i.e. after scaling), using
+// the average brightness of small blocks, which is cheap to calculate.
+// The file is a text file with one line per second of video: the time (in seconds) and the fraction of the image that changed
+// during that second (in units of 0.01%, so 0-10000), separated by a tab. Lines starting with '#' are comments.
+class ActivityIndex {
+
+private:
+	static const unsigned int BLOCK_SIZE;
+	static const unsigned int CHANGE_THRESHOLD;
+	static const unsigned int FLUSH_INTERVAL;
+
+private:
+	QString m_file_name;
+	QFile m_file;
+
+	unsigned int m_width, m_height, m_frame_rate;
+	AVPixelFormat m_pixel_format;
+	unsigned int m_blocks_x, m_blocks_y;
+
+	bool m_has_previous;
+	std::vector<uint32_t> m_brightness, m_previous_brightness;
+	std::vector<uint8_t> m_changed;
+	unsigned int m_changed_blocks;
+
+	int64_t m_current_second;
+	unsigned int m_unflushed_seconds;
+
+public:
+	ActivityIndex(const QString& file_name, unsigned int width, unsigned int height, unsigned int frame_rate, AVPixelFormat pixel_format);
+	~ActivityIndex();
+
+	// Adds a frame with the given timestamp (in frames). The frame should have the size and pixel format that were passed to the
+	// constructor. If the frame is NULL, the previous frame is repeated.
+	void AddFrame(int64_t pts, const AVFrame* frame);
+
+	// Returns the name of the index file for a given output file.
+	static QString GetFileName(const QString& output_file);
+
+private:
+	void Init();
+	void Free();
+
+	void CalculateBrightness(const AVFrame* frame);
+	void WriteSeconds(int64_t second);
+
+};
@@ -196,15 +196,18 @@ bool AudioEncoder::EncodeFrame(AVFrameWrapper* frame) {
 	av_frame_free(&avframe);
 
 	// try to receive a packet
+	// the packet is taken from the pool, and given back if it wasn't used
 	for( ; ; ) {
-		std::unique_ptr<AVPacketWrapper> packet(new AVPacketWrapper());
+		std::unique_ptr<AVPacketWrapper> packet = GetMuxer()->GetPacketPool()->GetPacket();
 		int res = avcodec_receive_packet(GetCodecContext(), packet->GetPacket());
 		if(res == 0) { // we have a packet, send the packet to the muxer
 			GetMuxer()->AddPacket(GetStream()->index, std::move(packet));
 			IncrementPacketCounter();
 		} else if(res == AVERROR(EAGAIN)) { // we have no packet
+			GetMuxer()->GetPacketPool()->ReturnPacket(std::move(packet));
 			return true;
 		} else if(res == AVERROR_EOF) { // this is the end of the stream
+			GetMuxer()->GetPacketPool()->ReturnPacket(std::move(packet));
 			return false;
 		} else {
 			Logger::LogError("[AudioEncoder::EncodeFrame] " + Logger::tr("Error: Receiving of audio packet failed!"));
@@ -22,6 +22,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Logger.h"
 #include "AVWrapper.h"
 #include "Muxer.h"
+#include "StatsSegment.h"
 
 int ParseCodecOptionInt(const QString& key, const QString& value, int min, int max, int multiply) {
 	bool parsed;
@@ -48,6 +49,7 @@ BaseEncoder::BaseEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_c
 	m_stream = stream;
 	m_codec_context = codec_context;
 	m_codec_opened = false;
+	m_codec_delay = true;
 
 	// initialize shared data
 	{
@@ -57,6 +59,16 @@ BaseEncoder::BaseEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_c
 		lock->m_stats_actual_frame_rate = 0.0;
 		lock->m_stats_previous_pts = AV_NOPTS_VALUE;
 		lock->m_stats_previous_frames = 0;
+		lock->m_control_keyframe = false;
+		lock->m_control_bit_rate = 0;
+		lock->m_control_crf = -1;
+		lock->m_keyframe_request_time = AV_NOPTS_VALUE;
+		lock->m_keyframe_request_pts = AV_NOPTS_VALUE;
+		lock->m_keyframe_latency = -1;
+		lock->m_resume_pending = false;
+		lock->m_resume_time = AV_NOPTS_VALUE;
+		lock->m_resume_pts = AV_NOPTS_VALUE;
+		lock->m_resume_latency = -1;
 	}
 
 	// initialize thread signals
@@ -127,6 +139,48 @@ unsigned int BaseEncoder::GetQueuedPacketCount() {
 	return GetMuxer()->GetQueuedPacketCount(GetStream()->index);
 }
 
+void BaseEncoder::RequestKeyframe() {
+	SharedLock lock(&m_shared_data);
+	if(!lock->m_control_keyframe) {
+		lock->m_control_keyframe = true;
+		lock->m_keyframe_request_time = hrt_time_micro();
+		lock->m_keyframe_request_pts = AV_NOPTS_VALUE;
+	}
+}
+
+void BaseEncoder::RequestBitRate(unsigned int bit_rate) {
+	SharedLock lock(&m_shared_data);
+	lock->m_control_bit_rate = bit_rate;
+}
+
+void BaseEncoder::RequestCRF(unsigned int crf) {
+	SharedLock lock(&m_shared_data);
+	lock->m_control_crf = crf;
+}
+
+void BaseEncoder::RequestPreset(const QString& preset) {
+	SharedLock lock(&m_shared_data);
+	lock->m_control_preset = preset;
+}
+
+int64_t BaseEncoder::GetKeyframeLatency() {
+	SharedLock lock(&m_shared_data);
+	return lock->m_keyframe_latency;
+}
+
+void BaseEncoder::MarkResume(int64_t time) {
+	SharedLock lock(&m_shared_data);
+	lock->m_resume_pending = true;
+	lock->m_resume_time = time;
+	lock->m_resume_pts = AV_NOPTS_VALUE;
+	lock->m_resume_latency = -1;
+}
+
+int64_t BaseEncoder::GetResumeLatency() {
+	SharedLock lock(&m_shared_data);
+	return lock->m_resume_latency;
+}
+
 void BaseEncoder::AddFrame(std::unique_ptr<AVFrameWrapper> frame) {
 	assert(frame->GetFrame()->pts != (int64_t) AV_NOPTS_VALUE);
 	SharedLock lock(&m_shared_data);
@@ -141,6 +195,10 @@ void BaseEncoder::AddFrame(std::unique_ptr<AVFrameWrapper> frame) {
 		lock->m_stats_previous_pts = frame->GetFrame()->pts;
 		lock->m_stats_previous_frames = lock->m_total_frames;
 	}
+	if(lock->m_resume_pending) {
+		lock->m_resume_pending = false;
+		lock->m_resume_pts = frame->GetFrame()->pts;
+	}
 	lock->m_frame_queue.push_back(std::move(frame));
 }
 
@@ -157,8 +215,41 @@ void BaseEncoder::IncrementPacketCounter() {
 	++lock->m_total_packets;
 }
 
+bool BaseEncoder::ApplyControlRequest(AVFrameWrapper* frame, const ControlRequest& request) {
+	if(request.m_keyframe)
+		frame->GetFrame()->pict_type = AV_PICTURE_TYPE_I;
+	return (request.m_bit_rate == 0 && request.m_crf < 0 && request.m_preset.isEmpty());
+}
+
+void BaseEncoder::TrackPacketLatency(const AVPacket* packet) {
+	int64_t keyframe_latency = -1, resume_latency = -1;
+	{
+		SharedLock lock(&m_shared_data);
+		int64_t time = hrt_time_micro();
+		if((packet->flags & AV_PKT_FLAG_KEY) && lock->m_keyframe_request_pts != (int64_t) AV_NOPTS_VALUE && packet->pts >= lock->m_keyframe_request_pts) {
+			keyframe_latency = time - lock->m_keyframe_request_time;
+			lock->m_keyframe_latency = keyframe_latency;
+			lock->m_keyframe_request_pts = AV_NOPTS_VALUE;
+		}
+		if(lock->m_resume_pts != (int64_t) AV_NOPTS_VALUE && packet->pts >= lock->m_resume_pts) {
+			resume_latency = time - lock->m_resume_time;
+			lock->m_resume_latency = resume_latency;
+			lock->m_resume_pts = AV_NOPTS_VALUE;
+		}
+	}
+	if(keyframe_latency >= 0)
+		Logger::LogInfo("[BaseEncoder::TrackPacketLatency] " + Logger::tr("Requested keyframe was encoded after %1 ms.").arg((double) keyframe_latency * 1.0e-3, 0, 'f', 1));
+	if(resume_latency >= 0)
+		Logger::LogInfo("[BaseEncoder::TrackPacketLatency] " + Logger::tr("First frame after resuming was encoded after %1 ms.").arg((double) resume_latency * 1.0e-3, 0, 'f', 1));
+}
+
 void BaseEncoder::Init(AVCodec* codec, AVDictionary** options) {
 
+	// the derived class encodes the frames itself, it will also handle the options
+	if(codec == NULL)
+		return;
+	m_codec_delay = ((codec->capabilities & AV_CODEC_CAP_DELAY) != 0);
+
 	// open codec
 	if(avcodec_open2(m_codec_context, codec, options) < 0) {
 		Logger::LogError("[BaseEncoder::Init] " + Logger::tr("Error: Can't open codec!"));
@@ -183,6 +274,58 @@ void BaseEncoder::Free() {
 	}
 }
 
+void BaseEncoder::UpdateSharedStats() {
+	unsigned int queued_frames, latency;
+	uint64_t encoded_frames;
+	double frame_rate;
+	{
+		SharedLock lock(&m_shared_data);
+		queued_frames = lock->m_frame_queue.size();
+		latency = (lock->m_total_frames > lock->m_total_packets + queued_frames)? lock->m_total_frames - lock->m_total_packets - queued_frames : 0;
+		encoded_frames = lock->m_total_frames - queued_frames;
+		frame_rate = lock->m_stats_actual_frame_rate;
+	}
+	StatsBlock *stats = m_muxer->GetStatsBlock();
+	StatsUpdate update(stats);
+	if(m_codec_context->codec_type == AVMEDIA_TYPE_VIDEO) {
+		stats->video_frames_out.Set(encoded_frames);
+		stats->video_fps_out.Set(frame_rate);
+		stats->video_encoder_queue.Set(queued_frames);
+		stats->video_encoder_latency.Set(latency);
+	} else {
+		stats->audio_encoder_queue.Set(queued_frames);
+		stats->audio_encoder_latency.Set(latency);
+	}
+}
+
+void BaseEncoder::HandleControlRequests(AVFrameWrapper* frame) {
+
+	// take the pending requests
+	ControlRequest request;
+	{
+		SharedLock lock(&m_shared_data);
+		if(!lock->m_control_keyframe && lock->m_control_bit_rate == 0 && lock->m_control_crf < 0 && lock->m_control_preset.isEmpty())
+			return;
+		request.m_keyframe = lock->m_control_keyframe;
+		request.m_bit_rate = lock->m_control_bit_rate;
+		request.m_crf = lock->m_control_crf;
+		request.m_preset = lock->m_control_preset;
+		lock->m_control_keyframe = false;
+		lock->m_control_bit_rate = 0;
+		lock->m_control_crf = -1;
+		lock->m_control_preset.clear();
+		if(request.m_keyframe)
+			lock->m_keyframe_request_pts = frame->GetFrame()->pts;
+	}
+
+	// apply them to this frame
+	if(!ApplyControlRequest(frame, request)) {
+		Logger::LogWarning("[BaseEncoder::HandleControlRequests] " + Logger::tr("Warning: Codec '%1' does not support changing the bit rate, quality or preset while encoding!")
+						   .arg((m_codec_context->codec == NULL)? "libx264 (native)" : m_codec_context->codec->name));
+	}
+
+}
+
 void BaseEncoder::EncoderThread() {
 
 	try {
@@ -209,13 +352,17 @@ void BaseEncoder::EncoderThread() {
 				continue;
 			}
 
-			// encode the frame
+			// apply control requests at the frame boundary, then encode the frame
+			HandleControlRequests(frame.get());
 			EncodeFrame(frame.get());
 
+			if(m_muxer->GetStatsBlock() != NULL)
+				UpdateSharedStats();
+
 		}
 
 		// flush the encoder
-		if(!m_should_stop && (m_codec_context->codec->capabilities & AV_CODEC_CAP_DELAY)) {
+		if(!m_should_stop && m_codec_delay) {
 			Logger::LogInfo("[BaseEncoder::EncoderThread] " + Logger::tr("Flushing encoder ..."));
 			while(!m_should_stop) {
 				if(!EncodeFrame(NULL)) {
@@ -37,20 +37,38 @@ private:
 		double m_stats_actual_frame_rate;
 		int64_t m_stats_previous_pts;
 		uint64_t m_stats_previous_frames;
+		bool m_control_keyframe;
+		unsigned int m_control_bit_rate;
+		int m_control_crf;
+		QString m_control_preset;
+		int64_t m_keyframe_request_time, m_keyframe_request_pts;
+		int64_t m_keyframe_latency;
+		bool m_resume_pending;
+		int64_t m_resume_time, m_resume_pts;
+		int64_t m_resume_latency;
 	};
 	typedef MutexDataPair<SharedData>::Lock SharedLock;
 
+protected:
+	struct ControlRequest {
+		bool m_keyframe;
+		unsigned int m_bit_rate; // 0 = unchanged
+		int m_crf; // -1 = unchanged
+		QString m_preset; // empty = unchanged
+	};
+
 private:
 	Muxer *m_muxer;
 	AVStream *m_stream;
 	AVCodecContext *m_codec_context;
-	bool m_codec_opened;
+	bool m_codec_opened, m_codec_delay;
 
 	std::thread m_thread;
 	MutexDataPair<SharedData> m_shared_data;
 	std::atomic<bool> m_should_stop, m_should_finish, m_is_done, m_error_occurred;
 
 protected:
+	// If 'codec' is NULL, the codec is not opened and the derived class is responsible for encoding the frames without libavcodec.
 	BaseEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options);
 
 public:
@@ -79,6 +97,39 @@ public:
 
 	unsigned int GetQueuedPacketCount();
 
+	// Returns the CPU time used by the encoder thread (in microseconds).
+	// This function is thread-safe.
+	inline int64_t GetCPUTime() { return thread_cpu_time_micro(m_thread); }
+
+	// Asks the encoder to turn the next frame into a keyframe.
+	// This function is thread-safe.
+	void RequestKeyframe();
+
+	// Asks the encoder to change the bit rate (in bit/s) or the constant rate factor, starting at the next frame.
+	// Not all codecs support this, unsupported requests are ignored with a warning.
+	// This function is thread-safe.
+	void RequestBitRate(unsigned int bit_rate);
+	void RequestCRF(unsigned int crf);
+
+	// Asks the encoder to switch to a different speed preset, starting at the next frame.
+	// Only the native libx264 backend supports this, other encoders ignore the request with a warning.
+	// This function is thread-safe.
+	void RequestPreset(const QString& preset);
+
+	// Returns the time between the last keyframe request and the resulting keyframe packet (in microseconds),
+	// or -1 if no requested keyframe has been encoded yet.
+	// This function is thread-safe.
+	int64_t GetKeyframeLatency();
+
+	// Marks the next added frame as the first frame after resuming a paused recording (at 'time', in microseconds).
+	// This function is thread-safe.
+	void MarkResume(int64_t time);
+
+	// Returns the time between the last resume and the packet of the first frame after it (in microseconds),
+	// or -1 if that frame has not been encoded yet.
+	// This function is thread-safe.
+	int64_t GetResumeLatency();
+
 public: // internal
 
 	// Adds a frame to the frame queue. Called by the synchronizer.
@@ -113,13 +164,23 @@ protected:
 	// Returns whether a packet was created.
 	virtual bool EncodeFrame(AVFrameWrapper* frame) = 0;
 
+	// Called by the encoder thread before a frame is encoded, if there are pending control requests.
+	// Returns whether the request could be applied. The default implementation only handles keyframe requests.
+	virtual bool ApplyControlRequest(AVFrameWrapper* frame, const ControlRequest& request);
+
 	// Called to increment the packet counter.
 	void IncrementPacketCounter();
 
+	// Called for every created packet, to measure the latency of keyframe requests and resumes.
+	void TrackPacketLatency(const AVPacket* packet);
+
 private:
 	void Init(AVCodec* codec, AVDictionary** options);
 	void Free();
 
+	void UpdateSharedStats();
+	void HandleControlRequests(AVFrameWrapper* frame);
+
 	void EncoderThread();
 
 };
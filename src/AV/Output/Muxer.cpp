@@ -24,6 +24,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "BaseEncoder.h"
 #include "VideoEncoder.h"
 #include "AudioEncoder.h"
+#include "StatsSegment.h"
 
 Muxer::Muxer(const QString& container_name, const QString& output_file) {
 
@@ -32,6 +33,7 @@ Muxer::Muxer(const QString& container_name, const QString& output_file) {
 
 	m_format_context = NULL;
 	m_started = false;
+	m_stats = NULL;
 
 	// initialize stream data
 	for(int i = 0; i < MUXER_MAX_STREAMS; ++i) {
@@ -104,8 +106,9 @@ VideoEncoder* Muxer::AddVideoEncoder(const QString& codec_name, const std::vecto
 							.arg(codec_context->time_base.num).arg(codec_context->time_base.den).arg(time_base));
 		}
 		
-		VideoEncoder::PrepareStream(stream, codec_context, codec, &options, codec_options, bit_rate, width, height, frame_rate);
-		m_encoders[stream->index] = encoder = new VideoEncoder(this, stream, codec_context, codec, &options);
+		bool native_x264 = VideoEncoder::UseNativeX264(codec_name, codec_options);
+		VideoEncoder::PrepareStream(stream, codec_context, codec, &options, codec_options, bit_rate, width, height, frame_rate, native_x264);
+		m_encoders[stream->index] = encoder = new VideoEncoder(this, stream, codec_context, codec, &options, native_x264);
 #if SSR_USE_AVSTREAM_CODECPAR
 		if(avcodec_parameters_from_context(stream->codecpar, codec_context) < 0) {
 			Logger::LogError("[Muxer::AddVideoEncoder] " + Logger::tr("Error: Can't copy parameters to stream!"));
@@ -155,6 +158,30 @@ AudioEncoder* Muxer::AddAudioEncoder(const QString& codec_name, const std::vecto
 	return encoder;
 }
 
+void Muxer::EnablePacketJournal(const QString& journal_file) {
+	assert(!m_started);
+	m_journal_file = journal_file;
+}
+
+void Muxer::EnableChecksumManifest(const QString& manifest_file) {
+	assert(!m_started);
+
+	// replace the file that was opened by Init
+	if(m_format_context->pb != NULL) {
+		avio_close(m_format_context->pb);
+		m_format_context->pb = NULL;
+	}
+	m_output_checksum.reset(new OutputChecksum(m_output_file, manifest_file));
+	m_format_context->pb = m_output_checksum->GetIOContext();
+	m_format_context->flags |= AVFMT_FLAG_CUSTOM_IO;
+
+}
+
+void Muxer::SetStatsBlock(StatsBlock* stats) {
+	assert(!m_started);
+	m_stats = stats;
+}
+
 void Muxer::Start() {
 	assert(!m_started);
 
@@ -170,6 +197,20 @@ void Muxer::Start() {
 	}
 
 	m_started = true;
+
+	// create the journal (after writing the header, because the muxer may change the time base of the streams)
+	if(!m_journal_file.isEmpty()) {
+		try {
+			std::vector<AVCodecContext*> codec_contexts;
+			for(unsigned int i = 0; i < m_format_context->nb_streams; ++i) {
+				codec_contexts.push_back(m_encoders[i]->GetCodecContext());
+			}
+			m_journal.reset(new PacketJournal(m_journal_file, m_container_name, m_output_file, m_format_context, codec_contexts));
+		} catch(...) {
+			Logger::LogWarning("[Muxer::Start] " + Logger::tr("Warning: Can't create packet journal, continuing without it."));
+		}
+	}
+
 	m_thread = std::thread(&Muxer::MuxerThread, this);
 
 }
@@ -183,6 +224,11 @@ void Muxer::Finish() {
 	}
 }
 
+void Muxer::Wait() {
+	if(m_thread.joinable())
+		m_thread.join();
+}
+
 double Muxer::GetActualBitRate() {
 	SharedLock lock(&m_shared_data);
 	return lock->m_stats_actual_bit_rate;
@@ -193,6 +239,16 @@ uint64_t Muxer::GetTotalBytes() {
 	return lock->m_total_bytes;
 }
 
+int64_t Muxer::GetCPUTime() {
+	int64_t cpu_time = thread_cpu_time_micro(m_thread);
+	if(m_started) {
+		for(unsigned int i = 0; i < m_format_context->nb_streams; ++i) {
+			cpu_time += m_encoders[i]->GetCPUTime();
+		}
+	}
+	return cpu_time;
+}
+
 void Muxer::EndStream(unsigned int stream_index) {
 	assert(stream_index < m_format_context->nb_streams);
 	StreamLock lock(&m_stream_data[stream_index]);
@@ -246,14 +302,36 @@ void Muxer::Free() {
 	if(m_format_context != NULL) {
 
 		// write trailer (needed to free private muxer data)
+		bool finished = false;
 		if(m_started) {
 			if(av_write_trailer(m_format_context) != 0) {
 				// we can't throw exceptions here because this is called from the destructor
 				Logger::LogError("[Muxer::Free] " + Logger::tr("Error: Can't write trailer, continuing anyway.", "Don't translate 'trailer'"));
+			} else {
+				finished = !m_error_occurred;
 			}
 			m_started = false;
 		}
 
+		// write the remaining data, the manifest is only written if the output file is complete
+		if(m_output_checksum != NULL && finished) {
+			try {
+				m_output_checksum->Flush();
+			} catch(...) {
+				Logger::LogWarning("[Muxer::Free] " + Logger::tr("Warning: Can't write checksum manifest, continuing anyway."));
+				finished = false;
+			}
+		}
+
+		// the journal is only needed if the output file is incomplete
+		if(m_journal != NULL) {
+			m_journal.reset();
+			if(finished)
+				QFile(m_journal_file).remove();
+			else
+				Logger::LogWarning("[Muxer::Free] " + Logger::tr("Warning: The output file may be incomplete, the packet journal '%1' was kept.").arg(m_journal_file));
+		}
+
 		// destroy the encoders
 		for(unsigned int i = 0; i < m_format_context->nb_streams; ++i) {
 			if(m_encoders[i] != NULL) {
@@ -263,7 +341,15 @@ void Muxer::Free() {
 		}
 
 		// close file
-		if(m_format_context->pb != NULL) {
+		// The checksums are finished in the background, since that may require reading back a large part of the file
+		// and this function may be called while the output manager is locked.
+		if(m_output_checksum != NULL) {
+			m_format_context->pb = NULL;
+			if(finished)
+				OutputChecksum::FinishInBackground(std::move(m_output_checksum));
+			else
+				m_output_checksum.reset();
+		} else if(m_format_context->pb != NULL) {
 			avio_close(m_format_context->pb);
 			m_format_context->pb = NULL;
 		}
@@ -415,6 +501,10 @@ void Muxer::MuxerThread() {
 			}
 #endif
 
+			// add the packet to the journal before the muxer takes the data
+			if(m_journal != NULL)
+				m_journal->AddPacket(packet->GetPacket());
+
 			// write the packet (again, why does libav/ffmpeg call this a frame?)
 			if(av_interleaved_write_frame(m_format_context, packet->GetPacket()) != 0) {
 				Logger::LogError("[Muxer::MuxerThread] " + Logger::tr("Error: Can't write frame to muxer!"));
@@ -424,6 +514,9 @@ void Muxer::MuxerThread() {
 			// the data is now owned by libav/ffmpeg, so don't free it
 			packet->SetFreeOnDestruct(false);
 
+			// the packet itself can be reused by the encoders
+			m_packet_pool.ReturnPacket(std::move(packet));
+
 			// update the byte counter
 			{
 				SharedLock lock(&m_shared_data);
@@ -438,6 +531,15 @@ void Muxer::MuxerThread() {
 					lock->m_stats_previous_time = total_time;
 					lock->m_stats_previous_bytes = lock->m_total_bytes;
 				}
+				if(m_stats != NULL) {
+					StatsUpdate update(m_stats);
+					if(codec_context->codec_type == AVMEDIA_TYPE_VIDEO)
+						m_stats->video_packets_out.Add(1);
+					else
+						m_stats->audio_packets_out.Add(1);
+					m_stats->total_bytes.Set(lock->m_total_bytes);
+					m_stats->bit_rate.Set(lock->m_stats_actual_bit_rate);
+				}
 			}
 
 		}
@@ -445,6 +547,10 @@ void Muxer::MuxerThread() {
 		// tell the others that we're done
 		m_is_done = true;
 
+		PacketPool::Stats stats = m_packet_pool.GetStats();
+		Logger::LogInfo("[Muxer::MuxerThread] " + Logger::tr("Packet pool: %1 allocated, %2 reused, %3 recycled, %4 discarded.")
+						.arg(stats.m_allocated).arg(stats.m_reused).arg(stats.m_recycled).arg(stats.m_discarded));
+
 		Logger::LogInfo("[Muxer::MuxerThread] " + Logger::tr("Muxer thread stopped."));
 
 	} catch(const std::exception& e) {
@@ -21,6 +21,9 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Global.h"
 
 #include "MutexDataPair.h"
+#include "OutputChecksum.h"
+#include "PacketPool.h"
+#include "PacketJournal.h"
 
 #define MUXER_MAX_STREAMS 2
 
@@ -28,6 +31,7 @@ class AVPacketWrapper;
 class BaseEncoder;
 class VideoEncoder;
 class AudioEncoder;
+struct StatsBlock;
 
 class Muxer {
 
@@ -60,6 +64,14 @@ private:
 	MutexDataPair<SharedData> m_shared_data;
 	std::atomic<bool> m_is_done, m_error_occurred;
 
+	PacketPool m_packet_pool;
+
+	QString m_journal_file;
+	std::unique_ptr<PacketJournal> m_journal;
+	std::unique_ptr<OutputChecksum> m_output_checksum;
+
+	StatsBlock *m_stats;
+
 public:
 	Muxer(const QString& container_name, const QString& output_file);
 	~Muxer();
@@ -70,12 +82,29 @@ public:
 	AudioEncoder* AddAudioEncoder(const QString& codec_name, const std::vector<std::pair<QString, QString> >& codec_options, unsigned int bit_rate,
 								  unsigned int channels, unsigned int sample_rate, double time_base = 0.0);
 
+	// Writes all packets to a journal as well, so the output file can be recovered if the program crashes (see PacketJournal).
+	// The journal is deleted when the output file is finished successfully. This should be called before Start.
+	void EnablePacketJournal(const QString& journal_file);
+
+	// Computes checksums of the output file while it is written (see OutputChecksum), and writes them to a manifest when the
+	// file is finished successfully. The manifest is written in the background, shortly after the muxer is deleted.
+	// This should be called before Start.
+	void EnableChecksumManifest(const QString& manifest_file);
+
+	// Reports the statistics of the muxer and its encoders in a shared statistics slot (see StatsSegment).
+	// The slot must outlive the muxer. This should be called before Start.
+	void SetStatsBlock(StatsBlock* stats);
+
 	// Starts the muxer. You can't create new encoders after calling this function.
 	void Start();
 
 	// Tells the muxer to stop. It can take some time before the muxer really stops.
 	void Finish();
 
+	// Blocks until the muxer thread has stopped, either because the muxer is done (after Finish) or because an error occurred.
+	// This function is not thread-safe, it should be called by the thread that owns the muxer.
+	void Wait();
+
 	// Returns the bit rate of the output stream.
 	// This function is thread-safe.
 	double GetActualBitRate();
@@ -84,6 +113,10 @@ public:
 	// This function is thread-safe.
 	uint64_t GetTotalBytes();
 
+	// Returns the CPU time used by the muxer thread and the encoder threads (in microseconds).
+	// This function is thread-safe.
+	int64_t GetCPUTime();
+
 	// Returns whether the muxing is done. If this returns true, the object can be deleted.
 	// Note: If an error occurred in the mixing thread, this function will return false.
 	// This function is thread-safe and lock-free.
@@ -93,6 +126,10 @@ public:
 	// This function is thread-safe and lock-free.
 	inline bool HasErrorOccurred() { return m_error_occurred; }
 
+	// Returns the shared statistics slot, or NULL if there is none.
+	// This function is thread-safe.
+	inline StatsBlock* GetStatsBlock() { return m_stats; }
+
 public:
 	inline QString GetOutputFile() { return m_output_file; }
 
@@ -110,6 +147,10 @@ public: // internal
 	// This function is thread-safe.
 	unsigned int GetQueuedPacketCount(unsigned int stream_index);
 
+	// Returns the packet pool. Encoders should get their packets from this pool, the muxer returns them after writing.
+	// The pool itself is thread-safe.
+	inline PacketPool* GetPacketPool() { return &m_packet_pool; }
+
 private:
 	void Init();
 	void Free();
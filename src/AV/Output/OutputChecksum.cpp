@@ -0,0 +1,429 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "OutputChecksum.h"
+
+#include "Logger.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+// Size of the buffer of the AVIOContext. The hashing tasks get a copy of every buffer that is written.
+const size_t OutputChecksum::IO_BUFFER_SIZE = 256 * 1024;
+
+// Size of the reads when parts of the file are read back.
+const size_t OutputChecksum::READ_BUFFER_SIZE = 1024 * 1024;
+
+// Maximum amount of written data that is waiting to be hashed. If the hashing falls further behind, the data is not copied
+// anymore and that part of the file is read back when the file is finished instead.
+const size_t OutputChecksum::MAX_QUEUED_BYTES = 64 * 1024 * 1024;
+
+// Size of the chunks that are hashed separately. Smaller chunks make verification of partial copies more precise,
+// but every chunk adds a line to the manifest. This must be a multiple of READ_BUFFER_SIZE.
+const uint64_t OutputChecksum::CHUNK_SIZE = 16 * 1024 * 1024;
+
+// Amount of data that is read back by one task, so a long read-back doesn't occupy a worker thread for too long.
+const uint64_t OutputChecksum::READ_BACK_STEP = 64 * 1024 * 1024;
+
+const uint64_t OutputChecksum::NO_GAP = std::numeric_limits<uint64_t>::max();
+
+static QString DigestToHex(const uint8_t* digest) {
+	return QString::fromLatin1(QByteArray((const char*) digest, 32).toHex());
+}
+
+OutputChecksum::OutputChecksum(const QString& file_name, const QString& manifest_file) {
+
+	m_file_name = file_name;
+	m_manifest_file = manifest_file;
+	m_fd = -1;
+	m_io = NULL;
+	m_position = 0;
+	m_size = 0;
+
+	m_sha_file = NULL;
+	m_sha_chunk = NULL;
+	m_hashed_end = 0;
+	m_gap = NO_GAP;
+	m_read_back_started = false;
+
+	m_stats_skipped_bytes = 0;
+	m_stats_reread_bytes = 0;
+	m_stats_reread_time = 0;
+
+	{
+		SharedLock lock(&m_shared_data);
+		lock->m_queued_bytes = 0;
+		lock->m_hashing = false;
+		lock->m_finishing = false;
+		lock->m_warn_overflow = true;
+	}
+
+	try {
+		Init();
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+}
+
+OutputChecksum::~OutputChecksum() {
+	Free();
+	Logger::LogInfo("[OutputChecksum::~OutputChecksum] " + Logger::tr("Checksums: %1 MiB hashed while writing, %2 MiB not copied, %3 MiB read back in %4 ms, %5 ms CPU time.")
+					.arg((double) m_size / (1024.0 * 1024.0), 0, 'f', 1).arg((double) m_stats_skipped_bytes / (1024.0 * 1024.0), 0, 'f', 1)
+					.arg((double) m_stats_reread_bytes / (1024.0 * 1024.0), 0, 'f', 1).arg((double) m_stats_reread_time * 1.0e-3, 0, 'f', 0)
+					.arg((double) m_tasks.GetCPUTime() * 1.0e-3, 0, 'f', 0));
+}
+
+void OutputChecksum::Flush() {
+	avio_flush(m_io);
+	if(m_io->error < 0) {
+		Logger::LogError("[OutputChecksum::Flush] " + Logger::tr("Error: Can't write to output file!"));
+		throw LibavException();
+	}
+}
+
+void OutputChecksum::FinishInBackground(std::unique_ptr<OutputChecksum> output) {
+
+	// from now on the object is owned by its tasks, the last one deletes it
+	OutputChecksum *ptr = output.release();
+
+	// the checksums are finished by the hashing task once it has processed the remaining blocks
+	bool start;
+	{
+		SharedLock lock(&ptr->m_shared_data);
+		lock->m_finishing = true;
+		start = !lock->m_hashing;
+		lock->m_hashing = true;
+	}
+	if(start)
+		ptr->m_tasks.Submit(TaskScheduler::PRIORITY_LOW, [ptr]() { ptr->HashBlocks(); });
+
+}
+
+QString OutputChecksum::GetFileName(const QString& output_file) {
+	return output_file + ".sha256.json";
+}
+
+void OutputChecksum::Init() {
+
+	// open the file
+	m_fd = open(QFile::encodeName(m_file_name).constData(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+	if(m_fd == -1) {
+		Logger::LogError("[OutputChecksum::Init] " + Logger::tr("Error: Can't open output file!"));
+		throw LibavException();
+	}
+
+	// create the hashes
+	m_sha_file = av_sha_alloc();
+	m_sha_chunk = av_sha_alloc();
+	if(m_sha_file == NULL || m_sha_chunk == NULL)
+		throw std::bad_alloc();
+	av_sha_init(m_sha_file, 256);
+
+	// create the AVIOContext
+	uint8_t *buffer = (uint8_t*) av_malloc(IO_BUFFER_SIZE);
+	if(buffer == NULL)
+		throw std::bad_alloc();
+	m_io = avio_alloc_context(buffer, IO_BUFFER_SIZE, 1, this, NULL, &WritePacket, &Seek);
+	if(m_io == NULL) {
+		av_free(buffer);
+		throw std::bad_alloc();
+	}
+
+}
+
+void OutputChecksum::Free() {
+	m_tasks.Wait();
+	if(m_io != NULL) {
+		av_freep(&m_io->buffer);
+		av_freep(&m_io);
+	}
+	if(m_sha_file != NULL) {
+		av_freep(&m_sha_file);
+	}
+	if(m_sha_chunk != NULL) {
+		av_freep(&m_sha_chunk);
+	}
+	if(m_fd != -1) {
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+void OutputChecksum::AddBlock(uint64_t offset, const uint8_t* data, size_t size) {
+	Block block;
+	block.m_offset = offset;
+	block.m_size = size;
+
+	// don't copy the data if the hashing has fallen too far behind, that part of the file is read back later
+	bool copy, warn = false;
+	{
+		SharedLock lock(&m_shared_data);
+		copy = (lock->m_queued_bytes + size <= MAX_QUEUED_BYTES);
+		if(copy) {
+			lock->m_queued_bytes += size;
+		} else {
+			m_stats_skipped_bytes += size;
+			warn = lock->m_warn_overflow;
+			lock->m_warn_overflow = false;
+		}
+	}
+	if(warn) {
+		Logger::LogWarning("[OutputChecksum::AddBlock] " + Logger::tr("Warning: Hashing can't keep up with the output, the rest of the file will be read back when it is finished."));
+	}
+	if(copy)
+		block.m_data.assign(data, data + size);
+
+	bool start;
+	{
+		SharedLock lock(&m_shared_data);
+		lock->m_blocks.push_back(std::move(block));
+		start = !lock->m_hashing;
+		lock->m_hashing = true;
+	}
+	// the blocks have to be hashed in order, so there is never more than one task
+	if(start)
+		m_tasks.Submit(TaskScheduler::PRIORITY_NORMAL, [this]() { HashBlocks(); });
+}
+
+void OutputChecksum::HashBlocks() {
+	for( ; ; ) {
+		Block block;
+		{
+			SharedLock lock(&m_shared_data);
+			if(lock->m_blocks.empty()) {
+				if(lock->m_finishing)
+					break;
+				lock->m_hashing = false;
+				return;
+			}
+			block = std::move(lock->m_blocks.front());
+			lock->m_blocks.pop_front();
+			lock->m_queued_bytes -= block.m_data.size();
+		}
+		HashBlock(block.m_offset, (block.m_data.empty())? NULL : block.m_data.data(), block.m_size);
+	}
+	FinishTask();
+}
+
+void OutputChecksum::HashBlock(uint64_t offset, const uint8_t* data, size_t size) {
+	uint64_t end = offset + size;
+
+	// data that was already hashed has been overwritten
+	if(offset < m_hashed_end) {
+		uint64_t last_chunk = (std::min(end, m_hashed_end) - 1) / CHUNK_SIZE;
+		for(uint64_t c = offset / CHUNK_SIZE; c <= last_chunk; ++c) {
+			m_chunks[c].m_dirty = true;
+		}
+		if(end <= m_hashed_end)
+			return;
+		if(data != NULL)
+			data += m_hashed_end - offset;
+		size = end - m_hashed_end;
+		offset = m_hashed_end;
+	}
+
+	// if the muxer skipped over some data or the data wasn't copied, the rest has to be read back later
+	if(m_gap != NO_GAP)
+		return;
+	if(offset > m_hashed_end || data == NULL) {
+		m_gap = m_hashed_end;
+		return;
+	}
+
+	HashData(data, size);
+}
+
+void OutputChecksum::HashData(const uint8_t* data, size_t size) {
+	while(size != 0) {
+		if(m_hashed_end % CHUNK_SIZE == 0) {
+			Chunk chunk;
+			chunk.m_dirty = false;
+			chunk.m_file_state.assign((const uint8_t*) m_sha_file, (const uint8_t*) m_sha_file + av_sha_size);
+			m_chunks.push_back(std::move(chunk));
+			av_sha_init(m_sha_chunk, 256);
+		}
+		size_t n = std::min((uint64_t) size, CHUNK_SIZE - m_hashed_end % CHUNK_SIZE);
+		av_sha_update(m_sha_file, data, n);
+		av_sha_update(m_sha_chunk, data, n);
+		data += n;
+		size -= n;
+		m_hashed_end += n;
+		if(m_hashed_end % CHUNK_SIZE == 0)
+			av_sha_final(m_sha_chunk, m_chunks.back().m_digest);
+	}
+}
+
+// Finishes the checksums after the file is complete and deletes the object. The read-back is split into steps, every step
+// submits this task again.
+void OutputChecksum::FinishTask() {
+	try {
+
+		// hash the changed parts again
+		if(!ReadBack()) {
+			m_tasks.Submit(TaskScheduler::PRIORITY_LOW, [this]() { FinishTask(); });
+			return;
+		}
+
+		// finish the last chunk and the file
+		if(m_hashed_end % CHUNK_SIZE != 0)
+			av_sha_final(m_sha_chunk, m_chunks.back().m_digest);
+		uint8_t file_digest[32];
+		av_sha_final(m_sha_file, file_digest);
+
+		// don't write a manifest for a file that was deleted in the meantime (e.g. because the recording was cancelled)
+		struct stat st;
+		if(fstat(m_fd, &st) == 0 && st.st_nlink == 0) {
+			Logger::LogInfo("[OutputChecksum::FinishTask] " + Logger::tr("The output file was deleted, the checksum manifest is not written."));
+		} else {
+			WriteManifest(file_digest);
+			Logger::LogInfo("[OutputChecksum::FinishTask] " + Logger::tr("SHA-256 of the output file: %1").arg(DigestToHex(file_digest)));
+		}
+
+	} catch(...) {
+		Logger::LogWarning("[OutputChecksum::FinishTask] " + Logger::tr("Warning: Can't write checksum manifest, continuing anyway."));
+	}
+
+	// the destructor waits for the tasks of this object, so it has to run in a task that doesn't belong to it
+	OutputChecksum *output = this;
+	TaskScheduler::GetInstance()->Submit(TaskScheduler::PRIORITY_LOW, [output]() { delete output; });
+
+}
+
+// Reads back the part of the file that has to be hashed again, at most READ_BACK_STEP bytes at a time.
+// Returns true when everything has been hashed.
+bool OutputChecksum::ReadBack() {
+	int64_t t1 = hrt_time_micro();
+
+	if(!m_read_back_started) {
+		m_read_back_started = true;
+
+		// the end of the file wasn't hashed if the hashing fell behind
+		if(m_gap == NO_GAP && m_hashed_end < m_size)
+			m_gap = m_hashed_end;
+
+		// find the first chunk that was changed after it was hashed
+		size_t first_chunk = m_chunks.size();
+		bool read_back = false;
+		for(size_t i = 0; i < m_chunks.size(); ++i) {
+			if(m_chunks[i].m_dirty) {
+				first_chunk = i;
+				read_back = true;
+				break;
+			}
+		}
+		if(m_gap != NO_GAP) {
+			first_chunk = std::min(first_chunk, (size_t) (m_gap / CHUNK_SIZE));
+			read_back = true;
+		}
+		if(!read_back)
+			return true;
+		Logger::LogInfo("[OutputChecksum::ReadBack] " + Logger::tr("The muxer changed data that was already hashed, reading back %1 MiB ...")
+						.arg((double) (m_size - first_chunk * CHUNK_SIZE) / (1024.0 * 1024.0), 0, 'f', 1));
+
+		// go back to the state at the start of the chunk (if the chunk doesn't exist yet, the hash is already there)
+		if(first_chunk < m_chunks.size()) {
+			memcpy(m_sha_file, m_chunks[first_chunk].m_file_state.data(), av_sha_size);
+			m_chunks.resize(first_chunk);
+		}
+		m_hashed_end = first_chunk * CHUNK_SIZE;
+		m_gap = NO_GAP;
+
+	}
+
+	// hash the data from the file
+	std::vector<uint8_t> buffer(READ_BUFFER_SIZE);
+	uint64_t step_end = std::min(m_size, m_hashed_end + READ_BACK_STEP);
+	while(m_hashed_end < step_end) {
+		size_t size = std::min((uint64_t) READ_BUFFER_SIZE, step_end - m_hashed_end);
+		ssize_t bytes_read = pread(m_fd, buffer.data(), size, m_hashed_end);
+		if(bytes_read < 0 && errno == EINTR)
+			continue;
+		if(bytes_read <= 0) {
+			Logger::LogError("[OutputChecksum::ReadBack] " + Logger::tr("Error: Can't read output file!"));
+			throw LibavException();
+		}
+		HashData(buffer.data(), bytes_read);
+		m_stats_reread_bytes += bytes_read;
+	}
+
+	m_stats_reread_time += hrt_time_micro() - t1;
+	return (m_hashed_end >= m_size);
+}
+
+void OutputChecksum::WriteManifest(const uint8_t* file_digest) {
+	QJsonArray chunks;
+	for(size_t i = 0; i < m_chunks.size(); ++i) {
+		QJsonObject obj;
+		obj["offset"] = (qint64) (i * CHUNK_SIZE);
+		obj["size"] = (qint64) std::min(CHUNK_SIZE, m_size - i * CHUNK_SIZE);
+		obj["sha256"] = DigestToHex(m_chunks[i].m_digest);
+		chunks.append(obj);
+	}
+	QJsonObject root;
+	root["file"] = QFileInfo(m_file_name).fileName();
+	root["size"] = (qint64) m_size;
+	root["sha256"] = DigestToHex(file_digest);
+	root["chunk_size"] = (qint64) CHUNK_SIZE;
+	root["chunks"] = chunks;
+	QFile file(m_manifest_file);
+	if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate) || file.write(QJsonDocument(root).toJson()) < 0) {
+		Logger::LogError("[OutputChecksum::WriteManifest] " + Logger::tr("Error: Can't write checksum manifest '%1'!").arg(m_manifest_file));
+		throw LibavException();
+	}
+}
+
+#if SSR_USE_AVIO_WRITE_CONST
+int OutputChecksum::WritePacket(void* opaque, const uint8_t* buf, int buf_size) {
+#else
+int OutputChecksum::WritePacket(void* opaque, uint8_t* buf, int buf_size) {
+#endif
+	OutputChecksum *output = (OutputChecksum*) opaque;
+	size_t done = 0;
+	while(done < (size_t) buf_size) {
+		ssize_t bytes_written = pwrite(output->m_fd, buf + done, buf_size - done, output->m_position + done);
+		if(bytes_written < 0) {
+			if(errno == EINTR)
+				continue;
+			return AVERROR(errno);
+		}
+		done += bytes_written;
+	}
+	output->AddBlock(output->m_position, buf, buf_size);
+	output->m_position += buf_size;
+	output->m_size = std::max(output->m_size, output->m_position);
+	return buf_size;
+}
+
+int64_t OutputChecksum::Seek(void* opaque, int64_t offset, int whence) {
+	OutputChecksum *output = (OutputChecksum*) opaque;
+	int64_t position;
+	switch(whence & ~AVSEEK_FORCE) {
+		case AVSEEK_SIZE: return output->m_size;
+		case SEEK_SET: position = offset; break;
+		case SEEK_CUR: position = output->m_position + offset; break;
+		case SEEK_END: position = output->m_size + offset; break;
+		default: return AVERROR(EINVAL);
+	}
+	if(position < 0)
+		return AVERROR(EINVAL);
+	output->m_position = position;
+	return position;
+}
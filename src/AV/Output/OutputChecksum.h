@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "MutexDataPair.h"
+#include "TaskScheduler.h"
+
+// An output file that computes SHA-256 checksums while it is being written, so the file doesn't have to be read back later.
+// It replaces the AVIOContext of the muxer. The data is written to the file directly and hashed on the worker threads.
+// Besides the checksum of the whole file, the file is split into chunks that are hashed separately.
+//
+// Most muxers seek back at the end to fill in sizes and indexes (e.g. the 'moov' size of MP4 or the seek head and cues
+// of Matroska). The chunks that were changed after they were hashed are read back and hashed again when the file is finished.
+// Since the checksum of the whole file depends on everything before it, it has to be recalculated from the first changed chunk
+// until the end of the file. The hash state at the start of every chunk is saved to make this possible. This is done in the
+// background after the muxer is gone, in small steps so the tasks don't occupy a worker thread for too long.
+// If the hashing falls behind the muxer, the data is not copied anymore and the rest of the file is read back as well.
+class OutputChecksum {
+
+private:
+	struct Block {
+		uint64_t m_offset, m_size;
+		std::vector<uint8_t> m_data; // empty if the data was not copied because the hashing fell behind
+	};
+	struct Chunk {
+		uint8_t m_digest[32];
+		bool m_dirty; // the chunk was changed after it was hashed
+		std::vector<uint8_t> m_file_state; // state of the file hash at the start of the chunk
+	};
+	struct SharedData {
+		std::deque<Block> m_blocks;
+		size_t m_queued_bytes;
+		bool m_hashing; // a task is processing the blocks
+		bool m_finishing; // the file is complete, the task should finish the checksums when the blocks are done
+		bool m_warn_overflow;
+	};
+	typedef MutexDataPair<SharedData>::Lock SharedLock;
+
+	static const size_t IO_BUFFER_SIZE, READ_BUFFER_SIZE, MAX_QUEUED_BYTES;
+	static const uint64_t CHUNK_SIZE, READ_BACK_STEP;
+	static const uint64_t NO_GAP;
+
+private:
+	QString m_file_name, m_manifest_file;
+	int m_fd;
+	AVIOContext *m_io;
+	uint64_t m_position, m_size;
+
+	// only used by the hashing task
+	AVSHA *m_sha_file, *m_sha_chunk;
+	uint64_t m_hashed_end, m_gap;
+	std::vector<Chunk> m_chunks;
+	bool m_read_back_started;
+
+	uint64_t m_stats_skipped_bytes, m_stats_reread_bytes;
+	int64_t m_stats_reread_time;
+
+	MutexDataPair<SharedData> m_shared_data;
+
+	TaskScheduler::Group m_tasks; // must be destroyed first
+
+public:
+	// Creates (or truncates) the output file. The manifest is written when the file is finished.
+	OutputChecksum(const QString& file_name, const QString& manifest_file);
+	~OutputChecksum();
+
+	// Returns the AVIOContext that the muxer should write to. It remains owned by this object.
+	inline AVIOContext* GetIOContext() { return m_io; }
+
+	// Writes the remaining buffered data to the file. Call this after the trailer was written.
+	void Flush();
+
+	// Takes ownership of a flushed output, hashes the changed parts of the file again and writes the manifest with tasks on the
+	// task scheduler. The object is deleted when this is done. This returns immediately, so it can be called while holding locks.
+	static void FinishInBackground(std::unique_ptr<OutputChecksum> output);
+
+	// Returns the name of the manifest file for a given output file.
+	static QString GetFileName(const QString& output_file);
+
+private:
+	void Init();
+	void Free();
+
+	void AddBlock(uint64_t offset, const uint8_t* data, size_t size);
+	void HashBlocks();
+	void HashBlock(uint64_t offset, const uint8_t* data, size_t size);
+	void HashData(const uint8_t* data, size_t size);
+	void FinishTask();
+	bool ReadBack();
+	void WriteManifest(const uint8_t* file_digest);
+
+#if SSR_USE_AVIO_WRITE_CONST
+	static int WritePacket(void* opaque, const uint8_t* buf, int buf_size);
+#else
+	static int WritePacket(void* opaque, uint8_t* buf, int buf_size);
+#endif
+	static int64_t Seek(void* opaque, int64_t offset, int whence);
+
+};
@@ -33,9 +33,10 @@ static QString GetNewFragmentFile(const QString& file, unsigned int fragment_num
 	return newfile;
 }
 
-OutputManager::OutputManager(const OutputSettings& output_settings) {
+OutputManager::OutputManager(const OutputSettings& output_settings, StatsBlock* stats) {
 
 	m_output_settings = output_settings;
+	m_stats = stats;
 
 	m_fragmented = false;
 	m_fragment_length = 5;
@@ -45,6 +46,8 @@ OutputManager::OutputManager(const OutputSettings& output_settings) {
 		SharedLock lock(&m_shared_data);
 		lock->m_fragment_number = 0;
 		lock->m_video_encoder = NULL;
+		lock->m_video_bit_rate_override = 0;
+		lock->m_video_crf_override = -1;
 		lock->m_audio_encoder = NULL;
 	}
 
@@ -106,6 +109,38 @@ bool OutputManager::IsFinished() {
 	}
 }
 
+void OutputManager::WaitFinished() {
+	if(m_fragmented) {
+		// the fragment thread stops after the last fragment has been finished
+		if(m_thread.joinable())
+			m_thread.join();
+	} else {
+		// the muxer is only replaced in fragmented mode, so it's safe to use it without the lock
+		Muxer *muxer;
+		{
+			SharedLock lock(&m_shared_data);
+			assert(lock->m_muxer != NULL);
+			muxer = lock->m_muxer.get();
+		}
+		muxer->Wait();
+	}
+}
+
+bool OutputManager::HasErrorOccurred() {
+	if(m_error_occurred)
+		return true;
+	if(m_synchronizer != NULL && m_synchronizer->HasErrorOccurred())
+		return true;
+	SharedLock lock(&m_shared_data);
+	if(lock->m_muxer != NULL && lock->m_muxer->HasErrorOccurred())
+		return true;
+	if(lock->m_video_encoder != NULL && lock->m_video_encoder->HasErrorOccurred())
+		return true;
+	if(lock->m_audio_encoder != NULL && lock->m_audio_encoder->HasErrorOccurred())
+		return true;
+	return false;
+}
+
 void OutputManager::AddVideoFrame(std::unique_ptr<AVFrameWrapper> frame) {
 	assert(frame->GetFrame()->pts != (int64_t) AV_NOPTS_VALUE);
 	SharedLock lock(&m_shared_data);
@@ -183,6 +218,61 @@ double OutputManager::GetActualFrameRate() {
 	return lock->m_video_encoder->GetActualFrameRate();
 }
 
+bool OutputManager::RequestVideoKeyframe() {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder == NULL)
+		return false;
+	lock->m_video_encoder->RequestKeyframe();
+	return true;
+}
+
+bool OutputManager::RequestVideoBitRate(unsigned int bit_rate) {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder == NULL)
+		return false;
+	lock->m_video_bit_rate_override = bit_rate;
+	lock->m_video_encoder->RequestBitRate(bit_rate);
+	return true;
+}
+
+bool OutputManager::RequestVideoCRF(unsigned int crf) {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder == NULL)
+		return false;
+	lock->m_video_crf_override = crf;
+	lock->m_video_encoder->RequestCRF(crf);
+	return true;
+}
+
+bool OutputManager::RequestVideoPreset(const QString& preset) {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder == NULL)
+		return false;
+	lock->m_video_preset_override = preset;
+	lock->m_video_encoder->RequestPreset(preset);
+	return true;
+}
+
+int64_t OutputManager::GetVideoKeyframeLatency() {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder == NULL)
+		return -1;
+	return lock->m_video_encoder->GetKeyframeLatency();
+}
+
+void OutputManager::MarkVideoResume(int64_t time) {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder != NULL)
+		lock->m_video_encoder->MarkResume(time);
+}
+
+int64_t OutputManager::GetVideoResumeLatency() {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_video_encoder == NULL)
+		return -1;
+	return lock->m_video_encoder->GetResumeLatency();
+}
+
 double OutputManager::GetActualBitRate() {
 	SharedLock lock(&m_shared_data);
 	if(lock->m_muxer == NULL)
@@ -197,6 +287,16 @@ uint64_t OutputManager::GetTotalBytes() {
 	return lock->m_muxer->GetTotalBytes();
 }
 
+int64_t OutputManager::GetCPUTime() {
+	int64_t cpu_time = thread_cpu_time_micro(m_thread);
+	if(m_synchronizer != NULL)
+		cpu_time += m_synchronizer->GetCPUTime();
+	SharedLock lock(&m_shared_data);
+	if(lock->m_muxer != NULL)
+		cpu_time += lock->m_muxer->GetCPUTime();
+	return cpu_time;
+}
+
 void OutputManager::Init() {
 
 	// start muxer and encoders
@@ -269,11 +369,13 @@ void OutputManager::StartFragment() {
 	} else {
 		filename = m_output_settings.file;
 	}
+	std::unique_ptr<Muxer> muxer;
+	VideoEncoder *video_encoder = NULL;
+	AudioEncoder *audio_encoder = NULL;
 	try {
 		Logger::LogInfo("[OutputManager::StartFragment] Creating muxer for file: " + filename);
-		std::unique_ptr<Muxer> muxer(new Muxer(m_output_settings.container_avname, filename));
-		VideoEncoder *video_encoder = NULL;
-		AudioEncoder *audio_encoder = NULL;
+		muxer.reset(new Muxer(m_output_settings.container_avname, filename));
+		muxer->SetStatsBlock(m_stats);
 
 		// 检查视频参数是否有效
 		if(!m_output_settings.video_codec_avname.isEmpty()) {
@@ -315,13 +417,11 @@ void OutputManager::StartFragment() {
 											   m_output_settings.audio_channels, m_output_settings.audio_sample_rate, audio_time_base);
 		}
 		
+		if(m_output_settings.packet_journal)
+			muxer->EnablePacketJournal(PacketJournal::GetFileName(filename));
+		if(m_output_settings.checksum_manifest)
+			muxer->EnableChecksumManifest(OutputChecksum::GetFileName(filename));
 		muxer->Start();
-		
-		// acquire lock and share the muxer and encoders
-		SharedLock lock(&m_shared_data);
-		lock->m_muxer = std::move(muxer);
-		lock->m_video_encoder = video_encoder;
-		lock->m_audio_encoder = audio_encoder;
 	} catch(const std::exception& e) {
 		Logger::LogError("[OutputManager::StartFragment] " + Logger::tr("Error: %1").arg(e.what()));
 		throw;
@@ -330,6 +430,22 @@ void OutputManager::StartFragment() {
 		throw;
 	}
 
+	// acquire lock and share the muxer and encoders
+	SharedLock lock(&m_shared_data);
+	lock->m_muxer = std::move(muxer);
+	lock->m_video_encoder = video_encoder;
+	lock->m_audio_encoder = audio_encoder;
+
+	// reapply rate control changes that were requested during previous fragments
+	if(video_encoder != NULL) {
+		if(lock->m_video_bit_rate_override != 0)
+			video_encoder->RequestBitRate(lock->m_video_bit_rate_override);
+		if(lock->m_video_crf_override >= 0)
+			video_encoder->RequestCRF(lock->m_video_crf_override);
+		if(!lock->m_video_preset_override.isEmpty())
+			video_encoder->RequestPreset(lock->m_video_preset_override);
+	}
+
 	// increment fragment number
 	// It's important that this is done here (i.e. after the encoders have been set up), because the fragment number
 	// acts as a signal to AddVideoFrame/AddAudioFrame that they can pass frames to the encoders.
@@ -26,6 +26,8 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Synchronizer.h"
 #include "OutputSettings.h"
 
+struct StatsBlock;
+
 class OutputManager {
 
 private:
@@ -41,6 +43,11 @@ private:
 		VideoEncoder *m_video_encoder;
 		AudioEncoder *m_audio_encoder;
 
+		// rate control changes requested while recording, reapplied to the encoders of new fragments
+		unsigned int m_video_bit_rate_override; // 0 = none
+		int m_video_crf_override; // -1 = none
+		QString m_video_preset_override; // empty = none
+
 	};
 	typedef MutexDataPair<SharedData>::Lock SharedLock;
 
@@ -50,6 +57,7 @@ private:
 private:
 	OutputSettings m_output_settings;
 	OutputFormat m_output_format;
+	StatsBlock *m_stats;
 
 	bool m_fragmented;
 	int64_t m_fragment_length;
@@ -61,7 +69,8 @@ private:
 	std::atomic<bool> m_should_stop, m_should_finish, m_is_done, m_error_occurred;
 
 public:
-	OutputManager(const OutputSettings& output_settings);
+	// The statistics are reported in 'stats' if it is not NULL (see StatsSegment), the slot must outlive the output manager.
+	OutputManager(const OutputSettings& output_settings, StatsBlock* stats = NULL);
 	~OutputManager();
 
 	// Tells the encoders and muxer to finish. After calling this function, you should wait until
@@ -71,6 +80,14 @@ public:
 	// Returns whether the encoders and muxer have finished.
 	bool IsFinished();
 
+	// Blocks until the encoders and muxer have finished. Finish should be called first.
+	void WaitFinished();
+
+	// Returns whether an error has occurred in the synchronizer, the encoders, the muxer or the fragment thread.
+	// The output should still be finished with Finish and WaitFinished, so the file gets a valid trailer if possible.
+	// This function should be called by the same thread as Finish.
+	bool HasErrorOccurred();
+
 	// Adds a video frame to the frame queue. Called by the synchronizer.
 	// This function is thread-safe.
 	void AddVideoFrame(std::unique_ptr<AVFrameWrapper> frame);
@@ -100,6 +117,30 @@ public:
 	// This function is thread-safe.
 	uint64_t GetTotalBytes();
 
+	// Forwards control requests to the current video encoder, they are applied at the next frame.
+	// Returns false if there is no video encoder.
+	// This function is thread-safe.
+	bool RequestVideoKeyframe();
+	bool RequestVideoBitRate(unsigned int bit_rate);
+	bool RequestVideoCRF(unsigned int crf);
+	bool RequestVideoPreset(const QString& preset);
+
+	// Returns the latency of the last keyframe request (in microseconds), or -1 if it is not known.
+	// This function is thread-safe.
+	int64_t GetVideoKeyframeLatency();
+
+	// Tells the video encoder that the next frame is the first one after resuming (at 'time', in microseconds). Called by the synchronizer.
+	// This function is thread-safe.
+	void MarkVideoResume(int64_t time);
+
+	// Returns the time between the last resume and the first encoded frame after it (in microseconds), or -1 if it is not known.
+	// This function is thread-safe.
+	int64_t GetVideoResumeLatency();
+
+	// Returns the CPU time used by the synchronizer, encoder, muxer and fragment threads (in microseconds).
+	// This does not include the input threads.
+	int64_t GetCPUTime();
+
 private:
 	void Init();
 	void Free();
@@ -113,5 +154,6 @@ public:
 	inline const OutputSettings* GetOutputSettings() { return &m_output_settings; }
 	inline const OutputFormat* GetOutputFormat() { return &m_output_format; }
 	inline Synchronizer* GetSynchronizer() { return m_synchronizer.get(); }
+	inline StatsBlock* GetStatsBlock() { return m_stats; }
 
 };
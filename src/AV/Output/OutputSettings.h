@@ -24,6 +24,8 @@ struct OutputSettings {
 
 	QString file;
 	QString container_avname;
+	bool packet_journal; // write all packets to a journal as well, so the file can be recovered after a crash
+	bool checksum_manifest; // compute SHA-256 checksums while writing and save them in a sidecar file
 
 	QString video_codec_avname;
 	unsigned int video_kbit_rate;
@@ -32,6 +34,11 @@ struct OutputSettings {
 	unsigned int video_frame_rate;
 	double video_time_base;
 	bool video_allow_frame_skipping;
+	bool video_content_hints; // analyze the content of each frame and pass hints to the encoder
+	bool video_roi_cursor, video_roi_window; // encode the area around the cursor and the active window with a higher quality
+	bool video_activity_index; // write a sidecar file with the amount of activity in every second
+	int video_conversion_threads; // threads used to convert frames in the synchronizer, 0 = convert in the input thread, -1 = automatic
+	bool video_letterbox; // preserve the aspect ratio of the input instead of stretching it to the output size (can be changed while recording)
 
 	QString audio_codec_avname;
 	unsigned int audio_kbit_rate;
@@ -0,0 +1,501 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PacketJournal.h"
+
+#include "Logger.h"
+#include "AVWrapper.h"
+
+// Record types. The values are ASCII tags, which makes the file easier to inspect with a hex editor.
+const uint32_t PacketJournal::RECORD_HEADER = 0x4a525353; // "SSRJ"
+const uint32_t PacketJournal::RECORD_STREAM = 0x4d525453; // "STRM"
+const uint32_t PacketJournal::RECORD_PACKET = 0x544b4350; // "PCKT"
+
+// Version of the journal format, stored in the header. Journals with a different version are rejected.
+const uint32_t PacketJournal::VERSION = 1;
+
+// Records that claim to be larger than this are treated as damaged. This is far more than the largest packet any encoder will produce.
+const uint32_t PacketJournal::MAX_RECORD_SIZE = 256 * 1024 * 1024;
+
+// Minimum time between flushes (in microseconds). Audio-only recordings have a keyframe in every packet, so without this limit
+// the journal would be flushed hundreds of times per second.
+const int64_t PacketJournal::MIN_FLUSH_INTERVAL = 500000;
+
+static void PutU32(std::vector<uint8_t>* buffer, uint32_t value) {
+	for(unsigned int i = 0; i < 4; ++i) {
+		buffer->push_back((uint8_t) (value >> (8 * i)));
+	}
+}
+static void PutU64(std::vector<uint8_t>* buffer, uint64_t value) {
+	for(unsigned int i = 0; i < 8; ++i) {
+		buffer->push_back((uint8_t) (value >> (8 * i)));
+	}
+}
+static void PutBytes(std::vector<uint8_t>* buffer, const uint8_t* data, size_t size) {
+	PutU32(buffer, size);
+	buffer->insert(buffer->end(), data, data + size);
+}
+static void PutString(std::vector<uint8_t>* buffer, const QString& str) {
+	QByteArray utf8 = str.toUtf8();
+	PutBytes(buffer, (const uint8_t*) utf8.constData(), utf8.size());
+}
+
+static inline uint32_t GetU32(const uint8_t* data) {
+	return (uint32_t) data[0] | ((uint32_t) data[1] << 8) | ((uint32_t) data[2] << 16) | ((uint32_t) data[3] << 24);
+}
+
+// Reads the fields of a record payload. Throws an exception if the payload is too short.
+class JournalFieldReader {
+
+private:
+	const std::vector<uint8_t> &m_payload;
+	size_t m_pos;
+
+public:
+	inline JournalFieldReader(const std::vector<uint8_t>& payload) : m_payload(payload), m_pos(0) {}
+	inline size_t GetPosition() { return m_pos; }
+	inline void Check(size_t size) {
+		if(size > m_payload.size() - m_pos) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Journal record is too short!"));
+			throw LibavException();
+		}
+	}
+	inline uint32_t U32() {
+		Check(4);
+		uint32_t value = GetU32(m_payload.data() + m_pos);
+		m_pos += 4;
+		return value;
+	}
+	inline int32_t I32() {
+		return (int32_t) U32();
+	}
+	inline int64_t I64() {
+		uint64_t low = U32();
+		uint64_t high = U32();
+		return (int64_t) (low | (high << 32));
+	}
+	inline const uint8_t* Bytes(size_t* size) {
+		*size = U32();
+		Check(*size);
+		const uint8_t *data = m_payload.data() + m_pos;
+		m_pos += *size;
+		return data;
+	}
+	inline QString String() {
+		size_t size;
+		const uint8_t *data = Bytes(&size);
+		return QString::fromUtf8((const char*) data, size);
+	}
+
+};
+
+// The parameters of a stream, as stored in the journal.
+struct JournalStream {
+	AVMediaType m_codec_type;
+	AVCodecID m_codec_id;
+	AVRational m_time_base;
+	int64_t m_bit_rate;
+	int m_width, m_height, m_format;
+	AVRational m_sample_aspect_ratio;
+	int m_color_range, m_color_primaries, m_color_trc, m_colorspace, m_chroma_location;
+	int m_video_delay;
+	int m_sample_rate, m_channels, m_frame_size;
+	std::vector<uint8_t> m_extradata;
+};
+
+PacketJournal::PacketJournal(const QString& file_name, const QString& container_name, const QString& output_file, AVFormatContext* format_context,
+							 const std::vector<AVCodecContext*>& codec_contexts) {
+
+	m_file_name = file_name;
+	m_io = NULL;
+	m_crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+
+	m_last_flush_time = hrt_time_micro();
+
+	m_stats_packets = 0;
+	m_stats_bytes = 0;
+	m_stats_flushes = 0;
+	m_stats_write_time = 0;
+
+	try {
+		Init(container_name, output_file, format_context, codec_contexts);
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+}
+
+PacketJournal::~PacketJournal() {
+	Free();
+	Logger::LogInfo("[PacketJournal::~PacketJournal] " + Logger::tr("Packet journal: %1 packets, %2 MiB, %3 flushes, %4 ms spent writing.")
+					.arg(m_stats_packets).arg((double) m_stats_bytes / (1024.0 * 1024.0), 0, 'f', 1).arg(m_stats_flushes)
+					.arg((double) m_stats_write_time * 1.0e-3, 0, 'f', 1));
+}
+
+void PacketJournal::AddPacket(const AVPacket* packet) {
+
+	if(m_io == NULL)
+		return;
+	int64_t t1 = hrt_time_micro();
+
+	// the packet data is written directly from the packet, only the fields are collected first
+	m_record.clear();
+	PutU32(&m_record, packet->stream_index);
+	PutU32(&m_record, packet->flags);
+	PutU64(&m_record, packet->pts);
+	PutU64(&m_record, packet->dts);
+	PutU64(&m_record, packet->duration);
+	WriteRecord(RECORD_PACKET, m_record, packet->data, packet->size);
+	++m_stats_packets;
+
+	// Flush at keyframes, because the packets after the last keyframe can't be decoded anyway.
+	// This only pushes the data to the kernel, which is enough to survive a crash of the program itself.
+	bool keyframe = ((packet->flags & AV_PKT_FLAG_KEY) && (unsigned int) packet->stream_index < m_stream_is_video.size() &&
+					 (m_stream_is_video[packet->stream_index] || std::find(m_stream_is_video.begin(), m_stream_is_video.end(), true) == m_stream_is_video.end()));
+	if(keyframe && t1 >= m_last_flush_time + MIN_FLUSH_INTERVAL) {
+		avio_flush(m_io);
+		m_last_flush_time = t1;
+		++m_stats_flushes;
+		if(m_io->error < 0) {
+			Logger::LogError("[PacketJournal::AddPacket] " + Logger::tr("Error: Can't write to the packet journal, continuing without it."));
+			Free();
+		}
+	}
+
+	m_stats_write_time += hrt_time_micro() - t1;
+
+}
+
+QString PacketJournal::GetFileName(const QString& output_file) {
+	return output_file + ".journal";
+}
+
+bool PacketJournal::Recover(const QString& journal_file, const QString& output_file) {
+#if SSR_USE_AVSTREAM_CODECPAR
+
+	const AVCRC *crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+	AVIOContext *io = NULL;
+	AVFormatContext *format_context = NULL;
+	bool header_written = false;
+	uint64_t packets = 0;
+	try {
+
+		// open the journal
+		if(avio_open(&io, QFile::encodeName(journal_file).constData(), AVIO_FLAG_READ) < 0) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't open journal file!"));
+			throw LibavException();
+		}
+
+		// read the header
+		uint32_t type;
+		std::vector<uint8_t> payload;
+		if(!ReadRecord(io, crc_table, &type, &payload) || type != RECORD_HEADER) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: This is not a packet journal!"));
+			throw LibavException();
+		}
+		JournalFieldReader header(payload);
+		uint32_t version = header.U32();
+		if(version != VERSION) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Journal version %1 is not supported!").arg(version));
+			throw LibavException();
+		}
+		QString container_name = header.String();
+		QString original_file = header.String();
+		uint32_t stream_count = header.U32();
+		if(stream_count == 0 || stream_count > 16) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Journal has an invalid number of streams!"));
+			throw LibavException();
+		}
+
+		// read the streams
+		std::vector<JournalStream> streams(stream_count);
+		for(JournalStream &s : streams) {
+			if(!ReadRecord(io, crc_table, &type, &payload) || type != RECORD_STREAM) {
+				Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Journal is damaged, the stream parameters are missing!"));
+				throw LibavException();
+			}
+			JournalFieldReader reader(payload);
+			s.m_codec_type = (AVMediaType) reader.I32();
+			s.m_codec_id = (AVCodecID) reader.I32();
+			s.m_time_base.num = reader.I32();
+			s.m_time_base.den = reader.I32();
+			s.m_bit_rate = reader.I64();
+			s.m_width = reader.I32();
+			s.m_height = reader.I32();
+			s.m_format = reader.I32();
+			s.m_sample_aspect_ratio.num = reader.I32();
+			s.m_sample_aspect_ratio.den = reader.I32();
+			s.m_color_range = reader.I32();
+			s.m_color_primaries = reader.I32();
+			s.m_color_trc = reader.I32();
+			s.m_colorspace = reader.I32();
+			s.m_chroma_location = reader.I32();
+			s.m_video_delay = reader.I32();
+			s.m_sample_rate = reader.I32();
+			s.m_channels = reader.I32();
+			s.m_frame_size = reader.I32();
+			size_t extradata_size;
+			const uint8_t *extradata = reader.Bytes(&extradata_size);
+			s.m_extradata.assign(extradata, extradata + extradata_size);
+			if(s.m_time_base.num <= 0 || s.m_time_base.den <= 0) {
+				Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Journal has an invalid time base!"));
+				throw LibavException();
+			}
+		}
+
+		// choose the output file
+		QString file = output_file;
+		if(file.isEmpty()) {
+			QFileInfo fi(original_file);
+			file = fi.path() + "/" + fi.completeBaseName() + "-recovered" + ((fi.suffix().isEmpty())? QString() : "." + fi.suffix());
+		}
+		Logger::LogInfo("[PacketJournal::Recover] " + Logger::tr("Recovering '%1' as '%2' ...").arg(original_file).arg(file));
+
+		// create the output file with the same streams
+		// we have to break const correctness for compatibility with older ffmpeg versions
+		AVOutputFormat *format = (AVOutputFormat*) av_guess_format(container_name.toUtf8().constData(), NULL, NULL);
+		if(format == NULL) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't find chosen output format!"));
+			throw LibavException();
+		}
+		format_context = avformat_alloc_context();
+		if(format_context == NULL) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't allocate format context!"));
+			throw LibavException();
+		}
+		format_context->oformat = format;
+		for(const JournalStream &s : streams) {
+			AVStream *stream = avformat_new_stream(format_context, NULL);
+			if(stream == NULL) {
+				Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't create new stream!"));
+				throw LibavException();
+			}
+			stream->time_base = s.m_time_base;
+			AVCodecParameters *par = stream->codecpar;
+			par->codec_type = s.m_codec_type;
+			par->codec_id = s.m_codec_id;
+			par->bit_rate = s.m_bit_rate;
+			if(s.m_codec_type == AVMEDIA_TYPE_VIDEO) {
+				par->width = s.m_width;
+				par->height = s.m_height;
+				par->format = s.m_format;
+				par->sample_aspect_ratio = s.m_sample_aspect_ratio;
+				stream->sample_aspect_ratio = s.m_sample_aspect_ratio;
+				par->color_range = (AVColorRange) s.m_color_range;
+				par->color_primaries = (AVColorPrimaries) s.m_color_primaries;
+				par->color_trc = (AVColorTransferCharacteristic) s.m_color_trc;
+				par->color_space = (AVColorSpace) s.m_colorspace;
+				par->chroma_location = (AVChromaLocation) s.m_chroma_location;
+				par->video_delay = s.m_video_delay;
+			} else {
+				par->format = s.m_format;
+				par->sample_rate = s.m_sample_rate;
+#if SSR_USE_AV_CHANNEL_LAYOUT
+				av_channel_layout_default(&par->ch_layout, s.m_channels);
+#else
+				par->channels = s.m_channels;
+				par->channel_layout = av_get_default_channel_layout(s.m_channels);
+#endif
+				par->frame_size = s.m_frame_size;
+			}
+			if(!s.m_extradata.empty()) {
+				par->extradata = (uint8_t*) av_mallocz(s.m_extradata.size() + AV_INPUT_BUFFER_PADDING_SIZE);
+				if(par->extradata == NULL)
+					throw std::bad_alloc();
+				memcpy(par->extradata, s.m_extradata.data(), s.m_extradata.size());
+				par->extradata_size = s.m_extradata.size();
+			}
+		}
+		if(avio_open(&format_context->pb, QFile::encodeName(file).constData(), AVIO_FLAG_WRITE) < 0) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't open output file!"));
+			throw LibavException();
+		}
+		if(avformat_write_header(format_context, NULL) < 0) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't write header!", "Don't translate 'header'"));
+			throw LibavException();
+		}
+		header_written = true;
+
+		// copy the packets, the muxer may have changed the time base of the streams
+		double duration = 0.0;
+		while(ReadRecord(io, crc_table, &type, &payload)) {
+			if(type != RECORD_PACKET)
+				continue;
+			JournalFieldReader reader(payload);
+			uint32_t stream_index = reader.U32();
+			if(stream_index >= stream_count) {
+				Logger::LogWarning("[PacketJournal::Recover] " + Logger::tr("Warning: Journal contains a packet for an unknown stream, skipping it."));
+				continue;
+			}
+			uint32_t flags = reader.U32();
+			int64_t pts = reader.I64(), dts = reader.I64(), packet_duration = reader.I64();
+			size_t size = payload.size() - reader.GetPosition();
+			AVPacketWrapper packet(size);
+			memcpy(packet.GetPacket()->data, payload.data() + reader.GetPosition(), size);
+			packet.GetPacket()->stream_index = stream_index;
+			packet.GetPacket()->flags = flags;
+			packet.GetPacket()->pts = pts;
+			packet.GetPacket()->dts = dts;
+			packet.GetPacket()->duration = packet_duration;
+			AVStream *stream = format_context->streams[stream_index];
+			av_packet_rescale_ts(packet.GetPacket(), streams[stream_index].m_time_base, stream->time_base);
+			if(pts != (int64_t) AV_NOPTS_VALUE)
+				duration = std::max(duration, (double) pts * ToDouble(streams[stream_index].m_time_base));
+			if(av_interleaved_write_frame(format_context, packet.GetPacket()) != 0) {
+				Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't write frame to muxer!"));
+				throw LibavException();
+			}
+			++packets;
+		}
+		if(!avio_feof(io)) {
+			Logger::LogWarning("[PacketJournal::Recover] " + Logger::tr("Warning: The journal ends with an incomplete record at byte %1, the rest was ignored.")
+							   .arg(avio_tell(io)));
+		}
+
+		// finish the file
+		header_written = false;
+		if(av_write_trailer(format_context) != 0) {
+			Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Can't write trailer!", "Don't translate 'trailer'"));
+			throw LibavException();
+		}
+		Logger::LogInfo("[PacketJournal::Recover] " + Logger::tr("Recovered %1 packets (%2 seconds).").arg(packets).arg(duration, 0, 'f', 1));
+
+	} catch(const std::exception& e) {
+		Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Recovery failed: %1").arg(e.what()));
+		if(format_context != NULL) {
+			if(header_written)
+				av_write_trailer(format_context);
+			if(format_context->pb != NULL)
+				avio_closep(&format_context->pb);
+			avformat_free_context(format_context);
+		}
+		if(io != NULL)
+			avio_closep(&io);
+		return false;
+	}
+	avio_closep(&format_context->pb);
+	avformat_free_context(format_context);
+	avio_closep(&io);
+	return true;
+
+#else
+	Q_UNUSED(journal_file);
+	Q_UNUSED(output_file);
+	Logger::LogError("[PacketJournal::Recover] " + Logger::tr("Error: Recovering a journal requires a newer version of libavformat!"));
+	return false;
+#endif
+}
+
+void PacketJournal::Init(const QString& container_name, const QString& output_file, AVFormatContext* format_context, const std::vector<AVCodecContext*>& codec_contexts) {
+
+	assert(codec_contexts.size() == format_context->nb_streams);
+
+	// open the file
+	if(avio_open(&m_io, QFile::encodeName(m_file_name).constData(), AVIO_FLAG_WRITE) < 0) {
+		Logger::LogError("[PacketJournal::Init] " + Logger::tr("Error: Can't open journal file!"));
+		throw LibavException();
+	}
+
+	// write the header
+	std::vector<uint8_t> fields;
+	PutU32(&fields, VERSION);
+	PutString(&fields, container_name);
+	PutString(&fields, output_file);
+	PutU32(&fields, format_context->nb_streams);
+	WriteRecord(RECORD_HEADER, fields);
+
+	// write the stream parameters
+	for(unsigned int i = 0; i < format_context->nb_streams; ++i) {
+		AVStream *stream = format_context->streams[i];
+		AVCodecContext *codec_context = codec_contexts[i];
+		fields.clear();
+		PutU32(&fields, codec_context->codec_type);
+		PutU32(&fields, codec_context->codec_id);
+		PutU32(&fields, stream->time_base.num);
+		PutU32(&fields, stream->time_base.den);
+		PutU64(&fields, codec_context->bit_rate);
+		PutU32(&fields, codec_context->width);
+		PutU32(&fields, codec_context->height);
+		PutU32(&fields, (codec_context->codec_type == AVMEDIA_TYPE_VIDEO)? (int) codec_context->pix_fmt : (int) codec_context->sample_fmt);
+		PutU32(&fields, codec_context->sample_aspect_ratio.num);
+		PutU32(&fields, codec_context->sample_aspect_ratio.den);
+		PutU32(&fields, codec_context->color_range);
+		PutU32(&fields, codec_context->color_primaries);
+		PutU32(&fields, codec_context->color_trc);
+		PutU32(&fields, codec_context->colorspace);
+		PutU32(&fields, codec_context->chroma_sample_location);
+		PutU32(&fields, codec_context->has_b_frames);
+		PutU32(&fields, codec_context->sample_rate);
+#if SSR_USE_AV_CHANNEL_LAYOUT
+		PutU32(&fields, codec_context->ch_layout.nb_channels);
+#else
+		PutU32(&fields, codec_context->channels);
+#endif
+		PutU32(&fields, codec_context->frame_size);
+		PutBytes(&fields, codec_context->extradata, (codec_context->extradata == NULL)? 0 : codec_context->extradata_size);
+		WriteRecord(RECORD_STREAM, fields);
+		m_stream_is_video.push_back(codec_context->codec_type == AVMEDIA_TYPE_VIDEO);
+	}
+
+	// the parameters have to be on disk before the first packet
+	avio_flush(m_io);
+	if(m_io->error < 0) {
+		Logger::LogError("[PacketJournal::Init] " + Logger::tr("Error: Can't write to journal file!"));
+		throw LibavException();
+	}
+
+	Logger::LogInfo("[PacketJournal::Init] " + Logger::tr("Writing packet journal to '%1'.").arg(m_file_name));
+
+}
+
+void PacketJournal::Free() {
+	if(m_io != NULL) {
+		avio_closep(&m_io);
+	}
+}
+
+void PacketJournal::WriteRecord(uint32_t type, const std::vector<uint8_t>& fields, const uint8_t* data, size_t size) {
+	uint32_t crc = av_crc(m_crc_table, 0, fields.data(), fields.size());
+	if(size != 0)
+		crc = av_crc(m_crc_table, crc, data, size);
+	avio_wl32(m_io, type);
+	avio_wl32(m_io, fields.size() + size);
+	avio_write(m_io, fields.data(), fields.size());
+	if(size != 0)
+		avio_write(m_io, data, size);
+	avio_wl32(m_io, crc);
+	m_stats_bytes += 12 + fields.size() + size;
+}
+
+bool PacketJournal::ReadRecord(AVIOContext* io, const AVCRC* crc_table, uint32_t* type, std::vector<uint8_t>* payload) {
+	uint8_t head[8], tail[4];
+	if(avio_read(io, head, 8) != 8)
+		return false;
+	*type = GetU32(head);
+	uint32_t size = GetU32(head + 4);
+	if(size > MAX_RECORD_SIZE)
+		return false;
+	payload->resize(size);
+	if(size != 0 && avio_read(io, payload->data(), size) != (int) size)
+		return false;
+	if(avio_read(io, tail, 4) != 4)
+		return false;
+	return (GetU32(tail) == av_crc(crc_table, 0, payload->data(), size));
+}
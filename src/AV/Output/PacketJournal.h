@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+// An append-only journal of the encoded packets of a recording, written next to the output file. Most containers can't be read
+// (or lose their index) if the recording is interrupted before the trailer is written, which can ruin a long recording.
+// The journal contains the stream parameters and every packet exactly as it was sent to the muxer, so the file can be rebuilt
+// later without re-encoding. It is flushed at keyframes, so a crash of the program loses at most the last few seconds.
+// The journal is deleted by the muxer when the output file was finished successfully.
+//
+// The file is a sequence of records: type (u32), payload size (u32), payload, CRC-32 of the payload (u32), all little-endian.
+// The first record is a header, followed by one record per stream and then the packets. Reading stops at the first incomplete
+// or damaged record, which is normally the one that was being written when the program crashed.
+class PacketJournal {
+
+private:
+	static const uint32_t RECORD_HEADER, RECORD_STREAM, RECORD_PACKET;
+	static const uint32_t VERSION;
+	static const uint32_t MAX_RECORD_SIZE;
+	static const int64_t MIN_FLUSH_INTERVAL;
+
+private:
+	QString m_file_name;
+	AVIOContext *m_io;
+	const AVCRC *m_crc_table;
+
+	std::vector<uint8_t> m_record;
+	std::vector<bool> m_stream_is_video;
+	int64_t m_last_flush_time;
+
+	uint64_t m_stats_packets, m_stats_bytes, m_stats_flushes;
+	int64_t m_stats_write_time;
+
+public:
+	// Creates the journal for a muxer that has just written its header. 'codec_contexts' contains the codec context of every
+	// stream of the format context.
+	PacketJournal(const QString& file_name, const QString& container_name, const QString& output_file, AVFormatContext* format_context,
+				  const std::vector<AVCodecContext*>& codec_contexts);
+	~PacketJournal();
+
+	// Adds a packet to the journal. The timestamps should be in the time base of the stream, i.e. the packet should be ready to be
+	// written to the muxer. Called by the muxer thread.
+	void AddPacket(const AVPacket* packet);
+
+	// Returns the name of the journal file for a given output file.
+	static QString GetFileName(const QString& output_file);
+
+	// Rebuilds the output file from a journal. If 'output_file' is empty, the recovered file is written next to the original one.
+	// Returns whether a file was written.
+	static bool Recover(const QString& journal_file, const QString& output_file);
+
+private:
+	void Init(const QString& container_name, const QString& output_file, AVFormatContext* format_context, const std::vector<AVCodecContext*>& codec_contexts);
+	void Free();
+
+	// Writes a record. The payload is the concatenation of 'fields' and 'data', so packet data doesn't have to be copied first.
+	void WriteRecord(uint32_t type, const std::vector<uint8_t>& fields, const uint8_t* data = NULL, size_t size = 0);
+
+	// Reads the next record. Returns false at the end of the journal, or if the record is incomplete or damaged.
+	static bool ReadRecord(AVIOContext* io, const AVCRC* crc_table, uint32_t* type, std::vector<uint8_t>* payload);
+
+};
@@ -0,0 +1,81 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "PacketPool.h"
+
+// The maximum number of packets that are kept in the pool. The muxer returns packets at the same rate as the encoders
+// request them, so the pool only needs to absorb short bursts (e.g. when the encoder is flushed).
+const size_t PacketPool::MAX_FREE_PACKETS = 64;
+
+PacketPool::PacketPool() {
+	SharedLock lock(&m_shared_data);
+	lock->m_free_packets.reserve(MAX_FREE_PACKETS);
+	lock->m_stats.m_allocated = 0;
+	lock->m_stats.m_reused = 0;
+	lock->m_stats.m_recycled = 0;
+	lock->m_stats.m_discarded = 0;
+	lock->m_stats.m_free = 0;
+}
+
+PacketPool::~PacketPool() {
+	// nothing to do, the remaining packets are freed by their destructors
+}
+
+std::unique_ptr<AVPacketWrapper> PacketPool::GetPacket() {
+	{
+		SharedLock lock(&m_shared_data);
+		if(!lock->m_free_packets.empty()) {
+			std::unique_ptr<AVPacketWrapper> packet = std::move(lock->m_free_packets.back());
+			lock->m_free_packets.pop_back();
+			++lock->m_stats.m_reused;
+			return packet;
+		}
+		++lock->m_stats.m_allocated;
+	}
+	// allocate outside the lock
+	return std::unique_ptr<AVPacketWrapper>(new AVPacketWrapper());
+}
+
+void PacketPool::ReturnPacket(std::unique_ptr<AVPacketWrapper> packet) {
+	if(packet == NULL)
+		return;
+	// note: if the packet isn't recycled, it is deleted when the function returns (after the lock has been released)
+#if SSR_USE_AV_PACKET_ALLOC
+	// drop our references to the data and side data, and reset all fields to their defaults
+	av_packet_unref(packet->GetPacket());
+	SharedLock lock(&m_shared_data);
+	if(lock->m_free_packets.size() < MAX_FREE_PACKETS) {
+		lock->m_free_packets.push_back(std::move(packet));
+		++lock->m_stats.m_recycled;
+	} else {
+		++lock->m_stats.m_discarded;
+	}
+#else
+	// the old API doesn't do reference counting, so we can't tell whether the data is still in use
+	SharedLock lock(&m_shared_data);
+	++lock->m_stats.m_discarded;
+#endif
+}
+
+PacketPool::Stats PacketPool::GetStats() {
+	SharedLock lock(&m_shared_data);
+	Stats stats = lock->m_stats;
+	stats.m_free = lock->m_free_packets.size();
+	return stats;
+}
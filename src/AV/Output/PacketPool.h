@@ -0,0 +1,73 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "AVWrapper.h"
+#include "MutexDataPair.h"
+
+// A pool of AVPacketWrapper objects that is shared by the encoders and the muxer of one output file.
+// The encoders take packets from the pool, the muxer gives them back after they have been written. This avoids allocating
+// and freeing a packet for every call to avcodec_receive_packet (including the ones that return EAGAIN).
+// Only the AVPacket structs are recycled: the data buffers are reference-counted by libav/ffmpeg and may still be in use
+// by the muxer (e.g. for interleaving), so they are released normally. Recycling is only done with the av_packet_alloc API,
+// with the older API packets are simply deleted.
+class PacketPool {
+
+public:
+	struct Stats {
+		uint64_t m_allocated; // packets that had to be allocated because the pool was empty
+		uint64_t m_reused; // packets that were taken from the pool
+		uint64_t m_recycled; // packets that were returned to the pool
+		uint64_t m_discarded; // packets that were deleted because the pool was full
+		unsigned int m_free; // packets currently in the pool
+	};
+
+private:
+	struct SharedData {
+		std::vector<std::unique_ptr<AVPacketWrapper> > m_free_packets;
+		Stats m_stats;
+	};
+	typedef MutexDataPair<SharedData>::Lock SharedLock;
+
+private:
+	static const size_t MAX_FREE_PACKETS;
+
+private:
+	MutexDataPair<SharedData> m_shared_data;
+
+public:
+	PacketPool();
+	~PacketPool();
+
+	// Returns an empty packet, either from the pool or newly allocated.
+	// This function is thread-safe.
+	std::unique_ptr<AVPacketWrapper> GetPacket();
+
+	// Returns a packet to the pool. The packet data is unreferenced, so the packet can be returned as soon as it is no longer
+	// needed, even if libav/ffmpeg still holds references to the data.
+	// This function is thread-safe.
+	void ReturnPacket(std::unique_ptr<AVPacketWrapper> packet);
+
+	// Returns the pool statistics.
+	// This function is thread-safe.
+	Stats GetStats();
+
+};
@@ -27,6 +27,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "AudioEncoder.h"
 #include "SampleCast.h"
 #include "SyncDiagram.h"
+#include "StatsSegment.h"
 #include <libavutil/channel_layout.h>
 
 // The amount of filtering applied to audio timestamps to reduce noise. Higher values reduce timestamp noise (and associated drift correction),
@@ -62,93 +63,24 @@ const size_t Synchronizer::MAX_AUDIO_SAMPLES_BUFFERED = 1000000;
 // This is needed because some video codecs/players can't handle long delays.
 const int64_t Synchronizer::MAX_FRAME_DELAY = 200000;
 
-static std::unique_ptr<AVFrameWrapper> CreateVideoFrame(unsigned int width, unsigned int height, AVPixelFormat pixel_format, const std::shared_ptr<AVFrameData>& reuse_data) {
-
-	// get required planes
-	unsigned int planes = 0;
-	size_t linesize[3] = {0}, planesize[3] = {0};
-	switch(pixel_format) {
-		case AV_PIX_FMT_YUV444P: {
-			// Y/U/V = 1 byte per pixel
-			planes = 3;
-			linesize[0]  = grow_align16(width); planesize[0] = linesize[0] * height;
-			linesize[1]  = grow_align16(width); planesize[1] = linesize[1] * height;
-			linesize[2]  = grow_align16(width); planesize[2] = linesize[2] * height;
-			break;
-		}
-		case AV_PIX_FMT_YUV422P: {
-			// Y = 1 byte per pixel, U/V = 1 byte per 2x1 pixels
-			assert(width % 2 == 0);
-			planes = 3;
-			linesize[0]  = grow_align16(width    ); planesize[0] = linesize[0] * height;
-			linesize[1]  = grow_align16(width / 2); planesize[1] = linesize[1] * height;
-			linesize[2]  = grow_align16(width / 2); planesize[2] = linesize[2] * height;
-			break;
-		}
-		case AV_PIX_FMT_YUV420P: {
-			// Y = 1 byte per pixel, U/V = 1 byte per 2x2 pixels
-			assert(width % 2 == 0);
-			assert(height % 2 == 0);
-			planes = 3;
-			linesize[0]  = grow_align16(width    ); planesize[0] = linesize[0] * height    ;
-			linesize[1]  = grow_align16(width / 2); planesize[1] = linesize[1] * height / 2;
-			linesize[2]  = grow_align16(width / 2); planesize[2] = linesize[2] * height / 2;
-			break;
-		}
-		case AV_PIX_FMT_NV12: {
-			assert(width % 2 == 0);
-			assert(height % 2 == 0);
-			// planar YUV 4:2:0, 12bpp, 1 plane for Y and 1 plane for the UV components, which are interleaved
-			// Y = 1 byte per pixel, U/V = 1 byte per 2x2 pixels
-			planes = 2;
-			linesize[0]  = grow_align16(width); planesize[0] = linesize[0] * height    ;
-			linesize[1]  = grow_align16(width); planesize[1] = linesize[1] * height / 2;
-			break;
-		}
-		case AV_PIX_FMT_BGRA: {
-			// BGRA = 4 bytes per pixel
-			planes = 1;
-			linesize[0] = grow_align16(width * 4); planesize[0] = linesize[0] * height;
-			break;
-		}
-		case AV_PIX_FMT_BGR24:
-		case AV_PIX_FMT_RGB24: {
-			// BGR/RGB = 3 bytes per pixel
-			planes = 1;
-			linesize[0] = grow_align16(width * 3); planesize[0] = linesize[0] * height;
-			break;
-		}
-		default: assert(false); break;
-	}
+// Frames that differ less than this from the previous frame are considered near-duplicates (mean absolute difference of the
+// frame signatures, 0 to 255). When the encoder can't keep up, these are dropped first.
+static const double NEAR_DUPLICATE_DIFFERENCE = 1.0;
 
-	// create the frame
-	size_t totalsize = 0;
-	for(unsigned int p = 0; p < planes; ++p) {
-		totalsize += planesize[p];
-	}
-	std::shared_ptr<AVFrameData> frame_data = (reuse_data == NULL)? std::make_shared<AVFrameData>(totalsize) : reuse_data;
-	std::unique_ptr<AVFrameWrapper> frame(new AVFrameWrapper(frame_data));
-	uint8_t *data = frame->GetRawData();
-	for(unsigned int p = 0; p < planes; ++p) {
-		frame->GetFrame()->data[p] = data;
-		frame->GetFrame()->linesize[p] = linesize[p];
-		data += planesize[p];
-	}
-#if SSR_USE_AVFRAME_WIDTH_HEIGHT
-	frame->GetFrame()->width = width;
-	frame->GetFrame()->height = height;
-#endif
-#if SSR_USE_AVFRAME_FORMAT
-	frame->GetFrame()->format = pixel_format;
-#endif
-#if SSR_USE_AVFRAME_SAR
-	frame->GetFrame()->sample_aspect_ratio.num = 1;
-	frame->GetFrame()->sample_aspect_ratio.den = 1;
-#endif
+// The time between two flushes of the buffers, in microseconds.
+static const int64_t SYNCHRONIZER_FLUSH_INTERVAL = 20000;
 
-	return frame;
+// The size of the region around the cursor that gets a higher quality, in pixels of the input frame (in every direction).
+static const int FOCUS_CURSOR_RADIUS = 128;
 
-}
+// The active window only gets a higher quality if it covers less than this fraction of the frame, otherwise it's not much of a region.
+static const double FOCUS_WINDOW_MAX_FRACTION = 0.75;
+
+// Quantizer offsets for the cursor and the active window (range -1 to 1, negative values result in higher quality).
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+static const AVRational FOCUS_QOFFSET_CURSOR = {-1, 5};
+static const AVRational FOCUS_QOFFSET_WINDOW = {-1, 10};
+#endif
 
 static std::unique_ptr<AVFrameWrapper> CreateAudioFrame(unsigned int channels, unsigned int sample_rate, unsigned int samples, unsigned int planes, AVSampleFormat sample_format) {
 
@@ -198,11 +130,32 @@ static std::unique_ptr<AVFrameWrapper> CreateAudioFrame(unsigned int channels, u
 
 }
 
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+// Clips a rectangle to the input frame and scales it to the area of the output frame that is covered by the input (rounded outwards).
+// Returns false if nothing is left.
+static bool ScaleFocusRectangle(int x1, int y1, int x2, int y2, unsigned int in_width, unsigned int in_height,
+								unsigned int out_x, unsigned int out_y, unsigned int out_width, unsigned int out_height,
+								int* out_x1, int* out_y1, int* out_x2, int* out_y2) {
+	x1 = clamp(x1, 0, (int) in_width);
+	y1 = clamp(y1, 0, (int) in_height);
+	x2 = clamp(x2, 0, (int) in_width);
+	y2 = clamp(y2, 0, (int) in_height);
+	if(x2 <= x1 || y2 <= y1)
+		return false;
+	*out_x1 = (int) (out_x + (uint64_t) x1 * out_width / in_width);
+	*out_y1 = (int) (out_y + (uint64_t) y1 * out_height / in_height);
+	*out_x2 = (int) (out_x + ((uint64_t) x2 * out_width + in_width - 1) / in_width);
+	*out_y2 = (int) (out_y + ((uint64_t) y2 * out_height + in_height - 1) / in_height);
+	return true;
+}
+#endif
+
 Synchronizer::Synchronizer(OutputManager *output_manager) {
 
 	m_output_manager = output_manager;
 	m_output_settings = m_output_manager->GetOutputSettings();
 	m_output_format = m_output_manager->GetOutputFormat();
+	m_stats = m_output_manager->GetStatsBlock();
 	assert(m_output_format->m_video_enabled || m_output_format->m_audio_enabled);
 
 	try {
@@ -220,17 +173,44 @@ Synchronizer::~Synchronizer() {
 	ConnectVideoSource(NULL);
 	ConnectAudioSource(NULL);
 
-	// tell the thread to stop
-	if(m_thread.joinable()) {
-		Logger::LogInfo("[Synchronizer::~Synchronizer] " + Logger::tr("Stopping synchronizer thread ..."));
-		m_should_stop = true;
-		m_thread.join();
-	}
+	// deliver the frames that are still being converted
+	m_conversion_pipeline.reset();
+
+	// tell the task to stop
+	Logger::LogInfo("[Synchronizer::~Synchronizer] " + Logger::tr("Stopping synchronizer task ..."));
+	m_should_stop = true;
+	m_tasks.Wait();
 
 	// flush one more time
 	{
 		SharedLock lock(&m_shared_data);
 		FlushBuffers(lock.get());
+		lock->m_activity_index.reset(); // writes the last second
+	}
+
+	// report how many frames could be skipped thanks to the content hints
+	if(m_output_format->m_video_enabled && m_output_settings->video_content_hints) {
+		VideoLock videolock(&m_video_data);
+		if(videolock->m_stats_hint_frames != 0) {
+			Logger::LogInfo("[Synchronizer::~Synchronizer] " + Logger::tr("Content hints: %1 of %2 frames were static (conversion skipped), %3 scene cuts.")
+							.arg(videolock->m_stats_hint_static_frames).arg(videolock->m_stats_hint_frames).arg(videolock->m_stats_hint_scene_cuts));
+		}
+	}
+	if(m_output_format->m_video_enabled && (m_output_settings->video_roi_cursor || m_output_settings->video_roi_window)) {
+		VideoLock videolock(&m_video_data);
+		if(videolock->m_stats_focus_frames != 0) {
+			Logger::LogInfo("[Synchronizer::~Synchronizer] " + Logger::tr("Regions of interest: cursor in %1 of %2 frames, active window in %3 of %2 frames.")
+							.arg(videolock->m_stats_focus_cursor_frames).arg(videolock->m_stats_focus_frames).arg(videolock->m_stats_focus_window_frames));
+		}
+	}
+
+	if(m_output_format->m_video_enabled) {
+		SharedLock lock(&m_shared_data);
+		if(lock->m_stats_drop_frames != 0) {
+			Logger::LogInfo("[Synchronizer::~Synchronizer] " + Logger::tr("Overload: dropped %1 frames, %2 of them near-duplicates, average difference %3.")
+							.arg(lock->m_stats_drop_frames).arg(lock->m_stats_drop_near_duplicates)
+							.arg(lock->m_stats_drop_difference / (double) lock->m_stats_drop_frames, 0, 'f', 2));
+		}
 	}
 
 	// free everything
@@ -246,6 +226,19 @@ void Synchronizer::Init() {
 		VideoLock videolock(&m_video_data);
 		videolock->m_last_timestamp = std::numeric_limits<int64_t>::min();
 		videolock->m_next_timestamp = SINK_TIMESTAMP_ASAP;
+		videolock->m_stats_previous_time = hrt_time_micro();
+		videolock->m_stats_frames = 0;
+		videolock->m_stats_hint_frames = 0;
+		videolock->m_stats_hint_static_frames = 0;
+		videolock->m_stats_hint_scene_cuts = 0;
+		videolock->m_focus_valid = false;
+		videolock->m_has_converted_reference = false;
+		videolock->m_letterbox = m_output_settings->video_letterbox;
+		videolock->m_last_width = 0;
+		videolock->m_last_height = 0;
+		videolock->m_stats_focus_frames = 0;
+		videolock->m_stats_focus_cursor_frames = 0;
+		videolock->m_stats_focus_window_frames = 0;
 	}
 
 	// initialize audio
@@ -280,14 +273,43 @@ void Synchronizer::Init() {
 
 		InitSegment(lock.get());
 
+		if(m_output_format->m_video_enabled && m_output_settings->video_activity_index) {
+			lock->m_activity_index.reset(new ActivityIndex(ActivityIndex::GetFileName(m_output_settings->file), m_output_format->m_video_width, m_output_format->m_video_height,
+														   m_output_format->m_video_frame_rate, m_output_format->m_video_pixel_format));
+		}
+
 		lock->m_warn_drop_video = true;
 
+		lock->m_stats_drop_frames = 0;
+		lock->m_stats_drop_near_duplicates = 0;
+		lock->m_stats_drop_difference = 0.0;
+
+	}
+
+	// create conversion pipeline for large frames
+	if(m_output_format->m_video_enabled) {
+		unsigned int threads = (m_output_settings->video_conversion_threads < 0)?
+			ConversionPipeline::GetRecommendedThreads(m_output_format->m_video_width, m_output_format->m_video_height) : m_output_settings->video_conversion_threads;
+		if(threads != 0) {
+			Logger::LogInfo("[Synchronizer::Init] " + Logger::tr("Using %1 threads for video conversion.").arg(threads));
+			m_conversion_pipeline.reset(new ConversionPipeline(threads, threads + 1, m_output_format->m_video_width, m_output_format->m_video_height,
+															   m_output_format->m_video_pixel_format, m_output_format->m_video_colorspace, [this](ConversionPipeline::Job* job) {
+				SharedLock lock(&m_shared_data);
+				if(job->m_ping)
+					StoreVideoPing(lock.get(), job->m_timestamp);
+				else
+					StoreVideoFrame(lock.get(), job->m_timestamp, job->m_hints, std::move(job->m_frame), job->m_reuse);
+			}));
+		}
 	}
 
-	// start synchronizer thread
+	// start synchronizer task
 	m_should_stop = false;
 	m_error_occurred = false;
-	m_thread = std::thread(&Synchronizer::SynchronizerThread, this);
+	m_paused = false;
+	m_letterbox = m_output_settings->video_letterbox;
+	Logger::LogInfo("[Synchronizer::Init] " + Logger::tr("Synchronizer task started."));
+	m_tasks.Submit(TaskScheduler::PRIORITY_NORMAL, [this]() { SynchronizerTask(); });
 
 }
 
@@ -297,6 +319,10 @@ void Synchronizer::Free() {
 
 void Synchronizer::NewSegment() {
 
+	// frames that are still being converted belong to the previous segment
+	if(m_conversion_pipeline != NULL)
+		m_conversion_pipeline->Flush();
+
 	if(m_output_format->m_audio_enabled) {
 		AudioLock audiolock(&m_audio_data);
 		InitAudioSegment(audiolock.get());
@@ -307,6 +333,40 @@ void Synchronizer::NewSegment() {
 
 }
 
+void Synchronizer::SetPaused(bool paused) {
+
+	if(paused) {
+		if(!m_paused) {
+			m_paused = true;
+			Logger::LogInfo("[Synchronizer::SetPaused] " + Logger::tr("Paused."));
+		}
+		return;
+	}
+	if(!m_paused)
+		return;
+
+	// End the previous segment now rather than when pausing, so frames that were already on their way still make it into that segment.
+	int64_t resume_time = hrt_time_micro();
+	if(m_conversion_pipeline != NULL)
+		m_conversion_pipeline->Flush();
+	if(m_output_format->m_audio_enabled) {
+		AudioLock audiolock(&m_audio_data);
+		InitAudioSegment(audiolock.get());
+	}
+	{
+		SharedLock lock(&m_shared_data);
+		NewSegment(lock.get());
+
+		// measure how long it takes until the first new frame comes out of the encoder
+		if(m_output_format->m_video_enabled)
+			m_output_manager->MarkVideoResume(resume_time);
+	}
+
+	m_paused = false;
+	Logger::LogInfo("[Synchronizer::SetPaused] " + Logger::tr("Resumed."));
+
+}
+
 int64_t Synchronizer::GetTotalTime() {
 	SharedLock lock(&m_shared_data);
 	return GetTotalTime(lock.get());
@@ -314,6 +374,8 @@ int64_t Synchronizer::GetTotalTime() {
 
 int64_t Synchronizer::GetNextVideoTimestamp() {
 	assert(m_output_format->m_video_enabled);
+	if(m_paused)
+		return SINK_TIMESTAMP_NONE;
 	VideoLock videolock(&m_video_data);
 	return videolock->m_next_timestamp;
 }
@@ -321,6 +383,10 @@ int64_t Synchronizer::GetNextVideoTimestamp() {
 void Synchronizer::ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) {
 	assert(m_output_format->m_video_enabled);
 
+	// ignore frames while paused
+	if(m_paused)
+		return;
+
 	// add new block to sync diagram
 	if(m_sync_diagram != NULL)
 		m_sync_diagram->AddBlock(0, (double) timestamp * 1.0e-6, (double) timestamp * 1.0e-6 + 1.0 / (double) m_output_format->m_video_frame_rate, QColor(255, 0, 0));
@@ -334,37 +400,191 @@ void Synchronizer::ReadVideoFrame(unsigned int width, unsigned int height, const
 		timestamp = videolock->m_last_timestamp;
 	}
 
+	// update the shared stats
+	if(m_stats != NULL) {
+		StatsUpdate update(m_stats);
+		int64_t time = hrt_time_micro();
+		++videolock->m_stats_frames;
+		m_stats->video_frames_in.Add(1);
+		m_stats->video_input_latency.Set(time - timestamp);
+		if(time - videolock->m_stats_previous_time > 1000000) {
+			m_stats->video_fps_in.Set((double) videolock->m_stats_frames / ((double) (time - videolock->m_stats_previous_time) * 1.0e-6));
+			videolock->m_stats_previous_time = time;
+			videolock->m_stats_frames = 0;
+		}
+	}
+
 	// drop the frame if it is too early (before converting it)
-	if(videolock->m_next_timestamp != SINK_TIMESTAMP_ASAP && timestamp < videolock->m_next_timestamp - (int64_t) (1000000 / m_output_format->m_video_frame_rate))
+	if(videolock->m_next_timestamp != SINK_TIMESTAMP_ASAP && timestamp < videolock->m_next_timestamp - (int64_t) (1000000 / m_output_format->m_video_frame_rate)) {
+		if(m_stats != NULL) {
+			StatsUpdate update(m_stats);
+			m_stats->video_frames_dropped.Add(1);
+		}
 		return;
+	}
 
 	// update the timestamps
 	videolock->m_last_timestamp = timestamp;
 	videolock->m_next_timestamp = std::max(videolock->m_next_timestamp + (int64_t) (1000000 / m_output_format->m_video_frame_rate), timestamp);
 
-	// create the converted frame
-	std::unique_ptr<AVFrameWrapper> converted_frame = CreateVideoFrame(m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, NULL);
+	// The input size and the scaling mode can change while recording (e.g. when the recording area is moved), but the output size
+	// is fixed, so the new frames are simply scaled differently. A converted frame can't be reused across such a change.
+	bool letterbox = m_letterbox;
+	if(width != videolock->m_last_width || height != videolock->m_last_height || letterbox != videolock->m_letterbox) {
+		if(videolock->m_last_width != 0) {
+			Logger::LogInfo("[Synchronizer::ReadVideoFrame] " + Logger::tr("Video input changed to %1x%2 (%3), scaling to %4x%5.")
+							.arg(width).arg(height).arg((letterbox)? "letterbox" : "stretch").arg(m_output_format->m_video_width).arg(m_output_format->m_video_height));
+		}
+		videolock->m_last_width = width;
+		videolock->m_last_height = height;
+		videolock->m_letterbox = letterbox;
+		videolock->m_has_converted_reference = false;
+	}
+
+	// the area of the output frame that is covered by the input
+	unsigned int box_x = 0, box_y = 0, box_width = m_output_format->m_video_width, box_height = m_output_format->m_video_height;
+	if(letterbox)
+		FastScaler::GetLetterboxRectangle(width, height, m_output_format->m_video_width, m_output_format->m_video_height, &box_x, &box_y, &box_width, &box_height);
+
+	// find out what changed since the previous frame (before converting it, since static frames don't have to be converted at all)
+	AVFrameHints hints = AVFrameHints();
+	if(m_output_settings->video_content_hints && format == AV_PIX_FMT_BGRA) {
+		FrameChangeInfo info = videolock->m_change_detector.Analyze(width, height, data[0], stride[0]);
+		hints = FrameChangeHints(info, width, height, box_width, box_height);
+		hints.m_changed_x1 += box_x;
+		hints.m_changed_y1 += box_y;
+		hints.m_changed_x2 += box_x;
+		hints.m_changed_y2 += box_y;
+		++videolock->m_stats_hint_frames;
+		if(hints.m_static)
+			++videolock->m_stats_hint_static_frames;
+		if(hints.m_scene_cut)
+			++videolock->m_stats_hint_scene_cuts;
+	}
+
+	// create the converted frame (static frames reuse the previous converted frame, so they don't need a new one)
+	bool reuse = (hints.m_static && videolock->m_has_converted_reference);
+	std::unique_ptr<AVFrameWrapper> converted_frame;
+	if(!reuse) {
+		converted_frame = CreateVideoFrame(m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, NULL);
+		converted_frame->GetHints() = hints;
+		videolock->m_has_converted_reference = hints.m_valid;
+	}
+
+	// give the area around the cursor and the active window a higher quality (static frames don't need this)
+	if(videolock->m_focus_valid && !hints.m_static) {
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+		const VideoFocus &focus = videolock->m_focus;
+		std::vector<AVRegionOfInterest> regions;
+		int x1, y1, x2, y2;
+		if(m_output_settings->video_roi_cursor && focus.m_has_cursor) {
+			if(ScaleFocusRectangle(focus.m_cursor_x - FOCUS_CURSOR_RADIUS, focus.m_cursor_y - FOCUS_CURSOR_RADIUS,
+								   focus.m_cursor_x + FOCUS_CURSOR_RADIUS, focus.m_cursor_y + FOCUS_CURSOR_RADIUS,
+								   width, height, box_x, box_y, box_width, box_height, &x1, &y1, &x2, &y2)) {
+				regions.push_back(MakeRegionOfInterest(x1, y1, x2, y2, FOCUS_QOFFSET_CURSOR));
+				++videolock->m_stats_focus_cursor_frames;
+			}
+		}
+		if(m_output_settings->video_roi_window && focus.m_has_window) {
+			if(ScaleFocusRectangle(focus.m_window_x1, focus.m_window_y1, focus.m_window_x2, focus.m_window_y2,
+								   width, height, box_x, box_y, box_width, box_height, &x1, &y1, &x2, &y2) &&
+					(double) (x2 - x1) * (double) (y2 - y1) < FOCUS_WINDOW_MAX_FRACTION * (double) m_output_format->m_video_width * (double) m_output_format->m_video_height) {
+				regions.push_back(MakeRegionOfInterest(x1, y1, x2, y2, FOCUS_QOFFSET_WINDOW));
+				++videolock->m_stats_focus_window_frames;
+			}
+		}
+		if(converted_frame != NULL)
+			AddFrameRegionsOfInterest(converted_frame->GetFrame(), regions);
+#endif
+		++videolock->m_stats_focus_frames;
+	}
+	videolock->m_focus_valid = false;
+
+	// let the conversion pipeline do the expensive part, the input thread only has to copy the frame
+	// The video lock is released first, since AddFrame can block until the pipeline has room. Everything it needs is in local
+	// variables, and frames are still added in order because only the input thread calls this function.
+	if(m_conversion_pipeline != NULL) {
+		videolock.lock().unlock();
+		m_conversion_pipeline->AddFrame(width, height, data, stride, format, colorspace, timestamp, hints, std::move(converted_frame), reuse, letterbox);
+		return;
+	}
 
 	// scale and convert the frame to the right format
-	videolock->m_fast_scaler.Scale(width, height, format, colorspace, data, stride,
-			m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, m_output_format->m_video_colorspace,
-			converted_frame->GetFrame()->data, converted_frame->GetFrame()->linesize);
+	if(!reuse) {
+		if(letterbox) {
+			videolock->m_fast_scaler.ScaleLetterbox(width, height, format, colorspace, data, stride,
+					m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, m_output_format->m_video_colorspace,
+					converted_frame->GetFrame()->data, converted_frame->GetFrame()->linesize);
+		} else {
+			videolock->m_fast_scaler.Scale(width, height, format, colorspace, data, stride,
+					m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, m_output_format->m_video_colorspace,
+					converted_frame->GetFrame()->data, converted_frame->GetFrame()->linesize);
+		}
+	}
 
 	SharedLock lock(&m_shared_data);
+	StoreVideoFrame(lock.get(), timestamp, hints, std::move(converted_frame), reuse);
+
+}
+
+// Adds a converted frame to the video buffer. This is called in the same order as ReadVideoFrame, but possibly by a different thread.
+void Synchronizer::StoreVideoFrame(SharedData* lock, int64_t timestamp, const AVFrameHints& hints, std::unique_ptr<AVFrameWrapper> converted_frame, bool reuse) {
+
+	// reuse the previous converted frame, or remember this one so it can be reused
+	if(reuse) {
+		if(lock->m_last_converted_data != NULL) {
+			converted_frame = CreateVideoFrame(m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, lock->m_last_converted_data);
+			converted_frame->GetHints() = hints;
+		}
+	} else if(converted_frame != NULL && hints.m_valid) {
+		lock->m_last_converted_data = converted_frame->GetFrameData();
+	} else {
+		lock->m_last_converted_data.reset();
+	}
+
+	// the conversion may have failed
+	if(converted_frame == NULL) {
+		if(m_stats != NULL) {
+			StatsUpdate update(m_stats);
+			m_stats->video_frames_dropped.Add(1);
+		}
+		return;
+	}
+
+	FrameSignature signature = ComputeFrameSignature(converted_frame->GetFrame());
 
 	// avoid memory problems by limiting the video buffer size
 	if(lock->m_video_buffer.size() >= MAX_VIDEO_FRAMES_BUFFERED) {
 		if(lock->m_segment_audio_started) {
 			if(lock->m_warn_drop_video) {
 				lock->m_warn_drop_video = false;
-				Logger::LogWarning("[Synchronizer::ReadVideoFrame] " + Logger::tr("Warning: Video buffer overflow, some frames will be lost. The audio input seems to be too slow."));
+				Logger::LogWarning("[Synchronizer::StoreVideoFrame] " + Logger::tr("Warning: Video buffer overflow, some frames will be lost. The audio input seems to be too slow."));
 			}
-			return;
+			// drop the frame that is most similar to the frame before it, so motion is preserved as much as possible
+			// (the new frame wins ties, since that's what happened before)
+			size_t drop = lock->m_video_buffer.size();
+			double drop_difference = FrameSignatureDifference(lock->m_video_buffer.back().m_signature, signature);
+			for(size_t i = 0; i < lock->m_video_buffer.size(); ++i) {
+				const FrameSignature &previous = (i == 0)? lock->m_last_video_signature : lock->m_video_buffer[i - 1].m_signature;
+				double difference = FrameSignatureDifference(previous, lock->m_video_buffer[i].m_signature);
+				if(difference < drop_difference) {
+					drop = i;
+					drop_difference = difference;
+				}
+			}
+			CountSimilarDrop(lock, drop_difference);
+			if(drop == lock->m_video_buffer.size())
+				return;
+			lock->m_video_buffer.erase(lock->m_video_buffer.begin() + drop);
 		} else {
 			// if the audio hasn't started yet, it makes more sense to drop the oldest frames
 			lock->m_video_buffer.pop_front();
 			assert(lock->m_video_buffer.size() > 0);
-			lock->m_segment_video_start_time = lock->m_video_buffer.front()->GetFrame()->pts;
+			lock->m_segment_video_start_time = lock->m_video_buffer.front().m_frame->GetFrame()->pts;
+			if(m_stats != NULL) {
+				StatsUpdate update(m_stats);
+				m_stats->video_frames_dropped.Add(1);
+			}
 		}
 	}
 
@@ -377,17 +597,52 @@ void Synchronizer::ReadVideoFrame(unsigned int width, unsigned int height, const
 
 	// store the frame
 	converted_frame->GetFrame()->pts = timestamp;
-	lock->m_video_buffer.push_back(std::move(converted_frame));
+	BufferedVideoFrame buffered;
+	buffered.m_frame = std::move(converted_frame);
+	buffered.m_signature = signature;
+	lock->m_video_buffer.push_back(std::move(buffered));
 
 	// increase the segment stop time
 	lock->m_segment_video_stop_time = timestamp + (int64_t) (1000000 / m_output_format->m_video_frame_rate);
 
+	if(m_stats != NULL) {
+		StatsUpdate update(m_stats);
+		m_stats->video_sync_queue.Set(lock->m_video_buffer.size());
+	}
+
+}
+
+void Synchronizer::CountSimilarDrop(SharedData* lock, double difference) {
+	++lock->m_stats_drop_frames;
+	if(difference < NEAR_DUPLICATE_DIFFERENCE)
+		++lock->m_stats_drop_near_duplicates;
+	lock->m_stats_drop_difference += difference;
+	if(m_stats != NULL) {
+		StatsUpdate update(m_stats);
+		m_stats->video_frames_dropped.Add(1);
+		m_stats->video_frames_dropped_similar.Set(lock->m_stats_drop_near_duplicates);
+		m_stats->video_dropped_difference.Set(lock->m_stats_drop_difference / (double) lock->m_stats_drop_frames);
+	}
 }
 
 void Synchronizer::ReadVideoPing(int64_t timestamp) {
 	assert(m_output_format->m_video_enabled);
 
+	if(m_paused)
+		return;
+
+	// pings must not overtake frames that are still being converted
+	if(m_conversion_pipeline != NULL) {
+		m_conversion_pipeline->AddPing(timestamp);
+		return;
+	}
+
 	SharedLock lock(&m_shared_data);
+	StoreVideoPing(lock.get(), timestamp);
+
+}
+
+void Synchronizer::StoreVideoPing(SharedData* lock, int64_t timestamp) {
 
 	// if the video has not been started, ignore it
 	if(!lock->m_segment_video_started)
@@ -398,17 +653,33 @@ void Synchronizer::ReadVideoPing(int64_t timestamp) {
 
 }
 
+unsigned int Synchronizer::GetVideoFocusFlags() {
+	return ((m_output_settings->video_roi_cursor)? VIDEO_FOCUS_CURSOR : 0) | ((m_output_settings->video_roi_window)? VIDEO_FOCUS_WINDOW : 0);
+}
+
+void Synchronizer::ReadVideoFocus(const VideoFocus& focus) {
+	assert(m_output_format->m_video_enabled);
+	VideoLock videolock(&m_video_data);
+	videolock->m_focus_valid = true;
+	videolock->m_focus = focus;
+}
+
 void Synchronizer::ReadAudioSamples(unsigned int channels, unsigned int sample_rate, AVSampleFormat format, unsigned int sample_count, const uint8_t* data, int64_t timestamp) {
 	assert(m_output_format->m_audio_enabled);
 
-	// sanity check
-	if(sample_count == 0)
+	// sanity check, and ignore samples while paused
+	if(sample_count == 0 || m_paused)
 		return;
 
 	// add new block to sync diagram
 	if(m_sync_diagram != NULL)
 		m_sync_diagram->AddBlock(1, (double) timestamp * 1.0e-6, (double) timestamp * 1.0e-6 + (double) sample_count / (double) sample_rate, QColor(0, 255, 0));
 
+	if(m_stats != NULL) {
+		StatsUpdate update(m_stats);
+		m_stats->audio_samples_in.Add(sample_count);
+	}
+
 	AudioLock audiolock(&m_audio_data);
 
 	// check the timestamp
@@ -461,6 +732,10 @@ void Synchronizer::ReadAudioSamples(unsigned int channels, unsigned int sample_r
 		// drop samples
 		int n = (int) round(current_drift * (double) sample_rate);
 		if(n > 0) {
+			if(m_stats != NULL) {
+				StatsUpdate update(m_stats);
+				m_stats->audio_samples_dropped.Add(std::min(n, (int) sample_count));
+			}
 			if(n >= (int) sample_count) {
 				audiolock->m_drop_samples = true;
 				return; // drop all samples
@@ -488,6 +763,11 @@ void Synchronizer::ReadAudioSamples(unsigned int channels, unsigned int sample_r
 		int n = (int) round(-current_drift * (double) sample_rate);
 		if(n > 0) {
 
+			if(m_stats != NULL) {
+				StatsUpdate update(m_stats);
+				m_stats->audio_samples_inserted.Add(n);
+			}
+
 			// insert zeros
 			audiolock->m_temp_input_buffer.Alloc(n * m_output_format->m_audio_channels);
 			std::fill_n(audiolock->m_temp_input_buffer.GetData(), n * m_output_format->m_audio_channels, 0.0f);
@@ -583,11 +863,20 @@ void Synchronizer::ReadAudioSamples(unsigned int channels, unsigned int sample_r
 	double new_sample_length = (double) (lock->m_segment_audio_samples_read + lock->m_audio_buffer.GetSize() / m_output_format->m_audio_channels) / (double) m_output_format->m_audio_sample_rate;
 	lock->m_segment_audio_stop_time = lock->m_segment_audio_start_time + (int64_t) round(new_sample_length * 1.0e6);
 
+	if(m_stats != NULL) {
+		StatsUpdate update(m_stats);
+		m_stats->audio_drift.Set(current_drift);
+		m_stats->audio_sync_queue.Set(lock->m_audio_buffer.GetSize() / m_output_format->m_audio_channels);
+	}
+
 }
 
 void Synchronizer::ReadAudioHole() {
 	assert(m_output_format->m_audio_enabled);
 
+	if(m_paused)
+		return;
+
 	AudioLock audiolock(&m_audio_data);
 	if(audiolock->m_first_timestamp != (int64_t) AV_NOPTS_VALUE) {
 		audiolock->m_average_drift = 0.0;
@@ -699,9 +988,21 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 	for( ; ; ) {
 
 		// get/predict the timestamp of the next frame
-		int64_t next_timestamp = (lock->m_video_buffer.empty())? lock->m_segment_video_stop_time - (int64_t) (1000000 / m_output_format->m_video_frame_rate) : lock->m_video_buffer.front()->GetFrame()->pts;
+		int64_t next_timestamp = (lock->m_video_buffer.empty())? lock->m_segment_video_stop_time - (int64_t) (1000000 / m_output_format->m_video_frame_rate) : lock->m_video_buffer.front().m_frame->GetFrame()->pts;
 		int64_t next_pts = (lock->m_time_offset + (next_timestamp - segment_start_time)) * (int64_t) m_output_format->m_video_frame_rate / (int64_t) 1000000;
 
+		// If the encoder is falling behind, some frames will be skipped. Near-duplicates of the previous frame can be dropped
+		// without losing anything, so drop those first rather than whichever frames happen to land on a skipped position.
+		if(lock->m_segment_video_accumulated_delay >= delay_time_per_frame && !lock->m_video_buffer.empty() && next_pts < segment_stop_video_pts) {
+			double difference = FrameSignatureDifference(lock->m_last_video_signature, lock->m_video_buffer.front().m_signature);
+			if(difference < NEAR_DUPLICATE_DIFFERENCE) {
+				lock->m_video_buffer.pop_front();
+				lock->m_segment_video_accumulated_delay -= delay_time_per_frame;
+				CountSimilarDrop(lock, difference);
+				continue;
+			}
+		}
+
 		// if the frame is too late, decrease the pts by one to avoid gaps
 		if(next_pts > lock->m_video_pts)
 			--next_pts;
@@ -720,6 +1021,10 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 				// create duplicate frame
 				std::unique_ptr<AVFrameWrapper> duplicate_frame = CreateVideoFrame(m_output_format->m_video_width, m_output_format->m_video_height, m_output_format->m_video_pixel_format, lock->m_last_video_frame_data);
 				duplicate_frame->GetFrame()->pts = lock->m_video_pts + m_max_frames_skipped;
+				if(m_output_settings->video_content_hints) {
+					duplicate_frame->GetHints().m_valid = true;
+					duplicate_frame->GetHints().m_static = true;
+				}
 
 				// add new block to sync diagram
 				if(m_sync_diagram != NULL) {
@@ -727,6 +1032,10 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 					m_sync_diagram->AddBlock(2, t, t + 1.0 / (double) m_output_format->m_video_frame_rate, QColor(255, 196, 0));
 				}
 
+				// update the activity index
+				if(lock->m_activity_index != NULL)
+					lock->m_activity_index->AddFrame(duplicate_frame->GetFrame()->pts, NULL);
+
 				// send the frame to the encoder
 				lock->m_segment_video_accumulated_delay = std::max((int64_t) 0, lock->m_segment_video_accumulated_delay - m_max_frames_skipped * delay_time_per_frame);
 				lock->m_video_pts = duplicate_frame->GetFrame()->pts + 1;
@@ -734,6 +1043,11 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 				m_output_manager->AddVideoFrame(std::move(duplicate_frame));
 				lock->m_segment_video_accumulated_delay += m_output_manager->GetVideoFrameDelay();
 
+				if(m_stats != NULL) {
+					StatsUpdate update(m_stats);
+					m_stats->video_frames_duplicated.Add(1);
+				}
+
 			}
 		}
 
@@ -742,7 +1056,8 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 			break;
 
 		// get the frame
-		std::unique_ptr<AVFrameWrapper> frame = std::move(lock->m_video_buffer.front());
+		std::unique_ptr<AVFrameWrapper> frame = std::move(lock->m_video_buffer.front().m_frame);
+		lock->m_last_video_signature = lock->m_video_buffer.front().m_signature;
 		lock->m_video_buffer.pop_front();
 		frame->GetFrame()->pts = next_pts;
 		lock->m_last_video_frame_data = frame->GetFrameData();
@@ -750,6 +1065,10 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 		// if the frame is too early, drop it
 		if(frame->GetFrame()->pts < lock->m_video_pts) {
 			//Logger::LogInfo("[Synchronizer::FlushVideoBuffer] Dropped video frame [" + QString::number(frame->GetFrame()->pts) + "] acc " + QString::number(lock->m_segment_video_accumulated_delay) + ".");
+			if(m_stats != NULL) {
+				StatsUpdate update(m_stats);
+				m_stats->video_frames_dropped.Add(1);
+			}
 			continue;
 		}
 
@@ -763,6 +1082,10 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 			m_sync_diagram->AddBlock(2, t, t + 1.0 / (double) m_output_format->m_video_frame_rate, QColor(255, 0, 0));
 		}
 
+		// update the activity index
+		if(lock->m_activity_index != NULL)
+			lock->m_activity_index->AddFrame(frame->GetFrame()->pts, frame->GetFrame());
+
 		// send the frame to the encoder
 		lock->m_segment_video_accumulated_delay = std::max((int64_t) 0, lock->m_segment_video_accumulated_delay - (frame->GetFrame()->pts - lock->m_video_pts) * delay_time_per_frame);
 		lock->m_video_pts = frame->GetFrame()->pts + 1;
@@ -772,6 +1095,11 @@ void Synchronizer::FlushVideoBuffer(Synchronizer::SharedData* lock, int64_t segm
 
 	}
 
+	if(m_stats != NULL) {
+		StatsUpdate update(m_stats);
+		m_stats->video_sync_queue.Set(lock->m_video_buffer.size());
+	}
+
 }
 
 void Synchronizer::FlushAudioBuffer(Synchronizer::SharedData* lock, int64_t segment_start_time, int64_t segment_stop_time) {
@@ -801,6 +1129,10 @@ void Synchronizer::FlushAudioBuffer(Synchronizer::SharedData* lock, int64_t segm
 				int64_t n = std::min(lock->m_audio_samples - pos, (int64_t) lock->m_audio_buffer.GetSize() / m_output_format->m_audio_channels);
 				lock->m_audio_buffer.Pop(n * m_output_format->m_audio_channels);
 				lock->m_segment_audio_samples_read += n;
+				if(m_stats != NULL) {
+					StatsUpdate update(m_stats);
+					m_stats->audio_samples_dropped.Add(n);
+				}
 			}
 
 		}
@@ -890,38 +1222,34 @@ void Synchronizer::FlushAudioBuffer(Synchronizer::SharedData* lock, int64_t segm
 
 }
 
-void Synchronizer::SynchronizerThread() {
+// Flushes the buffers once and then submits itself again, until the synchronizer is stopped.
+void Synchronizer::SynchronizerTask() {
 	try {
 
-		Logger::LogInfo("[Synchronizer::SynchronizerThread] " + Logger::tr("Synchronizer thread started."));
-
-		while(!m_should_stop) {
+		if(m_should_stop)
+			return;
 
-			{
-				SharedLock lock(&m_shared_data);
-				FlushBuffers(lock.get());
-				if(m_sync_diagram != NULL) {
-					double time_in = (double) hrt_time_micro() * 1.0e-6;
-					double time_out = (double) GetTotalTime(lock.get()) * 1.0e-6;
-					m_sync_diagram->SetCurrentTime(0, time_in);
-					m_sync_diagram->SetCurrentTime(1, time_in);
-					m_sync_diagram->SetCurrentTime(2, time_out);
-					m_sync_diagram->SetCurrentTime(3, time_out);
-					m_sync_diagram->Update();
-				}
+		{
+			SharedLock lock(&m_shared_data);
+			FlushBuffers(lock.get());
+			if(m_sync_diagram != NULL) {
+				double time_in = (double) hrt_time_micro() * 1.0e-6;
+				double time_out = (double) GetTotalTime(lock.get()) * 1.0e-6;
+				m_sync_diagram->SetCurrentTime(0, time_in);
+				m_sync_diagram->SetCurrentTime(1, time_in);
+				m_sync_diagram->SetCurrentTime(2, time_out);
+				m_sync_diagram->SetCurrentTime(3, time_out);
+				m_sync_diagram->Update();
 			}
-
-			usleep(20000);
-
 		}
 
-		Logger::LogInfo("[Synchronizer::SynchronizerThread] " + Logger::tr("Synchronizer thread stopped."));
+		m_tasks.SubmitDelayed(TaskScheduler::PRIORITY_NORMAL, SYNCHRONIZER_FLUSH_INTERVAL, [this]() { SynchronizerTask(); });
 
 	} catch(const std::exception& e) {
 		m_error_occurred = true;
-		Logger::LogError("[Synchronizer::SynchronizerThread] " + Logger::tr("Exception '%1' in synchronizer thread.").arg(e.what()));
+		Logger::LogError("[Synchronizer::SynchronizerTask] " + Logger::tr("Exception '%1' in synchronizer task.").arg(e.what()));
 	} catch(...) {
 		m_error_occurred = true;
-		Logger::LogError("[Synchronizer::SynchronizerThread] " + Logger::tr("Unknown exception in synchronizer thread."));
+		Logger::LogError("[Synchronizer::SynchronizerTask] " + Logger::tr("Unknown exception in synchronizer task."));
 	}
 }
@@ -24,14 +24,20 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "MutexDataPair.h"
 #include "FastScaler.h"
 #include "FastResampler.h"
+#include "FrameChangeDetector.h"
+#include "FrameSignature.h"
 #include "QueueBuffer.h"
+#include "TaskScheduler.h"
 #include "TempBuffer.h"
 #include "AVWrapper.h"
+#include "ConversionPipeline.h"
+#include "ActivityIndex.h"
 
 class OutputManager;
 class OutputSettings;
 class OutputFormat;
 class SyncDiagram;
+struct StatsBlock;
 
 class Synchronizer : public VideoSink, public AudioSink {
 
@@ -40,9 +46,22 @@ private:
 
 		FastScaler m_fast_scaler;
 
+		FrameChangeDetector m_change_detector;
+		bool m_has_converted_reference; // whether the last converted frame can be reused for static frames (it may still be in the conversion pipeline)
+		bool m_letterbox; // the scaling mode of the previous frame (a converted frame can't be reused after a change)
+		unsigned int m_last_width, m_last_height; // the size of the previous frame (for logging size changes)
+		uint64_t m_stats_hint_frames, m_stats_hint_static_frames, m_stats_hint_scene_cuts;
+
+		bool m_focus_valid;
+		VideoFocus m_focus; // the focus of the next frame
+		uint64_t m_stats_focus_frames, m_stats_focus_cursor_frames, m_stats_focus_window_frames;
+
 		int64_t m_last_timestamp; // the timestamp of the last received video frame (for gap detection)
 		int64_t m_next_timestamp; // the preferred timestamp of the next frame (for rate control)
 
+		int64_t m_stats_previous_time; // for the input frame rate in the shared stats
+		uint64_t m_stats_frames;
+
 	};
 	struct AudioData {
 
@@ -60,12 +79,16 @@ private:
 		bool m_warn_desync;
 
 	};
+	struct BufferedVideoFrame {
+		std::unique_ptr<AVFrameWrapper> m_frame;
+		FrameSignature m_signature; // used to decide which frames to drop under overload
+	};
 	struct SharedData {
 
 		TempBuffer<float> m_partial_audio_frame;
 		unsigned int m_partial_audio_frame_samples;
 
-		std::deque<std::unique_ptr<AVFrameWrapper> > m_video_buffer;
+		std::deque<BufferedVideoFrame> m_video_buffer;
 		QueueBuffer<float> m_audio_buffer;
 		int64_t m_video_pts, m_audio_samples; // video and audio position in the final stream (encoded frames and samples, including the partial audio frame)
 		int64_t m_time_offset; // the length of all previous segments combined (in microseconds)
@@ -78,9 +101,17 @@ private:
 		int64_t m_segment_video_accumulated_delay; // sum of all video frame delays that were applied so far
 
 		std::shared_ptr<AVFrameData> m_last_video_frame_data;
+		FrameSignature m_last_video_signature; // signature of the last frame that was sent to the encoder
+		std::shared_ptr<AVFrameData> m_last_converted_data; // the last converted frame, reused for static frames
+
+		std::unique_ptr<ActivityIndex> m_activity_index; // NULL if the activity index is disabled
 
 		bool m_warn_drop_video;
 
+		// frames that were dropped because of overload, chosen by similarity
+		uint64_t m_stats_drop_frames, m_stats_drop_near_duplicates;
+		double m_stats_drop_difference;
+
 	};
 	typedef MutexDataPair<VideoData>::Lock VideoLock;
 	typedef MutexDataPair<AudioData>::Lock AudioLock;
@@ -97,16 +128,21 @@ private:
 	OutputManager *m_output_manager;
 	const OutputSettings *m_output_settings;
 	const OutputFormat *m_output_format;
+	StatsBlock *m_stats;
 
 	int64_t m_max_frames_skipped;
 
 	std::unique_ptr<SyncDiagram> m_sync_diagram;
 
-	std::thread m_thread;
+	std::unique_ptr<ConversionPipeline> m_conversion_pipeline; // NULL if frames are converted by the input thread
+
+	TaskScheduler::Group m_tasks;
 	MutexDataPair<VideoData> m_video_data;
 	MutexDataPair<AudioData> m_audio_data;
 	MutexDataPair<SharedData> m_shared_data;
 	std::atomic<bool> m_should_stop, m_error_occurred;
+	std::atomic<bool> m_paused;
+	std::atomic<bool> m_letterbox;
 
 public:
 	// The arguments 'video_encoder' and 'audio_encoder' can be NULL to disable video or audio.
@@ -126,11 +162,35 @@ public:
 	// while this function is called, because otherwise frames may end up in the wrong segment.
 	void NewSegment();
 
+	// Pauses or resumes the recording without stopping the inputs or the encoders. While paused, the synchronizer asks
+	// the inputs for no new frames and ignores everything they send anyway, so resuming is nearly instant. The new segment
+	// starts when the recording is resumed, so the timestamps continue without a gap.
+	// This function is thread-safe.
+	void SetPaused(bool paused);
+
+	// Returns whether the recording is paused.
+	// This function is thread-safe and lock-free.
+	inline bool IsPaused() { return m_paused; }
+
+	// Changes the way frames are scaled to the output size: if 'letterbox' is true, the aspect ratio of the input is preserved
+	// and the remaining area is filled with black, otherwise the input is stretched. The change applies to the next frame.
+	// This function is thread-safe and lock-free.
+	inline void SetLetterbox(bool letterbox) { m_letterbox = letterbox; }
+
+	// Returns whether frames are letterboxed.
+	// This function is thread-safe and lock-free.
+	inline bool GetLetterbox() { return m_letterbox; }
+
 	// Returns the total recording time (in microseconds).
 	// This function is thread-safe.
 	int64_t GetTotalTime();
 
-	// Returns whether an error has occurred in the synchronizer thread.
+	// Returns the CPU time used by the synchronizer task and the conversion pipeline (in microseconds).
+	// Note: Without the conversion pipeline, the scaling and conversion work is done in the input thread, so it isn't included.
+	// This function is thread-safe.
+	inline int64_t GetCPUTime() { return m_tasks.GetCPUTime() + ((m_conversion_pipeline == NULL)? 0 : m_conversion_pipeline->GetCPUTime()); }
+
+	// Returns whether an error has occurred in the synchronizer task.
 	// This function is thread-safe.
 	inline bool HasErrorOccurred() { return m_error_occurred; }
 
@@ -139,12 +199,17 @@ public:
 
 public: // internal
 	virtual int64_t GetNextVideoTimestamp() override;
+	virtual unsigned int GetVideoFocusFlags() override;
 	virtual void ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) override;
 	virtual void ReadVideoPing(int64_t timestamp) override;
+	virtual void ReadVideoFocus(const VideoFocus& focus) override;
 	virtual void ReadAudioSamples(unsigned int channels, unsigned int sample_rate, AVSampleFormat format, unsigned int sample_count, const uint8_t* data, int64_t timestamp) override;
 	virtual void ReadAudioHole() override;
 
 private:
+	void StoreVideoFrame(SharedData* lock, int64_t timestamp, const AVFrameHints& hints, std::unique_ptr<AVFrameWrapper> converted_frame, bool reuse);
+	void StoreVideoPing(SharedData* lock, int64_t timestamp);
+	void CountSimilarDrop(SharedData* lock, double difference); // also counts the dropped frame
 	void InitAudioSegment(AudioData* audiolock);
 	double GetAudioDrift(AudioData* audiolock, unsigned int extra_samples = 0);
 	void NewSegment(SharedData* lock);
@@ -156,6 +221,6 @@ private:
 	void FlushAudioBuffer(SharedData* lock, int64_t segment_start_time, int64_t segment_stop_time);
 
 private:
-	void SynchronizerThread();
+	void SynchronizerTask();
 
 };
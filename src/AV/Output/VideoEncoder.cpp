@@ -22,8 +22,20 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Logger.h"
 #include "AVWrapper.h"
 #include "Muxer.h"
+#include "X264Backend.h"
 #include "X264Presets.h"
 
+// Scene cuts that are closer together than this (in seconds) will not force another keyframe, to avoid wasting bits when the screen changes rapidly.
+static const double HINT_KEYFRAME_MIN_INTERVAL = 1.0;
+
+// Changes that cover less than this fraction of the frame will be encoded with a higher quality than the rest of the frame.
+static const double HINT_ROI_MAX_FRACTION = 0.25;
+
+// Quantizer offsets for regions of interest (range -1 to 1, negative values result in higher quality).
+// Static frames get a positive offset so the encoder will skip nearly everything, changed regions get a negative offset.
+static const AVRational HINT_QOFFSET_STATIC = {1, 5};
+static const AVRational HINT_QOFFSET_CHANGED = {-1, 10};
+
 const std::vector<VideoEncoder::PixelFormatData> VideoEncoder::SUPPORTED_PIXEL_FORMATS = {
 	{"nv12", AV_PIX_FMT_NV12, true},
 	{"yuv420", AV_PIX_FMT_YUV420P, true},
@@ -34,8 +46,15 @@ const std::vector<VideoEncoder::PixelFormatData> VideoEncoder::SUPPORTED_PIXEL_F
 	{"rgb", AV_PIX_FMT_RGB24, false},
 };
 
-VideoEncoder::VideoEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options)
-	: BaseEncoder(muxer, stream, codec_context, codec, options) {
+VideoEncoder::VideoEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options, bool native_x264)
+	: BaseEncoder(muxer, stream, codec_context, (native_x264)? NULL : codec, options) {
+
+#if SSR_USE_X264
+	if(native_x264)
+		m_x264_backend.reset(new X264Backend(codec_context, options));
+#else
+	assert(!native_x264);
+#endif
 
 #if !SSR_USE_AVCODEC_ENCODE_VIDEO2
 	// allocate a temporary buffer
@@ -48,11 +67,21 @@ VideoEncoder::VideoEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec
 	m_temp_buffer.resize(std::max<unsigned int>(FF_MIN_BUFFER_SIZE, 256 * 1024 + GetCodecContext()->width * GetCodecContext()->height * 3));
 #endif
 
+	m_next_forced_keyframe_pts = std::numeric_limits<int64_t>::min();
+	m_stats_hint_frames = 0;
+	m_stats_hint_keyframes = 0;
+	m_stats_hint_static_frames = 0;
+	m_stats_hint_roi_frames = 0;
+
 	StartThread();
 }
 
 VideoEncoder::~VideoEncoder() {
 	StopThread();
+	if(m_stats_hint_frames != 0) {
+		Logger::LogInfo("[VideoEncoder::~VideoEncoder] " + Logger::tr("Content hints: %1 frames, %2 forced keyframes, %3 static frames, %4 frames with a region of interest.")
+						.arg(m_stats_hint_frames).arg(m_stats_hint_keyframes).arg(m_stats_hint_static_frames).arg(m_stats_hint_roi_frames));
+	}
 }
 
 AVPixelFormat VideoEncoder::GetPixelFormat() {
@@ -112,8 +141,33 @@ bool VideoEncoder::AVCodecIsSupported(const QString& codec_name) {
 	return false;
 }
 
+bool VideoEncoder::UseNativeX264(const QString& codec_name, const std::vector<std::pair<QString, QString> >& codec_options) {
+	QString backend;
+	for(unsigned int i = 0; i < codec_options.size(); ++i) {
+		if(codec_options[i].first == "backend")
+			backend = codec_options[i].second;
+	}
+	if(backend.isEmpty() || backend == "libavcodec")
+		return false;
+	if(backend != "x264") {
+		Logger::LogWarning("[VideoEncoder::UseNativeX264] " + Logger::tr("Warning: Encoder backend '%1' is unknown, using libavcodec instead.").arg(backend));
+		return false;
+	}
+#if SSR_USE_X264
+	if(codec_name != "libx264") {
+		Logger::LogWarning("[VideoEncoder::UseNativeX264] " + Logger::tr("Warning: The native x264 backend can only be used with codec libx264, using libavcodec instead."));
+		return false;
+	}
+	return true;
+#else
+	Q_UNUSED(codec_name);
+	Logger::LogWarning("[VideoEncoder::UseNativeX264] " + Logger::tr("Warning: SimpleScreenRecorder was compiled without the native x264 backend, using libavcodec instead."));
+	return false;
+#endif
+}
+
 void VideoEncoder::PrepareStream(AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options, const std::vector<std::pair<QString, QString> >& codec_options,
-								 unsigned int bit_rate, unsigned int width, unsigned int height, unsigned int frame_rate) {
+								 unsigned int bit_rate, unsigned int width, unsigned int height, unsigned int frame_rate, bool native_x264) {
 
 	if(width == 0 || height == 0) {
 		Logger::LogError("[VideoEncoder::PrepareStream] " + Logger::tr("Error: Width or height is zero!"));
@@ -165,12 +219,14 @@ void VideoEncoder::PrepareStream(AVStream* stream, AVCodecContext* codec_context
 			codec_context->gop_size = ParseCodecOptionInt(key, value, 1, 1000000);
 		} else if(key == "pixelformat") {
 			pixel_format_name = value;
+		} else if(key == "backend") {
+			// already handled by UseNativeX264
 #if !SSR_USE_AVCODEC_PRIVATE_PRESET
-		} else if(key == "crf") {
+		} else if(key == "crf" && !native_x264) {
 			codec_context->crf = ParseCodecOptionInt(key, value, 0, 51);
 #endif
 #if !SSR_USE_AVCODEC_PRIVATE_PRESET
-		} else if(key == "preset") {
+		} else if(key == "preset" && !native_x264) {
 			X264Preset(codec_context, value.toUtf8().constData());
 #endif
 		} else {
@@ -185,6 +241,10 @@ void VideoEncoder::PrepareStream(AVStream* stream, AVCodecContext* codec_context
 			continue;
 		if(!AVCodecSupportsPixelFormat(codec, SUPPORTED_PIXEL_FORMATS[i].m_format))
 			continue;
+#if SSR_USE_X264
+		if(native_x264 && !X264Backend::SupportsPixelFormat(SUPPORTED_PIXEL_FORMATS[i].m_format))
+			continue;
+#endif
 		Logger::LogInfo("[VideoEncoder::PrepareStream] " + Logger::tr("Using pixel format %1.").arg(SUPPORTED_PIXEL_FORMATS[i].m_name));
 		codec_context->pix_fmt = SUPPORTED_PIXEL_FORMATS[i].m_format;
 		if(SUPPORTED_PIXEL_FORMATS[i].m_is_yuv) {
@@ -205,9 +265,106 @@ void VideoEncoder::PrepareStream(AVStream* stream, AVCodecContext* codec_context
 
 }
 
+void VideoEncoder::ApplyFrameHints(AVFrameWrapper* frame) {
+
+	const AVFrameHints &hints = frame->GetHints();
+	if(!hints.m_valid)
+		return;
+	AVFrame *avframe = frame->GetFrame();
+	++m_stats_hint_frames;
+
+	// force a keyframe when the content changed completely, unless we just did that
+	if(hints.m_scene_cut && avframe->pts >= m_next_forced_keyframe_pts) {
+		avframe->pict_type = AV_PICTURE_TYPE_I;
+		m_next_forced_keyframe_pts = avframe->pts + (int64_t) ceil(HINT_KEYFRAME_MIN_INTERVAL * (double) GetFrameRate());
+		++m_stats_hint_keyframes;
+	}
+	if(hints.m_static)
+		++m_stats_hint_static_frames;
+
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+	// Static frames are encoded with a lower quality, which makes the encoder skip almost all macroblocks.
+	// When only a small part of the frame changed, that part gets a higher quality instead.
+	// These regions are added after the regions of the synchronizer (cursor and active window), so those take precedence.
+	// Not all codecs support this, the others will simply ignore the side data.
+	std::vector<AVRegionOfInterest> regions;
+	if(hints.m_static) {
+		regions.push_back(MakeRegionOfInterest(0, 0, GetWidth(), GetHeight(), HINT_QOFFSET_STATIC));
+	} else if(!hints.m_scene_cut && hints.m_changed_fraction < HINT_ROI_MAX_FRACTION && hints.m_changed_x2 > hints.m_changed_x1 && hints.m_changed_y2 > hints.m_changed_y1) {
+		regions.push_back(MakeRegionOfInterest(hints.m_changed_x1, hints.m_changed_y1, hints.m_changed_x2, hints.m_changed_y2, HINT_QOFFSET_CHANGED));
+	}
+	if(!regions.empty()) {
+		AddFrameRegionsOfInterest(avframe, regions);
+		++m_stats_hint_roi_frames;
+	}
+#endif
+
+}
+
+bool VideoEncoder::ApplyControlRequest(AVFrameWrapper* frame, const ControlRequest& request) {
+
+	// keyframes are handled by the base class
+	bool supported = BaseEncoder::ApplyControlRequest(frame, ControlRequest{request.m_keyframe, 0, -1, QString()});
+
+#if SSR_USE_X264
+	// the native backend reconfigures x264 directly
+	if(m_x264_backend != NULL) {
+		if(request.m_bit_rate != 0) {
+			Logger::LogInfo("[VideoEncoder::ApplyControlRequest] " + Logger::tr("Changing video bit rate to %1 kbit/s.").arg(request.m_bit_rate / 1000));
+			if(!m_x264_backend->SetBitRate(request.m_bit_rate))
+				supported = false;
+		}
+		if(request.m_crf >= 0) {
+			Logger::LogInfo("[VideoEncoder::ApplyControlRequest] " + Logger::tr("Changing video constant rate factor to %1.").arg(request.m_crf));
+			if(!m_x264_backend->SetCRF(request.m_crf))
+				supported = false;
+		}
+		if(!request.m_preset.isEmpty()) {
+			if(!m_x264_backend->SetPreset(request.m_preset))
+				supported = false;
+		}
+		return supported;
+	}
+#endif
+
+	// Only libx264 checks the rate control settings before every frame and reconfigures itself when they change.
+	// The bit rate is only used in bit rate mode (bit_rate != 0), the constant rate factor only in CRF mode.
+	bool is_x264 = (strcmp(GetCodecContext()->codec->name, "libx264") == 0);
+	bool bit_rate_mode = (GetCodecContext()->bit_rate != 0);
+	if(request.m_bit_rate != 0) {
+		if(is_x264 && bit_rate_mode) {
+			Logger::LogInfo("[VideoEncoder::ApplyControlRequest] " + Logger::tr("Changing video bit rate to %1 kbit/s.").arg(request.m_bit_rate / 1000));
+			GetCodecContext()->bit_rate = request.m_bit_rate;
+			if(GetCodecContext()->rc_max_rate != 0 && GetCodecContext()->rc_max_rate < (int64_t) request.m_bit_rate)
+				GetCodecContext()->rc_max_rate = request.m_bit_rate;
+		} else {
+			supported = false;
+		}
+	}
+	if(request.m_crf >= 0) {
+		if(is_x264 && !bit_rate_mode) {
+			Logger::LogInfo("[VideoEncoder::ApplyControlRequest] " + Logger::tr("Changing video constant rate factor to %1.").arg(request.m_crf));
+#if SSR_USE_AVCODEC_PRIVATE_PRESET
+			av_opt_set_double(GetCodecContext()->priv_data, "crf", (double) request.m_crf, 0);
+#else
+			GetCodecContext()->crf = request.m_crf;
+#endif
+		} else {
+			supported = false;
+		}
+	}
+
+	// libavcodec can't change the preset while encoding
+	if(!request.m_preset.isEmpty())
+		supported = false;
+
+	return supported;
+}
+
 bool VideoEncoder::EncodeFrame(AVFrameWrapper* frame) {
 
 	if(frame != NULL) {
+		ApplyFrameHints(frame);
 #if SSR_USE_AVFRAME_WIDTH_HEIGHT
 		assert(frame->GetFrame()->width == GetCodecContext()->width);
 		assert(frame->GetFrame()->height == GetCodecContext()->height);
@@ -221,6 +378,11 @@ bool VideoEncoder::EncodeFrame(AVFrameWrapper* frame) {
 #endif
 	}
 
+#if SSR_USE_X264
+	if(m_x264_backend != NULL)
+		return EncodeFrameNative(frame);
+#endif
+
 #if SSR_USE_AVCODEC_SEND_RECEIVE
 
 	// send a frame
@@ -237,15 +399,19 @@ bool VideoEncoder::EncodeFrame(AVFrameWrapper* frame) {
 	av_frame_free(&avframe);
 
 	// try to receive a packet
+	// the packet is taken from the pool, and given back if it wasn't used
 	for( ; ; ) {
-		std::unique_ptr<AVPacketWrapper> packet(new AVPacketWrapper());
+		std::unique_ptr<AVPacketWrapper> packet = GetMuxer()->GetPacketPool()->GetPacket();
 		int res = avcodec_receive_packet(GetCodecContext(), packet->GetPacket());
 		if(res == 0) { // we have a packet, send the packet to the muxer
+			TrackPacketLatency(packet->GetPacket());
 			GetMuxer()->AddPacket(GetStream()->index, std::move(packet));
 			IncrementPacketCounter();
 		} else if(res == AVERROR(EAGAIN)) { // we have no packet
+			GetMuxer()->GetPacketPool()->ReturnPacket(std::move(packet));
 			return true;
 		} else if(res == AVERROR_EOF) { // this is the end of the stream
+			GetMuxer()->GetPacketPool()->ReturnPacket(std::move(packet));
 			return false;
 		} else {
 			Logger::LogError("[VideoEncoder::EncodeFrame] " + Logger::tr("Error: Receiving of video packet failed!"));
@@ -269,6 +435,7 @@ bool VideoEncoder::EncodeFrame(AVFrameWrapper* frame) {
 	if(got_packet) {
 
 		// send the packet to the muxer
+		TrackPacketLatency(packet->GetPacket());
 		GetMuxer()->AddPacket(GetStream()->index, std::move(packet));
 		IncrementPacketCounter();
 		return true;
@@ -305,6 +472,7 @@ bool VideoEncoder::EncodeFrame(AVFrameWrapper* frame) {
 			packet->GetPacket()->flags |= AV_PKT_FLAG_KEY;
 
 		// send the packet to the muxer
+		TrackPacketLatency(packet->GetPacket());
 		GetMuxer()->AddPacket(GetStream()->index, std::move(packet));
 		IncrementPacketCounter();
 		return true;
@@ -316,3 +484,27 @@ bool VideoEncoder::EncodeFrame(AVFrameWrapper* frame) {
 #endif
 
 }
+
+#if SSR_USE_X264
+bool VideoEncoder::EncodeFrameNative(AVFrameWrapper* frame) {
+
+	// x264 returns at most one packet per call, the flush loop stops when there are no delayed frames left
+	std::unique_ptr<AVPacketWrapper> packet;
+	do {
+		if(frame == NULL && !m_x264_backend->HasDelayedFrames())
+			return false;
+		packet = m_x264_backend->Encode(frame, GetMuxer()->GetPacketPool());
+	} while(packet == NULL && frame == NULL);
+
+	// do we have a packet?
+	if(packet == NULL)
+		return false;
+
+	// send the packet to the muxer
+	TrackPacketLatency(packet->GetPacket());
+	GetMuxer()->AddPacket(GetStream()->index, std::move(packet));
+	IncrementPacketCounter();
+	return true;
+
+}
+#endif
@@ -22,6 +22,8 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "BaseEncoder.h"
 
+class X264Backend;
+
 class VideoEncoder : public BaseEncoder {
 
 private:
@@ -39,8 +41,17 @@ private:
 	std::vector<uint8_t> m_temp_buffer;
 #endif
 
+#if SSR_USE_X264
+	std::unique_ptr<X264Backend> m_x264_backend;
+#endif
+
+	// content hints (only used by the encoder thread)
+	int64_t m_next_forced_keyframe_pts;
+	uint64_t m_stats_hint_frames, m_stats_hint_keyframes, m_stats_hint_static_frames, m_stats_hint_roi_frames;
+
 public:
-	VideoEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options);
+	// If 'native_x264' is true, the frames are encoded by the native libx264 backend instead of libavcodec.
+	VideoEncoder(Muxer* muxer, AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options, bool native_x264 = false);
 	~VideoEncoder();
 
 	// Returns the required pixel format.
@@ -55,10 +66,19 @@ public:
 
 public:
 	static bool AVCodecIsSupported(const QString& codec_name);
+	// Returns whether the codec options select the native libx264 backend ('backend=x264') and it can be used for this codec.
+	static bool UseNativeX264(const QString& codec_name, const std::vector<std::pair<QString, QString> >& codec_options);
 	static void PrepareStream(AVStream* stream, AVCodecContext* codec_context, AVCodec* codec, AVDictionary** options, const std::vector<std::pair<QString, QString> >& codec_options,
-							  unsigned int bit_rate, unsigned int width, unsigned int height, unsigned int frame_rate);
+							  unsigned int bit_rate, unsigned int width, unsigned int height, unsigned int frame_rate, bool native_x264 = false);
+
+private:
+	void ApplyFrameHints(AVFrameWrapper* frame);
+#if SSR_USE_X264
+	bool EncodeFrameNative(AVFrameWrapper* frame);
+#endif
 
 private:
+	virtual bool ApplyControlRequest(AVFrameWrapper* frame, const ControlRequest& request) override;
 	virtual bool EncodeFrame(AVFrameWrapper* frame) override;
 
 };
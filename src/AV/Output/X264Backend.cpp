@@ -0,0 +1,361 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "X264Backend.h"
+
+#if SSR_USE_X264
+
+#include "Logger.h"
+#include "PacketPool.h"
+
+#ifndef AV_INPUT_BUFFER_PADDING_SIZE
+#define AV_INPUT_BUFFER_PADDING_SIZE FF_INPUT_BUFFER_PADDING_SIZE
+#endif
+
+// The quantizer range of 8-bit H.264. Region of interest offsets (range -1 to 1) are scaled to this range, like libavcodec does.
+static const float X264_ROI_QP_RANGE = 51.0f;
+
+static int X264ColorSpace(AVPixelFormat format) {
+	switch(format) {
+		case AV_PIX_FMT_NV12: return X264_CSP_NV12;
+		case AV_PIX_FMT_YUV420P: return X264_CSP_I420;
+		case AV_PIX_FMT_YUV422P: return X264_CSP_I422;
+		case AV_PIX_FMT_YUV444P: return X264_CSP_I444;
+		default: return X264_CSP_NONE;
+	}
+}
+
+static bool TakeOption(AVDictionary** options, const char* key, QString* value) {
+	AVDictionaryEntry *t = av_dict_get(*options, key, NULL, 0);
+	if(t == NULL)
+		return false;
+	*value = QString::fromUtf8(t->value);
+	av_dict_set(options, key, NULL, 0);
+	return true;
+}
+
+X264Backend::X264Backend(AVCodecContext* codec_context, AVDictionary** options) {
+
+	m_codec_context = codec_context;
+
+	m_x264 = NULL;
+	m_mb_width = (codec_context->width + 15) / 16;
+	m_mb_height = (codec_context->height + 15) / 16;
+
+	m_stats_frames = 0;
+	m_stats_packets = 0;
+	m_stats_bytes = 0;
+	m_stats_reconfigs = 0;
+
+	try {
+		Init(options);
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+}
+
+X264Backend::~X264Backend() {
+	Free();
+	Logger::LogInfo("[X264Backend::~X264Backend] " + Logger::tr("Native x264 backend: %1 frames, %2 packets, %3 MiB, %4 reconfigurations.")
+					.arg(m_stats_frames).arg(m_stats_packets).arg((double) m_stats_bytes / (1024.0 * 1024.0), 0, 'f', 1).arg(m_stats_reconfigs));
+}
+
+std::unique_ptr<AVPacketWrapper> X264Backend::Encode(AVFrameWrapper* frame, PacketPool* packet_pool) {
+
+	// The planes of the frame are used directly, x264 reads them into its own lookahead buffers during the call.
+	// This avoids handing the frame over to libavcodec's reference counting, so the frame data can go back to the pool right away.
+	x264_picture_t picture_in, picture_out, *input = NULL;
+	if(frame != NULL) {
+		AVFrame *avframe = frame->GetFrame();
+		x264_picture_init(&picture_in);
+		picture_in.img.i_csp = m_param.i_csp;
+		picture_in.img.i_plane = (m_param.i_csp == X264_CSP_NV12)? 2 : 3;
+		for(int p = 0; p < picture_in.img.i_plane; ++p) {
+			picture_in.img.plane[p] = avframe->data[p];
+			picture_in.img.i_stride[p] = avframe->linesize[p];
+		}
+		picture_in.i_pts = avframe->pts;
+		picture_in.i_type = (avframe->pict_type == AV_PICTURE_TYPE_I)? X264_TYPE_KEYFRAME : X264_TYPE_AUTO;
+		SetRegionsOfInterest(&picture_in, avframe);
+		input = &picture_in;
+		++m_stats_frames;
+	}
+
+	// encode the frame
+	x264_nal_t *nals;
+	int nal_count;
+	int size = x264_encoder_encode(m_x264, &nals, &nal_count, input, &picture_out);
+	if(size < 0) {
+		Logger::LogError("[X264Backend::Encode] " + Logger::tr("Error: Encoding of video frame failed!"));
+		throw LibavException();
+	}
+	if(size == 0)
+		return std::unique_ptr<AVPacketWrapper>();
+
+	// The payloads of the NAL units are stored back-to-back in a buffer that x264 reuses for the next frame,
+	// so they are copied once into a packet from the pool.
+	std::unique_ptr<AVPacketWrapper> packet = packet_pool->GetPacket();
+	if(av_new_packet(packet->GetPacket(), m_sei.size() + size) != 0)
+		throw std::bad_alloc();
+	uint8_t *data = packet->GetPacket()->data;
+	if(!m_sei.empty()) {
+		memcpy(data, m_sei.data(), m_sei.size());
+		data += m_sei.size();
+		m_sei.clear();
+	}
+	memcpy(data, nals[0].p_payload, size);
+
+	// note: pts and dts will be rescaled and stream_index will be set by Muxer
+	packet->GetPacket()->pts = picture_out.i_pts;
+	packet->GetPacket()->dts = picture_out.i_dts;
+	if(picture_out.b_keyframe)
+		packet->GetPacket()->flags |= AV_PKT_FLAG_KEY;
+
+	++m_stats_packets;
+	m_stats_bytes += packet->GetPacket()->size;
+	return packet;
+
+}
+
+bool X264Backend::HasDelayedFrames() {
+	return (x264_encoder_delayed_frames(m_x264) > 0);
+}
+
+bool X264Backend::SetBitRate(unsigned int bit_rate) {
+	// x264 only accepts a new bit rate in bit rate mode with VBV enabled, and VBV can't be turned on while encoding
+	if(m_param.rc.i_rc_method != X264_RC_ABR || m_param.rc.i_vbv_max_bitrate <= 0 || m_param.rc.i_vbv_buffer_size <= 0)
+		return false;
+	x264_param_t param = m_param;
+	param.rc.i_bitrate = bit_rate / 1000;
+	if(param.rc.i_vbv_max_bitrate < param.rc.i_bitrate)
+		param.rc.i_vbv_max_bitrate = param.rc.i_bitrate;
+	return Reconfigure(param);
+}
+
+bool X264Backend::SetCRF(int crf) {
+	if(m_param.rc.i_rc_method != X264_RC_CRF)
+		return false;
+	x264_param_t param = m_param;
+	param.rc.f_rf_constant = (float) crf;
+	return Reconfigure(param);
+}
+
+bool X264Backend::SetPreset(const QString& preset) {
+
+	x264_param_t preset_param;
+	if(x264_param_default_preset(&preset_param, preset.toUtf8().constData(), (m_tune.isEmpty())? NULL : m_tune.toUtf8().constData()) < 0) {
+		Logger::LogWarning("[X264Backend::SetPreset] " + Logger::tr("Warning: Preset '%1' is not supported by x264!").arg(preset));
+		return false;
+	}
+
+	// Only the analysis settings of a preset can be changed while encoding, x264 ignores the others (e.g. B-frames and lookahead).
+	// x264 also never uses more reference frames than it was opened with.
+	x264_param_t param = m_param;
+	param.analyse = preset_param.analyse;
+	param.analyse.b_psnr = m_param.analyse.b_psnr;
+	param.analyse.b_ssim = m_param.analyse.b_ssim;
+	param.analyse.i_noise_reduction = m_param.analyse.i_noise_reduction;
+	param.i_frame_reference = preset_param.i_frame_reference;
+	if(!m_profile.isEmpty())
+		x264_param_apply_profile(&param, m_profile.toUtf8().constData());
+
+	Logger::LogInfo("[X264Backend::SetPreset] " + Logger::tr("Changing x264 preset to %1.").arg(preset));
+	return Reconfigure(param);
+}
+
+bool X264Backend::SupportsPixelFormat(AVPixelFormat format) {
+	return (X264ColorSpace(format) != X264_CSP_NONE);
+}
+
+void X264Backend::Init(AVDictionary** options) {
+
+	// the preset and tune have to be applied first, everything else overrides them
+	QString preset = "medium";
+	TakeOption(options, "preset", &preset);
+	TakeOption(options, "tune", &m_tune);
+	TakeOption(options, "profile", &m_profile);
+	if(x264_param_default_preset(&m_param, preset.toUtf8().constData(), (m_tune.isEmpty())? NULL : m_tune.toUtf8().constData()) < 0) {
+		Logger::LogError("[X264Backend::Init] " + Logger::tr("Error: Preset '%1' or tune '%2' is not supported by x264!").arg(preset).arg(m_tune));
+		throw LibavException();
+	}
+
+	// copy the settings from the codec context
+	m_param.i_csp = X264ColorSpace(m_codec_context->pix_fmt);
+	if(m_param.i_csp == X264_CSP_NONE) {
+		Logger::LogError("[X264Backend::Init] " + Logger::tr("Error: The pixel format is not supported by the native x264 backend!"));
+		throw LibavException();
+	}
+	m_param.i_width = m_codec_context->width;
+	m_param.i_height = m_codec_context->height;
+	m_param.i_fps_num = m_codec_context->time_base.den;
+	m_param.i_fps_den = m_codec_context->time_base.num;
+	m_param.i_timebase_num = m_codec_context->time_base.num;
+	m_param.i_timebase_den = m_codec_context->time_base.den;
+	m_param.vui.i_sar_width = m_codec_context->sample_aspect_ratio.num;
+	m_param.vui.i_sar_height = m_codec_context->sample_aspect_ratio.den;
+	m_param.vui.i_colorprim = m_codec_context->color_primaries;
+	m_param.vui.i_transfer = m_codec_context->color_trc;
+	m_param.vui.i_colmatrix = m_codec_context->colorspace;
+	m_param.vui.b_fullrange = (m_codec_context->color_range == AVCOL_RANGE_JPEG);
+	m_param.vui.i_chroma_loc = std::max(0, (int) m_codec_context->chroma_sample_location - 1);
+	m_param.i_threads = m_codec_context->thread_count;
+	if(m_codec_context->gop_size > 0)
+		m_param.i_keyint_max = m_codec_context->gop_size;
+	if(m_codec_context->bit_rate != 0) {
+		m_param.rc.i_rc_method = X264_RC_ABR;
+		m_param.rc.i_bitrate = m_codec_context->bit_rate / 1000;
+	} else if(m_codec_context->flags & AV_CODEC_FLAG_QSCALE) {
+		m_param.rc.i_rc_method = X264_RC_CQP;
+		m_param.rc.i_qp_constant = clamp((int) lrint((double) m_codec_context->global_quality / (double) FF_QP2LAMBDA), 0, 69);
+	}
+	if(m_codec_context->rc_max_rate != 0)
+		m_param.rc.i_vbv_max_bitrate = m_codec_context->rc_max_rate / 1000;
+	if(m_codec_context->rc_buffer_size != 0)
+		m_param.rc.i_vbv_buffer_size = m_codec_context->rc_buffer_size / 1000;
+	m_param.b_repeat_headers = !(m_codec_context->flags & AV_CODEC_FLAG_GLOBAL_HEADER);
+	m_param.i_log_level = X264_LOG_WARNING;
+
+	// pass the other options to x264, it uses the same names as the x264 command line
+	AVDictionaryEntry *t = NULL;
+	while((t = av_dict_get(*options, "", t, AV_DICT_IGNORE_SUFFIX)) != NULL) {
+		if(x264_param_parse(&m_param, t->key, t->value) != 0) {
+			Logger::LogWarning("[X264Backend::Init] " + Logger::tr("Warning: Codec option '%1' was not recognised!").arg(t->key));
+		}
+	}
+
+	// the profile has to be applied last
+	if(!m_profile.isEmpty() && x264_param_apply_profile(&m_param, m_profile.toUtf8().constData()) < 0) {
+		Logger::LogError("[X264Backend::Init] " + Logger::tr("Error: Profile '%1' is not supported by x264!").arg(m_profile));
+		throw LibavException();
+	}
+
+	// open the encoder
+	m_x264 = x264_encoder_open(&m_param);
+	if(m_x264 == NULL) {
+		Logger::LogError("[X264Backend::Init] " + Logger::tr("Error: Can't open x264 encoder!"));
+		throw LibavException();
+	}
+	x264_encoder_parameters(m_x264, &m_param);
+
+	// the muxer needs to know about B-frames
+	m_codec_context->max_b_frames = m_param.i_bframe;
+	m_codec_context->has_b_frames = (m_param.i_bframe == 0)? 0 : (m_param.i_bframe_pyramid != 0)? 2 : 1;
+
+	if(!m_param.b_repeat_headers)
+		StoreHeaders();
+
+	Logger::LogInfo("[X264Backend::Init] " + Logger::tr("Using the native x264 backend with preset %1.").arg(preset));
+
+}
+
+void X264Backend::Free() {
+	if(m_x264 != NULL) {
+		x264_encoder_close(m_x264);
+		m_x264 = NULL;
+	}
+}
+
+void X264Backend::StoreHeaders() {
+
+	x264_nal_t *nals;
+	int nal_count;
+	if(x264_encoder_headers(m_x264, &nals, &nal_count) < 0) {
+		Logger::LogError("[X264Backend::StoreHeaders] " + Logger::tr("Error: Can't get the x264 headers!"));
+		throw LibavException();
+	}
+
+	// The SPS and PPS go in the extradata. The SEI (which contains the x264 version and settings) doesn't belong there,
+	// it is prepended to the first packet instead, like libavcodec does.
+	size_t size = 0;
+	for(int i = 0; i < nal_count; ++i) {
+		if(nals[i].i_type != NAL_SEI)
+			size += nals[i].i_payload;
+	}
+	av_freep(&m_codec_context->extradata);
+	m_codec_context->extradata = (uint8_t*) av_mallocz(size + AV_INPUT_BUFFER_PADDING_SIZE);
+	if(m_codec_context->extradata == NULL)
+		throw std::bad_alloc();
+	m_codec_context->extradata_size = size;
+	uint8_t *data = m_codec_context->extradata;
+	for(int i = 0; i < nal_count; ++i) {
+		if(nals[i].i_type == NAL_SEI) {
+			m_sei.assign(nals[i].p_payload, nals[i].p_payload + nals[i].i_payload);
+		} else {
+			memcpy(data, nals[i].p_payload, nals[i].i_payload);
+			data += nals[i].i_payload;
+		}
+	}
+
+}
+
+void X264Backend::SetRegionsOfInterest(x264_picture_t* picture, AVFrame* frame) {
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+
+	// x264 can only use quantizer offsets when adaptive quantization is enabled
+	AVFrameSideData *side_data = av_frame_get_side_data(frame, AV_FRAME_DATA_REGIONS_OF_INTEREST);
+	if(side_data == NULL || m_param.rc.i_aq_mode == X264_AQ_NONE)
+		return;
+	const AVRegionOfInterest *first = (const AVRegionOfInterest*) side_data->data;
+	if(first->self_size == 0 || side_data->size % first->self_size != 0)
+		return;
+	unsigned int count = side_data->size / first->self_size;
+
+	// x264 frees the offsets with the callback once it is done with the frame
+	float *offsets = (float*) av_mallocz(sizeof(float) * m_mb_width * m_mb_height);
+	if(offsets == NULL)
+		throw std::bad_alloc();
+
+	// regions that come first take precedence, so they are applied last
+	for(unsigned int i = count; i > 0; ) {
+		--i;
+		const AVRegionOfInterest *roi = (const AVRegionOfInterest*) (side_data->data + first->self_size * i);
+		if(roi->qoffset.den == 0)
+			continue;
+		unsigned int x1 = std::min(m_mb_width, (unsigned int) std::max(0, roi->left) / 16);
+		unsigned int y1 = std::min(m_mb_height, (unsigned int) std::max(0, roi->top) / 16);
+		unsigned int x2 = std::min(m_mb_width, ((unsigned int) std::max(0, roi->right) + 15) / 16);
+		unsigned int y2 = std::min(m_mb_height, ((unsigned int) std::max(0, roi->bottom) + 15) / 16);
+		float qoffset = clamp((float) roi->qoffset.num / (float) roi->qoffset.den, -1.0f, 1.0f) * X264_ROI_QP_RANGE;
+		for(unsigned int y = y1; y < y2; ++y) {
+			std::fill_n(offsets + y * m_mb_width + x1, x2 - std::min(x1, x2), qoffset);
+		}
+	}
+	picture->prop.quant_offsets = offsets;
+	picture->prop.quant_offsets_free = av_free;
+
+#else
+	Q_UNUSED(picture);
+	Q_UNUSED(frame);
+#endif
+}
+
+bool X264Backend::Reconfigure(const x264_param_t& param) {
+	x264_param_t new_param = param;
+	if(x264_encoder_reconfig(m_x264, &new_param) < 0) {
+		Logger::LogWarning("[X264Backend::Reconfigure] " + Logger::tr("Warning: x264 rejected the new settings!"));
+		return false;
+	}
+	x264_encoder_parameters(m_x264, &m_param);
+	++m_stats_reconfigs;
+	return true;
+}
+
+#endif
@@ -0,0 +1,80 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "AVWrapper.h"
+
+#if SSR_USE_X264
+
+#include <x264.h>
+
+class PacketPool;
+
+// An encoder backend that talks to libx264 directly instead of going through libavcodec.
+// The planes of the frames are passed to x264 as-is, and the NAL units are written straight into packets from the packet pool.
+// The codec context is only used to read the settings and to store the global headers, the codec itself is never opened.
+class X264Backend {
+
+private:
+	AVCodecContext *m_codec_context;
+	QString m_tune, m_profile;
+
+	x264_t *m_x264;
+	x264_param_t m_param;
+	unsigned int m_mb_width, m_mb_height;
+	std::vector<uint8_t> m_sei; // prepended to the first packet when the headers are stored separately
+
+	uint64_t m_stats_frames, m_stats_packets, m_stats_bytes, m_stats_reconfigs;
+
+public:
+	// Creates the encoder with the settings of the codec context. The options are passed to x264, unknown options result in a warning.
+	X264Backend(AVCodecContext* codec_context, AVDictionary** options);
+	~X264Backend();
+
+	X264Backend(const X264Backend&) = delete;
+	X264Backend& operator=(const X264Backend&) = delete;
+
+	// Encodes a frame (or flushes the encoder if the frame is NULL). Returns the resulting packet, or NULL if x264 is still buffering.
+	// The frame data is only read during this call, so the frame can be reused immediately afterwards.
+	std::unique_ptr<AVPacketWrapper> Encode(AVFrameWrapper* frame, PacketPool* packet_pool);
+
+	// Returns whether x264 still has frames that need to be flushed.
+	bool HasDelayedFrames();
+
+	// Changes the rate control settings or the preset, starting at the next frame. Returns false if this is not possible in the current mode.
+	bool SetBitRate(unsigned int bit_rate);
+	bool SetCRF(int crf);
+	bool SetPreset(const QString& preset);
+
+public:
+	static bool SupportsPixelFormat(AVPixelFormat format);
+
+private:
+	void Init(AVDictionary** options);
+	void Free();
+
+	void StoreHeaders();
+	void SetRegionsOfInterest(x264_picture_t* picture, AVFrame* frame);
+	bool Reconfigure(const x264_param_t& param);
+
+};
+
+#endif
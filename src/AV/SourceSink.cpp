@@ -59,13 +59,32 @@ void BaseSink::ConnectBaseSource(BaseSource* source, int priority) {
 }
 
 int64_t VideoSource::CalculateNextVideoTimestamp() {
+	// The highest priority sink that wants frames decides. If there are multiple sinks with that priority
+	// (e.g. several recording sessions sharing one input), the earliest timestamp wins. Since SINK_TIMESTAMP_ASAP is
+	// the lowest possible timestamp, this works for that case as well.
 	SharedLock lock(&m_shared_data);
+	int64_t next_timestamp = SINK_TIMESTAMP_NONE;
+	int priority = 0;
 	for(SinkData &s : lock->m_sinks) {
+		if(next_timestamp != SINK_TIMESTAMP_NONE && s.priority != priority)
+			break;
 		int64_t timestamp = static_cast<VideoSink*>(s.sink)->GetNextVideoTimestamp();
-		if(timestamp != SINK_TIMESTAMP_NONE)
-			return timestamp;
+		if(timestamp != SINK_TIMESTAMP_NONE && (next_timestamp == SINK_TIMESTAMP_NONE || timestamp < next_timestamp)) {
+			next_timestamp = timestamp;
+			priority = s.priority;
+		}
+	}
+	return next_timestamp;
+}
+
+unsigned int VideoSource::CalculateVideoFocusFlags() {
+	// every sink gets the same information, so just combine the flags of all sinks
+	SharedLock lock(&m_shared_data);
+	unsigned int flags = 0;
+	for(SinkData &s : lock->m_sinks) {
+		flags |= static_cast<VideoSink*>(s.sink)->GetVideoFocusFlags();
 	}
-	return SINK_TIMESTAMP_NONE;
+	return flags;
 }
 
 void VideoSource::PushVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) {
@@ -82,6 +101,13 @@ void VideoSource::PushVideoPing(int64_t timestamp) {
 	}
 }
 
+void VideoSource::PushVideoFocus(const VideoFocus& focus) {
+	SharedLock lock(&m_shared_data);
+	for(SinkData &s : lock->m_sinks) {
+		static_cast<VideoSink*>(s.sink)->ReadVideoFocus(focus);
+	}
+}
+
 void AudioSource::PushAudioSamples(unsigned int channels, unsigned int sample_rate, AVSampleFormat format, unsigned int sample_count, const uint8_t* data, int64_t timestamp) {
 	SharedLock lock(&m_shared_data);
 	for(SinkData &s : lock->m_sinks) {
@@ -31,6 +31,18 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #define SINK_TIMESTAMP_NONE  ((int64_t) 0x8000000000000000ull)  // the sink doesn't want any new frames at the moment
 #define SINK_TIMESTAMP_ASAP  ((int64_t) 0x8000000000000001ull)  // the sink wants a new frame as soon as possible
 
+#define VIDEO_FOCUS_CURSOR  0x1  // the sink wants to know the position of the cursor
+#define VIDEO_FOCUS_WINDOW  0x2  // the sink wants to know the position of the active window
+
+// The parts of a video frame that the viewer is most likely looking at, in pixels relative to the frame.
+// Sources send this right before the frame it belongs to, but only if a sink asked for it.
+struct VideoFocus {
+	bool m_has_cursor;
+	int m_cursor_x, m_cursor_y; // the hotspot of the cursor
+	bool m_has_window;
+	int m_window_x1, m_window_y1, m_window_x2, m_window_y2; // the active window (may extend beyond the frame)
+};
+
 class BaseSource;
 class BaseSink;
 
@@ -72,8 +84,10 @@ class VideoSource : private BaseSource {
 protected:
 	VideoSource() {}
 	int64_t CalculateNextVideoTimestamp();
+	unsigned int CalculateVideoFocusFlags();
 	void PushVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp);
 	void PushVideoPing(int64_t timestamp);
+	void PushVideoFocus(const VideoFocus& focus);
 };
 
 class VideoSink : private BaseSink {
@@ -84,8 +98,10 @@ public:
 	inline void ConnectVideoSource(VideoSource* source, int priority = 0) { ConnectBaseSource(source, priority); }
 public:
 	virtual int64_t GetNextVideoTimestamp() { return SINK_TIMESTAMP_NONE; }
+	virtual unsigned int GetVideoFocusFlags() { return 0; }
 	virtual void ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) = 0;
 	virtual void ReadVideoPing(int64_t timestamp) {}
+	virtual void ReadVideoFocus(const VideoFocus& focus) {}
 };
 
 class AudioSource : private BaseSource {
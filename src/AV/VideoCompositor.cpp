@@ -0,0 +1,311 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "VideoCompositor.h"
+
+#include "Logger.h"
+#include "CPUFeatures.h"
+
+#include "VideoCompositor_Blend.h"
+
+static void BlendPlane(unsigned int w, unsigned int h, const uint8_t* in_data, int in_stride, uint8_t* out_data, int out_stride, unsigned int alpha) {
+	if(alpha == 0)
+		return;
+	if(alpha >= 256) {
+		for(unsigned int j = 0; j < h; ++j) {
+			memcpy(out_data + out_stride * (int) j, in_data + in_stride * (int) j, w);
+		}
+		return;
+	}
+#if SSR_USE_X86_ASM
+	if(CPUFeatures::HasMMX() && CPUFeatures::HasSSE() && CPUFeatures::HasSSE2()) {
+		Blend_Plane_SSE2(w, h, in_data, in_stride, out_data, out_stride, alpha);
+		return;
+	}
+#endif
+	Blend_Plane_Fallback(w, h, in_data, in_stride, out_data, out_stride, alpha);
+}
+
+VideoCompositor::Layer::Layer(VideoCompositor* compositor, unsigned int index) {
+	m_compositor = compositor;
+	m_index = index;
+}
+
+VideoCompositor::Layer::~Layer() {
+	ConnectVideoSource(NULL);
+}
+
+int64_t VideoCompositor::Layer::GetNextVideoTimestamp() {
+	return m_compositor->LayerGetNextVideoTimestamp(m_index);
+}
+
+unsigned int VideoCompositor::Layer::GetVideoFocusFlags() {
+	return m_compositor->LayerGetVideoFocusFlags(m_index);
+}
+
+void VideoCompositor::Layer::ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) {
+	m_compositor->LayerReadVideoFrame(m_index, width, height, data, stride, format, colorspace, timestamp);
+}
+
+void VideoCompositor::Layer::ReadVideoPing(int64_t timestamp) {
+	m_compositor->LayerReadVideoPing(m_index, timestamp);
+}
+
+void VideoCompositor::Layer::ReadVideoFocus(const VideoFocus& focus) {
+	m_compositor->LayerReadVideoFocus(m_index, focus);
+}
+
+VideoCompositor::VideoCompositor(unsigned int width, unsigned int height) {
+
+	m_width = width / 2 * 2;
+	m_height = height / 2 * 2;
+
+	if(m_width == 0 || m_height == 0) {
+		Logger::LogError("[VideoCompositor::VideoCompositor] " + Logger::tr("Error: Width or height is zero!"));
+		throw CompositorException();
+	}
+
+	SharedLock lock(&m_shared_data);
+	lock->m_canvas_strides[0] = grow_align16(m_width);
+	lock->m_canvas_strides[1] = grow_align16(m_width / 2);
+	lock->m_canvas_strides[2] = grow_align16(m_width / 2);
+	lock->m_canvas[0].Alloc(lock->m_canvas_strides[0] * m_height);
+	lock->m_canvas[1].Alloc(lock->m_canvas_strides[1] * m_height / 2);
+	lock->m_canvas[2].Alloc(lock->m_canvas_strides[2] * m_height / 2);
+	lock->m_last_timestamp = std::numeric_limits<int64_t>::min();
+	lock->m_stats_frames = 0;
+	lock->m_stats_conversions = 0;
+	lock->m_stats_partial_frames = 0;
+	lock->m_stats_time_convert = 0;
+	lock->m_stats_time_composite = 0;
+
+}
+
+VideoCompositor::~VideoCompositor() {
+
+	// disconnect all layers
+	m_layers.clear();
+
+	// report the compositing cost
+	SharedLock lock(&m_shared_data);
+	if(lock->m_stats_frames != 0) {
+		Logger::LogInfo("[VideoCompositor::~VideoCompositor] " + Logger::tr("Compositor: %1 frames (%2 partially recomposited), %3 layer conversions, %4 ms per frame.")
+						.arg(lock->m_stats_frames).arg(lock->m_stats_partial_frames).arg(lock->m_stats_conversions)
+						.arg((double) (lock->m_stats_time_convert + lock->m_stats_time_composite) * 1.0e-3 / (double) lock->m_stats_frames, 0, 'f', 2));
+	}
+
+}
+
+unsigned int VideoCompositor::AddLayer(int x, int y, unsigned int width, unsigned int height, double alpha) {
+	SharedLock lock(&m_shared_data);
+	unsigned int index = lock->m_layers.size();
+
+	std::unique_ptr<LayerData> layer(new LayerData());
+	if(index == 0) {
+		layer->m_x = 0;
+		layer->m_y = 0;
+		layer->m_width = m_width;
+		layer->m_height = m_height;
+		layer->m_alpha = 256;
+	} else {
+		layer->m_x = clamp(x, 0, (int) m_width) / 2 * 2;
+		layer->m_y = clamp(y, 0, (int) m_height) / 2 * 2;
+		layer->m_width = std::max(2u, std::min(width, (unsigned int) SSR_MAX_IMAGE_SIZE) / 2 * 2);
+		layer->m_height = std::max(2u, std::min(height, (unsigned int) SSR_MAX_IMAGE_SIZE) / 2 * 2);
+		layer->m_alpha = lrint(clamp(alpha, 0.0, 1.0) * 256.0);
+	}
+	layer->m_has_frame = false;
+	layer->m_changed = false;
+	layer->m_source_width = 0;
+	layer->m_source_height = 0;
+	layer->m_strides[0] = grow_align16(layer->m_width);
+	layer->m_strides[1] = grow_align16(layer->m_width / 2);
+	layer->m_strides[2] = grow_align16(layer->m_width / 2);
+	layer->m_planes[0].Alloc(layer->m_strides[0] * layer->m_height);
+	layer->m_planes[1].Alloc(layer->m_strides[1] * layer->m_height / 2);
+	layer->m_planes[2].Alloc(layer->m_strides[2] * layer->m_height / 2);
+	lock->m_layers.push_back(std::move(layer));
+
+	m_layers.emplace_back(new Layer(this, index));
+	return index;
+}
+
+void VideoCompositor::ConnectLayerSource(unsigned int layer, VideoSource* source, int priority) {
+	assert(layer < m_layers.size());
+	m_layers[layer]->ConnectVideoSource(source, priority);
+}
+
+double VideoCompositor::GetCompositingCost() {
+	SharedLock lock(&m_shared_data);
+	if(lock->m_stats_frames == 0)
+		return 0.0;
+	return (double) (lock->m_stats_time_convert + lock->m_stats_time_composite) / (double) lock->m_stats_frames;
+}
+
+void VideoCompositor::ConvertLayer(LayerData* layer, unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace) {
+	uint8_t *planes[3] = {layer->m_planes[0].GetData(), layer->m_planes[1].GetData(), layer->m_planes[2].GetData()};
+	layer->m_fast_scaler.Scale(width, height, format, colorspace, data, stride,
+							   layer->m_width, layer->m_height, AV_PIX_FMT_YUV420P, SWS_CS_ITU709, planes, layer->m_strides);
+	layer->m_source_width = width;
+	layer->m_source_height = height;
+	layer->m_has_frame = true;
+	layer->m_changed = true;
+}
+
+// Redraws one rectangle of the canvas. The coordinates should be even.
+void VideoCompositor::CompositeRegion(SharedData* lock, unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2) {
+
+	// draw the background
+	LayerData *background = lock->m_layers[0].get();
+	for(unsigned int p = 0; p < 3; ++p) {
+		unsigned int shift = (p == 0)? 0 : 1;
+		unsigned int px = x1 >> shift, py = y1 >> shift, pw = (x2 - x1) >> shift, ph = (y2 - y1) >> shift;
+		uint8_t *out = lock->m_canvas[p].GetData() + lock->m_canvas_strides[p] * py + px;
+		if(background->m_has_frame) {
+			BlendPlane(pw, ph, background->m_planes[p].GetData() + background->m_strides[p] * py + px, background->m_strides[p], out, lock->m_canvas_strides[p], 256);
+		} else {
+			for(unsigned int j = 0; j < ph; ++j) {
+				memset(out + lock->m_canvas_strides[p] * j, (p == 0)? 16 : 128, pw);
+			}
+		}
+	}
+
+	// draw the other layers on top of it
+	for(size_t i = 1; i < lock->m_layers.size(); ++i) {
+		LayerData *layer = lock->m_layers[i].get();
+		if(!layer->m_has_frame)
+			continue;
+		unsigned int lx1 = std::max(x1, layer->m_x), ly1 = std::max(y1, layer->m_y);
+		unsigned int lx2 = std::min(x2, std::min(m_width, layer->m_x + layer->m_width)), ly2 = std::min(y2, std::min(m_height, layer->m_y + layer->m_height));
+		if(lx1 >= lx2 || ly1 >= ly2)
+			continue;
+		for(unsigned int p = 0; p < 3; ++p) {
+			unsigned int shift = (p == 0)? 0 : 1;
+			unsigned int px = lx1 >> shift, py = ly1 >> shift, pw = (lx2 - lx1) >> shift, ph = (ly2 - ly1) >> shift;
+			unsigned int sx = (lx1 - layer->m_x) >> shift, sy = (ly1 - layer->m_y) >> shift;
+			BlendPlane(pw, ph, layer->m_planes[p].GetData() + layer->m_strides[p] * sy + sx, layer->m_strides[p],
+					   lock->m_canvas[p].GetData() + lock->m_canvas_strides[p] * py + px, lock->m_canvas_strides[p], layer->m_alpha);
+		}
+	}
+
+}
+
+// Recomposites the parts of the canvas that have changed and sends the result to the sinks.
+void VideoCompositor::PushCanvas(SharedData* lock, int64_t timestamp) {
+
+	int64_t t1 = hrt_time_micro();
+	if(lock->m_layers[0]->m_changed) {
+		CompositeRegion(lock, 0, 0, m_width, m_height);
+	} else {
+		for(size_t i = 1; i < lock->m_layers.size(); ++i) {
+			LayerData *layer = lock->m_layers[i].get();
+			if(layer->m_changed) {
+				CompositeRegion(lock, std::min(m_width, layer->m_x), std::min(m_height, layer->m_y),
+								std::min(m_width, layer->m_x + layer->m_width), std::min(m_height, layer->m_y + layer->m_height));
+			}
+		}
+		++lock->m_stats_partial_frames;
+	}
+	for(auto &layer : lock->m_layers) {
+		layer->m_changed = false;
+	}
+	lock->m_stats_time_composite += hrt_time_micro() - t1;
+	++lock->m_stats_frames;
+
+	// timestamps can come from different sources, so they could be out of order
+	lock->m_last_timestamp = std::max(lock->m_last_timestamp, timestamp);
+
+	const uint8_t *data[3] = {lock->m_canvas[0].GetData(), lock->m_canvas[1].GetData(), lock->m_canvas[2].GetData()};
+	PushVideoFrame(m_width, m_height, data, lock->m_canvas_strides, AV_PIX_FMT_YUV420P, SWS_CS_ITU709, lock->m_last_timestamp);
+
+}
+
+bool VideoCompositor::SinkWantsFrame(int64_t timestamp) {
+	int64_t next_timestamp = CalculateNextVideoTimestamp();
+	if(next_timestamp == SINK_TIMESTAMP_NONE)
+		return false;
+	return (next_timestamp == SINK_TIMESTAMP_ASAP || timestamp >= next_timestamp);
+}
+
+int64_t VideoCompositor::LayerGetNextVideoTimestamp(unsigned int index) {
+	int64_t next_timestamp = CalculateNextVideoTimestamp();
+	if(index == 0 || next_timestamp == SINK_TIMESTAMP_NONE)
+		return next_timestamp;
+	return SINK_TIMESTAMP_ASAP; // the other layers are usually smaller and slower, so we take every frame
+}
+
+unsigned int VideoCompositor::LayerGetVideoFocusFlags(unsigned int index) {
+	return (index == 0)? CalculateVideoFocusFlags() : 0;
+}
+
+void VideoCompositor::LayerReadVideoFrame(unsigned int index, unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) {
+	SharedLock lock(&m_shared_data);
+
+	// convert the frame, this is only done when the source has changed
+	int64_t t1 = hrt_time_micro();
+	ConvertLayer(lock->m_layers[index].get(), width, height, data, stride, format, colorspace);
+	lock->m_stats_time_convert += hrt_time_micro() - t1;
+	++lock->m_stats_conversions;
+
+	// the background decides the frame rate, the other layers only trigger a frame if the background is static
+	if(index == 0 || SinkWantsFrame(timestamp))
+		PushCanvas(lock.get(), timestamp);
+
+}
+
+void VideoCompositor::LayerReadVideoPing(unsigned int index, int64_t timestamp) {
+	if(index != 0)
+		return;
+	SharedLock lock(&m_shared_data);
+	bool changed = false;
+	for(auto &layer : lock->m_layers) {
+		changed = changed || layer->m_changed;
+	}
+	if(changed && SinkWantsFrame(timestamp)) {
+		PushCanvas(lock.get(), timestamp);
+	} else {
+		PushVideoPing(timestamp);
+	}
+}
+
+void VideoCompositor::LayerReadVideoFocus(unsigned int index, const VideoFocus& focus) {
+	if(index != 0)
+		return;
+	unsigned int source_width, source_height;
+	{
+		SharedLock lock(&m_shared_data);
+		source_width = lock->m_layers[0]->m_source_width;
+		source_height = lock->m_layers[0]->m_source_height;
+	}
+	if(source_width == 0 || source_height == 0) {
+		PushVideoFocus(focus);
+		return;
+	}
+
+	// translate the coordinates to the canvas
+	VideoFocus scaled = focus;
+	scaled.m_cursor_x = (int64_t) focus.m_cursor_x * (int64_t) m_width / (int64_t) source_width;
+	scaled.m_cursor_y = (int64_t) focus.m_cursor_y * (int64_t) m_height / (int64_t) source_height;
+	scaled.m_window_x1 = (int64_t) focus.m_window_x1 * (int64_t) m_width / (int64_t) source_width;
+	scaled.m_window_y1 = (int64_t) focus.m_window_y1 * (int64_t) m_height / (int64_t) source_height;
+	scaled.m_window_x2 = (int64_t) focus.m_window_x2 * (int64_t) m_width / (int64_t) source_width;
+	scaled.m_window_y2 = (int64_t) focus.m_window_y2 * (int64_t) m_height / (int64_t) source_height;
+	PushVideoFocus(scaled);
+
+}
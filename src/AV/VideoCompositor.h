@@ -0,0 +1,107 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "SourceSink.h"
+#include "MutexDataPair.h"
+#include "FastScaler.h"
+#include "TempBuffer.h"
+
+// Combines the frames of several video sources into one canvas, e.g. a screen capture with a webcam in the corner.
+// Layer 0 is the background, it always fills the entire canvas and determines when new frames are sent. The other layers
+// are drawn on top of it, in order, with their own position, size and alpha. Every layer is converted to YUV420 when a new
+// frame arrives, and blending is done in the YUV domain, so static layers cost nothing until their source changes.
+// Only the parts of the canvas that are covered by changed layers are recomposited.
+class VideoCompositor : public VideoSource {
+
+private:
+	class Layer : public VideoSink {
+	private:
+		VideoCompositor *m_compositor;
+		unsigned int m_index;
+	public:
+		Layer(VideoCompositor* compositor, unsigned int index);
+		~Layer();
+	public: // internal
+		virtual int64_t GetNextVideoTimestamp() override;
+		virtual unsigned int GetVideoFocusFlags() override;
+		virtual void ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) override;
+		virtual void ReadVideoPing(int64_t timestamp) override;
+		virtual void ReadVideoFocus(const VideoFocus& focus) override;
+	};
+
+	struct LayerData {
+		unsigned int m_x, m_y, m_width, m_height; // position and size in the canvas
+		unsigned int m_alpha; // 0-256
+		bool m_has_frame, m_changed;
+		unsigned int m_source_width, m_source_height;
+		FastScaler m_fast_scaler;
+		TempBuffer<uint8_t> m_planes[3];
+		int m_strides[3];
+	};
+
+	struct SharedData {
+		std::vector<std::unique_ptr<LayerData> > m_layers;
+		TempBuffer<uint8_t> m_canvas[3];
+		int m_canvas_strides[3];
+		int64_t m_last_timestamp;
+		uint64_t m_stats_frames, m_stats_conversions, m_stats_partial_frames;
+		int64_t m_stats_time_convert, m_stats_time_composite;
+	};
+	typedef MutexDataPair<SharedData>::Lock SharedLock;
+
+private:
+	unsigned int m_width, m_height;
+
+	std::vector<std::unique_ptr<Layer> > m_layers;
+
+	MutexDataPair<SharedData> m_shared_data;
+
+public:
+	VideoCompositor(unsigned int width, unsigned int height);
+	~VideoCompositor();
+
+	// Adds a layer and returns its index. The first layer is the background, its position and size are ignored.
+	// The position and size are rounded down to even numbers. The alpha should be between 0 (invisible) and 1 (opaque).
+	// This should only be called before any sources are connected.
+	unsigned int AddLayer(int x, int y, unsigned int width, unsigned int height, double alpha);
+
+	// Connects a source to a layer.
+	// This function is NOT thread-safe, it follows the same rules as ConnectVideoSource.
+	void ConnectLayerSource(unsigned int layer, VideoSource* source, int priority = 0);
+
+	// Returns the average time needed to produce one frame (in microseconds), including the conversion of changed layers.
+	// This function is thread-safe.
+	double GetCompositingCost();
+
+private:
+	void ConvertLayer(LayerData* layer, unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace);
+	void CompositeRegion(SharedData* lock, unsigned int x1, unsigned int y1, unsigned int x2, unsigned int y2);
+	void PushCanvas(SharedData* lock, int64_t timestamp);
+	bool SinkWantsFrame(int64_t timestamp);
+
+	int64_t LayerGetNextVideoTimestamp(unsigned int index);
+	unsigned int LayerGetVideoFocusFlags(unsigned int index);
+	void LayerReadVideoFrame(unsigned int index, unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp);
+	void LayerReadVideoPing(unsigned int index, int64_t timestamp);
+	void LayerReadVideoFocus(unsigned int index, const VideoFocus& focus);
+
+};
@@ -0,0 +1,39 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "VideoCompositor_Blend.h"
+
+/*
+==== Fallback Plane Blender ====
+
+Blends one plane of an image on top of another plane with a constant alpha between 0 and 256:
+out = (in * alpha + out * (256 - alpha) + 128) / 256
+This works for Y, U and V planes alike, so the blending can be done in the YUV domain without converting back to RGB.
+*/
+
+void Blend_Plane_Fallback(unsigned int w, unsigned int h, const uint8_t* in_data, int in_stride, uint8_t* out_data, int out_stride, unsigned int alpha) {
+	unsigned int inv_alpha = 256 - alpha;
+	for(unsigned int j = 0; j < h; ++j) {
+		const uint8_t *in = in_data + in_stride * (int) j;
+		uint8_t *out = out_data + out_stride * (int) j;
+		for(unsigned int i = 0; i < w; ++i) {
+			out[i] = (in[i] * alpha + out[i] * inv_alpha + 128) >> 8;
+		}
+	}
+}
@@ -0,0 +1,106 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "VideoCropper.h"
+
+static unsigned int GetPackedPixelSize(AVPixelFormat format) {
+	switch(format) {
+		case AV_PIX_FMT_BGRA:
+		case AV_PIX_FMT_RGBA:
+		case AV_PIX_FMT_ABGR:
+		case AV_PIX_FMT_ARGB: return 4;
+		case AV_PIX_FMT_BGR24:
+		case AV_PIX_FMT_RGB24: return 3;
+		case AV_PIX_FMT_RGB565:
+		case AV_PIX_FMT_RGB555: return 2;
+		default: return 0;
+	}
+}
+
+VideoCropper::VideoCropper(unsigned int x, unsigned int y, unsigned int width, unsigned int height) {
+	SetRectangle(x, y, width, height);
+}
+
+VideoCropper::~VideoCropper() {
+	ConnectVideoSource(NULL);
+}
+
+void VideoCropper::SetRectangle(unsigned int x, unsigned int y, unsigned int width, unsigned int height) {
+	SharedLock lock(&m_shared_data);
+	lock->m_x = x;
+	lock->m_y = y;
+	lock->m_width = width;
+	lock->m_height = height;
+}
+
+int64_t VideoCropper::GetNextVideoTimestamp() {
+	return CalculateNextVideoTimestamp();
+}
+
+unsigned int VideoCropper::GetVideoFocusFlags() {
+	return CalculateVideoFocusFlags();
+}
+
+void VideoCropper::ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) {
+
+	// we can only crop packed formats
+	unsigned int pixel_size = GetPackedPixelSize(format);
+	if(pixel_size == 0) {
+		PushVideoFrame(width, height, data, stride, format, colorspace, timestamp);
+		return;
+	}
+
+	// clip the rectangle to the frame
+	SharedData rect;
+	{
+		SharedLock lock(&m_shared_data);
+		rect = *lock.get();
+	}
+	unsigned int x = std::min(rect.m_x, width), y = std::min(rect.m_y, height);
+	unsigned int w = std::min(rect.m_width, width - x), h = std::min(rect.m_height, height - y);
+	if(w == 0 || h == 0)
+		return;
+
+	// adjust the pointer
+	const uint8_t *cropped_data[1] = {data[0] + (ptrdiff_t) y * (ptrdiff_t) stride[0] + (ptrdiff_t) (x * pixel_size)};
+	PushVideoFrame(w, h, cropped_data, stride, format, colorspace, timestamp);
+
+}
+
+void VideoCropper::ReadVideoPing(int64_t timestamp) {
+	PushVideoPing(timestamp);
+}
+
+void VideoCropper::ReadVideoFocus(const VideoFocus& focus) {
+	// translate the coordinates to the cropped frame
+	int x, y;
+	{
+		SharedLock lock(&m_shared_data);
+		x = lock->m_x;
+		y = lock->m_y;
+	}
+	VideoFocus cropped = focus;
+	cropped.m_cursor_x -= x;
+	cropped.m_cursor_y -= y;
+	cropped.m_window_x1 -= x;
+	cropped.m_window_y1 -= y;
+	cropped.m_window_x2 -= x;
+	cropped.m_window_y2 -= y;
+	PushVideoFocus(cropped);
+}
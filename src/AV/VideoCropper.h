@@ -0,0 +1,55 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "SourceSink.h"
+#include "MutexDataPair.h"
+
+// Passes a rectangular part of the video frames from a source to its sinks. This is used to share one capture input
+// between multiple recordings of different regions. No data is copied, only the pointers are adjusted, so this only works
+// for packed pixel formats. Frames in other formats are passed through unchanged.
+class VideoCropper : public VideoSource, public VideoSink {
+
+private:
+	struct SharedData {
+		unsigned int m_x, m_y, m_width, m_height;
+	};
+	typedef MutexDataPair<SharedData>::Lock SharedLock;
+
+private:
+	MutexDataPair<SharedData> m_shared_data;
+
+public:
+	VideoCropper(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+	~VideoCropper();
+
+	// Changes the rectangle (relative to the frames of the source). The next frame uses the new rectangle.
+	// This function is thread-safe.
+	void SetRectangle(unsigned int x, unsigned int y, unsigned int width, unsigned int height);
+
+public: // internal
+	virtual int64_t GetNextVideoTimestamp() override;
+	virtual unsigned int GetVideoFocusFlags() override;
+	virtual void ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) override;
+	virtual void ReadVideoPing(int64_t timestamp) override;
+	virtual void ReadVideoFocus(const VideoFocus& focus) override;
+
+};
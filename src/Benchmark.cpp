@@ -20,7 +20,10 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Benchmark.h"
 
 #include "AVWrapper.h"
+#include "BenchmarkReport.h"
 #include "CPUFeatures.h"
+#include "ConversionPipeline.h"
+#include "FastScaler.h"
 #include "FastScaler_Convert.h"
 #include "FastScaler_Scale.h"
 #include "Logger.h"
@@ -93,7 +96,22 @@ void PlaneWrapper(unsigned int w, unsigned int h, const uint8_t* in_data, int in
 	T(w, h, in_data, in_stride, out_data[0], out_stride[0]);
 }
 
-void BenchmarkScale(unsigned int in_w, unsigned int in_h, unsigned int out_w, unsigned int out_h) {
+// Calls a function 'runs' times per repetition and returns the average time per call (in microseconds) for each repetition.
+template<typename F>
+std::vector<double> BenchmarkRepeat(unsigned int repetitions, unsigned int runs, F func) {
+	std::vector<double> samples;
+	for(unsigned int r = 0; r < repetitions; ++r) {
+		int64_t t1 = hrt_time_micro();
+		for(unsigned int i = 0; i < runs; ++i) {
+			func(i);
+		}
+		int64_t t2 = hrt_time_micro();
+		samples.push_back((double) (t2 - t1) / (double) runs);
+	}
+	return samples;
+}
+
+void BenchmarkScale(BenchmarkReport* report, unsigned int repetitions, unsigned int in_w, unsigned int in_h, unsigned int out_w, unsigned int out_h) {
 
 	std::mt19937 rng(12345);
 #if SSR_USE_X86_ASM
@@ -103,7 +121,7 @@ void BenchmarkScale(unsigned int in_w, unsigned int in_h, unsigned int out_w, un
 	// the queue needs to use enough memory to make sure that the CPU cache is flushed
 	unsigned int pixels = std::max(in_w * in_h, out_w * out_h);
 	unsigned int queue_size = 1 + 20000000 / pixels;
-	unsigned int run_size = queue_size * 20;
+	unsigned int run_size = std::max(queue_size, queue_size * 20 / repetitions);
 
 	// create queue
 	std::vector<std::unique_ptr<ImageGeneric> > queue_in(queue_size);
@@ -114,7 +132,7 @@ void BenchmarkScale(unsigned int in_w, unsigned int in_h, unsigned int out_w, un
 	}
 
 	// run test
-	unsigned int time_swscale = 0, time_fallback = 0, time_ssse3 = 0;
+	std::vector<double> time_swscale, time_fallback, time_ssse3;
 	{
 		SwsContext *sws = sws_getCachedContext(NULL,
 											   in_w, in_h, AV_PIX_FMT_BGRA,
@@ -128,49 +146,49 @@ void BenchmarkScale(unsigned int in_w, unsigned int in_h, unsigned int out_w, un
 								 sws_getCoefficients(SWS_CS_ITU709), 0,
 								 sws_getCoefficients(SWS_CS_DEFAULT), 0,
 								 0, 1 << 16, 1 << 16);
-		int64_t t1 = hrt_time_micro();
-		for(unsigned int i = 0; i < run_size / 2; ++i) {
+		time_swscale = BenchmarkRepeat(repetitions, std::max(1u, run_size / 2), [&](unsigned int i) {
 			unsigned int ii = i % queue_size;
 			sws_scale(sws, queue_in[ii]->m_data.data(), queue_in[ii]->m_stride.data(), 0, in_h, queue_out[ii]->m_data.data(), queue_out[ii]->m_stride.data());
-		}
-		int64_t t2 = hrt_time_micro();
-		time_swscale = (t2 - t1) / (run_size / 2);
-	}
-	{
-		int64_t t1 = hrt_time_micro();
-		for(unsigned int i = 0; i < run_size; ++i) {
-			unsigned int ii = i % queue_size;
-			Scale_BGRA_Fallback(in_w, in_h, queue_in[ii]->m_data[0], queue_in[ii]->m_stride[0],
-								out_w, out_h, queue_out[ii]->m_data[0], queue_out[ii]->m_stride[0]);
-		}
-		int64_t t2 = hrt_time_micro();
-		time_fallback = (t2 - t1) / run_size;
+		});
+		sws_freeContext(sws);
 	}
+	time_fallback = BenchmarkRepeat(repetitions, run_size, [&](unsigned int i) {
+		unsigned int ii = i % queue_size;
+		Scale_BGRA_Fallback(in_w, in_h, queue_in[ii]->m_data[0], queue_in[ii]->m_stride[0],
+							out_w, out_h, queue_out[ii]->m_data[0], queue_out[ii]->m_stride[0]);
+	});
 #if SSR_USE_X86_ASM
 	if(use_ssse3) {
-		int64_t t1 = hrt_time_micro();
-		for(unsigned int i = 0; i < run_size; ++i) {
+		time_ssse3 = BenchmarkRepeat(repetitions, run_size, [&](unsigned int i) {
 			unsigned int ii = i % queue_size;
 			Scale_BGRA_SSSE3(in_w, in_h, queue_in[ii]->m_data[0], queue_in[ii]->m_stride[0],
 							 out_w, out_h, queue_out[ii]->m_data[0], queue_out[ii]->m_stride[0]);
-		}
-		int64_t t2 = hrt_time_micro();
-		time_ssse3 = (t2 - t1) / run_size;
+		});
 	}
 #endif
 
 	// print result
 	QString in_size = QString("%1x%2").arg(in_w).arg(in_h);
 	QString out_size = QString("%1x%2").arg(out_w).arg(out_h);
+	double median_swscale = BenchmarkReport::Summarize(time_swscale).m_median;
+	double median_fallback = BenchmarkReport::Summarize(time_fallback).m_median;
+	double median_ssse3 = BenchmarkReport::Summarize(time_ssse3).m_median;
 	Logger::LogInfo("[BenchmarkScale] " + Logger::tr("BGRA %1 to BGRA %2  |  SWScale %3 us  |  Fallback %4 us (%5%)  |  SSSE3 %6 us (%7%)")
 					.arg(in_size, 9).arg(out_size, 9)
-					.arg(time_swscale, 6)
-					.arg(time_fallback, 6).arg(100 * time_fallback / time_swscale, 3)
-					.arg(time_ssse3, 6).arg(100 * time_ssse3 / time_fallback, 3));
+					.arg(median_swscale, 8, 'f', 1)
+					.arg(median_fallback, 8, 'f', 1).arg(BenchmarkReport::SafePercentage(median_fallback, median_swscale), 3, 'f', 0)
+					.arg(median_ssse3, 8, 'f', 1).arg(BenchmarkReport::SafePercentage(median_ssse3, median_fallback), 3, 'f', 0));
+
+	QString name = "scale/BGRA_" + in_size + "_to_BGRA_" + out_size;
+	report->AddResult(name + "/swscale", "us", false, time_swscale);
+	report->AddResult(name + "/fallback", "us", false, time_fallback);
+	if(!time_ssse3.empty())
+		report->AddResult(name + "/ssse3", "us", false, time_ssse3);
 
 }
 
-void BenchmarkConvert(unsigned int w, unsigned int h, AVPixelFormat in_format, AVPixelFormat out_format, const QString& in_format_name, const QString& out_format_name, NewImageFunc in_image, NewImageFunc out_image, ConvertFunc fallback
+void BenchmarkConvert(BenchmarkReport* report, unsigned int repetitions, unsigned int w, unsigned int h, AVPixelFormat in_format, AVPixelFormat out_format,
+					  const QString& in_format_name, const QString& out_format_name, NewImageFunc in_image, NewImageFunc out_image, ConvertFunc fallback
 #if SSR_USE_X86_ASM
 , ConvertFunc ssse3
 #endif
@@ -184,7 +202,7 @@ void BenchmarkConvert(unsigned int w, unsigned int h, AVPixelFormat in_format, A
 	// the queue needs to use enough memory to make sure that the CPU cache is flushed
 	unsigned int pixels = w * h;
 	unsigned int queue_size = 1 + 20000000 / pixels;
-	unsigned int run_size = queue_size * 20;
+	unsigned int run_size = std::max(queue_size, queue_size * 20 / repetitions);
 
 	// create queue
 	std::vector<std::unique_ptr<ImageGeneric> > queue_in(queue_size);
@@ -195,81 +213,154 @@ void BenchmarkConvert(unsigned int w, unsigned int h, AVPixelFormat in_format, A
 	}
 
 	// run test
-	unsigned int time_swscale = 0, time_fallback = 0, time_ssse3 = 0;
+	std::vector<double> time_swscale, time_fallback, time_ssse3;
 	{
 		SwsContext *sws = sws_getCachedContext(NULL,
 											   w, h, in_format,
 											   w, h, out_format,
 											   SWS_BILINEAR, NULL, NULL, NULL);
 		if(sws == NULL) {
-			Logger::LogError("[BenchmarkScale] " + Logger::tr("Error: Can't get swscale context!", "Don't translate 'swscale'"));
+			Logger::LogError("[BenchmarkConvert] " + Logger::tr("Error: Can't get swscale context!", "Don't translate 'swscale'"));
 			throw LibavException();
 		}
 		sws_setColorspaceDetails(sws,
 								 sws_getCoefficients(SWS_CS_ITU709), 0,
 								 sws_getCoefficients(SWS_CS_DEFAULT), 0,
 								 0, 1 << 16, 1 << 16);
-		int64_t t1 = hrt_time_micro();
-		for(unsigned int i = 0; i < run_size / 2; ++i) {
+		time_swscale = BenchmarkRepeat(repetitions, std::max(1u, run_size / 2), [&](unsigned int i) {
 			unsigned int ii = i % queue_size;
 			sws_scale(sws, queue_in[ii]->m_data.data(), queue_in[ii]->m_stride.data(), 0, h, queue_out[ii]->m_data.data(), queue_out[ii]->m_stride.data());
-		}
-		int64_t t2 = hrt_time_micro();
-		time_swscale = (t2 - t1) / (run_size / 2);
-	}
-	{
-		int64_t t1 = hrt_time_micro();
-		for(unsigned int i = 0; i < run_size; ++i) {
-			unsigned int ii = i % queue_size;
-			fallback(w, h, queue_in[ii]->m_data[0], queue_in[ii]->m_stride[0], queue_out[ii]->m_data.data(), queue_out[ii]->m_stride.data());
-		}
-		int64_t t2 = hrt_time_micro();
-		time_fallback = (t2 - t1) / run_size;
+		});
+		sws_freeContext(sws);
 	}
+	time_fallback = BenchmarkRepeat(repetitions, run_size, [&](unsigned int i) {
+		unsigned int ii = i % queue_size;
+		fallback(w, h, queue_in[ii]->m_data[0], queue_in[ii]->m_stride[0], queue_out[ii]->m_data.data(), queue_out[ii]->m_stride.data());
+	});
 #if SSR_USE_X86_ASM
 	if(use_ssse3) {
-		int64_t t1 = hrt_time_micro();
-		for(unsigned int i = 0; i < run_size; ++i) {
+		time_ssse3 = BenchmarkRepeat(repetitions, run_size, [&](unsigned int i) {
 			unsigned int ii = i % queue_size;
 			ssse3(w, h, queue_in[ii]->m_data[0], queue_in[ii]->m_stride[0], queue_out[ii]->m_data.data(), queue_out[ii]->m_stride.data());
-		}
-		int64_t t2 = hrt_time_micro();
-		time_ssse3 = (t2 - t1) / run_size;
+		});
 	}
 #endif
 
 	// print result
 	QString size = QString("%1x%2").arg(w).arg(h);
+	double median_swscale = BenchmarkReport::Summarize(time_swscale).m_median;
+	double median_fallback = BenchmarkReport::Summarize(time_fallback).m_median;
+	double median_ssse3 = BenchmarkReport::Summarize(time_ssse3).m_median;
 	Logger::LogInfo("[BenchmarkConvert] " + Logger::tr("%1 %2 to %3 %4  |  SWScale %5 us  |  Fallback %6 us (%7%)  |  SSSE3 %8 us (%9%)")
 					.arg(in_format_name).arg(size, 9).arg(out_format_name).arg(size, 9)
-					.arg(time_swscale, 6)
-					.arg(time_fallback, 6).arg(100 * time_fallback / time_swscale, 3)
-					.arg(time_ssse3, 6).arg(100 * time_ssse3 / time_fallback, 3));
+					.arg(median_swscale, 8, 'f', 1)
+					.arg(median_fallback, 8, 'f', 1).arg(BenchmarkReport::SafePercentage(median_fallback, median_swscale), 3, 'f', 0)
+					.arg(median_ssse3, 8, 'f', 1).arg(BenchmarkReport::SafePercentage(median_ssse3, median_fallback), 3, 'f', 0));
+
+	QString name = "convert/" + in_format_name.trimmed() + "_" + size + "_to_" + out_format_name.trimmed();
+	report->AddResult(name + "/swscale", "us", false, time_swscale);
+	report->AddResult(name + "/fallback", "us", false, time_fallback);
+	if(!time_ssse3.empty())
+		report->AddResult(name + "/ssse3", "us", false, time_ssse3);
+
+}
+
+// Measures how many frames per second can be converted from BGRA to YUV420, either synchronously or with the conversion pipeline.
+// Unlike the other benchmarks, the result includes the overhead of copying the frames and creating the output frames.
+void BenchmarkPipeline(BenchmarkReport* report, unsigned int repetitions, unsigned int w, unsigned int h) {
+
+	std::mt19937 rng(12345);
+
+	// the queue needs to use enough memory to make sure that the CPU cache is flushed
+	unsigned int queue_size = 1 + 20000000 / (w * h);
+	unsigned int run_size = std::max(queue_size, 2 * queue_size * 20 / repetitions);
+
+	// create queue
+	std::vector<std::unique_ptr<ImageGeneric> > queue_in(queue_size);
+	for(unsigned int i = 0; i < queue_size; ++i) {
+		queue_in[i] = NewImageBGRA(w, h, rng);
+	}
+
+	// run test
+	std::vector<std::vector<double> > results;
+	{
+		FastScaler fast_scaler;
+		std::vector<double> samples;
+		for(unsigned int r = 0; r < repetitions; ++r) {
+			int64_t t1 = hrt_time_micro();
+			for(unsigned int i = 0; i < run_size; ++i) {
+				unsigned int ii = i % queue_size;
+				std::unique_ptr<AVFrameWrapper> frame = CreateVideoFrame(w, h, AV_PIX_FMT_YUV420P, NULL);
+				fast_scaler.Scale(w, h, AV_PIX_FMT_BGRA, SWS_CS_ITU709, queue_in[ii]->m_data.data(), queue_in[ii]->m_stride.data(),
+								  w, h, AV_PIX_FMT_YUV420P, SWS_CS_ITU709, frame->GetFrame()->data, frame->GetFrame()->linesize);
+			}
+			int64_t t2 = hrt_time_micro();
+			samples.push_back((double) run_size * 1.0e6 / (double) std::max((int64_t) 1, t2 - t1));
+		}
+		results.push_back(std::move(samples));
+	}
+	for(unsigned int threads = 1; threads <= 4; ++threads) {
+		std::atomic<unsigned int> delivered(0);
+		ConversionPipeline pipeline(threads, threads + 1, w, h, AV_PIX_FMT_YUV420P, SWS_CS_ITU709, [&](ConversionPipeline::Job* job) {
+			if(job->m_frame != NULL)
+				++delivered;
+		});
+		std::vector<double> samples;
+		for(unsigned int r = 0; r < repetitions; ++r) {
+			int64_t t1 = hrt_time_micro();
+			for(unsigned int i = 0; i < run_size; ++i) {
+				unsigned int ii = i % queue_size;
+				pipeline.AddFrame(w, h, queue_in[ii]->m_data.data(), queue_in[ii]->m_stride.data(), AV_PIX_FMT_BGRA, SWS_CS_ITU709, 0, AVFrameHints(),
+								  CreateVideoFrame(w, h, AV_PIX_FMT_YUV420P, NULL), false);
+			}
+			pipeline.Flush();
+			int64_t t2 = hrt_time_micro();
+			samples.push_back((double) run_size * 1.0e6 / (double) std::max((int64_t) 1, t2 - t1));
+		}
+		if(delivered != run_size * repetitions)
+			Logger::LogWarning("[BenchmarkPipeline] " + Logger::tr("Warning: Some frames were lost in the conversion pipeline!"));
+		results.push_back(std::move(samples));
+	}
+
+	// print result
+	QString size = QString("%1x%2").arg(w).arg(h);
+	QString name = "pipeline/BGRA_" + size + "_to_YUV420";
+	for(unsigned int i = 0; i < results.size(); ++i) {
+		double median = BenchmarkReport::Summarize(results[i]).m_median;
+		QString label = (i == 0)? QString("sync") : QString("threads_%1").arg(i);
+		Logger::LogInfo("[BenchmarkPipeline] " + Logger::tr("BGRA %1 to YUV420 %2  |  %3  |  %4 fps (%5%)")
+						.arg(size, 9).arg(size, 9).arg(label, 9)
+						.arg(median, 6, 'f', 1).arg(BenchmarkReport::SafePercentage(median, BenchmarkReport::Summarize(results[0]).m_median), 3, 'f', 0));
+		report->AddResult(name + "/" + label, "fps", true, results[i]);
+	}
 
 }
 
-void Benchmark() {
+void Benchmark(BenchmarkReport* report, unsigned int repetitions) {
 
 	Logger::LogInfo("[Benchmark] " + Logger::tr("Starting scaler benchmark ..."));
-	BenchmarkScale(1920, 1080, 1920, 1080); // direct copy
-	BenchmarkScale(1280, 720, 1920, 1080); // upscaling
-	BenchmarkScale(1920, 1080, 1280, 720); // downscaling
-	BenchmarkScale(1920, 1080, 960, 540); // pure mipmap
-	BenchmarkScale(1920, 1080, 640, 360); // mipmap + downscaling
+	BenchmarkScale(report, repetitions, 1920, 1080, 1920, 1080); // direct copy
+	BenchmarkScale(report, repetitions, 1280, 720, 1920, 1080); // upscaling
+	BenchmarkScale(report, repetitions, 1920, 1080, 1280, 720); // downscaling
+	BenchmarkScale(report, repetitions, 1920, 1080, 960, 540); // pure mipmap
+	BenchmarkScale(report, repetitions, 1920, 1080, 640, 360); // mipmap + downscaling
 
 	Logger::LogInfo("[Benchmark] " + Logger::tr("Starting converter benchmark ..."));
 #if SSR_USE_X86_ASM
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P, "BGRA", "YUV444", NewImageBGRA, NewImageYUV444, Convert_BGRA_YUV444_Fallback           , Convert_BGRA_YUV444_SSSE3           );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV422P, "BGRA", "YUV422", NewImageBGRA, NewImageYUV422, Convert_BGRA_YUV422_Fallback           , Convert_BGRA_YUV422_SSSE3           );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, "BGRA", "YUV420", NewImageBGRA, NewImageYUV420, Convert_BGRA_YUV420_Fallback           , Convert_BGRA_YUV420_SSSE3           );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12   , "BGRA", "NV12  ", NewImageBGRA, NewImageNV12  , Convert_BGRA_NV12_Fallback             , Convert_BGRA_NV12_SSSE3             );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR24  , "BGRA", "BGR   ", NewImageBGRA, NewImageBGR   , PlaneWrapper<Convert_BGRA_BGR_Fallback>, PlaneWrapper<Convert_BGRA_BGR_SSSE3>);
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P, "BGRA", "YUV444", NewImageBGRA, NewImageYUV444, Convert_BGRA_YUV444_Fallback           , Convert_BGRA_YUV444_SSSE3           );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV422P, "BGRA", "YUV422", NewImageBGRA, NewImageYUV422, Convert_BGRA_YUV422_Fallback           , Convert_BGRA_YUV422_SSSE3           );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, "BGRA", "YUV420", NewImageBGRA, NewImageYUV420, Convert_BGRA_YUV420_Fallback           , Convert_BGRA_YUV420_SSSE3           );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12   , "BGRA", "NV12  ", NewImageBGRA, NewImageNV12  , Convert_BGRA_NV12_Fallback             , Convert_BGRA_NV12_SSSE3             );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR24  , "BGRA", "BGR   ", NewImageBGRA, NewImageBGR   , PlaneWrapper<Convert_BGRA_BGR_Fallback>, PlaneWrapper<Convert_BGRA_BGR_SSSE3>);
 #else
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P, "BGRA", "YUV444", NewImageBGRA, NewImageYUV444, Convert_BGRA_YUV444_Fallback           );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV422P, "BGRA", "YUV422", NewImageBGRA, NewImageYUV422, Convert_BGRA_YUV422_Fallback           );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, "BGRA", "YUV420", NewImageBGRA, NewImageYUV420, Convert_BGRA_YUV420_Fallback           );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12   , "BGRA", "NV12  ", NewImageBGRA, NewImageNV12  , Convert_BGRA_NV12_Fallback             );
-	BenchmarkConvert(1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR24  , "BGRA", "BGR   ", NewImageBGRA, NewImageBGR   , PlaneWrapper<Convert_BGRA_BGR_Fallback>);
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV444P, "BGRA", "YUV444", NewImageBGRA, NewImageYUV444, Convert_BGRA_YUV444_Fallback           );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV422P, "BGRA", "YUV422", NewImageBGRA, NewImageYUV422, Convert_BGRA_YUV422_Fallback           );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_YUV420P, "BGRA", "YUV420", NewImageBGRA, NewImageYUV420, Convert_BGRA_YUV420_Fallback           );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_NV12   , "BGRA", "NV12  ", NewImageBGRA, NewImageNV12  , Convert_BGRA_NV12_Fallback             );
+	BenchmarkConvert(report, repetitions, 1920, 1080, AV_PIX_FMT_BGRA, AV_PIX_FMT_BGR24  , "BGRA", "BGR   ", NewImageBGRA, NewImageBGR   , PlaneWrapper<Convert_BGRA_BGR_Fallback>);
 #endif
 
+	Logger::LogInfo("[Benchmark] " + Logger::tr("Starting conversion pipeline benchmark ..."));
+	BenchmarkPipeline(report, repetitions, 3840, 2160);
+
 }
@@ -20,4 +20,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #pragma once
 #include "Global.h"
 
-void Benchmark();
+class BenchmarkReport;
+
+// Runs the scaler and converter benchmarks and adds the results to the report.
+void Benchmark(BenchmarkReport* report, unsigned int repetitions);
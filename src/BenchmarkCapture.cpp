@@ -0,0 +1,310 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BenchmarkCapture.h"
+
+#include "BenchmarkReport.h"
+#include "Logger.h"
+#include "X11Input.h"
+
+class BenchmarkXServerException : public std::exception {
+public:
+	inline virtual const char* what() const throw() override {
+		return "BenchmarkXServerException";
+	}
+};
+
+struct CaptureBenchmarkConfig {
+	unsigned int m_width, m_height, m_depth;
+};
+
+struct CaptureBenchmarkCase {
+	const char *m_name;
+	bool m_use_shm, m_multi_monitor;
+	bool m_record_cursor, m_follow_cursor;
+};
+
+// The cases are sorted such that cases which use the same server options are next to each other, this avoids restarting the server.
+static const CaptureBenchmarkCase CAPTURE_BENCHMARK_CASES[] = {
+	{"shm"                 , true , false, false, false},
+	{"shm+cursor"          , true , false, true , false},
+	{"shm+follow-cursor"   , true , false, true , true },
+	{"noshm"               , false, false, false, false},
+	{"noshm+cursor"        , false, false, true , false},
+	{"shm+multi-monitor"   , true , true , false, false},
+	{"noshm+multi-monitor" , false, true , false, false},
+};
+
+// Time used to let the input thread reach a steady state before measuring.
+static const int64_t CAPTURE_BENCHMARK_WARMUP = 1000000;
+
+// A private X server. The display number is chosen by checking the lock files, the server is killed on destruction.
+class BenchmarkXServer {
+
+private:
+	QProcess m_process;
+	QString m_display_name;
+
+public:
+	BenchmarkXServer(const QString& program, const CaptureBenchmarkConfig& config, bool use_shm, bool multi_monitor) {
+
+		// find a free display
+		unsigned int display = 90;
+		for( ; display < 200; ++display) {
+			if(!QFileInfo(QString("/tmp/.X%1-lock").arg(display)).exists() && !QFileInfo(QString("/tmp/.X11-unix/X%1").arg(display)).exists())
+				break;
+		}
+		m_display_name = QString(":%1").arg(display);
+
+		// The second monitor is half the size of the first one, so the combined screen has a dead space in the bottom right corner.
+		QStringList args;
+		args << m_display_name << "-nolisten" << "tcp" << "-noreset";
+		if(!use_shm)
+			args << "-extension" << "MIT-SHM";
+		if(program.contains("Xephyr")) {
+			args << "-screen" << QString("%1x%2x%3").arg(config.m_width).arg(config.m_height).arg(config.m_depth);
+			if(multi_monitor)
+				args << "+xinerama" << "-screen" << QString("%1x%2x%3").arg(config.m_width / 2).arg(config.m_height / 2).arg(config.m_depth);
+		} else {
+			args << "-screen" << "0" << QString("%1x%2x%3").arg(config.m_width).arg(config.m_height).arg(config.m_depth);
+			if(multi_monitor)
+				args << "+xinerama" << "-screen" << "1" << QString("%1x%2x%3").arg(config.m_width / 2).arg(config.m_height / 2).arg(config.m_depth);
+		}
+
+		m_process.setProcessChannelMode(QProcess::ForwardedChannels);
+		m_process.start(program, args);
+		if(!m_process.waitForStarted(5000)) {
+			Logger::LogError("[BenchmarkXServer::BenchmarkXServer] " + Logger::tr("Error: Can't start X server '%1'!").arg(program));
+			throw BenchmarkXServerException();
+		}
+
+		// wait until the server accepts connections
+		for(unsigned int i = 0; i < 100; ++i) {
+			if(m_process.state() != QProcess::Running)
+				break;
+			Display *test = XOpenDisplay(m_display_name.toLocal8Bit().constData());
+			if(test != NULL) {
+				XCloseDisplay(test);
+				return;
+			}
+			usleep(100000);
+		}
+		Logger::LogError("[BenchmarkXServer::BenchmarkXServer] " + Logger::tr("Error: X server '%1' did not accept connections!").arg(program));
+		Stop();
+		throw BenchmarkXServerException();
+
+	}
+	~BenchmarkXServer() {
+		Stop();
+	}
+
+	inline const QString& GetDisplayName() { return m_display_name; }
+
+	// Returns the CPU time used by the server (in microseconds).
+	int64_t GetCPUTime() {
+#if QT_VERSION >= QT_VERSION_CHECK(5, 3, 0)
+		QFile file(QString("/proc/%1/stat").arg(m_process.processId()));
+#else
+		QFile file(QString("/proc/%1/stat").arg(m_process.pid()));
+#endif
+		if(!file.open(QIODevice::ReadOnly))
+			return 0;
+		QString stat = QString::fromLocal8Bit(file.readAll());
+		// the process name can contain spaces, so skip everything up to the closing parenthesis
+		QStringList fields = stat.mid(stat.lastIndexOf(')') + 2).split(' ');
+		if(fields.size() < 13)
+			return 0;
+		int64_t ticks = fields[11].toLongLong() + fields[12].toLongLong(); // utime + stime
+		return ticks * 1000000 / sysconf(_SC_CLK_TCK);
+	}
+
+private:
+	void Stop() {
+		if(m_process.state() != QProcess::NotRunning) {
+			m_process.terminate();
+			if(!m_process.waitForFinished(5000)) {
+				m_process.kill();
+				m_process.waitForFinished(5000);
+			}
+		}
+	}
+
+};
+
+// Changes the screen content continuously and moves the cursor around, so the capture has realistic work to do.
+class BenchmarkAnimator {
+
+private:
+	Display *m_display;
+	std::thread m_thread;
+	std::atomic<bool> m_should_stop;
+
+public:
+	BenchmarkAnimator(const QString& display_name) {
+		m_display = XOpenDisplay(display_name.toLocal8Bit().constData());
+		if(m_display == NULL) {
+			Logger::LogError("[BenchmarkAnimator::BenchmarkAnimator] " + Logger::tr("Error: Can't open X display!", "Don't translate 'display'"));
+			throw BenchmarkXServerException();
+		}
+		m_should_stop = false;
+		m_thread = std::thread(&BenchmarkAnimator::AnimatorThread, this);
+	}
+	~BenchmarkAnimator() {
+		m_should_stop = true;
+		if(m_thread.joinable())
+			m_thread.join();
+		XCloseDisplay(m_display);
+	}
+
+private:
+	void AnimatorThread() {
+		int screen = DefaultScreen(m_display);
+		Window root = RootWindow(m_display, screen);
+		unsigned int width = DisplayWidth(m_display, screen), height = DisplayHeight(m_display, screen);
+		GC gc = XCreateGC(m_display, root, 0, NULL);
+		std::mt19937 rng(12345);
+		for(unsigned int frame = 0; !m_should_stop; ++frame) {
+			// draw some rectangles, roughly 10% of the screen changes every step
+			for(unsigned int i = 0; i < 10; ++i) {
+				unsigned int w = width / 10, h = height / 10;
+				XSetForeground(m_display, gc, rng() & 0xffffff);
+				XFillRectangle(m_display, root, gc, rng() % (width - w), rng() % (height - h), w, h);
+			}
+			// move the cursor in a circle
+			double angle = (double) frame * 0.02;
+			XWarpPointer(m_display, None, root, 0, 0, 0, 0, width / 2 + lrint(cos(angle) * width / 3), height / 2 + lrint(sin(angle) * height / 3));
+			XSync(m_display, False);
+			usleep(10000);
+		}
+		XFreeGC(m_display, gc);
+	}
+
+};
+
+static std::vector<CaptureBenchmarkConfig> ParseCaptureBenchmarkConfigs(const QString& configs) {
+	std::vector<CaptureBenchmarkConfig> result;
+	for(const QString &config : SplitSkipEmptyParts(configs, ',')) {
+		QStringList parts = config.trimmed().split('x');
+		CaptureBenchmarkConfig c;
+		c.m_width = (parts.size() > 0)? parts[0].toUInt() : 0;
+		c.m_height = (parts.size() > 1)? parts[1].toUInt() : 0;
+		c.m_depth = (parts.size() > 2)? parts[2].toUInt() : 24;
+		if(c.m_width < 64 || c.m_height < 64 || c.m_width > SSR_MAX_IMAGE_SIZE || c.m_height > SSR_MAX_IMAGE_SIZE) {
+			Logger::LogWarning("[BenchmarkCapture] " + Logger::tr("Warning: Ignoring invalid screen configuration '%1'.").arg(config));
+			continue;
+		}
+		result.push_back(c);
+	}
+	return result;
+}
+
+void BenchmarkCapture(BenchmarkReport* report, unsigned int repetitions, const QString& xserver, const QString& configs, unsigned int duration) {
+
+	std::vector<CaptureBenchmarkConfig> config_list = ParseCaptureBenchmarkConfigs(configs);
+
+	// X11Input uses the default display, so we have to change it temporarily
+	QByteArray old_display = qgetenv("DISPLAY");
+
+	for(const CaptureBenchmarkConfig &config : config_list) {
+		std::unique_ptr<BenchmarkXServer> server;
+		bool server_use_shm = false, server_multi_monitor = false;
+		for(const CaptureBenchmarkCase &bcase : CAPTURE_BENCHMARK_CASES) {
+			try {
+
+				// start a new server if needed
+				if(server == NULL || server_use_shm != bcase.m_use_shm || server_multi_monitor != bcase.m_multi_monitor) {
+					server.reset();
+					server.reset(new BenchmarkXServer(xserver, config, bcase.m_use_shm, bcase.m_multi_monitor));
+					server_use_shm = bcase.m_use_shm;
+					server_multi_monitor = bcase.m_multi_monitor;
+				}
+				qputenv("DISPLAY", server->GetDisplayName().toLocal8Bit());
+
+				// the multi-monitor case records the bounding box of both screens, the follow-cursor case records a quarter of the screen
+				unsigned int width = config.m_width, height = config.m_height;
+				if(bcase.m_multi_monitor)
+					width += config.m_width / 2;
+				if(bcase.m_follow_cursor) {
+					width = (width / 2) & ~1u;
+					height = (height / 2) & ~1u;
+				}
+
+				BenchmarkAnimator animator(server->GetDisplayName());
+				CaptureBenchmarkSink sink;
+				X11Input input(0, 0, width, height, bcase.m_record_cursor, bcase.m_follow_cursor, false);
+				sink.ConnectVideoSource(&input);
+
+				usleep(CAPTURE_BENCHMARK_WARMUP);
+
+				std::vector<double> samples_fps, samples_grab_avg, samples_grab_max, samples_interval_max, samples_input_cpu, samples_server_cpu;
+				for(unsigned int r = 0; r < repetitions; ++r) {
+					uint64_t grabs1, grabs2;
+					int64_t grab_time_sum1, grab_time_sum2, grab_time_max;
+					sink.StartMeasuring();
+					input.GetGrabStats(&grabs1, &grab_time_sum1, &grab_time_max);
+					int64_t t1 = hrt_time_micro(), input_cpu1 = input.GetCPUTime(), server_cpu1 = server->GetCPUTime();
+					usleep((int64_t) duration * 1000 / repetitions);
+					int64_t t2 = hrt_time_micro(), input_cpu2 = input.GetCPUTime(), server_cpu2 = server->GetCPUTime();
+					input.GetGrabStats(&grabs2, &grab_time_sum2, &grab_time_max);
+					if(input.HasErrorOccurred())
+						throw X11Exception();
+
+					uint64_t frames;
+					int64_t interval_sum, interval_max;
+					sink.GetResults(&frames, &interval_sum, &interval_max);
+					samples_fps.push_back((double) frames * 1.0e6 / (double) std::max<int64_t>(1, t2 - t1));
+					samples_grab_avg.push_back((grabs2 == grabs1)? 0.0 : (double) (grab_time_sum2 - grab_time_sum1) / (double) (grabs2 - grabs1));
+					samples_grab_max.push_back((double) grab_time_max);
+					samples_interval_max.push_back((double) interval_max);
+					samples_input_cpu.push_back(100.0 * (double) (input_cpu2 - input_cpu1) / (double) std::max<int64_t>(1, t2 - t1));
+					samples_server_cpu.push_back(100.0 * (double) (server_cpu2 - server_cpu1) / (double) std::max<int64_t>(1, t2 - t1));
+				}
+				sink.ConnectVideoSource(NULL);
+
+				Logger::LogInfo("[BenchmarkCapture] " + Logger::tr("%1x%2x%3 %4  |  %5 fps  |  grab %6 us (max %7 us)  |  max frame interval %8 us  |  input CPU %9%  |  server CPU %10%")
+								.arg(config.m_width).arg(config.m_height).arg(config.m_depth).arg(bcase.m_name, -20)
+								.arg(BenchmarkReport::Summarize(samples_fps).m_median, 7, 'f', 1)
+								.arg(BenchmarkReport::Summarize(samples_grab_avg).m_median, 7, 'f', 0)
+								.arg(BenchmarkReport::Summarize(samples_grab_max).m_max, 7, 'f', 0)
+								.arg(BenchmarkReport::Summarize(samples_interval_max).m_max, 7, 'f', 0)
+								.arg(BenchmarkReport::Summarize(samples_input_cpu).m_median, 5, 'f', 1)
+								.arg(BenchmarkReport::Summarize(samples_server_cpu).m_median, 5, 'f', 1));
+
+				QString name = QString("capture/%1/%2x%3x%4/%5").arg(QFileInfo(xserver).fileName()).arg(config.m_width).arg(config.m_height).arg(config.m_depth).arg(bcase.m_name);
+				report->AddResult(name + "/fps", "fps", true, samples_fps);
+				report->AddResult(name + "/grab_avg", "us", false, samples_grab_avg);
+				report->AddResult(name + "/grab_max", "us", false, samples_grab_max);
+				report->AddResult(name + "/frame_interval_max", "us", false, samples_interval_max);
+				report->AddResult(name + "/input_cpu", "%", false, samples_input_cpu);
+				report->AddResult(name + "/server_cpu", "%", false, samples_server_cpu);
+
+			} catch(const std::exception& e) {
+				Logger::LogError("[BenchmarkCapture] " + Logger::tr("Error: Case '%1' failed: %2").arg(bcase.m_name).arg(e.what()));
+				server.reset(); // the server may be in a bad state
+			}
+		}
+	}
+
+	if(old_display.isNull()) {
+		qunsetenv("DISPLAY");
+	} else {
+		qputenv("DISPLAY", old_display);
+	}
+
+}
@@ -0,0 +1,91 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "MutexDataPair.h"
+#include "SourceSink.h"
+
+class BenchmarkReport;
+
+// Requests frames as fast as possible and records the time between frames.
+class CaptureBenchmarkSink : public VideoSink {
+
+private:
+	struct SharedData {
+		bool m_measuring;
+		uint64_t m_frames;
+		int64_t m_last_timestamp;
+		int64_t m_interval_sum, m_interval_max;
+	};
+	typedef MutexDataPair<SharedData>::Lock SharedLock;
+
+private:
+	MutexDataPair<SharedData> m_shared_data;
+
+public:
+	CaptureBenchmarkSink() {
+		SharedLock lock(&m_shared_data);
+		lock->m_measuring = false;
+		lock->m_frames = 0;
+		lock->m_last_timestamp = SINK_TIMESTAMP_NONE;
+		lock->m_interval_sum = 0;
+		lock->m_interval_max = 0;
+	}
+	~CaptureBenchmarkSink() {
+		ConnectVideoSource(NULL);
+	}
+
+	void StartMeasuring() {
+		SharedLock lock(&m_shared_data);
+		lock->m_measuring = true;
+		lock->m_frames = 0;
+		lock->m_interval_sum = 0;
+		lock->m_interval_max = 0;
+	}
+	void GetResults(uint64_t* frames, int64_t* interval_sum, int64_t* interval_max) {
+		SharedLock lock(&m_shared_data);
+		*frames = lock->m_frames;
+		*interval_sum = lock->m_interval_sum;
+		*interval_max = lock->m_interval_max;
+	}
+
+	virtual int64_t GetNextVideoTimestamp() override {
+		return SINK_TIMESTAMP_ASAP;
+	}
+	virtual void ReadVideoFrame(unsigned int width, unsigned int height, const uint8_t* const* data, const int* stride, AVPixelFormat format, int colorspace, int64_t timestamp) override {
+		Q_UNUSED(width); Q_UNUSED(height); Q_UNUSED(data); Q_UNUSED(stride); Q_UNUSED(format); Q_UNUSED(colorspace);
+		SharedLock lock(&m_shared_data);
+		if(lock->m_measuring && lock->m_last_timestamp != SINK_TIMESTAMP_NONE) {
+			int64_t interval = timestamp - lock->m_last_timestamp;
+			++lock->m_frames;
+			lock->m_interval_sum += interval;
+			lock->m_interval_max = std::max(lock->m_interval_max, interval);
+		}
+		lock->m_last_timestamp = timestamp;
+	}
+
+};
+
+
+// Runs X11Input against a private X server (Xvfb or Xephyr) with animated content and adds the results to the report.
+// 'configs' is a comma-separated list of screen configurations (WIDTHxHEIGHTxDEPTH).
+// The measurement time of each case ('duration', in milliseconds) is split into 'repetitions' equal parts.
+void BenchmarkCapture(BenchmarkReport* report, unsigned int repetitions, const QString& xserver, const QString& configs, unsigned int duration);
@@ -0,0 +1,550 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BenchmarkEncoder.h"
+
+#include "AVWrapper.h"
+#include "BenchmarkReport.h"
+#include "FastScaler.h"
+#include "FrameChangeDetector.h"
+#include "Logger.h"
+#include "Muxer.h"
+#include "PacketJournal.h"
+#include "TempBuffer.h"
+#include "VideoEncoder.h"
+
+// Number of unique frames in the synthetic clip. The motion is periodic, so the clip can be looped without visible jumps.
+// More frames would be more realistic, but every frame is stored in the encoder's pixel format, which takes a lot of memory.
+static const unsigned int ENCODER_BENCHMARK_CLIP_FRAMES = 16;
+
+// Length of one period of the mostly static clip (in frames). The window moves during the first ENCODER_BENCHMARK_CLIP_FRAMES frames,
+// and then the screen stays static for the rest of the period.
+static const unsigned int ENCODER_BENCHMARK_STATIC_PERIOD = 64;
+
+// Minimum number of frames per run. This should be a lot more than the lookahead of the encoder, otherwise we would mostly measure
+// the start-up and flushing of the encoder.
+static const unsigned int ENCODER_BENCHMARK_MIN_FRAMES = 120;
+
+// Maximum number of frames in the encoder queue. This is enough to keep the encoder busy, a larger queue would only waste memory.
+static const unsigned int ENCODER_BENCHMARK_MAX_QUEUED = 8;
+
+// A preset is only suggested if it is faster than the target frame rate by at least this factor, since the recording also needs
+// CPU time for capturing, scaling and audio.
+static const double ENCODER_BENCHMARK_HEADROOM = 1.25;
+
+// The focus region is a square around a fixed point in the text (as if the cursor were there), with the same size and quantizer offset
+// as the region around the cursor in the synchronizer.
+static const int ENCODER_BENCHMARK_FOCUS_RADIUS = 128;
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+static const AVRational ENCODER_BENCHMARK_FOCUS_QOFFSET = {-1, 5};
+#endif
+
+static inline uint32_t ClipHash(uint32_t x, uint32_t y, uint32_t z) {
+	uint32_t h = x * 73856093u ^ y * 19349663u ^ z * 83492791u;
+	h ^= h >> 13;
+	h *= 0x5bd1e995u;
+	h ^= h >> 15;
+	return h;
+}
+
+// Generates frame 'index' of the synthetic clip: a static page of text, with a window moving over it in an ellipse. The window contains
+// a gradient and some noise which changes every frame, similar to a video player.
+static void GenerateClipFrame(unsigned int width, unsigned int height, unsigned int index, uint8_t* data, int stride) {
+
+	// window position
+	double phase = 2.0 * M_PI * (double) index / (double) ENCODER_BENCHMARK_CLIP_FRAMES;
+	unsigned int win_w = width / 3, win_h = height / 3;
+	int win_x = (int) lrint((double) (width - win_w) * (0.5 + 0.4 * cos(phase)));
+	int win_y = (int) lrint((double) (height - win_h) * (0.5 + 0.4 * sin(phase)));
+	unsigned int title_h = std::min(24u, win_h / 4);
+
+	for(unsigned int y = 0; y < height; ++y) {
+		uint32_t *row = (uint32_t*) (data + (size_t) stride * y);
+		unsigned int line = y / 16, line_y = y % 16;
+		unsigned int line_length = ClipHash(line, 0, 1) % (width / 8 + 1);
+		for(unsigned int x = 0; x < width; ++x) {
+			uint32_t pixel;
+			if((int) x >= win_x && (int) x < win_x + (int) win_w && (int) y >= win_y && (int) y < win_y + (int) win_h) {
+				unsigned int wx = x - win_x, wy = y - win_y;
+				if(wy < title_h) {
+					pixel = 0xff3060a0;
+				} else {
+					uint32_t noise = ClipHash(wx, wy, index) & 0x1f;
+					uint32_t r = (wx * 255 / win_w + index * 16) & 0xff, g = (wy * 255 / win_h) & 0xff, b = ((wx + wy) / 2 + index * 8) & 0xff;
+					pixel = 0xff000000 | (std::min(255u, r + noise) << 16) | (std::min(255u, g + noise) << 8) | std::min(255u, b + noise);
+				}
+			} else {
+				unsigned int cell = x / 8, cell_x = x % 8;
+				bool ink = (cell < line_length && ClipHash(cell, line, 2) % 6 != 0 && cell_x >= 1 && cell_x < 7 && line_y >= 3 && line_y < 13 &&
+							ClipHash(x, y, 3) % 3 == 0);
+				pixel = (ink)? 0xff202020 : 0xfff0f0f0;
+			}
+			row[x] = pixel;
+		}
+	}
+
+}
+
+// Generates the synthetic clip and converts it to the given pixel format. If 'hints' is not NULL, it receives the content hints for every
+// frame of the clip, relative to the frame before it (the last frame for the first frame, since the clip is looped).
+static std::vector<std::shared_ptr<AVFrameData> > GenerateClip(unsigned int width, unsigned int height, AVPixelFormat pixel_format, int colorspace,
+															   std::vector<AVFrameHints>* hints) {
+	std::vector<std::shared_ptr<AVFrameData> > clip;
+	int stride = grow_align16(width * 4);
+	TempBuffer<uint8_t> buffer;
+	buffer.Alloc(stride * height);
+	FastScaler fast_scaler;
+	FrameChangeDetector change_detector;
+	if(hints != NULL)
+		hints->assign(ENCODER_BENCHMARK_CLIP_FRAMES, AVFrameHints());
+	for(unsigned int i = 0; i < ENCODER_BENCHMARK_CLIP_FRAMES; ++i) {
+		GenerateClipFrame(width, height, i, buffer.GetData(), stride);
+		if(hints != NULL) {
+			AVFrameHints frame_hints = FrameChangeHints(change_detector.Analyze(width, height, buffer.GetData(), stride), width, height, width, height);
+			if(i != 0)
+				(*hints)[i] = frame_hints;
+		}
+		std::unique_ptr<AVFrameWrapper> frame = CreateVideoFrame(width, height, pixel_format, NULL);
+		const uint8_t *in_data[1] = {buffer.GetData()};
+		fast_scaler.Scale(width, height, AV_PIX_FMT_BGRA, SWS_CS_DEFAULT, in_data, &stride,
+						  width, height, pixel_format, colorspace, frame->GetFrame()->data, frame->GetFrame()->linesize);
+		clip.push_back(frame->GetFrameData());
+	}
+	if(hints != NULL) {
+		// the first frame follows the last frame when the clip is looped
+		GenerateClipFrame(width, height, 0, buffer.GetData(), stride);
+		(*hints)[0] = FrameChangeHints(change_detector.Analyze(width, height, buffer.GetData(), stride), width, height, width, height);
+	}
+	return clip;
+}
+
+// Returns the index of the clip frame that is used for frame 'frame' of the video.
+static unsigned int ClipIndex(unsigned int frame, bool static_content) {
+	unsigned int position = (static_content)? frame % ENCODER_BENCHMARK_STATIC_PERIOD : frame % ENCODER_BENCHMARK_CLIP_FRAMES;
+	return std::min(position, ENCODER_BENCHMARK_CLIP_FRAMES - 1);
+}
+
+static void GetFocusRect(unsigned int width, unsigned int height, int* x1, int* y1, int* x2, int* y2) {
+	int cx = width / 6, cy = height / 6;
+	*x1 = std::max(0, cx - ENCODER_BENCHMARK_FOCUS_RADIUS);
+	*y1 = std::max(0, cy - ENCODER_BENCHMARK_FOCUS_RADIUS);
+	*x2 = std::min((int) width, cx + ENCODER_BENCHMARK_FOCUS_RADIUS);
+	*y2 = std::min((int) height, cy + ENCODER_BENCHMARK_FOCUS_RADIUS);
+}
+
+static double CalculatePSNR(uint64_t squared_error, uint64_t samples) {
+	if(samples == 0)
+		return 0.0;
+	if(squared_error == 0)
+		return 99.0;
+	return 10.0 * log10(255.0 * 255.0 * (double) samples / (double) squared_error);
+}
+
+// Decodes the output file and compares the luma channel of every frame with the original, separately inside and outside the focus region.
+// Only YUV pixel formats are supported.
+static void MeasureQuality(const QString& file, const std::vector<std::shared_ptr<AVFrameData> >& clip, unsigned int width, unsigned int height,
+						   AVPixelFormat pixel_format, unsigned int frames, bool static_content, double* psnr_focus, double* psnr_other) {
+#if SSR_USE_AVCODEC_SEND_RECEIVE && SSR_USE_AVSTREAM_CODECPAR
+
+	if(pixel_format != AV_PIX_FMT_NV12 && pixel_format != AV_PIX_FMT_YUV420P && pixel_format != AV_PIX_FMT_YUV422P && pixel_format != AV_PIX_FMT_YUV444P) {
+		Logger::LogError("[MeasureQuality] " + Logger::tr("Error: The quality can only be measured for YUV pixel formats!"));
+		throw LibavException();
+	}
+	int focus_x1, focus_y1, focus_x2, focus_y2;
+	GetFocusRect(width, height, &focus_x1, &focus_y1, &focus_x2, &focus_y2);
+
+	AVFormatContext *format_context = NULL;
+	AVCodecContext *codec_context = NULL;
+	AVFrame *frame = NULL;
+	AVPacket *packet = NULL;
+	uint64_t error_focus = 0, samples_focus = 0, error_other = 0, samples_other = 0;
+	unsigned int frame_index = 0;
+	try {
+
+		// open the file and the decoder
+		if(avformat_open_input(&format_context, file.toLocal8Bit().constData(), NULL, NULL) < 0 || avformat_find_stream_info(format_context, NULL) < 0) {
+			Logger::LogError("[MeasureQuality] " + Logger::tr("Error: Can't open output file for decoding!"));
+			throw LibavException();
+		}
+		if(format_context->nb_streams < 1) {
+			Logger::LogError("[MeasureQuality] " + Logger::tr("Error: Output file has no streams!"));
+			throw LibavException();
+		}
+		AVStream *stream = format_context->streams[0];
+		const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+		if(codec == NULL) {
+			Logger::LogError("[MeasureQuality] " + Logger::tr("Error: Can't find decoder!"));
+			throw LibavException();
+		}
+		codec_context = avcodec_alloc_context3(codec);
+		frame = av_frame_alloc();
+		packet = av_packet_alloc();
+		if(codec_context == NULL || frame == NULL || packet == NULL)
+			throw std::bad_alloc();
+		if(avcodec_parameters_to_context(codec_context, stream->codecpar) < 0 || avcodec_open2(codec_context, codec, NULL) < 0) {
+			Logger::LogError("[MeasureQuality] " + Logger::tr("Error: Can't open decoder!"));
+			throw LibavException();
+		}
+
+		// decode and compare every frame
+		// The frames come out of the decoder in presentation order, which is the same order in which they were encoded.
+		auto receive_frames = [&]() {
+			while(avcodec_receive_frame(codec_context, frame) == 0) {
+				if(frame_index < frames && frame->width == (int) width && frame->height == (int) height) {
+					std::unique_ptr<AVFrameWrapper> original = CreateVideoFrame(width, height, pixel_format, clip[ClipIndex(frame_index, static_content)]);
+					for(unsigned int y = 0; y < height; ++y) {
+						const uint8_t *row1 = original->GetFrame()->data[0] + (ptrdiff_t) original->GetFrame()->linesize[0] * y;
+						const uint8_t *row2 = frame->data[0] + (ptrdiff_t) frame->linesize[0] * y;
+						bool focus_row = ((int) y >= focus_y1 && (int) y < focus_y2);
+						for(unsigned int x = 0; x < width; ++x) {
+							int d = (int) row1[x] - (int) row2[x];
+							if(focus_row && (int) x >= focus_x1 && (int) x < focus_x2) {
+								error_focus += d * d;
+								++samples_focus;
+							} else {
+								error_other += d * d;
+								++samples_other;
+							}
+						}
+					}
+				}
+				++frame_index;
+				av_frame_unref(frame);
+			}
+		};
+		while(av_read_frame(format_context, packet) >= 0) {
+			if(packet->stream_index == stream->index) {
+				if(avcodec_send_packet(codec_context, packet) < 0) {
+					av_packet_unref(packet);
+					Logger::LogError("[MeasureQuality] " + Logger::tr("Error: Decoding failed!"));
+					throw LibavException();
+				}
+				receive_frames();
+			}
+			av_packet_unref(packet);
+		}
+		avcodec_send_packet(codec_context, NULL);
+		receive_frames();
+
+	} catch(...) {
+		av_packet_free(&packet);
+		av_frame_free(&frame);
+		avcodec_free_context(&codec_context);
+		avformat_close_input(&format_context);
+		throw;
+	}
+	av_packet_free(&packet);
+	av_frame_free(&frame);
+	avcodec_free_context(&codec_context);
+	avformat_close_input(&format_context);
+
+	if(frame_index != frames) {
+		Logger::LogWarning("[MeasureQuality] " + Logger::tr("Warning: Decoded %1 frames, expected %2.").arg(frame_index).arg(frames));
+	}
+	*psnr_focus = CalculatePSNR(error_focus, samples_focus);
+	*psnr_other = CalculatePSNR(error_other, samples_other);
+
+#else
+	Q_UNUSED(file);
+	Q_UNUSED(clip);
+	Q_UNUSED(width);
+	Q_UNUSED(height);
+	Q_UNUSED(pixel_format);
+	Q_UNUSED(frames);
+	Q_UNUSED(static_content);
+	Q_UNUSED(psnr_focus);
+	Q_UNUSED(psnr_other);
+	Logger::LogError("[MeasureQuality] " + Logger::tr("Error: Measuring the quality requires a newer version of libavcodec!"));
+	throw LibavException();
+#endif
+}
+
+template<typename F>
+static void WaitForMuxer(Muxer* muxer, F condition) {
+	while(!condition()) {
+		if(muxer->HasErrorOccurred())
+			throw LibavException();
+		usleep(1000);
+	}
+}
+
+EncoderBenchmarkResult EncoderBenchmarkRun(const QString& codec_name, const std::vector<std::pair<QString, QString> >& codec_options,
+										   unsigned int width, unsigned int height, unsigned int frame_rate, unsigned int frames,
+										   const EncoderBenchmarkOptions& options) {
+
+	QString output_file = QDir::temp().filePath(QString("ssr-benchmark-encoder-%1.mkv").arg(getpid()));
+	QString journal_file = PacketJournal::GetFileName(output_file);
+	EncoderBenchmarkResult result;
+	result.m_psnr_focus = 0.0;
+	result.m_psnr_other = 0.0;
+	try {
+
+		std::unique_ptr<Muxer> muxer(new Muxer("matroska", output_file));
+		if(options.m_packet_journal)
+			muxer->EnablePacketJournal(journal_file);
+		VideoEncoder *video_encoder = muxer->AddVideoEncoder(codec_name, codec_options, 0, width, height, frame_rate);
+		AVPixelFormat pixel_format = video_encoder->GetPixelFormat();
+		std::vector<AVFrameHints> clip_hints;
+		std::vector<std::shared_ptr<AVFrameData> > clip = GenerateClip(width, height, pixel_format, video_encoder->GetColorSpace(), (options.m_content_hints)? &clip_hints : NULL);
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+		std::vector<AVRegionOfInterest> focus_regions;
+		if(options.m_focus_roi) {
+			int x1, y1, x2, y2;
+			GetFocusRect(width, height, &x1, &y1, &x2, &y2);
+			focus_regions.push_back(MakeRegionOfInterest(x1, y1, x2, y2, ENCODER_BENCHMARK_FOCUS_QOFFSET));
+		}
+#else
+		if(options.m_focus_roi) {
+			Logger::LogError("[EncoderBenchmarkRun] " + Logger::tr("Error: Regions of interest require a newer version of libavutil!"));
+			throw LibavException();
+		}
+#endif
+		muxer->Start();
+
+		// feed the frames as fast as the encoder accepts them
+		int64_t t1 = hrt_time_micro(), cpu1 = process_cpu_time_micro();
+		for(unsigned int i = 0; i < frames; ++i) {
+			WaitForMuxer(muxer.get(), [&]() { return video_encoder->GetQueuedFrameCount() < ENCODER_BENCHMARK_MAX_QUEUED; });
+			unsigned int index = ClipIndex(i, options.m_static_content);
+			std::unique_ptr<AVFrameWrapper> frame = CreateVideoFrame(width, height, pixel_format, clip[index]);
+			frame->GetFrame()->pts = i;
+			if(options.m_content_hints) {
+				AVFrameHints &hints = frame->GetHints();
+				if(i == 0) { // the first frame is always a scene cut
+					hints.m_valid = true;
+					hints.m_scene_cut = true;
+					hints.m_changed_fraction = 1.0;
+					hints.m_changed_x2 = width;
+					hints.m_changed_y2 = height;
+				} else if(index == ClipIndex(i - 1, options.m_static_content)) {
+					hints.m_valid = true;
+					hints.m_static = true;
+				} else {
+					hints = clip_hints[index];
+				}
+			}
+#if SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST
+			AddFrameRegionsOfInterest(frame->GetFrame(), focus_regions);
+#endif
+			video_encoder->AddFrame(std::move(frame));
+		}
+
+		// the measurement includes flushing the encoder, since this is also part of the work
+		muxer->Finish();
+		WaitForMuxer(muxer.get(), [&]() { return muxer->IsDone(); });
+		int64_t t2 = hrt_time_micro(), cpu2 = process_cpu_time_micro();
+
+		result.m_fps = (double) frames * 1.0e6 / (double) std::max<int64_t>(1, t2 - t1);
+		result.m_cpu = 100.0 * (double) (cpu2 - cpu1) / (double) std::max<int64_t>(1, t2 - t1);
+		result.m_bit_rate = (double) muxer->GetTotalBytes() * 8.0e-3 * (double) frame_rate / (double) frames;
+
+		// the muxer has to be destroyed first, otherwise the file may not be complete
+		if(options.m_measure_quality) {
+			muxer.reset();
+			MeasureQuality(output_file, clip, width, height, pixel_format, frames, options.m_static_content, &result.m_psnr_focus, &result.m_psnr_other);
+		}
+
+	} catch(...) {
+		QFile::remove(output_file);
+		QFile::remove(journal_file);
+		throw;
+	}
+	QFile::remove(output_file);
+	QFile::remove(journal_file);
+	return result;
+
+}
+
+static QString CaseLabel(const QString& value) {
+	return (value.isEmpty())? QString("default") : value;
+}
+
+// Runs one case of the benchmark, adds the results to the report and returns the medians.
+static EncoderBenchmarkResult BenchmarkEncoderCase(BenchmarkReport* report, unsigned int repetitions, const QString& codec_name,
+												   const std::vector<std::pair<QString, QString> >& codec_options, const QString& case_name,
+												   unsigned int width, unsigned int height, unsigned int frame_rate, unsigned int frames,
+												   const EncoderBenchmarkOptions& options) {
+
+	std::vector<double> samples_fps, samples_cpu, samples_bit_rate, samples_psnr_focus, samples_psnr_other;
+	for(unsigned int r = 0; r < repetitions; ++r) {
+		EncoderBenchmarkResult result = EncoderBenchmarkRun(codec_name, codec_options, width, height, frame_rate, frames, options);
+		samples_fps.push_back(result.m_fps);
+		samples_cpu.push_back(result.m_cpu);
+		samples_bit_rate.push_back(result.m_bit_rate);
+		samples_psnr_focus.push_back(result.m_psnr_focus);
+		samples_psnr_other.push_back(result.m_psnr_other);
+	}
+
+	EncoderBenchmarkResult median;
+	median.m_fps = BenchmarkReport::Summarize(samples_fps).m_median;
+	median.m_cpu = BenchmarkReport::Summarize(samples_cpu).m_median;
+	median.m_bit_rate = BenchmarkReport::Summarize(samples_bit_rate).m_median;
+	median.m_psnr_focus = BenchmarkReport::Summarize(samples_psnr_focus).m_median;
+	median.m_psnr_other = BenchmarkReport::Summarize(samples_psnr_other).m_median;
+	QString message = Logger::tr("%1 %2x%3 %4  |  %5 fps  |  CPU %6%  |  %7 kbit/s")
+					  .arg(codec_name).arg(width).arg(height).arg(case_name, -32)
+					  .arg(median.m_fps, 7, 'f', 1)
+					  .arg(median.m_cpu, 6, 'f', 1)
+					  .arg(median.m_bit_rate, 8, 'f', 0);
+	if(options.m_measure_quality) {
+		message += Logger::tr("  |  PSNR focus %1 dB, other %2 dB").arg(median.m_psnr_focus, 0, 'f', 2).arg(median.m_psnr_other, 0, 'f', 2);
+	}
+	Logger::LogInfo("[BenchmarkEncoder] " + message);
+
+	QString name = QString("encoder/%1/%2x%3/%4").arg(codec_name).arg(width).arg(height).arg(case_name);
+	report->AddResult(name + "/fps", "fps", true, samples_fps);
+	report->AddResult(name + "/cpu", "%", false, samples_cpu);
+	report->AddResult(name + "/bitrate", "kbit/s", false, samples_bit_rate);
+	if(options.m_measure_quality) {
+		report->AddResult(name + "/psnr-focus", "dB", true, samples_psnr_focus);
+		report->AddResult(name + "/psnr-other", "dB", true, samples_psnr_other);
+	}
+
+	return median;
+}
+
+void BenchmarkEncoder(BenchmarkReport* report, unsigned int repetitions, const QString& size, const QString& codec_name,
+					  const QString& presets, const QString& crfs, const QString& threads, const QString& pixel_formats, const QString& backends,
+					  unsigned int target_fps, unsigned int duration, bool content_hints, bool focus_roi, bool packet_journal) {
+
+	QStringList size_parts = size.split('x');
+	unsigned int width = (size_parts.size() > 0)? size_parts[0].toUInt() : 0;
+	unsigned int height = (size_parts.size() > 1)? size_parts[1].toUInt() : 0;
+	if(width < 64 || height < 64 || width > SSR_MAX_IMAGE_SIZE || height > SSR_MAX_IMAGE_SIZE || width % 2 != 0 || height % 2 != 0) {
+		Logger::LogError("[BenchmarkEncoder] " + Logger::tr("Error: Invalid frame size '%1'!").arg(size));
+		return;
+	}
+	unsigned int frames = std::max(ENCODER_BENCHMARK_MIN_FRAMES, (unsigned int) ((uint64_t) duration * target_fps / 1000));
+
+	// empty lists mean 'use the default of the encoder'
+	QStringList preset_list = SplitSkipEmptyParts(presets, ','), crf_list = SplitSkipEmptyParts(crfs, ',');
+	QStringList thread_list = SplitSkipEmptyParts(threads, ','), pixel_format_list = SplitSkipEmptyParts(pixel_formats, ',');
+	QStringList backend_list = SplitSkipEmptyParts(backends, ',');
+	if(preset_list.isEmpty())
+		preset_list.append(QString());
+	if(crf_list.isEmpty())
+		crf_list.append(QString());
+	for(QString &thread_count : thread_list) {
+		if(thread_count.trimmed() == "0")
+			thread_count = QString(); // zero means 'automatic'
+	}
+	if(thread_list.isEmpty())
+		thread_list.append(QString());
+	if(pixel_format_list.isEmpty())
+		pixel_format_list.append(QString());
+	if(backend_list.isEmpty())
+		backend_list.append(QString());
+
+	for(const QString &backend : backend_list) {
+		for(const QString &pixel_format : pixel_format_list) {
+			for(const QString &thread_count : thread_list) {
+				for(const QString &crf : crf_list) {
+					// the backend is only part of the name if it was chosen explicitly, so the names of older reports still match
+					QString combination = QString("crf%1/t%2/%3").arg(CaseLabel(crf)).arg(CaseLabel(thread_count)).arg(CaseLabel(pixel_format));
+					if(!backend.isEmpty())
+						combination += "/" + backend;
+					QString suggestion;
+					for(const QString &preset : preset_list) {
+
+						std::vector<std::pair<QString, QString> > codec_options;
+						if(!preset.isEmpty())
+							codec_options.push_back(std::make_pair(QString("preset"), preset));
+						if(!crf.isEmpty())
+							codec_options.push_back(std::make_pair(QString("crf"), crf));
+						if(!thread_count.isEmpty())
+							codec_options.push_back(std::make_pair(QString("threads"), thread_count));
+						if(!pixel_format.isEmpty())
+							codec_options.push_back(std::make_pair(QString("pixelformat"), pixel_format));
+						if(!backend.isEmpty())
+							codec_options.push_back(std::make_pair(QString("backend"), backend));
+
+						QString case_name = CaseLabel(preset) + "/" + combination;
+						try {
+
+							EncoderBenchmarkResult base = BenchmarkEncoderCase(report, repetitions, codec_name, codec_options, case_name,
+																			   width, height, target_fps, frames, EncoderBenchmarkOptions());
+
+							// the presets are sorted from fast to slow, so the last one that is fast enough wins
+							if(base.m_fps >= (double) target_fps * ENCODER_BENCHMARK_HEADROOM)
+								suggestion = CaseLabel(preset);
+
+							// measure the overhead of the packet journal
+							if(packet_journal) {
+								EncoderBenchmarkOptions options;
+								options.m_packet_journal = true;
+								EncoderBenchmarkResult with_journal = BenchmarkEncoderCase(report, repetitions, codec_name, codec_options, case_name + "/journal",
+																						   width, height, target_fps, frames, options);
+								Logger::LogInfo("[BenchmarkEncoder] " + Logger::tr("Packet journal for %1: CPU %2%, speed %3%")
+												.arg(case_name)
+												.arg(100.0 * (with_journal.m_cpu / std::max(1e-6, base.m_cpu) - 1.0), 0, 'f', 1)
+												.arg(100.0 * (with_journal.m_fps / std::max(1e-6, base.m_fps) - 1.0), 0, 'f', 1));
+							}
+
+							// measure what the content hints save on a mostly static clip
+							if(content_hints) {
+								EncoderBenchmarkOptions options;
+								options.m_static_content = true;
+								EncoderBenchmarkResult without_hints = BenchmarkEncoderCase(report, repetitions, codec_name, codec_options, case_name + "/static",
+																							width, height, target_fps, frames, options);
+								options.m_content_hints = true;
+								EncoderBenchmarkResult with_hints = BenchmarkEncoderCase(report, repetitions, codec_name, codec_options, case_name + "/static-hints",
+																						 width, height, target_fps, frames, options);
+								Logger::LogInfo("[BenchmarkEncoder] " + Logger::tr("Content hints for %1: bit rate %2%, CPU %3%, speed %4%")
+												.arg(case_name)
+												.arg(100.0 * (with_hints.m_bit_rate / std::max(1e-6, without_hints.m_bit_rate) - 1.0), 0, 'f', 1)
+												.arg(100.0 * (with_hints.m_cpu / std::max(1e-6, without_hints.m_cpu) - 1.0), 0, 'f', 1)
+												.arg(100.0 * (with_hints.m_fps / std::max(1e-6, without_hints.m_fps) - 1.0), 0, 'f', 1));
+							}
+
+							// measure the quality inside and outside the focus region, with and without a region of interest
+							if(focus_roi) {
+								EncoderBenchmarkOptions options;
+								options.m_measure_quality = true;
+								EncoderBenchmarkResult without_roi = BenchmarkEncoderCase(report, repetitions, codec_name, codec_options, case_name + "/quality",
+																						  width, height, target_fps, frames, options);
+								options.m_focus_roi = true;
+								EncoderBenchmarkResult with_roi = BenchmarkEncoderCase(report, repetitions, codec_name, codec_options, case_name + "/quality-roi",
+																					   width, height, target_fps, frames, options);
+								Logger::LogInfo("[BenchmarkEncoder] " + Logger::tr("Region of interest for %1: PSNR focus %2 dB, other %3 dB, bit rate %4%")
+												.arg(case_name)
+												.arg(with_roi.m_psnr_focus - without_roi.m_psnr_focus, 0, 'f', 2)
+												.arg(with_roi.m_psnr_other - without_roi.m_psnr_other, 0, 'f', 2)
+												.arg(100.0 * (with_roi.m_bit_rate / std::max(1e-6, without_roi.m_bit_rate) - 1.0), 0, 'f', 1));
+							}
+
+						} catch(const std::exception& e) {
+							Logger::LogError("[BenchmarkEncoder] " + Logger::tr("Error: Case '%1' failed: %2").arg(case_name).arg(e.what()));
+						}
+
+					}
+					if(preset_list.size() > 1) {
+						if(suggestion.isEmpty()) {
+							Logger::LogWarning("[BenchmarkEncoder] " + Logger::tr("Warning: None of the presets can sustain %1 fps at %2x%3 (%4).")
+											   .arg(target_fps).arg(width).arg(height).arg(combination));
+						} else {
+							Logger::LogInfo("[BenchmarkEncoder] " + Logger::tr("Suggested preset for %1 fps at %2x%3 (%4): %5")
+											.arg(target_fps).arg(width).arg(height).arg(combination).arg(suggestion));
+						}
+					}
+				}
+			}
+		}
+	}
+
+}
@@ -0,0 +1,57 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+class BenchmarkReport;
+
+struct EncoderBenchmarkOptions {
+	bool m_static_content; // the window only moves during a small part of the clip, like a typical desktop recording
+	bool m_content_hints; // pass the frames to the encoder with the same content hints that the synchronizer would generate
+	bool m_focus_roi; // give a fixed region (as if the cursor were there) a higher quality, like the synchronizer would
+	bool m_measure_quality; // decode the output and measure the quality inside and outside that region
+	bool m_packet_journal; // write a packet journal next to the output file, like a recording with the recovery journal enabled
+	inline EncoderBenchmarkOptions() : m_static_content(false), m_content_hints(false), m_focus_roi(false), m_measure_quality(false), m_packet_journal(false) {}
+};
+
+struct EncoderBenchmarkResult {
+	double m_fps; // encoded frames per second
+	double m_cpu; // CPU usage of the whole process, in percent of one core
+	double m_bit_rate; // bit rate of the output file, in kbit/s
+	double m_psnr_focus, m_psnr_other; // PSNR of the luma channel inside and outside the focus region, in dB (only if the quality was measured)
+};
+
+// Encodes 'frames' frames of a synthetic screen recording (a window moving over a page of text) through the real VideoEncoder and Muxer,
+// as fast as the encoder can handle them. This function throws an exception if the encoder can't be created or fails.
+EncoderBenchmarkResult EncoderBenchmarkRun(const QString& codec_name, const std::vector<std::pair<QString, QString> >& codec_options,
+										   unsigned int width, unsigned int height, unsigned int frame_rate, unsigned int frames,
+										   const EncoderBenchmarkOptions& options = EncoderBenchmarkOptions());
+
+// Runs the encoder benchmark for every combination of preset, CRF, thread count, pixel format and encoder backend (comma-separated lists)
+// and adds the results to the report. For every combination of CRF, thread count, pixel format and backend, the slowest preset that can
+// sustain 'target_fps' with some headroom is suggested. The presets should be listed from fastest to slowest.
+// The length of the clip ('duration', in milliseconds of video) is the same for every repetition.
+// If 'content_hints' is true, every combination is also encoded as a mostly static clip, with and without content hints.
+// If 'focus_roi' is true, every combination is also encoded with and without a region of interest, and the quality inside and outside
+// that region is measured.
+// If 'packet_journal' is true, every combination is also encoded with a packet journal, to measure the overhead of the journal.
+void BenchmarkEncoder(BenchmarkReport* report, unsigned int repetitions, const QString& size, const QString& codec_name,
+					  const QString& presets, const QString& crfs, const QString& threads, const QString& pixel_formats, const QString& backends,
+					  unsigned int target_fps, unsigned int duration, bool content_hints, bool focus_roi, bool packet_journal);
@@ -0,0 +1,255 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "BenchmarkReport.h"
+
+#include "AVWrapper.h"
+#include "CPUFeatures.h"
+#include "Logger.h"
+
+// generated at build time
+#include "GitCommit.h"
+
+#include <QJsonArray>
+
+#include <algorithm>
+
+BenchmarkReport::BenchmarkReport() {
+}
+
+void BenchmarkReport::AddResult(const QString& name, const QString& unit, bool higher_is_better, const std::vector<double>& samples) {
+	Result result;
+	result.m_name = name;
+	result.m_unit = unit;
+	result.m_higher_is_better = higher_is_better;
+	result.m_samples = samples;
+	m_results.push_back(std::move(result));
+}
+
+void BenchmarkReport::Write(const QString& file) {
+	if(file.isEmpty())
+		return;
+	if(file == "-") {
+		QByteArray csv = ToCsv();
+		fwrite(csv.constData(), 1, csv.size(), stdout);
+		fflush(stdout);
+		return;
+	}
+	QFile out(file);
+	if(!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+		Logger::LogError("[BenchmarkReport::Write] " + Logger::tr("Error: Can't write benchmark report '%1'!").arg(file));
+		return;
+	}
+	if(file.endsWith(".csv", Qt::CaseInsensitive)) {
+		out.write(ToCsv());
+	} else {
+		out.write(ToJson().toJson());
+	}
+	Logger::LogInfo("[BenchmarkReport::Write] " + Logger::tr("Benchmark report written to '%1'.").arg(file));
+}
+
+bool BenchmarkReport::Compare(const QString& baseline_file, double threshold) {
+
+	QFile in(baseline_file);
+	if(!in.open(QIODevice::ReadOnly)) {
+		Logger::LogError("[BenchmarkReport::Compare] " + Logger::tr("Error: Can't read baseline '%1'!").arg(baseline_file));
+		return false;
+	}
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(in.readAll(), &error);
+	if(error.error != QJsonParseError::NoError || !doc.isObject()) {
+		Logger::LogError("[BenchmarkReport::Compare] " + Logger::tr("Error: Baseline '%1' is not a valid JSON report!").arg(baseline_file));
+		return false;
+	}
+
+	// the medians are compared, they are much less sensitive to outliers than the means
+	std::map<QString, double> baseline;
+	for(const QJsonValue &value : doc.object().value("results").toArray()) {
+		QJsonObject result = value.toObject();
+		baseline[result.value("name").toString()] = result.value("median").toDouble();
+	}
+	QJsonObject baseline_metadata = doc.object().value("metadata").toObject();
+	Logger::LogInfo("[BenchmarkReport::Compare] " + Logger::tr("Comparing against baseline from commit '%1' (%2), threshold %3%.")
+					.arg(baseline_metadata.value("commit").toString()).arg(baseline_metadata.value("date").toString()).arg(threshold * 100.0, 0, 'f', 1));
+
+	// new results can't regress, but they are reported so the baseline gets updated
+	// results that are missing from the current report count as failures, otherwise a benchmark that stopped running would go unnoticed
+	unsigned int regressions = 0, missing = 0;
+	for(Result &result : m_results) {
+		auto it = baseline.find(result.m_name);
+		if(it == baseline.end()) {
+			Logger::LogWarning("[BenchmarkReport::Compare] " + Logger::tr("Warning: '%1' is not in the baseline.").arg(result.m_name));
+			continue;
+		}
+		double current = Summarize(result.m_samples).m_median, base = it->second;
+		baseline.erase(it);
+		if(base <= 0.0) {
+			Logger::LogWarning("[BenchmarkReport::Compare] " + Logger::tr("Warning: '%1' has no usable baseline value, it can't be compared.").arg(result.m_name));
+			continue;
+		}
+		double change = (current - base) / base;
+		bool regression = (result.m_higher_is_better)? (change < -threshold) : (change > threshold);
+		if(regression)
+			++regressions;
+		QString message = Logger::tr("%1  |  baseline %2 %3  |  current %4 %3  |  change %5%  |  %6")
+						  .arg(result.m_name, -40).arg(base, 10, 'f', 2).arg(result.m_unit).arg(current, 10, 'f', 2)
+						  .arg(change * 100.0, 6, 'f', 1).arg((regression)? "REGRESSION" : "OK");
+		if(regression) {
+			Logger::LogWarning("[BenchmarkReport::Compare] " + message);
+		} else {
+			Logger::LogInfo("[BenchmarkReport::Compare] " + message);
+		}
+	}
+
+	for(auto &entry : baseline) {
+		Logger::LogWarning("[BenchmarkReport::Compare] " + Logger::tr("%1  |  baseline %2  |  MISSING").arg(entry.first, -40).arg(entry.second, 10, 'f', 2));
+		++missing;
+	}
+
+	if(missing != 0) {
+		Logger::LogError("[BenchmarkReport::Compare] " + Logger::tr("Error: %1 benchmark(s) from the baseline are missing!").arg(missing));
+	}
+	if(regressions != 0) {
+		Logger::LogError("[BenchmarkReport::Compare] " + Logger::tr("Error: %1 benchmark(s) regressed by more than %2%!").arg(regressions).arg(threshold * 100.0, 0, 'f', 1));
+	}
+	if(missing != 0 || regressions != 0)
+		return false;
+	Logger::LogInfo("[BenchmarkReport::Compare] " + Logger::tr("No regressions found."));
+	return true;
+
+}
+
+BenchmarkReport::Summary BenchmarkReport::Summarize(const std::vector<double>& samples) {
+	Summary summary = {0.0, 0.0, 0.0, 0.0, 0.0};
+	if(samples.empty())
+		return summary;
+	std::vector<double> sorted = samples;
+	std::sort(sorted.begin(), sorted.end());
+	size_t n = sorted.size();
+	summary.m_median = (n % 2 == 1)? sorted[n / 2] : 0.5 * (sorted[n / 2 - 1] + sorted[n / 2]);
+	summary.m_min = sorted.front();
+	summary.m_max = sorted.back();
+	double sum = 0.0;
+	for(double v : sorted) {
+		sum += v;
+	}
+	summary.m_mean = sum / (double) n;
+	double sum_sq = 0.0;
+	for(double v : sorted) {
+		sum_sq += (v - summary.m_mean) * (v - summary.m_mean);
+	}
+	summary.m_variance = (n > 1)? sum_sq / (double) (n - 1) : 0.0; // sample variance
+	return summary;
+}
+
+QJsonObject BenchmarkReport::GetMetadata() {
+	QJsonObject metadata;
+	metadata["version"] = QString(SSR_VERSION);
+	metadata["commit"] = QString(SSR_GIT_COMMIT);
+	metadata["date"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+	metadata["libavformat"] = (int) avformat_version();
+	metadata["libavcodec"] = (int) avcodec_version();
+	metadata["libswscale"] = (int) swscale_version();
+
+	// CPU model (from /proc/cpuinfo) and the features that SSR uses
+	QString cpu_model;
+	QFile cpuinfo("/proc/cpuinfo");
+	if(cpuinfo.open(QIODevice::ReadOnly)) {
+		for(const QString &line : QString::fromLocal8Bit(cpuinfo.readAll()).split('\n')) {
+			if(line.startsWith("model name")) {
+				cpu_model = line.mid(line.indexOf(':') + 1).trimmed();
+				break;
+			}
+		}
+	}
+	metadata["cpu_model"] = cpu_model;
+	metadata["cpu_threads"] = (int) std::thread::hardware_concurrency();
+	QJsonArray features;
+#if SSR_USE_X86_ASM
+	if(CPUFeatures::HasMMX()) features.append("mmx");
+	if(CPUFeatures::HasSSE()) features.append("sse");
+	if(CPUFeatures::HasSSE2()) features.append("sse2");
+	if(CPUFeatures::HasSSE3()) features.append("sse3");
+	if(CPUFeatures::HasSSSE3()) features.append("ssse3");
+	if(CPUFeatures::HasSSE41()) features.append("sse4.1");
+	if(CPUFeatures::HasSSE42()) features.append("sse4.2");
+	if(CPUFeatures::HasAVX()) features.append("avx");
+	if(CPUFeatures::HasAVX2()) features.append("avx2");
+	if(CPUFeatures::HasBMI1()) features.append("bmi1");
+	if(CPUFeatures::HasBMI2()) features.append("bmi2");
+#endif
+	metadata["cpu_features"] = features;
+	return metadata;
+}
+
+QJsonDocument BenchmarkReport::ToJson() {
+	QJsonArray results;
+	for(Result &result : m_results) {
+		Summary summary = Summarize(result.m_samples);
+		QJsonArray samples;
+		for(double v : result.m_samples) {
+			samples.append(v);
+		}
+		QJsonObject obj;
+		obj["name"] = result.m_name;
+		obj["unit"] = result.m_unit;
+		obj["higher_is_better"] = result.m_higher_is_better;
+		obj["samples"] = samples;
+		obj["median"] = summary.m_median;
+		obj["mean"] = summary.m_mean;
+		obj["variance"] = summary.m_variance;
+		obj["min"] = summary.m_min;
+		obj["max"] = summary.m_max;
+		results.append(obj);
+	}
+	QJsonObject root;
+	root["metadata"] = GetMetadata();
+	root["results"] = results;
+	return QJsonDocument(root);
+}
+
+QByteArray BenchmarkReport::ToCsv() {
+	QByteArray csv;
+
+	// the metadata is written as comments, most CSV readers can skip those
+	QJsonObject metadata = GetMetadata();
+	for(auto it = metadata.begin(); it != metadata.end(); ++it) {
+		QString value;
+		if(it.value().isArray()) {
+			QStringList list;
+			for(const QJsonValue &v : it.value().toArray()) {
+				list.append(v.toString());
+			}
+			value = list.join(" ");
+		} else {
+			value = it.value().toVariant().toString();
+		}
+		csv += "# " + it.key().toUtf8() + ": " + value.toUtf8() + "\n";
+	}
+
+	csv += "name,unit,higher_is_better,runs,median,mean,variance,min,max\n";
+	for(Result &result : m_results) {
+		Summary summary = Summarize(result.m_samples);
+		csv += QString("%1,%2,%3,%4,%5,%6,%7,%8,%9\n")
+			   .arg(result.m_name).arg(result.m_unit).arg((result.m_higher_is_better)? 1 : 0).arg(result.m_samples.size())
+			   .arg(summary.m_median, 0, 'g', 8).arg(summary.m_mean, 0, 'g', 8).arg(summary.m_variance, 0, 'g', 8)
+			   .arg(summary.m_min, 0, 'g', 8).arg(summary.m_max, 0, 'g', 8).toUtf8();
+	}
+	return csv;
+}
@@ -0,0 +1,65 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+// Collects benchmark results (repeated measurements) and writes them in a machine-readable format, together with
+// information about the machine and the build. Reports can be compared against a baseline report to detect regressions.
+class BenchmarkReport {
+
+public:
+	struct Result {
+		QString m_name, m_unit;
+		bool m_higher_is_better;
+		std::vector<double> m_samples;
+	};
+	struct Summary {
+		double m_median, m_mean, m_variance, m_min, m_max;
+	};
+
+private:
+	std::vector<Result> m_results;
+
+public:
+	BenchmarkReport();
+
+	// Adds one result. The samples are the values from the individual repetitions.
+	void AddResult(const QString& name, const QString& unit, bool higher_is_better, const std::vector<double>& samples);
+
+	// Writes the report to a file. The format is CSV if the file name ends with '.csv', otherwise JSON.
+	// The file name '-' means CSV on stdout.
+	void Write(const QString& file);
+
+	// Compares the report against a baseline (a JSON report written earlier) and logs the differences.
+	// Returns false if any result is worse than the baseline by more than 'threshold' (relative, e.g. 0.1 = 10%), or if a result from the
+	// baseline is missing. New results that are not in the baseline only cause a warning.
+	bool Compare(const QString& baseline_file, double threshold);
+
+	static Summary Summarize(const std::vector<double>& samples);
+
+	// Returns the ratio a / b as a percentage, or zero if b is zero (e.g. because the measurement was skipped).
+	inline static double SafePercentage(double a, double b) { return (b > 0.0)? 100.0 * a / b : 0.0; }
+
+private:
+	static QJsonObject GetMetadata();
+	QJsonDocument ToJson();
+	QByteArray ToCsv();
+
+};
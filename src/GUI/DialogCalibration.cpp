@@ -0,0 +1,137 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "DialogCalibration.h"
+
+#include "Dialogs.h"
+#include "Logger.h"
+#include "MainWindow.h"
+#include "PageOutput.h"
+
+const int DialogCalibration::UPDATE_INTERVAL = 100;
+
+DialogCalibration::DialogCalibration(PageOutput* parent)
+	: QDialog(parent) {
+
+	m_parent = parent;
+	m_has_results = Calibration::Load(&m_results);
+
+	setWindowTitle(tr("Calibration"));
+
+	QLabel *label_info = new QLabel(tr("The calibration measures how fast this computer can capture, convert and encode the video with the "
+									   "current recording settings, and picks the slowest (i.e. most efficient) H.264 preset that can still "
+									   "keep up with the frame rate. Try to avoid using the computer while the calibration is running."), this);
+	label_info->setWordWrap(true);
+	m_label_status = new QLabel(this);
+	m_progressbar = new QProgressBar(this);
+	m_progressbar->setRange(0, 1000);
+	m_progressbar->setValue(0);
+	m_label_summary = new QLabel(this);
+	m_label_summary->setWordWrap(true);
+	m_label_summary->setTextInteractionFlags(Qt::TextSelectableByMouse);
+
+	m_pushbutton_start = new QPushButton(tr("Start calibration"), this);
+	m_pushbutton_apply = new QPushButton(tr("Apply"), this);
+	QPushButton *pushbutton_close = new QPushButton(tr("Close"), this);
+
+	m_timer_update = new QTimer(this);
+
+	connect(m_pushbutton_start, SIGNAL(clicked()), this, SLOT(OnStart()));
+	connect(m_pushbutton_apply, SIGNAL(clicked()), this, SLOT(OnApply()));
+	connect(pushbutton_close, SIGNAL(clicked()), this, SLOT(reject()));
+	connect(m_timer_update, SIGNAL(timeout()), this, SLOT(OnUpdate()));
+
+	QVBoxLayout *layout = new QVBoxLayout(this);
+	layout->addWidget(label_info);
+	layout->addWidget(m_label_status);
+	layout->addWidget(m_progressbar);
+	layout->addWidget(m_label_summary);
+	layout->addStretch();
+	{
+		QHBoxLayout *layout2 = new QHBoxLayout();
+		layout->addLayout(layout2);
+		layout2->addWidget(m_pushbutton_start);
+		layout2->addStretch();
+		layout2->addWidget(m_pushbutton_apply);
+		layout2->addWidget(pushbutton_close);
+	}
+
+	setMinimumWidth(500);
+	UpdateSummary();
+
+}
+
+DialogCalibration::~DialogCalibration() {
+	// the calibration thread is stopped by the destructor of Calibration
+}
+
+void DialogCalibration::UpdateSummary() {
+	if(m_has_results) {
+		m_label_status->setText(tr("Last calibration: %1").arg(m_results.m_time.toLocalTime().toString("yyyy-MM-dd hh:mm:ss")));
+		m_label_summary->setText(Calibration::GetSummary(m_results));
+	} else {
+		m_label_status->setText(tr("This computer has not been calibrated yet."));
+		m_label_summary->clear();
+	}
+	m_pushbutton_apply->setEnabled(m_has_results && !m_results.m_preset.isEmpty());
+}
+
+void DialogCalibration::OnStart() {
+	if(m_calibration != NULL)
+		return;
+	try {
+		m_calibration.reset(new Calibration(m_parent->GetCalibrationSettings()));
+	} catch(...) {
+		MessageBox(QMessageBox::Critical, this, MainWindow::WINDOW_CAPTION, tr("The calibration could not be started, check the log for details."), BUTTON_OK, BUTTON_OK);
+		return;
+	}
+	m_pushbutton_start->setEnabled(false);
+	m_pushbutton_apply->setEnabled(false);
+	m_label_summary->clear();
+	m_progressbar->setValue(0);
+	m_timer_update->start(UPDATE_INTERVAL);
+}
+
+void DialogCalibration::OnApply() {
+	if(!m_has_results)
+		return;
+	m_parent->ApplyCalibration(m_results);
+	accept();
+}
+
+void DialogCalibration::OnUpdate() {
+	if(m_calibration == NULL)
+		return;
+	QString status;
+	double progress = m_calibration->GetProgress(&status);
+	m_progressbar->setValue(lrint(progress * 1000.0));
+	m_label_status->setText(status);
+	if(m_calibration->IsDone() || m_calibration->HasErrorOccurred()) {
+		m_timer_update->stop();
+		if(m_calibration->IsDone()) {
+			m_results = m_calibration->GetResults();
+			m_has_results = true;
+			UpdateSummary();
+		} else {
+			m_label_status->setText(tr("The calibration failed, check the log for details."));
+		}
+		m_calibration.reset();
+		m_pushbutton_start->setEnabled(true);
+	}
+}
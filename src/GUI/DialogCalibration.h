@@ -0,0 +1,59 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "Calibration.h"
+
+class PageOutput;
+
+class DialogCalibration : public QDialog {
+	Q_OBJECT
+
+private:
+	static const int UPDATE_INTERVAL;
+
+private:
+	PageOutput *m_parent;
+
+	std::unique_ptr<Calibration> m_calibration;
+	CalibrationResults m_results;
+	bool m_has_results;
+
+	QLabel *m_label_status;
+	QProgressBar *m_progressbar;
+	QLabel *m_label_summary;
+	QPushButton *m_pushbutton_start, *m_pushbutton_apply;
+
+	QTimer *m_timer_update;
+
+public:
+	DialogCalibration(PageOutput* parent);
+	~DialogCalibration();
+
+private:
+	void UpdateSummary();
+
+private slots:
+	void OnStart();
+	void OnApply();
+	void OnUpdate();
+
+};
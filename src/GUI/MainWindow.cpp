@@ -22,6 +22,8 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Logger.h"
 #include "CommandLineOptions.h"
 #include "Icons.h"
+#include "Calibration.h"
+#include "DialogCalibration.h"
 #include "Dialogs.h"
 #include "EnumStrings.h"
 #include "NVidia.h"
@@ -39,10 +41,12 @@ ENUMSTRINGS(MainWindow::enum_nvidia_disable_flipping) = {
 
 const QString MainWindow::WINDOW_CAPTION = "SimpleScreenRecorder";
 
-MainWindow::MainWindow()
+MainWindow::MainWindow(bool headless)
 	: QMainWindow() {
 
+	m_headless = headless;
 	m_nvidia_reenable_flipping = false;
+	m_calibration_never_ask = false;
 	m_old_geometry = QRect();
 
 	setWindowTitle(WINDOW_CAPTION);
@@ -69,7 +73,7 @@ MainWindow::MainWindow()
 	GoPageStart();
 
 	// warning for non-X11 window systems (e.g. Wayland)
-	if(!IsPlatformX11()) {
+	if(!m_headless && !IsPlatformX11()) {
 		MessageBox(QMessageBox::Warning, NULL, MainWindow::WINDOW_CAPTION,
 				   MainWindow::tr("You are using a non-X11 window system (e.g. Wayland) which is only partially supported by SimpleScreenRecorder. "
 								  "Several features will most likely not work properly, consider choosing a X11/Xorg session at the login screen if you experience issues. "
@@ -78,7 +82,7 @@ MainWindow::MainWindow()
 	}
 
 	// warning for glitch with proprietary NVIDIA drivers
-	if(GetNVidiaDisableFlipping() == NVIDIA_DISABLE_FLIPPING_ASK || GetNVidiaDisableFlipping() == NVIDIA_DISABLE_FLIPPING_YES) {
+	if(!m_headless && (GetNVidiaDisableFlipping() == NVIDIA_DISABLE_FLIPPING_ASK || GetNVidiaDisableFlipping() == NVIDIA_DISABLE_FLIPPING_YES)) {
 		if(NVidiaGetFlipping()) {
 			bool disable;
 			if(GetNVidiaDisableFlipping() == NVIDIA_DISABLE_FLIPPING_ASK) {
@@ -125,17 +129,37 @@ MainWindow::MainWindow()
 		setMinimumSize(preferred_size.boundedTo(available_size));
 
 	// show the window if needed
-	if(!CommandLineOptions::GetStartHidden()) {
+	if(!m_headless && !CommandLineOptions::GetStartHidden()) {
 		show();
 	}
 	m_page_record->UpdateShowHide();
 
-	// start recording and/or activate schedule if needed
-	if(CommandLineOptions::GetStartRecording()) {
-		m_page_record->OnRecordStart();
+	// offer calibration on the first run
+	if(!m_headless && !CommandLineOptions::GetStartHidden() && !m_calibration_never_ask) {
+		CalibrationResults results;
+		if(!Calibration::Load(&results)) {
+			enum_button button = MessageBox(QMessageBox::Question, this, MainWindow::WINDOW_CAPTION,
+											MainWindow::tr("This computer has not been calibrated yet. The calibration measures how fast this computer can record "
+														   "with the current settings, and picks suitable encoder settings. It takes about a minute. "
+														   "Do you want to do this now?\n\nYou can also do this later from the output settings page."),
+											BUTTON_YES | BUTTON_NO | BUTTON_NO_NEVER, BUTTON_YES);
+			if(button == BUTTON_NO_NEVER)
+				m_calibration_never_ask = true;
+			if(button == BUTTON_YES) {
+				DialogCalibration dialog(m_page_output);
+				dialog.exec();
+			}
+		}
 	}
-	if(CommandLineOptions::GetActivateSchedule()) {
-		m_page_record->OnScheduleActivate();
+
+	// start recording and/or activate schedule if needed
+	if(!m_headless) {
+		if(CommandLineOptions::GetStartRecording()) {
+			m_page_record->OnRecordStart();
+		}
+		if(CommandLineOptions::GetActivateSchedule()) {
+			m_page_record->OnScheduleActivate();
+		}
 	}
 
 }
@@ -149,6 +173,7 @@ void MainWindow::LoadSettings() {
 	QSettings settings(CommandLineOptions::GetSettingsFile(), QSettings::IniFormat);
 
 	SetNVidiaDisableFlipping(StringToEnum(settings.value("global/nvidia_disable_flipping", QString()).toString(), NVIDIA_DISABLE_FLIPPING_ASK));
+	m_calibration_never_ask = settings.value("global/calibration_never_ask", false).toBool();
 
 	m_page_welcome->LoadSettings(&settings);
 	m_page_input->LoadSettings(&settings);
@@ -163,6 +188,7 @@ void MainWindow::SaveSettings() {
 	settings.clear();
 
 	settings.setValue("global/nvidia_disable_flipping", EnumToString(GetNVidiaDisableFlipping()));
+	settings.setValue("global/calibration_never_ask", m_calibration_never_ask);
 
 	m_page_welcome->SaveSettings(&settings);
 	m_page_input->SaveSettings(&settings);
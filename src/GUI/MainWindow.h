@@ -41,8 +41,10 @@ public:
 	static const QString WINDOW_CAPTION;
 
 private:
+	bool m_headless;
 	enum_nvidia_disable_flipping m_nvidia_disable_flipping;
 	bool m_nvidia_reenable_flipping;
+	bool m_calibration_never_ask;
 
 	QRect m_old_geometry;
 
@@ -54,7 +56,9 @@ private:
 	PageDone *m_page_done;
 
 public:
-	MainWindow();
+	// In headless mode (backend mode and --calibrate) the window is never shown, no questions are asked, and the recording
+	// is not started automatically, the caller takes care of that.
+	MainWindow(bool headless = false);
 	~MainWindow();
 
 	void LoadSettings();
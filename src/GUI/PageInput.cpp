@@ -46,6 +46,13 @@ ENUMSTRINGS(PageInput::enum_video_x11_area) = {
 	{PageInput::VIDEO_X11_AREA_CURSOR, "cursor"},
 };
 
+ENUMSTRINGS(PageInput::enum_video_overlay_position) = {
+	{PageInput::VIDEO_OVERLAY_POSITION_TOP_LEFT, "top-left"},
+	{PageInput::VIDEO_OVERLAY_POSITION_TOP_RIGHT, "top-right"},
+	{PageInput::VIDEO_OVERLAY_POSITION_BOTTOM_LEFT, "bottom-left"},
+	{PageInput::VIDEO_OVERLAY_POSITION_BOTTOM_RIGHT, "bottom-right"},
+};
+
 ENUMSTRINGS(PageInput::enum_audio_backend) = {
 #if SSR_USE_ALSA
 	{PageInput::AUDIO_BACKEND_ALSA, "alsa"},
@@ -395,9 +402,40 @@ PageInput::PageInput(MainWindow* main_window)
 			m_spinbox_video_scaled_height = new QSpinBox(groupbox_video);
 			m_spinbox_video_scaled_height->setRange(0, SSR_MAX_IMAGE_SIZE);
 			m_spinbox_video_scaled_height->setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Fixed);
+			m_checkbox_video_letterbox = new QCheckBox(tr("Keep the aspect ratio"), groupbox_video);
+			m_checkbox_video_letterbox->setToolTip(tr("If checked, video with a different aspect ratio than the output (e.g. because the recording area was changed\n"
+													  "while recording) is scaled to fit and the remaining area is filled with black, instead of being stretched."));
 			m_checkbox_record_cursor = new QCheckBox(tr("Record cursor"), groupbox_video);
+			m_checkbox_adaptive_frame_rate = new QCheckBox(tr("Reduce the frame rate when the screen is idle"), groupbox_video);
+			m_checkbox_adaptive_frame_rate->setToolTip(tr("Capture fewer frames while nothing changes on the screen, and go back to the full frame rate as soon as\n"
+														  "something changes or the cursor moves. This saves CPU time. The video keeps the selected frame rate."));
+#if SSR_USE_V4L2
+			m_checkbox_video_overlay = new QCheckBox(tr("Add a webcam overlay"), groupbox_video);
+			m_checkbox_video_overlay->setToolTip(tr("Draw the image of a V4L2 device (e.g. a webcam) on top of the recording, in one of the corners."));
+			m_label_video_overlay_device = new QLabel(tr("Device:"), groupbox_video);
+			m_lineedit_video_overlay_device = new QLineEdit(groupbox_video);
+			m_lineedit_video_overlay_device->setToolTip(tr("The V4L2 device to use for the overlay (e.g. /dev/video0)."));
+			m_label_video_overlay_position = new QLabel(tr("Position:"), groupbox_video);
+			m_combobox_video_overlay_position = new QComboBox(groupbox_video);
+			m_combobox_video_overlay_position->addItem(tr("Top left"));
+			m_combobox_video_overlay_position->addItem(tr("Top right"));
+			m_combobox_video_overlay_position->addItem(tr("Bottom left"));
+			m_combobox_video_overlay_position->addItem(tr("Bottom right"));
+			m_label_video_overlay_size = new QLabel(tr("Size:"), groupbox_video);
+			m_spinbox_video_overlay_size = new QSpinBox(groupbox_video);
+			m_spinbox_video_overlay_size->setRange(5, 100);
+			m_spinbox_video_overlay_size->setSuffix(" %");
+			m_spinbox_video_overlay_size->setToolTip(tr("The width of the overlay, relative to the width of the video."));
+			m_label_video_overlay_opacity = new QLabel(tr("Opacity:"), groupbox_video);
+			m_spinbox_video_overlay_opacity = new QSpinBox(groupbox_video);
+			m_spinbox_video_overlay_opacity->setRange(0, 100);
+			m_spinbox_video_overlay_opacity->setSuffix(" %");
+#endif
 
 			connect(m_combobox_video_backend, SIGNAL(activated(int)), this, SLOT(OnUpdateVideoAreaFields()));
+#if SSR_USE_V4L2
+			connect(m_checkbox_video_overlay, SIGNAL(toggled(bool)), this, SLOT(OnUpdateVideoAreaFields()));
+#endif
 #if QT_VERSION >= QT_VERSION_CHECK(6, 0, 0)
 			connect(m_buttongroup_video_x11_area, SIGNAL(buttonClicked(QAbstractButton*)), this, SLOT(OnUpdateVideoAreaFields()));
 #else
@@ -515,7 +553,24 @@ PageInput::PageInput(MainWindow* main_window)
 				layout2->addWidget(m_label_video_scaled_height, 0, 2);
 				layout2->addWidget(m_spinbox_video_scaled_height, 0, 3);
 			}
+			layout->addWidget(m_checkbox_video_letterbox);
 			layout->addWidget(m_checkbox_record_cursor);
+			layout->addWidget(m_checkbox_adaptive_frame_rate);
+#if SSR_USE_V4L2
+			layout->addWidget(m_checkbox_video_overlay);
+			{
+				QGridLayout *layout2 = new QGridLayout();
+				layout->addLayout(layout2);
+				layout2->addWidget(m_label_video_overlay_device, 0, 0);
+				layout2->addWidget(m_lineedit_video_overlay_device, 0, 1);
+				layout2->addWidget(m_label_video_overlay_position, 0, 2);
+				layout2->addWidget(m_combobox_video_overlay_position, 0, 3);
+				layout2->addWidget(m_label_video_overlay_size, 1, 0);
+				layout2->addWidget(m_spinbox_video_overlay_size, 1, 1);
+				layout2->addWidget(m_label_video_overlay_opacity, 1, 2);
+				layout2->addWidget(m_spinbox_video_overlay_opacity, 1, 3);
+			}
+#endif
 		}
 		QGroupBox *groupbox_audio = new QGroupBox(tr("Audio input"), scrollarea_contents);
 		{
@@ -635,12 +690,7 @@ PageInput::PageInput(MainWindow* main_window)
 #endif
 
 	LoadScreenConfigurations();
-#if SSR_USE_ALSA
-	LoadALSASources();
-#endif
-#if SSR_USE_PULSEAUDIO
-	LoadPulseAudioSources();
-#endif
+	StartAudioSourceThread();
 
 	// temporary settings to calculate the worst-case size
 	SetAudioEnabled(true);
@@ -664,6 +714,12 @@ PageInput::PageInput(MainWindow* main_window)
 
 }
 
+PageInput::~PageInput() {
+	// there is no way to interrupt the enumeration, so we have to wait
+	if(m_audio_source_thread.joinable())
+		m_audio_source_thread.join();
+}
+
 void PageInput::LoadSettings(QSettings* settings) {
 	SetProfile(m_profile_box->FindProfile(settings->value("input/profile", QString()).toString()));
 	LoadProfileSettings(settings);
@@ -687,9 +743,11 @@ void PageInput::SaveProfileSettingsCallback(QSettings* settings, void* userdata)
 void PageInput::LoadProfileSettings(QSettings* settings) {
 
 	// choose default audio backend
+	// if the PulseAudio sources are still being enumerated, PulseAudio is used for now and the choice is revised when the result arrives
 #if SSR_USE_ALSA
 #if SSR_USE_PULSEAUDIO
 	enum_audio_backend default_audio_backend = (m_pulseaudio_available)? AUDIO_BACKEND_PULSEAUDIO : AUDIO_BACKEND_ALSA;
+	m_audio_backend_default_pending = (m_pulseaudio_loading && settings->value("input/audio_backend", QString()).toString().isEmpty());
 #else
 	enum_audio_backend default_audio_backend = AUDIO_BACKEND_ALSA;
 #endif
@@ -724,14 +782,23 @@ void PageInput::LoadProfileSettings(QSettings* settings) {
 	SetVideoScalingEnabled(settings->value("input/video_scale", false).toBool());
 	SetVideoScaledWidth(settings->value("input/video_scaled_width", 854).toUInt());
 	SetVideoScaledHeight(settings->value("input/video_scaled_height", 480).toUInt());
+	SetVideoLetterbox(settings->value("input/video_letterbox", false).toBool());
 	SetVideoRecordCursor(settings->value("input/video_record_cursor", true).toBool());
+	SetVideoAdaptiveFrameRate(settings->value("input/video_adaptive_frame_rate", false).toBool());
+#if SSR_USE_V4L2
+	SetVideoOverlayEnabled(settings->value("input/video_overlay", false).toBool());
+	SetVideoOverlayDevice(settings->value("input/video_overlay_device", "/dev/video0").toString());
+	SetVideoOverlayPosition(StringToEnum(settings->value("input/video_overlay_position", QString()).toString(), VIDEO_OVERLAY_POSITION_BOTTOM_RIGHT));
+	SetVideoOverlaySize(settings->value("input/video_overlay_size", 25).toUInt());
+	SetVideoOverlayOpacity(settings->value("input/video_overlay_opacity", 100).toUInt());
+#endif
 	SetAudioEnabled(settings->value("input/audio_enabled", true).toBool());
 	SetAudioBackend(StringToEnum(settings->value("input/audio_backend", QString()).toString(), default_audio_backend));
 #if SSR_USE_ALSA
-	SetALSASource(FindALSASource(settings->value("input/audio_alsa_source", QString()).toString()));
+	SelectALSASource(settings->value("input/audio_alsa_source", QString()).toString());
 #endif
 #if SSR_USE_PULSEAUDIO
-	SetPulseAudioSource(FindPulseAudioSource(settings->value("input/audio_pulseaudio_source", QString()).toString()));
+	SelectPulseAudioSource(settings->value("input/audio_pulseaudio_source", QString()).toString());
 #endif
 #if SSR_USE_JACK
 	SetJackConnectSystemCapture(settings->value("input/audio_jack_connect_system_capture", true).toBool());
@@ -777,7 +844,16 @@ void PageInput::SaveProfileSettings(QSettings* settings) {
 	settings->setValue("input/video_scale", GetVideoScalingEnabled());
 	settings->setValue("input/video_scaled_width", GetVideoScaledWeight());
 	settings->setValue("input/video_scaled_height", GetVideoScaledHeight());
+	settings->setValue("input/video_letterbox", GetVideoLetterbox());
 	settings->setValue("input/video_record_cursor", GetVideoRecordCursor());
+	settings->setValue("input/video_adaptive_frame_rate", GetVideoAdaptiveFrameRate());
+#if SSR_USE_V4L2
+	settings->setValue("input/video_overlay", GetVideoOverlayEnabled());
+	settings->setValue("input/video_overlay_device", GetVideoOverlayDevice());
+	settings->setValue("input/video_overlay_position", EnumToString(GetVideoOverlayPosition()));
+	settings->setValue("input/video_overlay_size", GetVideoOverlaySize());
+	settings->setValue("input/video_overlay_opacity", GetVideoOverlayOpacity());
+#endif
 	settings->setValue("input/audio_enabled", GetAudioEnabled());
 	settings->setValue("input/audio_backend", EnumToString(GetAudioBackend()));
 #if SSR_USE_ALSA
@@ -806,14 +882,24 @@ bool PageInput::Validate() {
 	return true;
 }
 
+void PageInput::WaitForAudioSources() {
+	if(m_audio_source_thread.joinable())
+		m_audio_source_thread.join();
+	OnAudioSourcesLoaded();
+}
+
 #if SSR_USE_ALSA
 QString PageInput::GetALSASourceName() {
+	if(m_alsa_loading)
+		return m_alsa_pending_source;
 	return QString::fromStdString(m_alsa_sources[GetALSASource()].m_name);
 }
 #endif
 
 #if SSR_USE_PULSEAUDIO
 QString PageInput::GetPulseAudioSourceName() {
+	if(m_pulseaudio_loading)
+		return m_pulseaudio_pending_source;
 	return QString::fromStdString(m_pulseaudio_sources[GetPulseAudioSource()].m_name);
 }
 #endif
@@ -826,6 +912,15 @@ unsigned int PageInput::FindALSASource(const QString& name) {
 	}
 	return 0;
 }
+
+// Selects a source by name. If the sources are still being enumerated, the selection is applied when the list arrives.
+void PageInput::SelectALSASource(const QString& name) {
+	if(m_alsa_loading) {
+		m_alsa_pending_source = name;
+	} else {
+		SetALSASource(FindALSASource(name));
+	}
+}
 #endif
 
 #if SSR_USE_PULSEAUDIO
@@ -836,6 +931,14 @@ unsigned int PageInput::FindPulseAudioSource(const QString& name) {
 	}
 	return 0;
 }
+
+void PageInput::SelectPulseAudioSource(const QString& name) {
+	if(m_pulseaudio_loading) {
+		m_pulseaudio_pending_source = name;
+	} else {
+		SetPulseAudioSource(FindPulseAudioSource(name));
+	}
+}
 #endif
 
 // Tries to find the real window that corresponds to a top-level window (the actual window without window manager decorations).
@@ -1073,8 +1176,8 @@ void PageInput::LoadScreenConfigurations() {
 }
 
 #if SSR_USE_ALSA
-void PageInput::LoadALSASources() {
-	m_alsa_sources = ALSAInput::GetSourceList();
+void PageInput::LoadALSASources(const std::vector<ALSAInput::Source>& sources) {
+	m_alsa_sources = sources;
 	if(m_alsa_sources.empty()) {
 		m_alsa_sources.push_back(ALSAInput::Source("", "(no sources found)"));
 	}
@@ -1088,8 +1191,8 @@ void PageInput::LoadALSASources() {
 #endif
 
 #if SSR_USE_PULSEAUDIO
-void PageInput::LoadPulseAudioSources() {
-	m_pulseaudio_sources = PulseAudioInput::GetSourceList();
+void PageInput::LoadPulseAudioSources(const std::vector<PulseAudioInput::Source>& sources) {
+	m_pulseaudio_sources = sources;
 	if(m_pulseaudio_sources.empty()) {
 		m_pulseaudio_available = false;
 		m_pulseaudio_sources.push_back(PulseAudioInput::Source("", "(no sources found)"));
@@ -1104,6 +1207,67 @@ void PageInput::LoadPulseAudioSources() {
 }
 #endif
 
+void PageInput::StartAudioSourceThread() {
+	{
+		AudioSourceLock lock(&m_audio_source_data);
+#if SSR_USE_ALSA
+		lock->m_alsa_done = false;
+		lock->m_alsa_sources.clear();
+#endif
+#if SSR_USE_PULSEAUDIO
+		lock->m_pulseaudio_done = false;
+		lock->m_pulseaudio_sources.clear();
+#endif
+	}
+
+	// show a placeholder until the real list arrives
+#if SSR_USE_ALSA
+	m_alsa_loading = true;
+	m_alsa_pending_source = QString();
+	m_alsa_sources.clear();
+	m_alsa_sources.push_back(ALSAInput::Source("", "(loading ...)"));
+	m_combobox_alsa_source->clear();
+	m_combobox_alsa_source->addItem(tr("(loading ...)"));
+#endif
+#if SSR_USE_PULSEAUDIO
+	m_pulseaudio_loading = true;
+	m_pulseaudio_available = true; // assume that PulseAudio is available until we know better (see m_audio_backend_default_pending)
+	m_pulseaudio_pending_source = QString();
+	m_pulseaudio_sources.clear();
+	m_pulseaudio_sources.push_back(PulseAudioInput::Source("", "(loading ...)"));
+	m_combobox_pulseaudio_source->clear();
+	m_combobox_pulseaudio_source->addItem(tr("(loading ...)"));
+#endif
+
+#if SSR_USE_ALSA && SSR_USE_PULSEAUDIO
+	m_audio_backend_default_pending = false;
+#endif
+
+	m_audio_source_thread = std::thread(&PageInput::AudioSourceThread, this);
+}
+
+void PageInput::AudioSourceThread() {
+	// PulseAudio is the most common backend, so it goes first. The UI is updated as soon as each list is available.
+#if SSR_USE_PULSEAUDIO
+	{
+		std::vector<PulseAudioInput::Source> sources = PulseAudioInput::GetSourceList();
+		AudioSourceLock lock(&m_audio_source_data);
+		lock->m_pulseaudio_sources = std::move(sources);
+		lock->m_pulseaudio_done = true;
+	}
+	QMetaObject::invokeMethod(this, "OnAudioSourcesLoaded", Qt::QueuedConnection);
+#endif
+#if SSR_USE_ALSA
+	{
+		std::vector<ALSAInput::Source> sources = ALSAInput::GetSourceList();
+		AudioSourceLock lock(&m_audio_source_data);
+		lock->m_alsa_sources = std::move(sources);
+		lock->m_alsa_done = true;
+	}
+	QMetaObject::invokeMethod(this, "OnAudioSourcesLoaded", Qt::QueuedConnection);
+#endif
+}
+
 void PageInput::OnUpdateRecordingFrame() {
 	if(GetVideoBackend() == VIDEO_BACKEND_X11 && (m_spinbox_video_x11_x->hasFocus() || m_spinbox_video_x11_y->hasFocus() || m_spinbox_video_x11_width->hasFocus() || m_spinbox_video_x11_height->hasFocus())) {
 		if(m_recording_frame == NULL)
@@ -1146,6 +1310,14 @@ void PageInput::OnUpdateVideoAreaFields() {
 	GroupEnabled({m_checkbox_record_cursor}, (backend == VIDEO_BACKEND_X11 || backend == VIDEO_BACKEND_GLINJECT));
 #else
 	GroupEnabled({m_checkbox_record_cursor}, (backend == VIDEO_BACKEND_X11));
+#endif
+	GroupEnabled({m_checkbox_adaptive_frame_rate}, (backend == VIDEO_BACKEND_X11));
+#if SSR_USE_V4L2
+	GroupEnabled({m_checkbox_video_overlay}, (backend != VIDEO_BACKEND_V4L2));
+	GroupEnabled({
+		m_label_video_overlay_device, m_lineedit_video_overlay_device, m_label_video_overlay_position, m_combobox_video_overlay_position,
+		m_label_video_overlay_size, m_spinbox_video_overlay_size, m_label_video_overlay_opacity, m_spinbox_video_overlay_opacity,
+	}, (backend != VIDEO_BACKEND_V4L2 && m_checkbox_video_overlay->isChecked()));
 #endif
 	if(GetVideoBackend() == VIDEO_BACKEND_X11) {
 		switch(GetVideoX11Area()) {
@@ -1265,20 +1437,57 @@ void PageInput::OnUpdateScreenConfiguration() {
 
 #if SSR_USE_ALSA
 void PageInput::OnUpdateALSASources() {
+	if(m_alsa_loading)
+		return;
 	QString selected_source = GetALSASourceName();
-	LoadALSASources();
+	LoadALSASources(ALSAInput::GetSourceList());
 	SetALSASource(FindALSASource(selected_source));
 }
 #endif
 
 #if SSR_USE_PULSEAUDIO
 void PageInput::OnUpdatePulseAudioSources() {
+	if(m_pulseaudio_loading)
+		return;
 	QString selected_source = GetPulseAudioSourceName();
-	LoadPulseAudioSources();
+	LoadPulseAudioSources(PulseAudioInput::GetSourceList());
 	SetPulseAudioSource(FindPulseAudioSource(selected_source));
 }
 #endif
 
+void PageInput::OnAudioSourcesLoaded() {
+#if SSR_USE_ALSA
+	if(m_alsa_loading) {
+		AudioSourceLock lock(&m_audio_source_data);
+		if(lock->m_alsa_done) {
+			m_alsa_loading = false;
+			LoadALSASources(lock->m_alsa_sources);
+			SetALSASource(FindALSASource(m_alsa_pending_source));
+		}
+	}
+#endif
+#if SSR_USE_PULSEAUDIO
+	if(m_pulseaudio_loading) {
+		AudioSourceLock lock(&m_audio_source_data);
+		if(lock->m_pulseaudio_done) {
+			m_pulseaudio_loading = false;
+			LoadPulseAudioSources(lock->m_pulseaudio_sources);
+			SetPulseAudioSource(FindPulseAudioSource(m_pulseaudio_pending_source));
+		}
+	}
+#endif
+#if SSR_USE_ALSA && SSR_USE_PULSEAUDIO
+	// now the default audio backend can be chosen, unless the user has already picked a different one
+	if(m_audio_backend_default_pending && !m_pulseaudio_loading) {
+		m_audio_backend_default_pending = false;
+		if(!m_pulseaudio_available && GetAudioBackend() == AUDIO_BACKEND_PULSEAUDIO) {
+			SetAudioBackend(AUDIO_BACKEND_ALSA);
+			OnUpdateAudioFields();
+		}
+	}
+#endif
+}
+
 void PageInput::OnIdentifyScreens() {
 	OnStopIdentifyScreens();
 	std::vector<QRect> screen_geometries = GetScreenGeometries();
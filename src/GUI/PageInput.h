@@ -21,6 +21,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Global.h"
 
 #include "ProfileBox.h"
+#include "MutexDataPair.h"
 
 #if SSR_USE_ALSA
 #include "ALSAInput.h"
@@ -123,6 +124,13 @@ public:
 		VIDEO_X11_AREA_CURSOR,
 		VIDEO_X11_AREA_COUNT // must be last
 	};
+	enum enum_video_overlay_position {
+		VIDEO_OVERLAY_POSITION_TOP_LEFT,
+		VIDEO_OVERLAY_POSITION_TOP_RIGHT,
+		VIDEO_OVERLAY_POSITION_BOTTOM_LEFT,
+		VIDEO_OVERLAY_POSITION_BOTTOM_RIGHT,
+		VIDEO_OVERLAY_POSITION_COUNT // must be last
+	};
 	enum enum_audio_backend {
 #if SSR_USE_ALSA
 		AUDIO_BACKEND_ALSA,
@@ -136,6 +144,19 @@ public:
 		AUDIO_BACKEND_COUNT // must be last
 	};
 
+private:
+	struct AudioSourceData {
+#if SSR_USE_ALSA
+		bool m_alsa_done;
+		std::vector<ALSAInput::Source> m_alsa_sources;
+#endif
+#if SSR_USE_PULSEAUDIO
+		bool m_pulseaudio_done;
+		std::vector<PulseAudioInput::Source> m_pulseaudio_sources;
+#endif
+	};
+	typedef MutexDataPair<AudioSourceData>::Lock AudioSourceLock;
+
 private:
 	MainWindow *m_main_window;
 
@@ -145,12 +166,23 @@ private:
 
 #if SSR_USE_ALSA
 	std::vector<ALSAInput::Source> m_alsa_sources;
+	bool m_alsa_loading;
+	QString m_alsa_pending_source;
 #endif
 #if SSR_USE_PULSEAUDIO
 	bool m_pulseaudio_available;
 	std::vector<PulseAudioInput::Source> m_pulseaudio_sources;
+	bool m_pulseaudio_loading;
+	QString m_pulseaudio_pending_source;
+#endif
+#if SSR_USE_ALSA && SSR_USE_PULSEAUDIO
+	bool m_audio_backend_default_pending; // the default backend depends on whether PulseAudio is available, which isn't known yet
 #endif
 
+	// the audio sources are enumerated in the background because this can be slow
+	std::thread m_audio_source_thread;
+	MutexDataPair<AudioSourceData> m_audio_source_data;
+
 #if SSR_USE_OPENGL_RECORDING
 	QString m_glinject_channel;
 	bool m_glinject_relax_permissions;
@@ -190,7 +222,16 @@ private:
 	QCheckBox *m_checkbox_scale;
 	QLabel *m_label_video_scaled_width, *m_label_video_scaled_height;
 	QSpinBox *m_spinbox_video_scaled_weight, *m_spinbox_video_scaled_height;
+	QCheckBox *m_checkbox_video_letterbox;
 	QCheckBox *m_checkbox_record_cursor;
+	QCheckBox *m_checkbox_adaptive_frame_rate;
+#if SSR_USE_V4L2
+	QCheckBox *m_checkbox_video_overlay;
+	QLabel *m_label_video_overlay_device, *m_label_video_overlay_position, *m_label_video_overlay_size, *m_label_video_overlay_opacity;
+	QLineEdit *m_lineedit_video_overlay_device;
+	QComboBox *m_combobox_video_overlay_position;
+	QSpinBox *m_spinbox_video_overlay_size, *m_spinbox_video_overlay_opacity;
+#endif
 
 	QCheckBox *m_checkbox_audio_enable;
 	QLabel *m_label_audio_backend;
@@ -211,6 +252,7 @@ private:
 
 public:
 	PageInput(MainWindow* main_window);
+	~PageInput();
 
 	void LoadSettings(QSettings* settings);
 	void SaveSettings(QSettings* settings);
@@ -224,6 +266,9 @@ private:
 public:
 	bool Validate();
 
+	// Blocks until the audio sources have been enumerated. This should be called before the source names are used to start a recording.
+	void WaitForAudioSources();
+
 #if SSR_USE_ALSA
 	QString GetALSASourceName();
 #endif
@@ -234,9 +279,11 @@ public:
 private:
 #if SSR_USE_ALSA
 	unsigned int FindALSASource(const QString& name);
+	void SelectALSASource(const QString& name);
 #endif
 #if SSR_USE_PULSEAUDIO
 	unsigned int FindPulseAudioSource(const QString& name);
+	void SelectPulseAudioSource(const QString& name);
 #endif
 
 protected:
@@ -253,11 +300,13 @@ private:
 
 	void LoadScreenConfigurations();
 #if SSR_USE_ALSA
-	void LoadALSASources();
+	void LoadALSASources(const std::vector<ALSAInput::Source>& sources);
 #endif
 #if SSR_USE_PULSEAUDIO
-	void LoadPulseAudioSources();
+	void LoadPulseAudioSources(const std::vector<PulseAudioInput::Source>& sources);
 #endif
+	void StartAudioSourceThread();
+	void AudioSourceThread();
 
 public slots:
 	void OnUpdateRecordingFrame();
@@ -277,6 +326,7 @@ private slots:
 #if SSR_USE_PULSEAUDIO
 	void OnUpdatePulseAudioSources();
 #endif
+	void OnAudioSourcesLoaded();
 	void OnIdentifyScreens();
 	void OnStopIdentifyScreens();
 	void OnStartSelectRectangle();
@@ -310,7 +360,16 @@ public:
 	inline bool GetVideoScalingEnabled() { return m_checkbox_scale->isChecked(); }
 	inline unsigned int GetVideoScaledWeight() { return m_spinbox_video_scaled_weight->value(); }
 	inline unsigned int GetVideoScaledHeight() { return m_spinbox_video_scaled_height->value(); }
+	inline bool GetVideoLetterbox() { return m_checkbox_video_letterbox->isChecked(); }
 	inline bool GetVideoRecordCursor() { return m_checkbox_record_cursor->isChecked(); }
+	inline bool GetVideoAdaptiveFrameRate() { return m_checkbox_adaptive_frame_rate->isChecked(); }
+#if SSR_USE_V4L2
+	inline bool GetVideoOverlayEnabled() { return m_checkbox_video_overlay->isChecked(); }
+	inline QString GetVideoOverlayDevice() { return m_lineedit_video_overlay_device->text(); }
+	inline enum_video_overlay_position GetVideoOverlayPosition() { return (enum_video_overlay_position) clamp(m_combobox_video_overlay_position->currentIndex(), 0, VIDEO_OVERLAY_POSITION_COUNT - 1); }
+	inline unsigned int GetVideoOverlaySize() { return m_spinbox_video_overlay_size->value(); }
+	inline unsigned int GetVideoOverlayOpacity() { return m_spinbox_video_overlay_opacity->value(); }
+#endif
 	inline bool GetAudioEnabled() { return m_checkbox_audio_enable->isChecked(); }
 	inline enum_audio_backend GetAudioBackend() { return (enum_audio_backend) clamp(m_combobox_audio_backend->currentIndex(), 0, AUDIO_BACKEND_COUNT - 1); }
 #if SSR_USE_ALSA
@@ -355,7 +414,16 @@ public:
 	inline void SetVideoScalingEnabled(bool enable) { m_checkbox_scale->setChecked(enable); }
 	inline void SetVideoScaledWidth(unsigned int scaled_w) { m_spinbox_video_scaled_weight->setValue(scaled_w); }
 	inline void SetVideoScaledHeight(unsigned int scaled_h) { m_spinbox_video_scaled_height->setValue(scaled_h); }
+	inline void SetVideoLetterbox(bool letterbox) { m_checkbox_video_letterbox->setChecked(letterbox); }
 	inline void SetVideoRecordCursor(bool show) { m_checkbox_record_cursor->setChecked(show); }
+	inline void SetVideoAdaptiveFrameRate(bool enable) { m_checkbox_adaptive_frame_rate->setChecked(enable); }
+#if SSR_USE_V4L2
+	inline void SetVideoOverlayEnabled(bool enable) { m_checkbox_video_overlay->setChecked(enable); }
+	inline void SetVideoOverlayDevice(const QString& device) { m_lineedit_video_overlay_device->setText(device); }
+	inline void SetVideoOverlayPosition(enum_video_overlay_position position) { m_combobox_video_overlay_position->setCurrentIndex(clamp((int) position, 0, VIDEO_OVERLAY_POSITION_COUNT - 1)); }
+	inline void SetVideoOverlaySize(unsigned int size) { m_spinbox_video_overlay_size->setValue(size); }
+	inline void SetVideoOverlayOpacity(unsigned int opacity) { m_spinbox_video_overlay_opacity->setValue(opacity); }
+#endif
 	inline void SetAudioEnabled(bool enable) { m_checkbox_audio_enable->setChecked(enable); }
 	inline void SetAudioBackend(enum_audio_backend backend) { m_combobox_audio_backend->setCurrentIndex(clamp((int) backend, 0, AUDIO_BACKEND_COUNT - 1)); }
 #if SSR_USE_ALSA
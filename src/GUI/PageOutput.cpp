@@ -19,6 +19,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "PageOutput.h"
 
+#include "DialogCalibration.h"
 #include "Dialogs.h"
 #include "EnumStrings.h"
 #include "HiddenScrollArea.h"
@@ -30,6 +31,8 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "AVWrapper.h"
 #include "VideoEncoder.h"
 #include "AudioEncoder.h"
+#include "Calibration.h"
+#include "CapabilityCache.h"
 
 ENUMSTRINGS(PageOutput::enum_container) = {
 	{PageOutput::CONTAINER_MKV, "mkv"},
@@ -73,6 +76,7 @@ PageOutput::PageOutput(MainWindow* main_window)
 
 	m_main_window = main_window;
 
+	m_video_conversion_threads = -1;
 	m_old_container = (enum_container) 0;
 	m_old_container_av = 0;
 
@@ -108,7 +112,7 @@ PageOutput::PageOutput(MainWindow* main_window)
 	};
 
 	// alternative aac codec
-	if(!AVCodecIsInstalled(m_audio_codecs[AUDIO_CODEC_AAC].avname)) {
+	if(!CapabilityCache::CodecIsInstalled(m_audio_codecs[AUDIO_CODEC_AAC].avname)) {
 		m_audio_codecs[AUDIO_CODEC_AAC].avname = "aac";
 	}
 
@@ -153,13 +157,13 @@ PageOutput::PageOutput(MainWindow* main_window)
 #endif
 		if(!av_codec_is_encoder(codec))
 			continue;
-		if(codec->type == AVMEDIA_TYPE_VIDEO && VideoEncoder::AVCodecIsSupported(codec->name)) {
+		if(codec->type == AVMEDIA_TYPE_VIDEO && CapabilityCache::VideoCodecIsSupported(codec->name)) {
 			VideoCodecData c;
 			c.name = codec->long_name;
 			c.avname = codec->name;
 			m_video_codecs_av.push_back(c);
 		}
-		if(codec->type == AVMEDIA_TYPE_AUDIO && AudioEncoder::AVCodecIsSupported(codec->name)) {
+		if(codec->type == AVMEDIA_TYPE_AUDIO && CapabilityCache::AudioCodecIsSupported(codec->name)) {
 			AudioCodecData c;
 			c.name = codec->long_name;
 			c.avname = codec->name;
@@ -204,7 +208,7 @@ PageOutput::PageOutput(MainWindow* main_window)
 			m_combobox_container = new QComboBox(groupbox_file);
 			for(unsigned int i = 0; i < CONTAINER_COUNT; ++i) {
 				QString name = "\u200e" + m_containers[i].name + "\u200e";
-				if(i != CONTAINER_OTHER && !AVFormatIsInstalled(m_containers[i].avname))
+				if(i != CONTAINER_OTHER && !CapabilityCache::FormatIsInstalled(m_containers[i].avname))
 					name += " \u200e" + tr("(not installed)") + "\u200e";
 				m_combobox_container->addItem(name);
 			}
@@ -226,6 +230,14 @@ PageOutput::PageOutput(MainWindow* main_window)
 			m_combobox_container_av->setToolTip(tr("For advanced users. You can use any libav/ffmpeg format, but many of them are not useful or may not work."));
 			m_label_container_warning = new QLabel(tr("Warning: This format will produce unreadable files if the recording is interrupted! Consider using MKV instead."), groupbox_file);
 			m_label_container_warning->setWordWrap(true);
+			m_checkbox_packet_journal = new QCheckBox(tr("Write a recovery journal"), groupbox_file);
+			m_checkbox_packet_journal->setToolTip(tr("If checked, all encoded data will also be written to a file with the extension '.journal'. If the program\n"
+													 "crashes, the recording can be rebuilt from this file with the command line option --recover-journal.\n"
+													 "The journal is deleted automatically when the recording is saved successfully."));
+			m_checkbox_checksum_manifest = new QCheckBox(tr("Write checksums"), groupbox_file);
+			m_checkbox_checksum_manifest->setToolTip(tr("If checked, SHA-256 checksums of the file (and of every 16 MiB chunk) will be calculated while recording\n"
+														"and saved in a file with the extension '.sha256.json', so the recording doesn't have to be read again\n"
+														"to verify copies of it."));
 
 			connect(m_combobox_container, SIGNAL(activated(int)), this, SLOT(OnUpdateSuffixAndContainerFields()));
 			connect(m_combobox_container_av, SIGNAL(activated(int)), this, SLOT(OnUpdateSuffixAndContainerFields()));
@@ -246,6 +258,12 @@ PageOutput::PageOutput(MainWindow* main_window)
 			layout->addWidget(m_label_container_av, 3, 0);
 			layout->addWidget(m_combobox_container_av, 3, 1, 1, 2);
 			layout->addWidget(m_label_container_warning, 4, 0, 1, 3);
+			{
+				QHBoxLayout *layout2 = new QHBoxLayout();
+				layout->addLayout(layout2, 5, 0, 1, 3);
+				layout2->addWidget(m_checkbox_packet_journal);
+				layout2->addWidget(m_checkbox_checksum_manifest);
+			}
 		}
 		QGroupBox *groupbox_video = new QGroupBox(tr("Video"), scrollarea_contents);
 		{
@@ -287,6 +305,9 @@ PageOutput::PageOutput(MainWindow* main_window)
 			}
 			m_combobox_h264_preset->setToolTip(tr("The encoding speed. A higher speed uses less CPU (making higher recording frame rates possible),\n"
 												  "but results in larger files. The quality shouldn't be affected too much."));
+			m_pushbutton_calibrate = new QPushButton(tr("Calibrate ..."), groupbox_video);
+			m_pushbutton_calibrate->setToolTip(tr("Measure the speed of this computer for the current recording settings, and pick the\n"
+												  "slowest preset that can still keep up with the frame rate. This takes about a minute."));
 			m_label_vp8_cpu_used = new QLabel(tr("CPU used:", "libvpx setting: don't translate this unless you can come up with something sensible"), groupbox_video);
 			m_combobox_vp8_cpu_used = new QComboBox(groupbox_video);
 			m_combobox_vp8_cpu_used->addItem("5 (" + tr("fastest") + ")");
@@ -305,9 +326,24 @@ PageOutput::PageOutput(MainWindow* main_window)
 																 "lower than the output frame rate. If not checked, input frames will be duplicated to fill the holes.\n"
 																 "This increases the file size and CPU usage, but reduces the latency for live streams in some cases.\n"
 																 "It shouldn't affect the appearance of the video."));
+			m_checkbox_video_content_hints = new QCheckBox(tr("Optimize for screen content"), groupbox_video);
+			m_checkbox_video_content_hints->setToolTip(tr("If checked, each frame will be compared with the previous frame before it is encoded. Frames that didn't change\n"
+														  "are not converted again and are encoded with as few bits as possible, and a keyframe is inserted when the\n"
+														  "whole screen changes. This reduces the file size and CPU usage when the screen is mostly static."));
+			m_checkbox_video_roi_cursor = new QCheckBox(tr("Higher quality around the cursor"), groupbox_video);
+			m_checkbox_video_roi_cursor->setToolTip(tr("If checked, the encoder will use more bits for the area around the mouse cursor, so text near the cursor\n"
+													   "stays readable when the video is scaled down or the bit rate is limited. Only some codecs (e.g. H.264\n"
+													   "and H.265) support this."));
+			m_checkbox_video_roi_window = new QCheckBox(tr("Higher quality in the active window"), groupbox_video);
+			m_checkbox_video_roi_window->setToolTip(tr("If checked, the encoder will use more bits for the window that has the focus. This requires a window manager\n"
+													   "that supports _NET_ACTIVE_WINDOW. Only some codecs (e.g. H.264 and H.265) support this."));
+			m_checkbox_video_activity_index = new QCheckBox(tr("Write an activity index"), groupbox_video);
+			m_checkbox_video_activity_index->setToolTip(tr("If checked, a small text file with the extension '.activity' will be written next to the recording. It lists how\n"
+														   "much of the screen changed in every second, so long recordings can be skimmed without watching them."));
 
 			connect(m_combobox_video_codec, SIGNAL(activated(int)), this, SLOT(OnUpdateVideoCodecFields()));
 			connect(m_slider_h264_crf, SIGNAL(valueChanged(int)), m_label_h264_crf_value, SLOT(setNum(int)));
+			connect(m_pushbutton_calibrate, SIGNAL(clicked()), this, SLOT(OnCalibrate()));
 
 			QGridLayout *layout = new QGridLayout(groupbox_video);
 			layout->addWidget(label_video_codec, 0, 0);
@@ -321,11 +357,16 @@ PageOutput::PageOutput(MainWindow* main_window)
 			layout->addWidget(m_label_h264_crf_value, 3, 2);
 			layout->addWidget(m_label_h264_preset, 4, 0);
 			layout->addWidget(m_combobox_h264_preset, 4, 1, 1, 2);
-			layout->addWidget(m_label_vp8_cpu_used, 5, 0);
-			layout->addWidget(m_combobox_vp8_cpu_used, 5, 1, 1, 2);
-			layout->addWidget(m_label_video_options, 6, 0);
-			layout->addWidget(m_lineedit_video_options, 6, 1, 1, 2);
-			layout->addWidget(m_checkbox_video_allow_frame_skipping, 7, 0, 1, 3);
+			layout->addWidget(m_pushbutton_calibrate, 5, 1, 1, 2);
+			layout->addWidget(m_label_vp8_cpu_used, 6, 0);
+			layout->addWidget(m_combobox_vp8_cpu_used, 6, 1, 1, 2);
+			layout->addWidget(m_label_video_options, 7, 0);
+			layout->addWidget(m_lineedit_video_options, 7, 1, 1, 2);
+			layout->addWidget(m_checkbox_video_allow_frame_skipping, 8, 0, 1, 3);
+			layout->addWidget(m_checkbox_video_content_hints, 9, 0, 1, 3);
+			layout->addWidget(m_checkbox_video_roi_cursor, 10, 0, 1, 3);
+			layout->addWidget(m_checkbox_video_roi_window, 11, 0, 1, 3);
+			layout->addWidget(m_checkbox_video_activity_index, 12, 0, 1, 3);
 		}
 		m_groupbox_audio = new QGroupBox(tr("Audio"), scrollarea_contents);
 		{
@@ -409,11 +450,13 @@ PageOutput::PageOutput(MainWindow* main_window)
 void PageOutput::LoadSettings(QSettings* settings) {
 	SetProfile(m_profile_box->FindProfile(settings->value("output/profile", QString()).toString()));
 	LoadProfileSettings(settings);
+	SetVideoConversionThreads(settings->value("output/video_conversion_threads", -1).toInt());
 }
 
 void PageOutput::SaveSettings(QSettings* settings) {
 	settings->setValue("output/profile", m_profile_box->GetProfileName());
 	SaveProfileSettings(settings);
+	settings->setValue("output/video_conversion_threads", GetVideoConversionThreads());
 }
 
 void PageOutput::LoadProfileSettingsCallback(QSettings* settings, void* userdata) {
@@ -431,21 +474,21 @@ void PageOutput::LoadProfileSettings(QSettings* settings) {
 	// choose default container and codecs
 	enum_container default_container = (enum_container) 0;
 	for(unsigned int i = 0; i < CONTAINER_OTHER; ++i) {
-		if(AVFormatIsInstalled(m_containers[i].avname)) {
+		if(CapabilityCache::FormatIsInstalled(m_containers[i].avname)) {
 			default_container = (enum_container) i;
 			break;
 		}
 	}
 	enum_video_codec default_video_codec = (enum_video_codec) 0;
 	for(unsigned int i = 0; i < VIDEO_CODEC_OTHER; ++i) {
-		if(AVCodecIsInstalled(m_video_codecs[i].avname) && m_containers[default_container].supported_video_codecs.count((enum_video_codec) i)) {
+		if(CapabilityCache::CodecIsInstalled(m_video_codecs[i].avname) && m_containers[default_container].supported_video_codecs.count((enum_video_codec) i)) {
 			default_video_codec = (enum_video_codec) i;
 			break;
 		}
 	}
 	enum_audio_codec default_audio_codec = (enum_audio_codec) 0;
 	for(unsigned int i = 0; i < VIDEO_CODEC_OTHER; ++i) {
-		if(AVCodecIsInstalled(m_audio_codecs[i].avname) && m_containers[default_container].supported_audio_codecs.count((enum_audio_codec) i)) {
+		if(CapabilityCache::CodecIsInstalled(m_audio_codecs[i].avname) && m_containers[default_container].supported_audio_codecs.count((enum_audio_codec) i)) {
 			default_audio_codec = (enum_audio_codec) i;
 			break;
 		}
@@ -467,6 +510,8 @@ void PageOutput::LoadProfileSettings(QSettings* settings) {
 	SetFile(settings->value("output/file", default_file).toString());
 	SetSeparateFiles(settings->value("output/separate_files", false).toBool());
 	SetAddTimestamp(settings->value("output/add_timestamp", true).toBool());
+	SetPacketJournal(settings->value("output/packet_journal", false).toBool());
+	SetChecksumManifest(settings->value("output/checksum_manifest", false).toBool());
 	SetContainer(StringToEnum(settings->value("output/container", QString()).toString(), default_container));
 	SetContainerAV(FindContainerAV(settings->value("output/container_av", QString()).toString()));
 
@@ -478,6 +523,10 @@ void PageOutput::LoadProfileSettings(QSettings* settings) {
 	SetVP8CPUUsed(settings->value("output/video_vp8_cpu_used", 5).toUInt());
 	SetVideoOptions(settings->value("output/video_options", "").toString());
 	SetVideoAllowFrameSkipping(settings->value("output/video_allow_frame_skipping", true).toBool());
+	SetVideoContentHints(settings->value("output/video_content_hints", false).toBool());
+	SetVideoROICursor(settings->value("output/video_roi_cursor", false).toBool());
+	SetVideoROIWindow(settings->value("output/video_roi_window", false).toBool());
+	SetVideoActivityIndex(settings->value("output/video_activity_index", false).toBool());
 
 	SetAudioCodec(StringToEnum(settings->value("output/audio_codec", QString()).toString(), default_audio_codec));
 	SetAudioCodecAV(FindAudioCodecAV(settings->value("output/audio_codec_av", QString()).toString()));
@@ -496,6 +545,8 @@ void PageOutput::SaveProfileSettings(QSettings* settings) {
 	settings->setValue("output/file", GetFile());
 	settings->setValue("output/separate_files", GetSeparateFiles());
 	settings->setValue("output/add_timestamp", GetAddTimestamp());
+	settings->setValue("output/packet_journal", GetPacketJournal());
+	settings->setValue("output/checksum_manifest", GetChecksumManifest());
 	settings->setValue("output/container", EnumToString(GetContainer()));
 	settings->setValue("output/container_av", m_containers_av[GetContainerAV()].avname);
 
@@ -507,6 +558,10 @@ void PageOutput::SaveProfileSettings(QSettings* settings) {
 	settings->setValue("output/video_vp8_cpu_used", GetVP8CPUUsed());
 	settings->setValue("output/video_options", GetVideoOptions());
 	settings->setValue("output/video_allow_frame_skipping", GetVideoAllowFrameSkipping());
+	settings->setValue("output/video_content_hints", GetVideoContentHints());
+	settings->setValue("output/video_roi_cursor", GetVideoROICursor());
+	settings->setValue("output/video_roi_window", GetVideoROIWindow());
+	settings->setValue("output/video_activity_index", GetVideoActivityIndex());
 
 	settings->setValue("output/audio_codec", EnumToString(GetAudioCodec()));
 	settings->setValue("output/audio_codec_av", m_audio_codecs_av[GetAudioCodecAV()].avname);
@@ -579,6 +634,47 @@ QString PageOutput::GetAudioCodecAVName() {
 		return m_audio_codecs_av[GetAudioCodecAV()].avname;
 }
 
+CalibrationSettings PageOutput::GetCalibrationSettings() {
+	PageInput *page_input = m_main_window->GetPageInput();
+	CalibrationSettings settings;
+	settings.m_x = 0;
+	settings.m_y = 0;
+	settings.m_width = 0;
+	settings.m_height = 0;
+	if(page_input->GetVideoBackend() == PageInput::VIDEO_BACKEND_X11) {
+		settings.m_x = page_input->GetVideoX11X();
+		settings.m_y = page_input->GetVideoX11Y();
+		settings.m_width = page_input->GetVideoX11Width() / 2 * 2;
+		settings.m_height = page_input->GetVideoX11Height() / 2 * 2;
+	}
+	if(page_input->GetVideoScalingEnabled()) {
+		settings.m_output_width = page_input->GetVideoScaledWeight() / 2 * 2;
+		settings.m_output_height = page_input->GetVideoScaledHeight() / 2 * 2;
+	} else if(settings.m_width != 0 && settings.m_height != 0) {
+		settings.m_output_width = settings.m_width;
+		settings.m_output_height = settings.m_height;
+	} else {
+		// the size of other inputs is only known while recording, so assume a common size
+		settings.m_output_width = 1920;
+		settings.m_output_height = 1080;
+	}
+	settings.m_frame_rate = page_input->GetVideoFrameRate();
+	settings.m_record_cursor = page_input->GetVideoRecordCursor();
+	settings.m_crf = GetH264CRF();
+	return settings;
+}
+
+void PageOutput::ApplyCalibration(const CalibrationResults& results) {
+	if(!results.m_preset.isEmpty()) {
+		SetH264Preset(StringToEnum(results.m_preset, GetH264Preset()));
+		Logger::LogInfo("[PageOutput::ApplyCalibration] " + tr("Using preset %1 from the calibration.").arg(results.m_preset));
+	}
+	if(results.m_convert_threads >= 0) {
+		SetVideoConversionThreads(results.m_convert_threads);
+		Logger::LogInfo("[PageOutput::ApplyCalibration] " + tr("Using %1 conversion thread(s) from the calibration.").arg(results.m_convert_threads));
+	}
+}
+
 unsigned int PageOutput::FindContainerAV(const QString& name) {
 	for(unsigned int i = 0; i < m_containers_av.size(); ++i) {
 		if(m_containers_av[i].avname == name)
@@ -642,7 +738,7 @@ void PageOutput::OnUpdateContainerFields() {
 	// mark uninstalled or unsupported codecs
 	for(unsigned int i = 0; i < VIDEO_CODEC_OTHER; ++i) {
 		QString name = m_video_codecs[i].name;
-		if(!AVCodecIsInstalled(m_video_codecs[i].avname))
+		if(!CapabilityCache::CodecIsInstalled(m_video_codecs[i].avname))
 			name += " (" + tr("not installed") + ")";
 		else if(container != CONTAINER_OTHER && !m_containers[container].supported_video_codecs.count((enum_video_codec) i))
 			name += " (" + tr("not supported by container") + ")";
@@ -650,7 +746,7 @@ void PageOutput::OnUpdateContainerFields() {
 	}
 	for(unsigned int i = 0; i < AUDIO_CODEC_OTHER; ++i) {
 		QString name = m_audio_codecs[i].name;
-		if(!AVCodecIsInstalled(m_audio_codecs[i].avname))
+		if(!CapabilityCache::CodecIsInstalled(m_audio_codecs[i].avname))
 			name += " (" + tr("not installed") + ")";
 		else if(container != CONTAINER_OTHER && !m_containers[container].supported_audio_codecs.count((enum_audio_codec) i))
 			name += " (" + tr("not supported by container") + ")";
@@ -666,7 +762,7 @@ void PageOutput::OnUpdateVideoCodecFields() {
 	enum_video_codec codec = GetVideoCodec();
 	MultiGroupVisible({
 		{{m_label_video_kbit_rate, m_lineedit_video_kbit_rate}, (codec != VIDEO_CODEC_H264)},
-		{{m_label_h264_crf, m_slider_h264_crf, m_label_h264_crf_value, m_label_h264_preset, m_combobox_h264_preset}, (codec == VIDEO_CODEC_H264)},
+		{{m_label_h264_crf, m_slider_h264_crf, m_label_h264_crf_value, m_label_h264_preset, m_combobox_h264_preset, m_pushbutton_calibrate}, (codec == VIDEO_CODEC_H264)},
 		{{m_label_vp8_cpu_used, m_combobox_vp8_cpu_used}, (codec == VIDEO_CODEC_VP8)},
 		{{m_label_video_codec_av, m_combobox_video_codec_av, m_label_video_options, m_lineedit_video_options}, (codec == VIDEO_CODEC_OTHER)},
 	});
@@ -733,6 +829,11 @@ void PageOutput::OnBrowse() {
 
 }
 
+void PageOutput::OnCalibrate() {
+	DialogCalibration dialog(this);
+	dialog.exec();
+}
+
 void PageOutput::OnContinue() {
 	if(!Validate())
 		return;
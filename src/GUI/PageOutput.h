@@ -23,6 +23,8 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "ProfileBox.h"
 
 class MainWindow;
+struct CalibrationSettings;
+struct CalibrationResults;
 
 class PageOutput : public QWidget {
 	Q_OBJECT
@@ -93,6 +95,8 @@ private:
 	std::vector<VideoCodecData> m_video_codecs, m_video_codecs_av;
 	std::vector<AudioCodecData> m_audio_codecs, m_audio_codecs_av;
 
+	int m_video_conversion_threads; // machine-specific, set by the calibration
+
 	ProfileBox *m_profile_box;
 
 	QComboBox *m_combobox_profiles;
@@ -104,6 +108,8 @@ private:
 	QLabel *m_label_container_av;
 	QComboBox *m_combobox_container_av;
 	QLabel *m_label_container_warning;
+	QCheckBox *m_checkbox_packet_journal;
+	QCheckBox *m_checkbox_checksum_manifest;
 
 	QComboBox *m_combobox_video_codec;
 	QLabel *m_label_video_codec_av;
@@ -115,11 +121,16 @@ private:
 	QLabel *m_label_h264_crf_value;
 	QLabel *m_label_h264_preset;
 	QComboBox *m_combobox_h264_preset;
+	QPushButton *m_pushbutton_calibrate;
 	QLabel *m_label_vp8_cpu_used;
 	QComboBox *m_combobox_vp8_cpu_used;
 	QLabel *m_label_video_options;
 	QLineEdit *m_lineedit_video_options;
 	QCheckBox *m_checkbox_video_allow_frame_skipping;
+	QCheckBox *m_checkbox_video_content_hints;
+	QCheckBox *m_checkbox_video_roi_cursor;
+	QCheckBox *m_checkbox_video_roi_window;
+	QCheckBox *m_checkbox_video_activity_index;
 
 	QGroupBox *m_groupbox_audio;
 	QComboBox *m_combobox_audio_codec;
@@ -151,6 +162,12 @@ public:
 	QString GetVideoCodecAVName();
 	QString GetAudioCodecAVName();
 
+	// Returns the settings that should be used for calibration, based on the current input and output settings.
+	CalibrationSettings GetCalibrationSettings();
+
+	// Applies the defaults that were picked by the calibration.
+	void ApplyCalibration(const CalibrationResults& results);
+
 private:
 	unsigned int FindContainerAV(const QString& name);
 	unsigned int FindVideoCodecAV(const QString& name);
@@ -169,6 +186,7 @@ public slots:
 
 private slots:
 	void OnBrowse();
+	void OnCalibrate();
 	void OnContinue();
 
 public:
@@ -176,6 +194,8 @@ public:
 	inline QString GetFile() { return m_lineedit_file->text(); }
 	inline bool GetSeparateFiles() { return m_checkbox_separate_files->isChecked(); }
 	inline bool GetAddTimestamp() { return m_checkbox_add_timestamp->isChecked(); }
+	inline bool GetPacketJournal() { return m_checkbox_packet_journal->isChecked(); }
+	inline bool GetChecksumManifest() { return m_checkbox_checksum_manifest->isChecked(); }
 	inline enum_container GetContainer() { return (enum_container) clamp(m_combobox_container->currentIndex(), 0, CONTAINER_COUNT - 1); }
 	inline unsigned int GetContainerAV() { return clamp(m_combobox_container_av->currentIndex(), 0, (int) m_containers_av.size() - 1); }
 	inline enum_video_codec GetVideoCodec() { return (enum_video_codec) clamp(m_combobox_video_codec->currentIndex(), 0, VIDEO_CODEC_COUNT - 1); }
@@ -186,6 +206,11 @@ public:
 	inline unsigned int GetVP8CPUUsed() { return clamp(5 - m_combobox_vp8_cpu_used->currentIndex(), 0, 5); }
 	inline QString GetVideoOptions() { return m_lineedit_video_options->text(); }
 	inline bool GetVideoAllowFrameSkipping() { return m_checkbox_video_allow_frame_skipping->isChecked(); }
+	inline bool GetVideoContentHints() { return m_checkbox_video_content_hints->isChecked(); }
+	inline bool GetVideoROICursor() { return m_checkbox_video_roi_cursor->isChecked(); }
+	inline bool GetVideoROIWindow() { return m_checkbox_video_roi_window->isChecked(); }
+	inline bool GetVideoActivityIndex() { return m_checkbox_video_activity_index->isChecked(); }
+	inline int GetVideoConversionThreads() { return m_video_conversion_threads; }
 	inline enum_audio_codec GetAudioCodec() { return (enum_audio_codec) clamp(m_combobox_audio_codec->currentIndex(), 0, AUDIO_CODEC_COUNT - 1); }
 	inline unsigned int GetAudioCodecAV() { return clamp(m_combobox_audio_codec_av->currentIndex(), 0, (int) m_audio_codecs_av.size() - 1); }
 	inline unsigned int GetAudioKBitRate() { return m_lineedit_audio_kbit_rate->text().toUInt(); }
@@ -197,6 +222,8 @@ public:
 	inline void SetFile(const QString& file) { m_lineedit_file->setText(file); }
 	inline void SetSeparateFiles(bool separate_files) { m_checkbox_separate_files->setChecked(separate_files); }
 	inline void SetAddTimestamp(bool add_timestamp) { m_checkbox_add_timestamp->setChecked(add_timestamp); }
+	inline void SetPacketJournal(bool packet_journal) { m_checkbox_packet_journal->setChecked(packet_journal); }
+	inline void SetChecksumManifest(bool checksum_manifest) { m_checkbox_checksum_manifest->setChecked(checksum_manifest); }
 	inline void SetVideoCodec(enum_video_codec video_codec) { m_combobox_video_codec->setCurrentIndex(clamp((unsigned int) video_codec, 0u, (unsigned int) VIDEO_CODEC_COUNT - 1)); }
 	inline void SetVideoCodecAV(unsigned int video_codec_av) { m_combobox_video_codec_av->setCurrentIndex(clamp(video_codec_av, 0u, (unsigned int) m_video_codecs_av.size() - 1)); }
 	inline void SetVideoKBitRate(unsigned int kbit_rate) { m_lineedit_video_kbit_rate->setText(QString::number(kbit_rate)); }
@@ -205,6 +232,11 @@ public:
 	inline void SetVP8CPUUsed(unsigned int cpu_used) { m_combobox_vp8_cpu_used->setCurrentIndex(clamp(5 - (int) cpu_used, 0, 5)); }
 	inline void SetVideoOptions(const QString& options) { m_lineedit_video_options->setText(options); }
 	inline void SetVideoAllowFrameSkipping(bool allow_frame_skipping) { return m_checkbox_video_allow_frame_skipping->setChecked(allow_frame_skipping); }
+	inline void SetVideoContentHints(bool content_hints) { return m_checkbox_video_content_hints->setChecked(content_hints); }
+	inline void SetVideoROICursor(bool roi_cursor) { return m_checkbox_video_roi_cursor->setChecked(roi_cursor); }
+	inline void SetVideoROIWindow(bool roi_window) { return m_checkbox_video_roi_window->setChecked(roi_window); }
+	inline void SetVideoActivityIndex(bool activity_index) { return m_checkbox_video_activity_index->setChecked(activity_index); }
+	inline void SetVideoConversionThreads(int threads) { m_video_conversion_threads = std::max(-1, threads); }
 	inline void SetAudioCodec(enum_audio_codec audio_codec) { m_combobox_audio_codec->setCurrentIndex(clamp((unsigned int) audio_codec, 0u, (unsigned int) AUDIO_CODEC_COUNT - 1)); }
 	inline void SetAudioCodecAV(unsigned int audio_codec_av) { m_combobox_audio_codec_av->setCurrentIndex(clamp(audio_codec_av, 0u, (unsigned int) m_audio_codecs_av.size() - 1)); }
 	inline void SetAudioKBitRate(unsigned int kbit_rate) { m_lineedit_audio_kbit_rate->setText(QString::number(kbit_rate)); }
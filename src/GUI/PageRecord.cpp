@@ -27,6 +27,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "PageInput.h"
 #include "PageOutput.h"
 #include "DialogRecordSchedule.h"
+#include "StatsSegment.h"
 
 #include "HotkeyListener.h"
 
@@ -34,6 +35,9 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "VideoEncoder.h"
 #include "AudioEncoder.h"
 #include "Synchronizer.h"
+#include "ActivityIndex.h"
+#include "OutputChecksum.h"
+#include "VideoCompositor.h"
 #include "X11Input.h"
 #if SSR_USE_OPENGL_RECORDING
 #include "GLInjectInput.h"
@@ -180,7 +184,13 @@ PageRecord::PageRecord(MainWindow* main_window)
 	m_page_started = false;
 	m_input_started = false;
 	m_output_started = false;
+	m_output_paused = false;
 	m_previewing = false;
+#if SSR_USE_V4L2
+	m_video_overlay = false;
+#endif
+
+	m_stats_slot.reset(new StatsSegment::Slot(0));
 
 	m_schedule_active = false;
 	m_schedule_time_zone = SCHEDULE_TIME_ZONE_LOCAL;
@@ -617,6 +627,14 @@ bool PageRecord::TryStartPage() {
 				m_video_scaled_width = page_input->GetVideoScaledWeight();
 				m_video_scaled_height = page_input->GetVideoScaledHeight();
 				m_video_record_cursor = page_input->GetVideoRecordCursor();
+				m_video_adaptive_frame_rate = page_input->GetVideoAdaptiveFrameRate();
+#if SSR_USE_V4L2
+				m_video_overlay = page_input->GetVideoOverlayEnabled();
+				m_video_overlay_device = page_input->GetVideoOverlayDevice();
+				m_video_overlay_position = page_input->GetVideoOverlayPosition();
+				m_video_overlay_size = page_input->GetVideoOverlaySize();
+				m_video_overlay_opacity = page_input->GetVideoOverlayOpacity();
+#endif
 				
 				// 在后台模式下，如果尺寸为0，设置默认尺寸
 				if(m_video_in_width <= 0 || m_video_in_height <= 0) {
@@ -638,10 +656,18 @@ bool PageRecord::TryStartPage() {
 			
 			// 音频设置
 			try {
+				// 等待音频源枚举完成，默认的音频后端和源名称取决于枚举结果
+				page_input->WaitForAudioSources();
 				m_audio_enabled = page_input->GetAudioEnabled();
 				m_audio_channels = 2; // 固定值
 				m_audio_sample_rate = 48000; // 固定值
 				m_audio_backend = page_input->GetAudioBackend();
+#if SSR_USE_ALSA
+				m_alsa_source = page_input->GetALSASourceName();
+#endif
+#if SSR_USE_PULSEAUDIO
+				m_pulseaudio_source = page_input->GetPulseAudioSourceName();
+#endif
 				
 				Logger::LogInfo("[PageRecord::TryStartPage] " + tr("Audio enabled: %1, Backend: %2").arg(m_audio_enabled ? "yes" : "no").arg(m_audio_backend));
 			} catch(const std::exception& e) {
@@ -801,8 +827,17 @@ void PageRecord::StartPage() {
 	m_video_scaled_width = page_input->GetVideoScaledWeight();
 	m_video_scaled_height = page_input->GetVideoScaledHeight();
 	m_video_record_cursor = page_input->GetVideoRecordCursor();
+	m_video_adaptive_frame_rate = page_input->GetVideoAdaptiveFrameRate();
+#if SSR_USE_V4L2
+	m_video_overlay = page_input->GetVideoOverlayEnabled();
+	m_video_overlay_device = page_input->GetVideoOverlayDevice();
+	m_video_overlay_position = page_input->GetVideoOverlayPosition();
+	m_video_overlay_size = page_input->GetVideoOverlaySize();
+	m_video_overlay_opacity = page_input->GetVideoOverlayOpacity();
+#endif
 
 	// get the audio input settings
+	page_input->WaitForAudioSources();
 	m_audio_enabled = page_input->GetAudioEnabled();
 	m_audio_channels = 2;
 	m_audio_sample_rate = 48000;
@@ -842,6 +877,8 @@ void PageRecord::StartPage() {
 	// get the output settings
 	m_output_settings.file = QString(); // will be set later
 	m_output_settings.container_avname = page_output->GetContainerAVName();
+	m_output_settings.packet_journal = page_output->GetPacketJournal() && m_file_protocol.isNull();
+	m_output_settings.checksum_manifest = page_output->GetChecksumManifest() && m_file_protocol.isNull();
 
 	m_output_settings.video_codec_avname = page_output->GetVideoCodecAVName();
 	m_output_settings.video_kbit_rate = page_output->GetVideoKBitRate();
@@ -850,6 +887,12 @@ void PageRecord::StartPage() {
 	m_output_settings.video_height = 0;
 	m_output_settings.video_frame_rate = m_video_frame_rate;
 	m_output_settings.video_allow_frame_skipping = page_output->GetVideoAllowFrameSkipping();
+	m_output_settings.video_content_hints = page_output->GetVideoContentHints();
+	m_output_settings.video_roi_cursor = page_output->GetVideoROICursor();
+	m_output_settings.video_roi_window = page_output->GetVideoROIWindow();
+	m_output_settings.video_activity_index = page_output->GetVideoActivityIndex();
+	m_output_settings.video_conversion_threads = page_output->GetVideoConversionThreads();
+	m_output_settings.video_letterbox = page_input->GetVideoLetterbox();
 
 	m_output_settings.audio_codec_avname = (m_audio_enabled)? page_output->GetAudioCodecAVName() : QString();
 	m_output_settings.audio_kbit_rate = page_output->GetAudioKBitRate();
@@ -959,6 +1002,7 @@ void PageRecord::StopPage(bool save) {
 	UpdateSchedule();
 
 	StopOutput(true);
+	m_output_paused = false;
 	StopInput();
 
 	Logger::LogInfo("[PageRecord::StopPage] " + tr("Stopping page ..."));
@@ -974,6 +1018,10 @@ void PageRecord::StopPage(bool save) {
 		if(!save && m_file_protocol.isNull()) {
 			if(QFileInfo(m_output_settings.file).exists())
 				QFile(m_output_settings.file).remove();
+			if(QFileInfo(ActivityIndex::GetFileName(m_output_settings.file)).exists())
+				QFile(ActivityIndex::GetFileName(m_output_settings.file)).remove();
+			if(QFileInfo(OutputChecksum::GetFileName(m_output_settings.file)).exists())
+				QFile(OutputChecksum::GetFileName(m_output_settings.file)).remove();
 		}
 
 	}
@@ -1118,18 +1166,19 @@ void PageRecord::StartOutput() {
 			Logger::LogInfo("[PageRecord::StartOutput] " + tr("Output video: %1x%2 %3 FPS").arg(m_output_settings.video_width).arg(m_output_settings.video_height).arg(m_video_frame_rate));
 			
 			// start the output
-			m_output_manager.reset(new OutputManager(m_output_settings));
+			m_output_manager.reset(new OutputManager(m_output_settings, m_stats_slot->GetBlock()));
 
 		} else {
 
-			// start a new segment
-			m_output_manager->GetSynchronizer()->NewSegment();
+			// resume the paused output, this starts a new segment
+			m_output_manager->GetSynchronizer()->SetPaused(false);
 
 		}
 
 		Logger::LogInfo("[PageRecord::StartOutput] " + tr("Started output."));
 
 		m_output_started = true;
+		m_output_paused = false;
 		m_recorded_something = true;
 		UpdateSysTray();
 		UpdateRecordButton();
@@ -1164,6 +1213,12 @@ void PageRecord::StopOutput(bool final) {
 		m_output_settings.video_width = 0;
 		m_output_settings.video_height = 0;
 
+	} else if(!final) {
+
+		// Only pause the synchronizer. The inputs keep running and the encoders keep their state, so resuming is nearly instant.
+		m_output_manager->GetSynchronizer()->SetPaused(true);
+		m_output_paused = true;
+
 	}
 
 	Logger::LogInfo("[PageRecord::StopOutput] " + tr("Stopped output."));
@@ -1205,6 +1260,7 @@ void PageRecord::StartInput() {
 			m_x11_input.reset(new X11Input(m_video_x, m_video_y, m_video_in_width, m_video_in_height, m_video_record_cursor,
 										   m_video_x11_area == PageInput::VIDEO_X11_AREA_CURSOR, m_video_x11_follow_fullscreen));
 			connect(m_x11_input.get(), SIGNAL(CurrentRectangleChanged()), this, SLOT(OnUpdateRecordingFrame()), Qt::QueuedConnection);
+			m_x11_input->SetAdaptiveFrameRate(m_video_adaptive_frame_rate);
 		}
 #if SSR_USE_OPENGL_RECORDING
 		if(m_video_backend == PageInput::VIDEO_BACKEND_GLINJECT) {
@@ -1228,6 +1284,29 @@ void PageRecord::StartInput() {
 		}
 #endif
 
+#if SSR_USE_V4L2
+		// start the overlay
+		if(m_video_overlay && m_video_backend != PageInput::VIDEO_BACKEND_V4L2) {
+			if(m_video_in_width == 0 || m_video_in_height == 0) {
+				Logger::LogWarning("[PageRecord::StartInput] " + tr("Warning: The size of the video is not known yet, the webcam overlay will not be added."));
+			} else {
+				unsigned int overlay_width, overlay_height;
+				m_overlay_input.reset(new V4L2Input(m_video_overlay_device, 640, 480));
+				m_overlay_input->GetCurrentSize(&overlay_width, &overlay_height);
+				unsigned int w = m_video_in_width * m_video_overlay_size / 100;
+				unsigned int h = (uint64_t) w * (uint64_t) overlay_height / (uint64_t) std::max(1u, overlay_width);
+				unsigned int margin = m_video_in_width / 50;
+				bool left = (m_video_overlay_position == PageInput::VIDEO_OVERLAY_POSITION_TOP_LEFT || m_video_overlay_position == PageInput::VIDEO_OVERLAY_POSITION_BOTTOM_LEFT);
+				bool top = (m_video_overlay_position == PageInput::VIDEO_OVERLAY_POSITION_TOP_LEFT || m_video_overlay_position == PageInput::VIDEO_OVERLAY_POSITION_TOP_RIGHT);
+				int x = (left)? (int) margin : (int) m_video_in_width - (int) (w + margin);
+				int y = (top)? (int) margin : (int) m_video_in_height - (int) (h + margin);
+				m_video_compositor.reset(new VideoCompositor(m_video_in_width, m_video_in_height));
+				m_video_compositor->AddLayer(0, 0, m_video_in_width, m_video_in_height, 1.0);
+				m_video_compositor->AddLayer(x, y, w, h, (double) m_video_overlay_opacity / 100.0);
+			}
+		}
+#endif
+
 		// start the audio input
 		if(m_audio_enabled) {
 #if SSR_USE_ALSA
@@ -1247,6 +1326,10 @@ void PageRecord::StartInput() {
 
 	} catch(...) {
 		Logger::LogError("[PageRecord::StartInput] " + tr("Error: Something went wrong during initialization."));
+#if SSR_USE_V4L2
+		m_video_compositor.reset();
+		m_overlay_input.reset();
+#endif
 		m_x11_input.reset();
 #if SSR_USE_OPENGL_RECORDING
 		if(m_gl_inject_input != NULL)
@@ -1278,6 +1361,10 @@ void PageRecord::StopInput() {
 
 	Logger::LogInfo("[PageRecord::StopInput] " + tr("Stopping input ..."));
 
+#if SSR_USE_V4L2
+	m_video_compositor.reset();
+	m_overlay_input.reset();
+#endif
 	m_x11_input.reset();
 #if SSR_USE_OPENGL_RECORDING
 	if(m_gl_inject_input != NULL)
@@ -1336,7 +1423,7 @@ void PageRecord::FinishOutput() {
 void PageRecord::UpdateInput() {
 	assert(m_page_started);
 
-	if(m_output_started || m_previewing) {
+	if(m_output_started || m_output_paused || m_previewing) {
 		StartInput();
 	} else {
 		StopInput();
@@ -1358,6 +1445,13 @@ void PageRecord::UpdateInput() {
 #if SSR_USE_PIPEWIRE
 	if(m_video_backend == PageInput::VIDEO_BACKEND_PIPEWIRE)
 		video_source = m_pipewire_input.get();
+#endif
+#if SSR_USE_V4L2
+	if(m_video_compositor != NULL) {
+		m_video_compositor->ConnectLayerSource(0, video_source);
+		m_video_compositor->ConnectLayerSource(1, m_overlay_input.get());
+		video_source = m_video_compositor.get();
+	}
 #endif
 	if(m_audio_enabled) {
 #if SSR_USE_ALSA
@@ -1376,7 +1470,7 @@ void PageRecord::UpdateInput() {
 
 	// connect sinks
 	if(m_output_manager != NULL) {
-		if(m_output_started) {
+		if(m_output_started || m_output_paused) {
 			m_output_manager->GetSynchronizer()->ConnectVideoSource(video_source, PRIORITY_RECORD);
 			m_output_manager->GetSynchronizer()->ConnectAudioSource(audio_source, PRIORITY_RECORD);
 		} else {
@@ -1803,6 +1897,19 @@ void PageRecord::OnUpdateInformation() {
 		m_label_info_file_size->setText(ReadableSizeIEC(total_bytes, "B"));
 		m_label_info_bit_rate->setText(ReadableSizeSI(bit_rate, "bit/s"));
 
+		StatsBlock *stats = m_stats_slot->GetBlock();
+		if(stats != NULL) {
+			StatsUpdate update(stats);
+			stats->capturing.Set(m_input_started);
+			stats->recording.Set(m_output_started);
+			stats->total_time.Set(total_time);
+			stats->size_in_width.Set(m_video_in_width);
+			stats->size_in_height.Set(m_video_in_height);
+			stats->size_out_width.Set(m_output_settings.video_width);
+			stats->size_out_height.Set(m_output_settings.video_height);
+			stats->update_time.Set(hrt_time_micro());
+		}
+
 		if(!CommandLineOptions::GetStatsFile().isNull()) {
 			QString str = QString() +
 					"capturing\t" + ((m_input_started)? "1" : "0") + "\n"
@@ -1841,6 +1948,14 @@ void PageRecord::OnUpdateInformation() {
 		m_label_info_file_size->clear();
 		m_label_info_bit_rate->clear();
 
+		StatsBlock *stats = m_stats_slot->GetBlock();
+		if(stats != NULL) {
+			StatsUpdate update(stats);
+			stats->capturing.Set(false);
+			stats->recording.Set(false);
+			stats->update_time.Set(hrt_time_micro());
+		}
+
 		if(!CommandLineOptions::GetStatsFile().isNull()) {
 			QByteArray old_file = QFile::encodeName(CommandLineOptions::GetStatsFile());
 			remove(old_file.constData());
@@ -1903,3 +2018,58 @@ QString PageRecord::GetTotalTime() const {
 	}
 	return "00:00:00";
 }
+
+bool PageRecord::RequestKeyframe() {
+	if(m_output_manager == NULL)
+		return false;
+	return m_output_manager->RequestVideoKeyframe();
+}
+
+bool PageRecord::SetVideoBitRate(unsigned int kbit_rate) {
+	if(m_output_manager == NULL)
+		return false;
+	return m_output_manager->RequestVideoBitRate(kbit_rate * 1000);
+}
+
+bool PageRecord::SetVideoCRF(unsigned int crf) {
+	if(m_output_manager == NULL)
+		return false;
+	return m_output_manager->RequestVideoCRF(crf);
+}
+
+bool PageRecord::SetVideoPreset(const QString& preset) {
+	if(m_output_manager == NULL)
+		return false;
+	return m_output_manager->RequestVideoPreset(preset);
+}
+
+int64_t PageRecord::GetKeyframeLatency() const {
+	if(m_output_manager == NULL)
+		return -1;
+	return m_output_manager->GetVideoKeyframeLatency();
+}
+
+int64_t PageRecord::GetResumeLatency() const {
+	if(m_output_manager == NULL)
+		return -1;
+	return m_output_manager->GetVideoResumeLatency();
+}
+
+bool PageRecord::SetRecordingArea(unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height) {
+	if(m_x11_input == NULL)
+		return false;
+	if(!m_x11_input->SetRectangle(x, y, width, height))
+		return false;
+	// remember the new area, so it is used again if the input is restarted
+	m_video_x = *x;
+	m_video_y = *y;
+	m_video_in_width = *width;
+	m_video_in_height = *height;
+	return true;
+}
+
+void PageRecord::SetVideoLetterbox(bool letterbox) {
+	m_output_settings.video_letterbox = letterbox;
+	if(m_output_manager != NULL)
+		m_output_manager->GetSynchronizer()->SetLetterbox(letterbox);
+}
@@ -24,6 +24,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "PageInput.h"
 #include "OutputSettings.h"
 #include "OutputManager.h"
+#include "StatsSegment.h"
 #include "ElidedLabel.h"
 #include "HotkeyListener.h"
 #include "DialogRecordSchedule.h"
@@ -41,6 +42,7 @@ class GLInjectInput;
 #endif
 #if SSR_USE_V4L2
 class V4L2Input;
+class VideoCompositor;
 #endif
 #if SSR_USE_PIPEWIRE
 class PipeWireInput;
@@ -70,6 +72,7 @@ private:
 	MainWindow *m_main_window;
 
 	bool m_page_started, m_input_started, m_output_started, m_previewing;
+	bool m_output_paused; // the output is paused, but the inputs are kept so resuming is nearly instant
 	bool m_recorded_something, m_wait_saving, m_error_occurred;
 
 	bool m_schedule_active;
@@ -91,6 +94,13 @@ private:
 	bool m_video_scaling;
 	unsigned int m_video_scaled_width, m_video_scaled_height;
 	bool m_video_record_cursor;
+	bool m_video_adaptive_frame_rate;
+#if SSR_USE_V4L2
+	bool m_video_overlay;
+	QString m_video_overlay_device;
+	PageInput::enum_video_overlay_position m_video_overlay_position;
+	unsigned int m_video_overlay_size, m_video_overlay_opacity;
+#endif
 	bool m_audio_enabled;
 	unsigned int m_audio_channels, m_audio_sample_rate;
 	PageInput::enum_audio_backend m_audio_backend;
@@ -102,6 +112,7 @@ private:
 #endif
 
 	OutputSettings m_output_settings;
+	std::unique_ptr<StatsSegment::Slot> m_stats_slot; // must outlive the output manager
 	std::unique_ptr<OutputManager> m_output_manager;
 
 	QString m_file_base;
@@ -114,6 +125,8 @@ private:
 #endif
 #if SSR_USE_V4L2
 	std::unique_ptr<V4L2Input> m_v4l2_input;
+	std::unique_ptr<V4L2Input> m_overlay_input;
+	std::unique_ptr<VideoCompositor> m_video_compositor;
 #endif
 #if SSR_USE_PIPEWIRE
 	std::unique_ptr<PipeWireInput> m_pipewire_input;
@@ -202,6 +215,20 @@ public:
 	int64_t GetCurrentFileSize() const;
 	QString GetTotalTime() const;
 
+	// Encoder control for the HTTP server, applied at the next frame. These return false if there is no output.
+	bool RequestKeyframe();
+	bool SetVideoBitRate(unsigned int kbit_rate);
+	bool SetVideoCRF(unsigned int crf);
+	bool SetVideoPreset(const QString& preset);
+	int64_t GetKeyframeLatency() const;
+	int64_t GetResumeLatency() const;
+
+	// Live reconfiguration for the HTTP server. The output size doesn't change, the new frames are scaled to the existing size.
+	// SetRecordingArea returns false if the input is not an X11 input or the area is invalid. Otherwise the arguments are changed to
+	// the area that is actually recorded, which can be smaller or moved if the requested area doesn't fit on the screen.
+	bool SetRecordingArea(unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height);
+	void SetVideoLetterbox(bool letterbox);
+
 private:
 	void FinishOutput();
 	void UpdateInput();
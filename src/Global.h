@@ -40,6 +40,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include <QMainWindow>
 #include <QMenu>
 #include <QMessageBox>
+#include <QProgressBar>
 #include <QProgressDialog>
 #include <QSystemTrayIcon>
 
@@ -72,6 +73,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdint.h>
 
 #include <fcntl.h>
+#include <pthread.h>
 #include <pwd.h>
 #include <strings.h>
 #include <sys/ioctl.h>
@@ -85,10 +87,14 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <array>
 #include <atomic>
+#include <condition_variable>
 #include <deque>
+#include <functional>
 #include <limits>
+#include <map>
 #include <memory>
 #include <mutex>
+#include <queue>
 #include <random>
 #include <set>
 #include <sstream>
@@ -101,6 +107,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <X11/Xlib.h>
 #include <X11/Xutil.h>
+#include <X11/Xatom.h>
 #include <X11/extensions/Xfixes.h>
 #include <X11/extensions/Xinerama.h>
 #include <X11/extensions/XShm.h>
@@ -177,9 +184,14 @@ extern "C" {
 #include <libavcodec/avcodec.h>
 #include <libavutil/avutil.h>
 #include <libavutil/channel_layout.h>
+#include <libavutil/crc.h>
+#include <libavutil/imgutils.h>
 #include <libavutil/mathematics.h>
+#include <libavutil/opt.h>
+#include <libavutil/pixdesc.h>
 #include <libavutil/pixfmt.h>
 #include <libavutil/samplefmt.h>
+#include <libavutil/sha.h>
 #include <libswscale/swscale.h>
 }
 
@@ -224,6 +236,11 @@ extern "C" {
 #error SSR_USE_JACK should be defined!
 #endif
 
+// Whether the native libx264 encoder backend should be used.
+#ifndef SSR_USE_X264
+#error SSR_USE_X264 should be defined!
+#endif
+
 // Path to system-wide application directory (usually /usr/share/simplescreenrecorder).
 #ifndef SSR_SYSTEM_DIR
 #error SSR_SYSTEM_DIR should be defined!
@@ -264,6 +281,8 @@ inline void atomic_thread_fence_replacement(memory_order) {
 #define TEST_AV_VERSION(prefix, ffmpeg_major, ffmpeg_minor, libav_major, libav_minor) TEST_MAJOR_MINOR(prefix##_VERSION_MAJOR, prefix##_VERSION_MINOR, libav_major, libav_minor)
 #endif
 
+// AVIOContext write_packet callback with const buffer: lavf 61.1.100 / ???
+#define SSR_USE_AVIO_WRITE_CONST                   TEST_AV_VERSION(LIBAVFORMAT, 61, 1, 999, 999)
 // av_muxer_iterate: lavf 58.9.100 / ???
 #define SSR_USE_AV_MUXER_ITERATE                   TEST_AV_VERSION(LIBAVFORMAT, 58, 9, 999, 999)
 // av_register_all deprecated: lavf 58.9.100 / ???
@@ -341,6 +360,8 @@ inline void atomic_thread_fence_replacement(memory_order) {
 // AVFrame::sample_aspect_ratio: lavc 53.3.0 / 53.31.0
 #define SSR_USE_AVFRAME_SAR                        TEST_AV_VERSION(LIBAVCODEC, 53, 3, 53, 31)
 
+// AV_FRAME_DATA_REGIONS_OF_INTEREST: lavu 56.25.100 / ???
+#define SSR_USE_AV_FRAME_DATA_REGIONS_OF_INTEREST  TEST_AV_VERSION(LIBAVUTIL, 56, 25, 999, 999)
 // AV_PIX_FMT_* instead of PIX_FMT_*: lavu 51.74.100 / 51.42.0
 #define SSR_USE_AV_PIX_FMT                         TEST_AV_VERSION(LIBAVUTIL, 51, 74, 51, 42)
 // planar sample formats: lavu 51.27.0 / 51.17.0
@@ -359,6 +380,12 @@ public:
 		return "ResamplerException";
 	}
 };
+class CompositorException : public std::exception {
+public:
+	inline virtual const char* what() const throw() override {
+		return "CompositorException";
+	}
+};
 class X11Exception : public std::exception {
 public:
 	inline virtual const char* what() const throw() override {
@@ -430,6 +457,35 @@ inline int64_t hrt_time_micro() {
 	return (uint64_t) ts.tv_sec * (uint64_t) 1000000 + (uint64_t) (ts.tv_nsec / 1000);
 }
 
+// Returns the CPU time used by a thread (in microseconds), or zero if the thread is not running.
+inline int64_t thread_cpu_time_micro(std::thread& thread) {
+	if(!thread.joinable())
+		return 0;
+	clockid_t clock;
+	if(pthread_getcpuclockid(thread.native_handle(), &clock) != 0)
+		return 0;
+	timespec ts;
+	if(clock_gettime(clock, &ts) != 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * (uint64_t) 1000000 + (uint64_t) (ts.tv_nsec / 1000);
+}
+
+// Returns the CPU time used by the calling thread (in microseconds).
+inline int64_t this_thread_cpu_time_micro() {
+	timespec ts;
+	if(clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * (uint64_t) 1000000 + (uint64_t) (ts.tv_nsec / 1000);
+}
+
+// Returns the CPU time used by all threads of the process (in microseconds), including threads created by libraries.
+inline int64_t process_cpu_time_micro() {
+	timespec ts;
+	if(clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts) != 0)
+		return 0;
+	return (uint64_t) ts.tv_sec * (uint64_t) 1000000 + (uint64_t) (ts.tv_nsec / 1000);
+}
+
 // Returns the name of the user.
 inline std::string GetUserName() {
 	std::vector<char> buf(std::max((long) 16384, sysconf(_SC_GETPW_R_SIZE_MAX)));
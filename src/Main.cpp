@@ -20,15 +20,26 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include "Global.h"
 
 #include "Benchmark.h"
+#include "BenchmarkCapture.h"
+#include "BenchmarkEncoder.h"
+#include "BenchmarkReport.h"
+#include "Calibration.h"
+#include "CapabilityCache.h"
 #include "CommandLineOptions.h"
+#include "ControlSocket.h"
 #include "CPUFeatures.h"
 #include "HotkeyListener.h"
 #include "Icons.h"
 #include "Logger.h"
 #include "MainWindow.h"
+#include "PacketJournal.h"
 #include "ScreenScaling.h"
+#include "SelfTest.h"
 #include "HTTPServer.h"
+#include "PageOutput.h"
 #include "PageRecord.h"
+#include "StatsSegment.h"
+#include "TaskScheduler.h"
 
 #include <signal.h>
 #include <execinfo.h>
@@ -121,8 +132,24 @@ void DumpObjectState(MainWindow *mainwindow) {
 	Logger::LogInfo(state);
 }
 
+// Logs the time since startup, and whether the capability cache was used (warm start) or had to be created (cold start).
+void LogStartupTime(int64_t start_time) {
+	int64_t startup_time = hrt_time_micro() - start_time;
+	CapabilityCache *cache = CapabilityCache::GetInstance();
+	if(cache == NULL) {
+		Logger::LogInfo(Logger::tr("Startup took %1 ms.").arg((double) startup_time * 1.0e-3, 0, 'f', 1));
+		return;
+	}
+	CapabilityCache::Stats stats = cache->GetStats();
+	Logger::LogInfo(Logger::tr("Startup took %1 ms (%2 start, capability cache: %3 hits, %4 misses).")
+					.arg((double) startup_time * 1.0e-3, 0, 'f', 1).arg((cache->IsLoaded())? "warm" : "cold").arg(stats.m_hits).arg(stats.m_misses));
+	cache->Save();
+}
+
 int main(int argc, char* argv[]) {
 
+	int64_t start_time = hrt_time_micro();
+
 	XInitThreads();
 
 	// Workarounds for broken screen scaling.
@@ -182,7 +209,7 @@ int main(int argc, char* argv[]) {
 	}
 
 	// do we need to continue?
-	if(!CommandLineOptions::GetBenchmark() && !CommandLineOptions::GetGui() && !CommandLineOptions::GetBackend()) {
+	if(!CommandLineOptions::GetBenchmark() && CommandLineOptions::GetBenchmarkCapture().isNull() && CommandLineOptions::GetBenchmarkEncoder().isNull() && CommandLineOptions::GetSelfTestIterations() == 0 && CommandLineOptions::GetRecoverJournal().isNull() && !CommandLineOptions::GetCalibrate() && !CommandLineOptions::GetGui() && !CommandLineOptions::GetBackend()) {
 		return 0;
 	}
 
@@ -203,6 +230,26 @@ int main(int argc, char* argv[]) {
 	CPUFeatures::Detect();
 #endif
 
+	// create the shared stats segment
+	// this has to exist before any recording starts, and it has to be destroyed after the recording has stopped
+	std::unique_ptr<StatsSegment> stats_segment;
+	if(!CommandLineOptions::GetStatsShmFile().isNull()) {
+		try {
+			stats_segment.reset(new StatsSegment(CommandLineOptions::GetStatsShmFile()));
+		} catch(const StatsException&) {
+			Logger::LogError(Logger::tr("Error: Can't create shared stats segment, continuing without it."));
+		}
+	}
+
+	// start the worker threads
+	// this has to exist before any recording starts, and it has to be destroyed after the recording has stopped
+	TaskScheduler task_scheduler(CommandLineOptions::GetWorkerThreads());
+	Q_UNUSED(task_scheduler);
+
+	// load the capability cache
+	CapabilityCache capability_cache(GetApplicationUserDir() + "/capabilities.conf");
+	Q_UNUSED(capability_cache);
+
 	// show screen scaling message
 	ScreenScalingMessage();
 
@@ -214,11 +261,55 @@ int main(int argc, char* argv[]) {
 
 	// start the program
 	int ret = 0;
-	if(CommandLineOptions::GetBenchmark()) {
-		Logger::LogInfo(Logger::tr("Starting benchmark ..."));
-		
-		Benchmark();
-		
+	if(CommandLineOptions::GetSelfTestIterations() != 0) {
+		Logger::LogInfo(Logger::tr("Starting self-test ..."));
+		return (SelfTest(CommandLineOptions::GetSelfTestIterations(), CommandLineOptions::GetSelfTestSeed()))? 0 : 1;
+	}
+	if(!CommandLineOptions::GetRecoverJournal().isNull()) {
+		Logger::LogInfo(Logger::tr("Starting journal recovery ..."));
+		return (PacketJournal::Recover(CommandLineOptions::GetRecoverJournal(), CommandLineOptions::GetRecoverOutput()))? 0 : 1;
+	}
+	if(CommandLineOptions::GetBenchmark() || !CommandLineOptions::GetBenchmarkCapture().isNull() || !CommandLineOptions::GetBenchmarkEncoder().isNull()) {
+		BenchmarkReport report;
+		if(CommandLineOptions::GetBenchmark()) {
+			Logger::LogInfo(Logger::tr("Starting benchmark ..."));
+			Benchmark(&report, CommandLineOptions::GetBenchmarkRepeat());
+		}
+		if(!CommandLineOptions::GetBenchmarkCapture().isNull()) {
+			Logger::LogInfo(Logger::tr("Starting capture benchmark ..."));
+			BenchmarkCapture(&report, CommandLineOptions::GetBenchmarkRepeat(), CommandLineOptions::GetBenchmarkXServer(),
+							 CommandLineOptions::GetBenchmarkCapture(), CommandLineOptions::GetBenchmarkDuration());
+		}
+		if(!CommandLineOptions::GetBenchmarkEncoder().isNull()) {
+			Logger::LogInfo(Logger::tr("Starting encoder benchmark ..."));
+			BenchmarkEncoder(&report, CommandLineOptions::GetBenchmarkRepeat(), CommandLineOptions::GetBenchmarkEncoder(), CommandLineOptions::GetBenchmarkCodec(),
+							 CommandLineOptions::GetBenchmarkPresets(), CommandLineOptions::GetBenchmarkCRF(), CommandLineOptions::GetBenchmarkThreads(),
+							 CommandLineOptions::GetBenchmarkPixFmts(), CommandLineOptions::GetBenchmarkBackends(), CommandLineOptions::GetBenchmarkFps(), CommandLineOptions::GetBenchmarkDuration(),
+							 CommandLineOptions::GetBenchmarkContentHints(), CommandLineOptions::GetBenchmarkROI(), CommandLineOptions::GetBenchmarkJournal());
+		}
+		report.Write(CommandLineOptions::GetBenchmarkOutput());
+		if(!CommandLineOptions::GetBenchmarkCompare().isEmpty()) {
+			return (report.Compare(CommandLineOptions::GetBenchmarkCompare(), CommandLineOptions::GetBenchmarkThreshold() * 0.01))? 0 : 1;
+		}
+		return 0;
+	}
+	if(CommandLineOptions::GetCalibrate()) {
+		Logger::LogInfo(Logger::tr("Starting calibration ..."));
+		MainWindow mainwindow(true);
+		PageOutput *pageoutput = mainwindow.GetPageOutput();
+		try {
+			Calibration calibration(pageoutput->GetCalibrationSettings());
+			while(!calibration.IsDone() && !calibration.HasErrorOccurred()) {
+				usleep(200000);
+			}
+			if(calibration.HasErrorOccurred())
+				return 1;
+			pageoutput->ApplyCalibration(calibration.GetResults());
+		} catch(const std::exception& e) {
+			Logger::LogError(Logger::tr("Calibration error: ") + e.what());
+			return 1;
+		}
+		mainwindow.SaveSettings();
 		return 0;
 	}
 	
@@ -288,6 +379,11 @@ int main(int argc, char* argv[]) {
 					HTTPServer server(pagerecord);
 					server.Start(CommandLineOptions::GetHttpPort());
 					Logger::LogInfo(Logger::tr("HTTP server started on port %1").arg(CommandLineOptions::GetHttpPort()));
+					std::unique_ptr<ControlSocket> control_socket;
+					if(!CommandLineOptions::GetControlSocket().isEmpty()) {
+						control_socket.reset(new ControlSocket(&server, CommandLineOptions::GetControlSocket()));
+					}
+					LogStartupTime(start_time);
 					
 					// start event loop
 					return application.exec();
@@ -322,6 +418,7 @@ int main(int argc, char* argv[]) {
 
 		// create main window
 		MainWindow mainwindow;
+		LogStartupTime(start_time);
 
 		// run application
 		ret = application.exec();
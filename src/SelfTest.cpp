@@ -0,0 +1,434 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SelfTest.h"
+
+#include "AVWrapper.h"
+#include "CPUFeatures.h"
+#include "FastResampler_FirFilter.h"
+#include "FastScaler.h"
+#include "FastScaler_Convert.h"
+#include "FastScaler_Scale.h"
+#include "Logger.h"
+#include "TempBuffer.h"
+#include "VideoCompositor_Blend.h"
+
+#include <random>
+
+// Size of the guard area after every plane. The kernels must never write to it.
+static const unsigned int SELFTEST_GUARD_SIZE = 64;
+static const uint8_t SELFTEST_GUARD_VALUE = 0xa5;
+
+typedef void (*ConvertFunc)(unsigned int, unsigned int, const uint8_t*, int, uint8_t* const*, const int*);
+typedef void (*ScaleFunc)(unsigned int, unsigned int, const uint8_t*, int, unsigned int, unsigned int, uint8_t*, int);
+typedef void (*PlaneLayoutFunc)(unsigned int, unsigned int, std::vector<unsigned int>*, std::vector<unsigned int>*);
+typedef void (*BlendFunc)(unsigned int, unsigned int, const uint8_t*, int, uint8_t*, int, unsigned int);
+
+template<void (*T)(unsigned int, unsigned int, const uint8_t*, int, uint8_t*, int)>
+void SelfTestPlaneWrapper(unsigned int w, unsigned int h, const uint8_t* in_data, int in_stride, uint8_t* const* out_data, const int* out_stride) {
+	T(w, h, in_data, in_stride, out_data[0], out_stride[0]);
+}
+
+static void LayoutYUV444(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w, w, w}; *rows = {h, h, h};
+}
+static void LayoutYUV422(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w, w / 2, w / 2}; *rows = {h, h, h};
+}
+static void LayoutYUV420(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w, w / 2, w / 2}; *rows = {h, h / 2, h / 2};
+}
+static void LayoutNV12(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w, w}; *rows = {h, h / 2};
+}
+static void LayoutGray(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w}; *rows = {h};
+}
+static void LayoutBGR(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w * 3}; *rows = {h};
+}
+static void LayoutBGRA(unsigned int w, unsigned int h, std::vector<unsigned int>* row_bytes, std::vector<unsigned int>* rows) {
+	*row_bytes = {w * 4}; *rows = {h};
+}
+
+// An image with random content, random padding and (optionally) a misaligned start address, followed by a guard area.
+// 'granularity' is the smallest misalignment that is used, this should be 4 for BGRA images.
+struct SelfTestImage {
+
+	TempBuffer<uint8_t> m_buffer;
+	std::vector<uint8_t*> m_data;
+	std::vector<int> m_stride;
+	std::vector<unsigned int> m_row_bytes, m_rows;
+
+	SelfTestImage(PlaneLayoutFunc layout, unsigned int w, unsigned int h, bool aligned, unsigned int granularity, std::mt19937& rng) {
+		layout(w, h, &m_row_bytes, &m_rows);
+		unsigned int planes = m_row_bytes.size();
+		m_data.resize(planes);
+		m_stride.resize(planes);
+		std::vector<size_t> offsets(planes);
+		size_t totalsize = 0;
+		for(unsigned int p = 0; p < planes; ++p) {
+			if(aligned) {
+				m_stride[p] = grow_align16(m_row_bytes[p]) + 16 * (rng() % 3);
+				offsets[p] = totalsize;
+			} else {
+				m_stride[p] = m_row_bytes[p] + granularity * (1 + 2 * (rng() % 8)); // odd padding, so the stride is never a multiple of 16
+				offsets[p] = totalsize + granularity * (1 + rng() % (15 / granularity));
+			}
+			totalsize = grow_align16(offsets[p] + (size_t) m_stride[p] * m_rows[p] + SELFTEST_GUARD_SIZE);
+		}
+		m_buffer.Alloc(totalsize);
+		for(size_t i = 0; i < totalsize; ++i) {
+			m_buffer[i] = rng();
+		}
+		for(unsigned int p = 0; p < planes; ++p) {
+			m_data[p] = m_buffer.GetData() + offsets[p];
+			memset(m_data[p] + (size_t) m_stride[p] * m_rows[p], SELFTEST_GUARD_VALUE, SELFTEST_GUARD_SIZE);
+		}
+	}
+
+	bool CheckGuards() {
+		for(unsigned int p = 0; p < m_data.size(); ++p) {
+			uint8_t *guard = m_data[p] + (size_t) m_stride[p] * m_rows[p];
+			for(unsigned int i = 0; i < SELFTEST_GUARD_SIZE; ++i) {
+				if(guard[i] != SELFTEST_GUARD_VALUE)
+					return false;
+			}
+		}
+		return true;
+	}
+
+	// Copies the visible part of another image with the same layout.
+	void CopyFrom(const SelfTestImage& other) {
+		for(unsigned int p = 0; p < m_data.size(); ++p) {
+			for(unsigned int j = 0; j < m_rows[p]; ++j) {
+				memcpy(m_data[p] + (size_t) m_stride[p] * j, other.m_data[p] + (size_t) other.m_stride[p] * j, m_row_bytes[p]);
+			}
+		}
+	}
+
+	// Returns the maximum absolute difference between the visible parts of two images with the same layout.
+	unsigned int Compare(const SelfTestImage& other) {
+		unsigned int max_error = 0;
+		for(unsigned int p = 0; p < m_data.size(); ++p) {
+			for(unsigned int j = 0; j < m_rows[p]; ++j) {
+				const uint8_t *row1 = m_data[p] + (size_t) m_stride[p] * j;
+				const uint8_t *row2 = other.m_data[p] + (size_t) other.m_stride[p] * j;
+				for(unsigned int i = 0; i < m_row_bytes[p]; ++i) {
+					max_error = std::max(max_error, (unsigned int) abs((int) row1[i] - (int) row2[i]));
+				}
+			}
+		}
+		return max_error;
+	}
+
+};
+
+// Accumulates the results of one kernel.
+struct SelfTestResult {
+
+	QString m_name;
+	unsigned int m_runs;
+	double m_max_error, m_error_limit;
+	bool m_guard_failed;
+	int64_t m_time_reference, m_time_simd;
+	uint64_t m_work;
+
+	SelfTestResult(const QString& name, double error_limit) {
+		m_name = name;
+		m_runs = 0;
+		m_max_error = 0.0;
+		m_error_limit = error_limit;
+		m_guard_failed = false;
+		m_time_reference = 0;
+		m_time_simd = 0;
+		m_work = 0;
+	}
+
+	bool Passed() {
+		return (m_max_error <= m_error_limit && !m_guard_failed);
+	}
+
+	// The timings are normalized by the amount of work (pixels or samples), because the sizes are random.
+	bool Report(const QString& unit) {
+		double work = (double) std::max<uint64_t>(1, m_work);
+		Logger::LogInfo("[SelfTest] " + Logger::tr("%1  |  %2 runs  |  max error %3 (limit %4)  |  Fallback %5 ns/%6  |  SIMD %7 ns/%6  |  %8")
+						.arg(m_name, -24).arg(m_runs, 4).arg(m_max_error, 0, 'g', 3).arg(m_error_limit, 0, 'g', 3)
+						.arg((double) m_time_reference * 1000.0 / work, 6, 'f', 2).arg(unit).arg((double) m_time_simd * 1000.0 / work, 6, 'f', 2)
+						.arg((Passed())? "PASS" : ((m_guard_failed)? "FAIL (buffer overrun)" : "FAIL")));
+		return Passed();
+	}
+
+};
+
+static bool SelfTestConvert(const QString& name, AVPixelFormat out_format, PlaneLayoutFunc layout, bool even_width, bool even_height,
+							ConvertFunc reference, ConvertFunc simd, unsigned int iterations, std::mt19937& rng) {
+
+	SelfTestResult result_simd(name, 1.0), result_dispatch(name + " (unaligned)", 0.0);
+	FastScaler scaler;
+
+	for(unsigned int it = 0; it < iterations; ++it) {
+
+		// random size, stride and alignment
+		unsigned int w = 1 + rng() % 300, h = 1 + rng() % 100;
+		if(even_width)
+			w = (w + 1) & ~1u;
+		if(even_height)
+			h = (h + 1) & ~1u;
+		SelfTestImage in(LayoutBGRA, w, h, (rng() % 2 == 0), 4, rng);
+		SelfTestImage out_reference(layout, w, h, true, 1, rng);
+
+		int64_t t1 = hrt_time_micro();
+		reference(w, h, in.m_data[0], in.m_stride[0], out_reference.m_data.data(), out_reference.m_stride.data());
+		int64_t t2 = hrt_time_micro();
+		result_simd.m_time_reference += t2 - t1;
+		result_dispatch.m_time_reference += t2 - t1;
+		result_simd.m_guard_failed |= !out_reference.CheckGuards();
+
+		// SIMD kernel with aligned output
+		if(simd != NULL) {
+			SelfTestImage out_simd(layout, w, h, true, 1, rng);
+			int64_t t3 = hrt_time_micro();
+			simd(w, h, in.m_data[0], in.m_stride[0], out_simd.m_data.data(), out_simd.m_stride.data());
+			int64_t t4 = hrt_time_micro();
+			result_simd.m_time_simd += t4 - t3;
+			result_simd.m_max_error = std::max(result_simd.m_max_error, (double) out_simd.Compare(out_reference));
+			result_simd.m_guard_failed |= !out_simd.CheckGuards();
+			++result_simd.m_runs;
+			result_simd.m_work += (uint64_t) w * h;
+		}
+
+		// FastScaler with misaligned output, this has to take the fallback path and produce exactly the reference output
+		{
+			SelfTestImage out_dispatch(layout, w, h, false, 1, rng);
+			const uint8_t *in_data = in.m_data[0];
+			int64_t t3 = hrt_time_micro();
+			scaler.Scale(w, h, AV_PIX_FMT_BGRA, SWS_CS_DEFAULT, &in_data, in.m_stride.data(),
+						 w, h, out_format, SWS_CS_ITU709, out_dispatch.m_data.data(), out_dispatch.m_stride.data());
+			int64_t t4 = hrt_time_micro();
+			result_dispatch.m_time_simd += t4 - t3;
+			result_dispatch.m_max_error = std::max(result_dispatch.m_max_error, (double) out_dispatch.Compare(out_reference));
+			result_dispatch.m_guard_failed |= !out_dispatch.CheckGuards();
+			++result_dispatch.m_runs;
+			result_dispatch.m_work += (uint64_t) w * h;
+		}
+
+	}
+
+	bool passed = true;
+	if(simd != NULL)
+		passed &= result_simd.Report("px");
+	passed &= result_dispatch.Report("px");
+	return passed;
+}
+
+static bool SelfTestScale(ScaleFunc simd, unsigned int iterations, std::mt19937& rng) {
+
+	SelfTestResult result_simd("BGRA scale", 2.0), result_dispatch("BGRA scale (unaligned)", 0.0);
+	FastScaler scaler;
+
+	for(unsigned int it = 0; it < iterations; ++it) {
+
+		// random sizes, this covers upscaling, pure mipmapping and mipmapping + downscaling
+		unsigned int in_w = 2 + rng() % 400, in_h = 2 + rng() % 200;
+		unsigned int out_w = std::max(1u, (unsigned int) ((uint64_t) in_w * (1 + rng() % 16) / 8));
+		unsigned int out_h = std::max(1u, (unsigned int) ((uint64_t) in_h * (1 + rng() % 16) / 8));
+		SelfTestImage in(LayoutBGRA, in_w, in_h, (rng() % 2 == 0), 4, rng);
+		SelfTestImage out_reference(LayoutBGRA, out_w, out_h, true, 4, rng);
+
+		int64_t t1 = hrt_time_micro();
+		Scale_BGRA_Fallback(in_w, in_h, in.m_data[0], in.m_stride[0], out_w, out_h, out_reference.m_data[0], out_reference.m_stride[0]);
+		int64_t t2 = hrt_time_micro();
+		result_simd.m_time_reference += t2 - t1;
+		result_dispatch.m_time_reference += t2 - t1;
+		result_simd.m_guard_failed |= !out_reference.CheckGuards();
+
+		if(simd != NULL) {
+			SelfTestImage out_simd(LayoutBGRA, out_w, out_h, true, 4, rng);
+			int64_t t3 = hrt_time_micro();
+			simd(in_w, in_h, in.m_data[0], in.m_stride[0], out_w, out_h, out_simd.m_data[0], out_simd.m_stride[0]);
+			int64_t t4 = hrt_time_micro();
+			result_simd.m_time_simd += t4 - t3;
+			result_simd.m_max_error = std::max(result_simd.m_max_error, (double) out_simd.Compare(out_reference));
+			result_simd.m_guard_failed |= !out_simd.CheckGuards();
+			++result_simd.m_runs;
+			result_simd.m_work += (uint64_t) out_w * out_h;
+		}
+
+		{
+			SelfTestImage out_dispatch(LayoutBGRA, out_w, out_h, false, 4, rng);
+			const uint8_t *in_data = in.m_data[0];
+			int64_t t3 = hrt_time_micro();
+			scaler.Scale(in_w, in_h, AV_PIX_FMT_BGRA, SWS_CS_DEFAULT, &in_data, in.m_stride.data(),
+						 out_w, out_h, AV_PIX_FMT_BGRA, SWS_CS_DEFAULT, out_dispatch.m_data.data(), out_dispatch.m_stride.data());
+			int64_t t4 = hrt_time_micro();
+			result_dispatch.m_time_simd += t4 - t3;
+			result_dispatch.m_max_error = std::max(result_dispatch.m_max_error, (double) out_dispatch.Compare(out_reference));
+			result_dispatch.m_guard_failed |= !out_dispatch.CheckGuards();
+			++result_dispatch.m_runs;
+			result_dispatch.m_work += (uint64_t) out_w * out_h;
+		}
+
+	}
+
+	bool passed = true;
+	if(simd != NULL)
+		passed &= result_simd.Report("px");
+	passed &= result_dispatch.Report("px");
+	return passed;
+}
+
+static bool SelfTestBlend(BlendFunc simd, unsigned int iterations, std::mt19937& rng) {
+
+	// the blender works in place, so both outputs start with the same random content
+	SelfTestResult result("Plane blend", 0.0);
+	if(simd == NULL)
+		return true;
+
+	for(unsigned int it = 0; it < iterations; ++it) {
+
+		// random size (every fourth width is a multiple of 16, the others also test the remainder), stride, alignment and alpha
+		unsigned int w = 1 + rng() % 300, h = 1 + rng() % 100;
+		if(it % 4 == 0)
+			w = grow_align16(w);
+		unsigned int alpha = 1 + rng() % 255;
+		SelfTestImage in(LayoutGray, w, h, (rng() % 2 == 0), 1, rng);
+		SelfTestImage out_reference(LayoutGray, w, h, (rng() % 2 == 0), 1, rng);
+		SelfTestImage out_simd(LayoutGray, w, h, (rng() % 2 == 0), 1, rng);
+		out_simd.CopyFrom(out_reference);
+
+		int64_t t1 = hrt_time_micro();
+		Blend_Plane_Fallback(w, h, in.m_data[0], in.m_stride[0], out_reference.m_data[0], out_reference.m_stride[0], alpha);
+		int64_t t2 = hrt_time_micro();
+		simd(w, h, in.m_data[0], in.m_stride[0], out_simd.m_data[0], out_simd.m_stride[0], alpha);
+		int64_t t3 = hrt_time_micro();
+		result.m_time_reference += t2 - t1;
+		result.m_time_simd += t3 - t2;
+		result.m_max_error = std::max(result.m_max_error, (double) out_simd.Compare(out_reference));
+		result.m_guard_failed |= !out_reference.CheckGuards() || !out_simd.CheckGuards();
+		++result.m_runs;
+		result.m_work += (uint64_t) w * h;
+
+	}
+
+	return result.Report("px");
+}
+
+static bool SelfTestFirFilter(const QString& name, unsigned int min_channels, unsigned int max_channels, FirFilter2Ptr reference, FirFilter2Ptr simd,
+							  unsigned int iterations, std::mt19937& rng) {
+
+	// The SIMD version sums in a different order, so the error is relative to the sum of the absolute values of all terms.
+	SelfTestResult result(name, 1.0e-5);
+	if(simd == NULL)
+		return true;
+
+	std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+	for(unsigned int it = 0; it < iterations; ++it) {
+
+		// the coefficients are always aligned (see FastResampler::UpdateFilterCoefficients), the input is not
+		unsigned int channels = min_channels + rng() % (max_channels - min_channels + 1);
+		unsigned int filter_length = 4 * (1 + rng() % 64);
+		unsigned int input_offset = rng() % 4;
+		float frac = std::uniform_real_distribution<float>(0.0f, 1.0f)(rng);
+		TempBuffer<float> coef1, coef2, input, output_reference, output_simd;
+		coef1.Alloc(filter_length);
+		coef2.Alloc(filter_length);
+		input.Alloc(filter_length * channels + input_offset);
+		output_reference.Alloc(channels);
+		output_simd.Alloc(channels);
+		for(unsigned int i = 0; i < filter_length; ++i) {
+			coef1[i] = dist(rng);
+			coef2[i] = dist(rng);
+		}
+		for(unsigned int i = 0; i < filter_length * channels + input_offset; ++i) {
+			input[i] = dist(rng);
+		}
+
+		int64_t t1 = hrt_time_micro();
+		reference(channels, filter_length, coef1.GetData(), coef2.GetData(), frac, input.GetData() + input_offset, output_reference.GetData());
+		int64_t t2 = hrt_time_micro();
+		simd(channels, filter_length, coef1.GetData(), coef2.GetData(), frac, input.GetData() + input_offset, output_simd.GetData());
+		int64_t t3 = hrt_time_micro();
+		result.m_time_reference += t2 - t1;
+		result.m_time_simd += t3 - t2;
+
+		for(unsigned int c = 0; c < channels; ++c) {
+			double magnitude = 0.0;
+			for(unsigned int i = 0; i < filter_length; ++i) {
+				magnitude += fabs((double) input[input_offset + i * channels + c] * (double) (coef1[i] + (coef2[i] - coef1[i]) * frac));
+			}
+			double error = fabs((double) output_simd[c] - (double) output_reference[c]) / std::max(magnitude, 1.0e-6);
+			result.m_max_error = std::max(result.m_max_error, error);
+		}
+		++result.m_runs;
+		result.m_work += channels;
+
+	}
+
+	return result.Report("sample");
+}
+
+bool SelfTest(unsigned int iterations, unsigned int seed) {
+
+	Logger::LogInfo("[SelfTest] " + Logger::tr("Running %1 iterations per kernel with seed %2 ...").arg(iterations).arg(seed));
+	std::mt19937 rng(seed);
+	bool passed = true;
+
+	// a NULL SIMD function means that only the fallback path can be tested
+	ConvertFunc ssse3_yuv444 = NULL, ssse3_yuv422 = NULL, ssse3_yuv420 = NULL, ssse3_nv12 = NULL, ssse3_bgr = NULL;
+	ScaleFunc ssse3_scale = NULL;
+	FirFilter2Ptr sse2_c1 = NULL, sse2_c2 = NULL, sse2_cn = NULL;
+	BlendFunc sse2_blend = NULL;
+#if SSR_USE_X86_ASM
+	if(CPUFeatures::HasMMX() && CPUFeatures::HasSSE() && CPUFeatures::HasSSE2() && CPUFeatures::HasSSE3() && CPUFeatures::HasSSSE3()) {
+		ssse3_yuv444 = Convert_BGRA_YUV444_SSSE3;
+		ssse3_yuv422 = Convert_BGRA_YUV422_SSSE3;
+		ssse3_yuv420 = Convert_BGRA_YUV420_SSSE3;
+		ssse3_nv12 = Convert_BGRA_NV12_SSSE3;
+		ssse3_bgr = SelfTestPlaneWrapper<Convert_BGRA_BGR_SSSE3>;
+		ssse3_scale = Scale_BGRA_SSSE3;
+	} else {
+		Logger::LogWarning("[SelfTest] " + Logger::tr("Warning: SSSE3 is not supported by this CPU, only the fallback paths will be tested."));
+	}
+	if(CPUFeatures::HasMMX() && CPUFeatures::HasSSE() && CPUFeatures::HasSSE2()) {
+		sse2_c1 = FastResampler_FirFilter2_C1_SSE2;
+		sse2_c2 = FastResampler_FirFilter2_C2_SSE2;
+		sse2_cn = FastResampler_FirFilter2_Cn_SSE2;
+		sse2_blend = Blend_Plane_SSE2;
+	}
+#endif
+
+	passed &= SelfTestConvert("BGRA to YUV444", AV_PIX_FMT_YUV444P, LayoutYUV444, false, false, Convert_BGRA_YUV444_Fallback, ssse3_yuv444, iterations, rng);
+	passed &= SelfTestConvert("BGRA to YUV422", AV_PIX_FMT_YUV422P, LayoutYUV422, true , false, Convert_BGRA_YUV422_Fallback, ssse3_yuv422, iterations, rng);
+	passed &= SelfTestConvert("BGRA to YUV420", AV_PIX_FMT_YUV420P, LayoutYUV420, true , true , Convert_BGRA_YUV420_Fallback, ssse3_yuv420, iterations, rng);
+	passed &= SelfTestConvert("BGRA to NV12"  , AV_PIX_FMT_NV12   , LayoutNV12  , true , true , Convert_BGRA_NV12_Fallback  , ssse3_nv12  , iterations, rng);
+	passed &= SelfTestConvert("BGRA to BGR"   , AV_PIX_FMT_BGR24  , LayoutBGR   , false, false, SelfTestPlaneWrapper<Convert_BGRA_BGR_Fallback>, ssse3_bgr, iterations, rng);
+	passed &= SelfTestScale(ssse3_scale, iterations, rng);
+	passed &= SelfTestBlend(sse2_blend, iterations, rng);
+	passed &= SelfTestFirFilter("FIR filter 1 channel" , 1, 1, FastResampler_FirFilter2_C1_Fallback, sse2_c1, iterations, rng);
+	passed &= SelfTestFirFilter("FIR filter 2 channels", 2, 2, FastResampler_FirFilter2_C2_Fallback, sse2_c2, iterations, rng);
+	passed &= SelfTestFirFilter("FIR filter N channels", 3, 8, FastResampler_FirFilter2_Cn_Fallback, sse2_cn, iterations, rng);
+
+	if(passed) {
+		Logger::LogInfo("[SelfTest] " + Logger::tr("All kernels passed."));
+	} else {
+		Logger::LogError("[SelfTest] " + Logger::tr("Error: Some kernels failed!"));
+	}
+	return passed;
+}
@@ -38,6 +38,11 @@ void PrintOptionHelp() {
 		"                        /dev/shm/simplescreenrecorder-stats-PID is used. It will\n"
 		"                        be updated continuously and deleted when the recording\n"
 		"                        page is closed.\n"
+		"  --statsshm[=FILE]     Write binary recording statistics to FILE, which is\n"
+		"                        mapped into memory and updated directly by the\n"
+		"                        recording threads. If FILE is omitted,\n"
+		"                        /dev/shm/simplescreenrecorder-stats-PID.bin is used.\n"
+		"                        The layout is described in common/StatsSegment.h.\n"
 		"  --no-redirect-stderr  Don't redirect stderr to the log.\n"
 		"  --no-systray          Don't show the system tray icon.\n"
 		"  --start-hidden        Start the application in hidden form.\n"
@@ -45,8 +50,82 @@ void PrintOptionHelp() {
 		"  --activate-schedule   Activate the recording schedule immediately.\n"
 		"  --syncdiagram         Show synchronization diagram (for debugging).\n"
 		"  --benchmark           Run the internal benchmark.\n"
+		"  --benchmark-capture[=CONFIGS]\n"
+		"                        Run the X11 capture benchmark on a private X server.\n"
+		"                        CONFIGS is a comma-separated list of screen\n"
+		"                        configurations (WIDTHxHEIGHTxDEPTH), the default is\n"
+		"                        1920x1080x24.\n"
+		"  --benchmark-xserver=PROGRAM\n"
+		"                        X server used by the capture benchmark, Xvfb (the\n"
+		"                        default) or Xephyr.\n"
+		"  --benchmark-encoder[=WIDTHxHEIGHT]\n"
+		"                        Run the encoder benchmark for every combination of\n"
+		"                        preset, CRF, thread count and pixel format, and suggest\n"
+		"                        the slowest preset that is fast enough. The default\n"
+		"                        frame size is 1920x1080.\n"
+		"  --benchmark-codec=CODEC\n"
+		"                        Video codec used by the encoder benchmark (default:\n"
+		"                        libx264).\n"
+		"  --benchmark-presets=LIST\n"
+		"                        Comma-separated list of presets, from fast to slow\n"
+		"                        (default: ultrafast,superfast,veryfast,faster,fast,\n"
+		"                        medium).\n"
+		"  --benchmark-crf=LIST  Comma-separated list of CRF values (default: 23).\n"
+		"  --benchmark-threads=LIST\n"
+		"                        Comma-separated list of encoder thread counts, 0 means\n"
+		"                        automatic (default: 0).\n"
+		"  --benchmark-pixfmts=LIST\n"
+		"                        Comma-separated list of pixel formats (default:\n"
+		"                        yuv420).\n"
+		"  --benchmark-backends=LIST\n"
+		"                        Comma-separated list of encoder backends (libavcodec,\n"
+		"                        x264), empty means the default backend (default: empty).\n"
+		"  --benchmark-fps=FPS   Frame rate that the encoder should sustain (default: 30).\n"
+		"  --benchmark-content-hints\n"
+		"                        Also encode a mostly static clip with and without\n"
+		"                        content hints, and report the difference.\n"
+		"  --benchmark-roi       Also measure the quality inside and outside a region of\n"
+		"                        interest (like the one around the cursor), with and\n"
+		"                        without giving that region a higher quality.\n"
+		"  --benchmark-journal   Also encode every case with a packet journal, and report\n"
+		"                        the overhead.\n"
+		"  --benchmark-duration=MS\n"
+		"                        Measurement time per benchmark case (default: 5000).\n"
+		"  --benchmark-repeat=N  Repeat every benchmark N times and report the median\n"
+		"                        and variance (default: 5).\n"
+		"  --benchmark-output=FILE\n"
+		"                        Write the benchmark results to FILE, as CSV if the\n"
+		"                        name ends with .csv, otherwise as JSON. The default is\n"
+		"                        '-', which writes CSV to stdout.\n"
+		"  --benchmark-compare=FILE\n"
+		"                        Compare the benchmark results against a baseline JSON\n"
+		"                        report. The exit code is non-zero if any result is\n"
+		"                        worse than the baseline by more than the threshold.\n"
+		"  --benchmark-threshold=PERCENT\n"
+		"                        Regression threshold for --benchmark-compare\n"
+		"                        (default: 10).\n"
+		"  --selftest[=N]        Compare all SIMD kernels against the fallback code with\n"
+		"                        N random sizes and alignments per kernel (default: 200).\n"
+		"                        The exit code is non-zero if any kernel fails.\n"
+		"  --selftest-seed=SEED  Random seed for the self-test (default: 12345).\n"
+		"  --recover-journal=FILE\n"
+		"                        Rebuild a recording from its packet journal (the\n"
+		"                        '.journal' file that is left behind after a crash)\n"
+		"                        without re-encoding it.\n"
+		"  --recover-output=FILE Output file for --recover-journal (default: the original\n"
+		"                        file name with '-recovered' appended).\n"
+		"  --calibrate           Measure the capture, conversion and encoder speed with the\n"
+		"                        saved recording settings, store the results and save the\n"
+		"                        slowest H.264 preset that can sustain the frame rate.\n"
 		"  --backend             Run in backend mode without GUI, with HTTP server.\n"
 		"  --http-port=PORT      Set the HTTP server port (default: 8080).\n"
+		"  --control-socket=PATH In backend mode, also accept commands and send events\n"
+		"                        through a unix domain socket at PATH.\n"
+		"  --session-dir=DIR     In backend mode, the directory where sessions created through\n"
+		"                        the API write their files (default: 'sessions' in the\n"
+		"                        configuration directory). Files outside it are rejected.\n"
+		"  --worker-threads=N    Set the number of worker threads that are shared by the\n"
+		"                        recording pipeline (default: one per core, at most 8).\n"
 		"\n"
 		"Commands accepted through stdin:\n"
 		"  record-start          Start the recording.\n"
@@ -87,6 +166,10 @@ QString DefaultStatsFile() {
 	return "/dev/shm/simplescreenrecorder-stats-" + QString::number(QCoreApplication::applicationPid());
 }
 
+QString DefaultStatsShmFile() {
+	return "/dev/shm/simplescreenrecorder-stats-" + QString::number(QCoreApplication::applicationPid()) + ".bin";
+}
+
 void CheckOptionHasValue(const QString &option, const QString &value) {
 	if(value.isNull()) {
 		Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Command-line option '%1' requires a value!").arg(option));
@@ -109,6 +192,7 @@ CommandLineOptions::CommandLineOptions() {
 	m_settings_file = DefaultSettingsFile();
 	m_log_file = QString();
 	m_stats_file = QString();
+	m_stats_shm_file = QString();
 	m_output_file = QString();
 	m_redirect_stderr = true;
 	m_systray = true;
@@ -117,9 +201,35 @@ CommandLineOptions::CommandLineOptions() {
 	m_activate_schedule = false;
 	m_sync_diagram = false;
 	m_benchmark = false;
+	m_benchmark_capture = QString();
+	m_benchmark_xserver = "Xvfb";
+	m_benchmark_encoder = QString();
+	m_benchmark_codec = "libx264";
+	m_benchmark_presets = "ultrafast,superfast,veryfast,faster,fast,medium";
+	m_benchmark_crf = "23";
+	m_benchmark_threads = "0";
+	m_benchmark_pixfmts = "yuv420";
+	m_benchmark_backends = QString();
+	m_benchmark_fps = 30;
+	m_benchmark_content_hints = false;
+	m_benchmark_roi = false;
+	m_benchmark_journal = false;
+	m_benchmark_duration = 5000;
+	m_benchmark_repeat = 5;
+	m_benchmark_output = "-";
+	m_benchmark_compare = QString();
+	m_benchmark_threshold = 10.0;
+	m_selftest_iterations = 0;
+	m_selftest_seed = 12345;
+	m_recover_journal = QString();
+	m_recover_output = QString();
+	m_calibrate = false;
 	m_gui = true;
 	m_backend = false;
 	m_http_port = 8080;
+	m_control_socket = QString();
+	m_session_dir = QString();
+	m_worker_threads = 0;
 }
 
 CommandLineOptions::~CommandLineOptions() {
@@ -171,6 +281,12 @@ void CommandLineOptions::Parse() {
 				} else {
 					m_stats_file = value;
 				}
+			} else if(option == "--statsshm") {
+				if(value.isNull()) {
+					m_stats_shm_file = DefaultStatsShmFile();
+				} else {
+					m_stats_shm_file = value;
+				}
 			} else if(option == "--no-redirect-stderr") {
 				CheckOptionHasNoValue(option, value);
 				m_redirect_stderr = false;
@@ -193,6 +309,125 @@ void CommandLineOptions::Parse() {
 				CheckOptionHasNoValue(option, value);
 				m_benchmark = true;
 				m_gui = false;
+			} else if(option == "--benchmark-capture") {
+				if(value.isNull()) {
+					m_benchmark_capture = "1920x1080x24";
+				} else {
+					m_benchmark_capture = value;
+				}
+				m_gui = false;
+			} else if(option == "--benchmark-xserver") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_xserver = value;
+			} else if(option == "--benchmark-encoder") {
+				if(value.isNull()) {
+					m_benchmark_encoder = "1920x1080";
+				} else {
+					m_benchmark_encoder = value;
+				}
+				m_gui = false;
+			} else if(option == "--benchmark-codec") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_codec = value;
+			} else if(option == "--benchmark-presets") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_presets = value;
+			} else if(option == "--benchmark-crf") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_crf = value;
+			} else if(option == "--benchmark-threads") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_threads = value;
+			} else if(option == "--benchmark-pixfmts") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_pixfmts = value;
+			} else if(option == "--benchmark-backends") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_backends = value;
+			} else if(option == "--benchmark-fps") {
+				CheckOptionHasValue(option, value);
+				bool ok;
+				int fps = value.toInt(&ok);
+				if(!ok || fps <= 0 || fps > 1000) {
+					Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Benchmark frame rate must be between 1 and 1000!"));
+					PrintOptionHelp();
+					throw CommandLineException();
+				}
+				m_benchmark_fps = fps;
+			} else if(option == "--benchmark-content-hints") {
+				CheckOptionHasNoValue(option, value);
+				m_benchmark_content_hints = true;
+			} else if(option == "--benchmark-roi") {
+				CheckOptionHasNoValue(option, value);
+				m_benchmark_roi = true;
+			} else if(option == "--benchmark-journal") {
+				CheckOptionHasNoValue(option, value);
+				m_benchmark_journal = true;
+			} else if(option == "--benchmark-duration") {
+				CheckOptionHasValue(option, value);
+				bool ok;
+				int duration = value.toInt(&ok);
+				if(!ok || duration < 100) {
+					Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Benchmark duration must be at least 100 ms!"));
+					PrintOptionHelp();
+					throw CommandLineException();
+				}
+				m_benchmark_duration = duration;
+			} else if(option == "--benchmark-repeat") {
+				CheckOptionHasValue(option, value);
+				bool ok;
+				int repeat = value.toInt(&ok);
+				if(!ok || repeat <= 0) {
+					Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Benchmark repeat count must be positive!"));
+					PrintOptionHelp();
+					throw CommandLineException();
+				}
+				m_benchmark_repeat = repeat;
+			} else if(option == "--benchmark-output") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_output = value;
+			} else if(option == "--benchmark-compare") {
+				CheckOptionHasValue(option, value);
+				m_benchmark_compare = value;
+			} else if(option == "--benchmark-threshold") {
+				CheckOptionHasValue(option, value);
+				bool ok;
+				double threshold = value.toDouble(&ok);
+				if(!ok || threshold < 0.0) {
+					Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Benchmark threshold must be a non-negative number!"));
+					PrintOptionHelp();
+					throw CommandLineException();
+				}
+				m_benchmark_threshold = threshold;
+			} else if(option == "--selftest") {
+				if(value.isNull()) {
+					m_selftest_iterations = 200;
+				} else {
+					bool ok;
+					int iterations = value.toInt(&ok);
+					if(!ok || iterations <= 0) {
+						Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Self-test iteration count must be positive!"));
+						PrintOptionHelp();
+						throw CommandLineException();
+					}
+					m_selftest_iterations = iterations;
+				}
+				m_gui = false;
+			} else if(option == "--selftest-seed") {
+				CheckOptionHasValue(option, value);
+				m_selftest_seed = value.toUInt();
+			} else if(option == "--recover-journal") {
+				CheckOptionHasValue(option, value);
+				m_recover_journal = value;
+				m_gui = false;
+			} else if(option == "--recover-output") {
+				CheckOptionHasValue(option, value);
+				m_recover_output = value;
+			} else if(option == "--calibrate") {
+				CheckOptionHasNoValue(option, value);
+				m_calibrate = true;
+				m_gui = false;
+				m_start_hidden = true;
 			} else if(option == "--backend") {
 				CheckOptionHasNoValue(option, value);
 				m_backend = true;
@@ -208,6 +443,22 @@ void CommandLineOptions::Parse() {
 					throw CommandLineException();
 				}
 				m_http_port = port;
+			} else if(option == "--control-socket") {
+				CheckOptionHasValue(option, value);
+				m_control_socket = value;
+			} else if(option == "--session-dir") {
+				CheckOptionHasValue(option, value);
+				m_session_dir = value;
+			} else if(option == "--worker-threads") {
+				CheckOptionHasValue(option, value);
+				bool ok;
+				unsigned int threads = value.toUInt(&ok);
+				if(!ok || threads == 0 || threads > 64) {
+					Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: The number of worker threads must be between 1 and 64!"));
+					PrintOptionHelp();
+					throw CommandLineException();
+				}
+				m_worker_threads = threads;
 			} else {
 				Logger::LogError("[CommandLineOptions::Parse] " + Logger::tr("Error: Unknown command-line option '%1'!").arg(option));
 				PrintOptionHelp();
@@ -33,6 +33,7 @@ private:
 	QString m_settings_file;
 	QString m_log_file;
 	QString m_stats_file;
+	QString m_stats_shm_file;
 	QString m_output_file;
 	bool m_redirect_stderr;
 	bool m_systray;
@@ -41,9 +42,35 @@ private:
 	bool m_activate_schedule;
 	bool m_sync_diagram;
 	bool m_benchmark;
+	QString m_benchmark_capture;
+	QString m_benchmark_xserver;
+	QString m_benchmark_encoder;
+	QString m_benchmark_codec;
+	QString m_benchmark_presets;
+	QString m_benchmark_crf;
+	QString m_benchmark_threads;
+	QString m_benchmark_pixfmts;
+	QString m_benchmark_backends;
+	unsigned int m_benchmark_fps;
+	bool m_benchmark_content_hints;
+	bool m_benchmark_roi;
+	bool m_benchmark_journal;
+	unsigned int m_benchmark_duration;
+	unsigned int m_benchmark_repeat;
+	QString m_benchmark_output;
+	QString m_benchmark_compare;
+	double m_benchmark_threshold;
+	unsigned int m_selftest_iterations;
+	unsigned int m_selftest_seed;
+	QString m_recover_journal;
+	QString m_recover_output;
+	bool m_calibrate;
 	bool m_gui;
 	bool m_backend;
 	int m_http_port;
+	QString m_control_socket;
+	QString m_session_dir;
+	unsigned int m_worker_threads;
 
 	static CommandLineOptions *s_instance;
 
@@ -58,6 +85,7 @@ public:
 	inline static const QString& GetSettingsFile() { return GetInstance()->m_settings_file; }
 	inline static const QString& GetLogFile() { return GetInstance()->m_log_file; }
 	inline static const QString& GetStatsFile() { return GetInstance()->m_stats_file; }
+	inline static const QString& GetStatsShmFile() { return GetInstance()->m_stats_shm_file; }
 	inline static const QString& GetOutputFile() { return GetInstance()->m_output_file; }
 	inline static bool GetRedirectStderr() { return GetInstance()->m_redirect_stderr; }
 	inline static bool GetSysTray() { return GetInstance()->m_systray; }
@@ -66,9 +94,35 @@ public:
 	inline static bool GetActivateSchedule() { return GetInstance()->m_activate_schedule; }
 	inline static bool GetSyncDiagram() { return GetInstance()->m_sync_diagram; }
 	inline static bool GetBenchmark() { return GetInstance()->m_benchmark; }
+	inline static const QString& GetBenchmarkCapture() { return GetInstance()->m_benchmark_capture; }
+	inline static const QString& GetBenchmarkXServer() { return GetInstance()->m_benchmark_xserver; }
+	inline static const QString& GetBenchmarkEncoder() { return GetInstance()->m_benchmark_encoder; }
+	inline static const QString& GetBenchmarkCodec() { return GetInstance()->m_benchmark_codec; }
+	inline static const QString& GetBenchmarkPresets() { return GetInstance()->m_benchmark_presets; }
+	inline static const QString& GetBenchmarkCRF() { return GetInstance()->m_benchmark_crf; }
+	inline static const QString& GetBenchmarkThreads() { return GetInstance()->m_benchmark_threads; }
+	inline static const QString& GetBenchmarkPixFmts() { return GetInstance()->m_benchmark_pixfmts; }
+	inline static const QString& GetBenchmarkBackends() { return GetInstance()->m_benchmark_backends; }
+	inline static unsigned int GetBenchmarkFps() { return GetInstance()->m_benchmark_fps; }
+	inline static bool GetBenchmarkContentHints() { return GetInstance()->m_benchmark_content_hints; }
+	inline static bool GetBenchmarkROI() { return GetInstance()->m_benchmark_roi; }
+	inline static bool GetBenchmarkJournal() { return GetInstance()->m_benchmark_journal; }
+	inline static unsigned int GetBenchmarkDuration() { return GetInstance()->m_benchmark_duration; }
+	inline static unsigned int GetBenchmarkRepeat() { return GetInstance()->m_benchmark_repeat; }
+	inline static const QString& GetBenchmarkOutput() { return GetInstance()->m_benchmark_output; }
+	inline static const QString& GetBenchmarkCompare() { return GetInstance()->m_benchmark_compare; }
+	inline static double GetBenchmarkThreshold() { return GetInstance()->m_benchmark_threshold; }
+	inline static unsigned int GetSelfTestIterations() { return GetInstance()->m_selftest_iterations; }
+	inline static unsigned int GetSelfTestSeed() { return GetInstance()->m_selftest_seed; }
+	inline static const QString& GetRecoverJournal() { return GetInstance()->m_recover_journal; }
+	inline static const QString& GetRecoverOutput() { return GetInstance()->m_recover_output; }
+	inline static bool GetCalibrate() { return GetInstance()->m_calibrate; }
 	inline static bool GetGui() { return GetInstance()->m_gui; }
 	inline static bool GetBackend() { return GetInstance()->m_backend; }
 	inline static int GetHttpPort() { return GetInstance()->m_http_port; }
+	inline static const QString& GetControlSocket() { return GetInstance()->m_control_socket; }
+	inline static const QString& GetSessionDir() { return GetInstance()->m_session_dir; }
+	inline static unsigned int GetWorkerThreads() { return GetInstance()->m_worker_threads; }
 
 	inline static void SetOutputFile(const QString& file) { GetInstance()->m_output_file = file; }
 
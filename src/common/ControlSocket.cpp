@@ -0,0 +1,468 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "ControlSocket.h"
+
+#include "HTTPServer.h"
+#include "Logger.h"
+#include "StatsSegment.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+
+#include <sys/socket.h>
+#include <sys/un.h>
+
+// Maximum size of a frame. Requests are small, so anything larger is probably not our protocol.
+const size_t ControlSocket::MAX_FRAME_SIZE = 1024 * 1024;
+
+// Maximum amount of unsent data per client. Clients that don't read their events are disconnected, otherwise they would use an
+// unlimited amount of memory.
+const size_t ControlSocket::MAX_OUTPUT_SIZE = 4 * 1024 * 1024;
+
+// Interval at which the state is checked for changes (in milliseconds). This is also the shortest interval for stats events.
+const int ControlSocket::UPDATE_INTERVAL = 100;
+
+static inline uint32_t ReadU32(const char* data) {
+	const uint8_t *p = (const uint8_t*) data;
+	return (uint32_t) p[0] | ((uint32_t) p[1] << 8) | ((uint32_t) p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+static inline void AppendU32(QByteArray* buffer, uint32_t value) {
+	for(unsigned int i = 0; i < 4; ++i) {
+		buffer->append((char) (uint8_t) (value >> (8 * i)));
+	}
+}
+
+ControlSocket::ControlSocket(HTTPServer* http_server, const QString& path) {
+
+	m_http_server = http_server;
+	m_path = path;
+	m_fd = -1;
+	m_bound = false;
+	m_notifier_accept = NULL;
+	m_timer_update = NULL;
+
+	try {
+		Init();
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+}
+
+ControlSocket::~ControlSocket() {
+	Free();
+}
+
+void ControlSocket::Init() {
+
+	QByteArray path = QFile::encodeName(m_path);
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if((size_t) path.size() >= sizeof(addr.sun_path)) {
+		Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Control socket path '%1' is too long!").arg(m_path));
+		throw ControlSocketException();
+	}
+	memcpy(addr.sun_path, path.constData(), path.size());
+
+	// remove the socket of a previous instance that didn't exit cleanly, but only if nothing is listening on it anymore
+	struct stat st;
+	if(lstat(path.constData(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+		int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+		if(fd == -1) {
+			Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Can't create control socket!"));
+			throw ControlSocketException();
+		}
+		bool in_use = (::connect(fd, (struct sockaddr*) &addr, sizeof(addr)) == 0);
+		close(fd);
+		if(in_use) {
+			Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Control socket '%1' is already in use by another instance!").arg(m_path));
+			throw ControlSocketException();
+		}
+		Logger::LogWarning("[ControlSocket::Init] " + Logger::tr("Warning: Replacing stale control socket '%1'.").arg(m_path));
+		unlink(path.constData());
+	}
+
+	// create the socket
+	m_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+	if(m_fd == -1) {
+		Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Can't create control socket!"));
+		throw ControlSocketException();
+	}
+
+	// the socket gives full control over the recordings, so only the current user should be able to connect
+	// the umask makes sure that the socket file is never accessible to others, not even between bind and chmod
+	mode_t old_umask = umask(0077);
+	int bind_result = bind(m_fd, (struct sockaddr*) &addr, sizeof(addr));
+	umask(old_umask);
+	if(bind_result == -1) {
+		Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Can't bind control socket to '%1'!").arg(m_path));
+		throw ControlSocketException();
+	}
+	m_bound = true;
+	if(chmod(path.constData(), 0600) == -1) {
+		Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Can't change permissions of control socket!"));
+		throw ControlSocketException();
+	}
+	if(listen(m_fd, 16) == -1) {
+		Logger::LogError("[ControlSocket::Init] " + Logger::tr("Error: Can't listen on control socket!"));
+		throw ControlSocketException();
+	}
+
+	m_notifier_accept = new QSocketNotifier(m_fd, QSocketNotifier::Read, this);
+	connect(m_notifier_accept, SIGNAL(activated(int)), this, SLOT(OnAccept()));
+
+	m_timer_update = new QTimer(this);
+	connect(m_timer_update, SIGNAL(timeout()), this, SLOT(OnUpdate()));
+	m_timer_update->start(UPDATE_INTERVAL);
+
+	Logger::LogInfo("[ControlSocket::Init] " + Logger::tr("Control socket listening on '%1'.").arg(m_path));
+
+}
+
+void ControlSocket::Free() {
+	for(std::unique_ptr<Client> &client : m_clients) {
+		CloseClient(client.get());
+	}
+	RemoveClosedClients();
+	if(m_timer_update != NULL) {
+		m_timer_update->stop();
+	}
+	if(m_notifier_accept != NULL) {
+		m_notifier_accept->setEnabled(false);
+	}
+	if(m_fd != -1) {
+		close(m_fd);
+		m_fd = -1;
+	}
+	if(m_bound) {
+		unlink(QFile::encodeName(m_path).constData());
+		m_bound = false;
+	}
+}
+
+ControlSocket::Client* ControlSocket::FindClient(int fd) {
+	for(std::unique_ptr<Client> &client : m_clients) {
+		if(client->m_fd == fd && !client->m_closed)
+			return client.get();
+	}
+	return NULL;
+}
+
+void ControlSocket::CloseClient(Client* client) {
+	client->m_closed = true;
+	client->m_notifier_read->setEnabled(false);
+	client->m_notifier_write->setEnabled(false);
+}
+
+void ControlSocket::RemoveClosedClients() {
+	for(size_t i = m_clients.size(); i > 0; ) {
+		--i;
+		Client *client = m_clients[i].get();
+		if(!client->m_closed)
+			continue;
+		for(OutputFrame &frame : client->m_output) {
+			if(frame.m_fd != -1)
+				close(frame.m_fd);
+		}
+		// this may be called from a signal of the notifier, so it can't be deleted immediately
+		client->m_notifier_read->deleteLater();
+		client->m_notifier_write->deleteLater();
+		close(client->m_fd);
+		m_clients.erase(m_clients.begin() + i);
+	}
+}
+
+void ControlSocket::HandleFrame(Client* client, uint8_t type, uint32_t id, const QByteArray& payload) {
+
+	if(type != FRAME_REQUEST) {
+		Logger::LogWarning("[ControlSocket::HandleFrame] " + Logger::tr("Warning: Received frame with unknown type %1, closing connection.").arg(type));
+		CloseClient(client);
+		return;
+	}
+
+	QJsonParseError error;
+	QJsonDocument doc = QJsonDocument::fromJson(payload, &error);
+	if(error.error != QJsonParseError::NoError || !doc.isObject()) {
+		SendFrame(client, FRAME_RESPONSE, id, HTTPServer::CreateErrorResponse("Invalid JSON"));
+		return;
+	}
+	QJsonObject json = doc.object();
+	QString command = json.value("command").toString();
+
+	if(command == "subscribe") {
+		QJsonArray events = json.value("events").toArray();
+		client->m_subscribe_state = events.contains(QString("state"));
+		if(events.contains(QString("stats"))) {
+			client->m_stats_interval = (int64_t) clamp(json.value("stats_interval").toInt(1000), UPDATE_INTERVAL, 60000) * 1000;
+			client->m_next_stats_time = hrt_time_micro();
+		} else {
+			client->m_stats_interval = 0;
+		}
+		SendFrame(client, FRAME_RESPONSE, id, HTTPServer::CreateSuccessResponse());
+		// the client needs to know the current state, otherwise the first event is meaningless
+		if(client->m_subscribe_state) {
+			SendFrame(client, FRAME_EVENT, client->m_next_event_id++, QJsonObject({{"event", "state"}, {"data", GetState()}}));
+		}
+	} else if(command == "unsubscribe") {
+		client->m_subscribe_state = false;
+		client->m_stats_interval = 0;
+		SendFrame(client, FRAME_RESPONSE, id, HTTPServer::CreateSuccessResponse());
+	} else if(command == "stats-fd") {
+		if(!StatsSegment::IsEnabled()) {
+			SendFrame(client, FRAME_RESPONSE, id, HTTPServer::CreateErrorResponse("The shared stats segment is disabled (see --statsshm)"));
+			return;
+		}
+		int fd = open(QFile::encodeName(StatsSegment::GetFile()).constData(), O_RDONLY | O_CLOEXEC);
+		if(fd == -1) {
+			SendFrame(client, FRAME_RESPONSE, id, HTTPServer::CreateErrorResponse("Could not open the shared stats segment"));
+			return;
+		}
+		QJsonObject data;
+		data["size"] = (qint64) StatsSegment::GetSize();
+		data["slot_count"] = (qint64) StatsSegment::SLOT_COUNT;
+		data["version"] = (qint64) StatsSegment::STATS_VERSION;
+		SendFrame(client, FRAME_RESPONSE, id, HTTPServer::CreateSuccessResponse(data), fd);
+	} else {
+		SendFrame(client, FRAME_RESPONSE, id, m_http_server->HandleCommand(command, json));
+	}
+
+}
+
+void ControlSocket::SendFrame(Client* client, uint8_t type, uint32_t id, const QJsonObject& payload, int fd) {
+
+	if(client->m_closed) {
+		if(fd != -1)
+			close(fd);
+		return;
+	}
+
+	QByteArray data = QJsonDocument(payload).toJson(QJsonDocument::Compact);
+	OutputFrame frame;
+	frame.m_data.reserve(9 + data.size());
+	AppendU32(&frame.m_data, 5 + data.size());
+	frame.m_data.append((char) type);
+	AppendU32(&frame.m_data, id);
+	frame.m_data.append(data);
+	frame.m_sent = 0;
+	frame.m_fd = fd;
+	client->m_output_size += frame.m_data.size();
+	client->m_output.push_back(std::move(frame));
+
+	if(client->m_output_size > MAX_OUTPUT_SIZE) {
+		Logger::LogWarning("[ControlSocket::SendFrame] " + Logger::tr("Warning: Client is not reading its messages, closing connection."));
+		CloseClient(client);
+		return;
+	}
+
+	FlushClient(client);
+
+}
+
+void ControlSocket::FlushClient(Client* client) {
+
+	while(!client->m_output.empty()) {
+		OutputFrame &frame = client->m_output.front();
+		const char *data = frame.m_data.constData() + frame.m_sent;
+		size_t size = frame.m_data.size() - frame.m_sent;
+		ssize_t bytes_sent;
+		if(frame.m_fd != -1) {
+			// the file descriptor is sent along with the first byte of the frame
+			struct iovec iov;
+			iov.iov_base = (void*) data;
+			iov.iov_len = size;
+			union {
+				char buffer[CMSG_SPACE(sizeof(int))];
+				struct cmsghdr align;
+			} control;
+			memset(&control, 0, sizeof(control));
+			struct msghdr msg;
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+			msg.msg_control = control.buffer;
+			msg.msg_controllen = sizeof(control.buffer);
+			struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+			cmsg->cmsg_level = SOL_SOCKET;
+			cmsg->cmsg_type = SCM_RIGHTS;
+			cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+			memcpy(CMSG_DATA(cmsg), &frame.m_fd, sizeof(int));
+			bytes_sent = sendmsg(client->m_fd, &msg, MSG_NOSIGNAL);
+			if(bytes_sent > 0) {
+				close(frame.m_fd);
+				frame.m_fd = -1;
+			}
+		} else {
+			bytes_sent = send(client->m_fd, data, size, MSG_NOSIGNAL);
+		}
+		if(bytes_sent < 0) {
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break;
+			CloseClient(client);
+			return;
+		}
+		frame.m_sent += bytes_sent;
+		client->m_output_size -= bytes_sent;
+		if(frame.m_sent == (size_t) frame.m_data.size())
+			client->m_output.pop_front();
+	}
+
+	// wait until the socket is writable again
+	client->m_notifier_write->setEnabled(!client->m_output.empty());
+
+}
+
+QJsonObject ControlSocket::GetState() {
+	QJsonObject status = m_http_server->HandleCommand("status", QJsonObject()).value("data").toObject();
+	QJsonObject state;
+	state["is_recording"] = status.value("is_recording");
+	state["is_paused"] = status.value("is_paused");
+	state["file_name"] = status.value("file_name");
+	QJsonArray sessions;
+	for(const QJsonValue &value : m_http_server->HandleCommand("sessions", QJsonObject()).value("data").toObject().value("sessions").toArray()) {
+		QJsonObject session = value.toObject();
+		sessions.append(QJsonObject({{"id", session.value("id")}, {"state", session.value("state")}}));
+	}
+	state["sessions"] = sessions;
+	return state;
+}
+
+void ControlSocket::OnAccept() {
+	for( ; ; ) {
+		int fd = accept4(m_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+		if(fd == -1) {
+			if(errno == EINTR)
+				continue;
+			if(errno != EAGAIN && errno != EWOULDBLOCK)
+				Logger::LogWarning("[ControlSocket::OnAccept] " + Logger::tr("Warning: Can't accept connection on control socket!"));
+			break;
+		}
+		std::unique_ptr<Client> client(new Client());
+		client->m_fd = fd;
+		client->m_notifier_read = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+		client->m_notifier_write = new QSocketNotifier(fd, QSocketNotifier::Write, this);
+		client->m_notifier_write->setEnabled(false);
+		connect(client->m_notifier_read, SIGNAL(activated(int)), this, SLOT(OnClientRead(int)));
+		connect(client->m_notifier_write, SIGNAL(activated(int)), this, SLOT(OnClientWrite(int)));
+		client->m_output_size = 0;
+		client->m_closed = false;
+		client->m_subscribe_state = false;
+		client->m_stats_interval = 0;
+		client->m_next_stats_time = 0;
+		client->m_next_event_id = 0;
+		m_clients.push_back(std::move(client));
+	}
+}
+
+void ControlSocket::OnClientRead(int fd) {
+	Client *client = FindClient(fd);
+	if(client == NULL)
+		return;
+
+	// read everything that is available
+	char buffer[65536];
+	for( ; ; ) {
+		ssize_t bytes_read = recv(fd, buffer, sizeof(buffer), 0);
+		if(bytes_read > 0) {
+			client->m_input.append(buffer, bytes_read);
+			continue;
+		}
+		if(bytes_read < 0 && errno == EINTR)
+			continue;
+		if(bytes_read < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+			break;
+		CloseClient(client); // end of stream or error
+		break;
+	}
+
+	// handle all complete frames
+	size_t pos = 0;
+	while(!client->m_closed && (size_t) client->m_input.size() - pos >= 4) {
+		uint32_t size = ReadU32(client->m_input.constData() + pos);
+		if(size < 5 || size > MAX_FRAME_SIZE) {
+			Logger::LogWarning("[ControlSocket::OnClientRead] " + Logger::tr("Warning: Received invalid frame, closing connection."));
+			CloseClient(client);
+			break;
+		}
+		if((size_t) client->m_input.size() - pos < 4 + (size_t) size)
+			break;
+		uint8_t type = (uint8_t) client->m_input[(int) (pos + 4)];
+		uint32_t id = ReadU32(client->m_input.constData() + pos + 5);
+		HandleFrame(client, type, id, client->m_input.mid((int) pos + 9, (int) size - 5));
+		pos += 4 + size;
+	}
+	client->m_input.remove(0, pos);
+
+	RemoveClosedClients();
+}
+
+void ControlSocket::OnClientWrite(int fd) {
+	Client *client = FindClient(fd);
+	if(client == NULL)
+		return;
+	FlushClient(client);
+	RemoveClosedClients();
+}
+
+void ControlSocket::OnUpdate() {
+
+	// find out what has to be sent
+	int64_t now = hrt_time_micro();
+	bool need_state = false, need_stats = false;
+	for(std::unique_ptr<Client> &client : m_clients) {
+		if(client->m_subscribe_state)
+			need_state = true;
+		if(client->m_stats_interval != 0 && now >= client->m_next_stats_time)
+			need_stats = true;
+	}
+
+	// state changes
+	if(need_state) {
+		QJsonObject state = GetState();
+		if(state != m_last_state) {
+			m_last_state = state;
+			QJsonObject event({{"event", "state"}, {"data", state}});
+			for(std::unique_ptr<Client> &client : m_clients) {
+				if(client->m_subscribe_state)
+					SendFrame(client.get(), FRAME_EVENT, client->m_next_event_id++, event);
+			}
+		}
+	}
+
+	// periodic stats
+	if(need_stats) {
+		QJsonObject data;
+		data["status"] = m_http_server->HandleCommand("status", QJsonObject()).value("data");
+		data["sessions"] = m_http_server->HandleCommand("sessions", QJsonObject()).value("data");
+		QJsonObject event({{"event", "stats"}, {"data", data}});
+		for(std::unique_ptr<Client> &client : m_clients) {
+			if(client->m_stats_interval != 0 && now >= client->m_next_stats_time) {
+				SendFrame(client.get(), FRAME_EVENT, client->m_next_event_id++, event);
+				client->m_next_stats_time = std::max(client->m_next_stats_time + client->m_stats_interval, now);
+			}
+		}
+	}
+
+	RemoveClosedClients();
+
+}
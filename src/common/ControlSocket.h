@@ -0,0 +1,117 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include <QJsonObject>
+
+class HTTPServer;
+
+class ControlSocketException : public std::exception {
+public:
+	inline virtual const char* what() const throw() override {
+		return "ControlSocketException";
+	}
+};
+
+// A control channel on a unix domain socket for local supervisors in backend mode. Unlike the HTTP server, connections are
+// persistent and the server can push events, so clients don't have to poll.
+//
+// Every message is a frame: size (u32, number of bytes after this field), type (u8), id (u32), payload (compact JSON, may be empty).
+// All integers are little-endian. Frame types:
+// - FRAME_REQUEST (client to server): the payload is an object with a 'command' and its parameters. The commands are the same as
+//   the HTTP API paths (e.g. 'status', 'record/start', 'sessions/create') and are handled by the same code. There are also three
+//   commands that only exist here: 'subscribe' (parameters: 'events', a list containing 'state' and/or 'stats', and 'stats_interval'
+//   in milliseconds), 'unsubscribe' and 'stats-fd'.
+// - FRAME_RESPONSE (server to client): the response to the request with the same id, the same object that HTTP would return.
+//   The response to 'stats-fd' carries a read-only file descriptor of the shared stats segment (SCM_RIGHTS), which the client can
+//   map to read the statistics of all recordings directly (see StatsSegment.h).
+// - FRAME_EVENT (server to client): an event for a subscribed client, the id is a sequence number. 'state' events are sent when the
+//   recording or session states change, 'stats' events are sent periodically.
+class ControlSocket : public QObject {
+	Q_OBJECT
+
+private:
+	struct OutputFrame {
+		QByteArray m_data;
+		size_t m_sent;
+		int m_fd; // file descriptor that is sent with the first byte of the frame, or -1
+	};
+	struct Client {
+		int m_fd;
+		QSocketNotifier *m_notifier_read, *m_notifier_write;
+		QByteArray m_input;
+		std::deque<OutputFrame> m_output;
+		size_t m_output_size;
+		bool m_closed;
+		bool m_subscribe_state;
+		int64_t m_stats_interval, m_next_stats_time; // in microseconds, zero if not subscribed
+		uint32_t m_next_event_id;
+	};
+
+public:
+	enum enum_frame_type {
+		FRAME_REQUEST = 1,
+		FRAME_RESPONSE = 2,
+		FRAME_EVENT = 3,
+	};
+
+private:
+	static const size_t MAX_FRAME_SIZE, MAX_OUTPUT_SIZE;
+	static const int UPDATE_INTERVAL;
+
+private:
+	HTTPServer *m_http_server;
+	QString m_path;
+	int m_fd;
+	bool m_bound;
+	QSocketNotifier *m_notifier_accept;
+	std::vector<std::unique_ptr<Client> > m_clients;
+
+	QJsonObject m_last_state;
+
+	QTimer *m_timer_update;
+
+public:
+	// Creates the socket. A stale socket file at the same path is replaced.
+	ControlSocket(HTTPServer* http_server, const QString& path);
+	~ControlSocket();
+
+private:
+	void Init();
+	void Free();
+
+	Client* FindClient(int fd);
+	void CloseClient(Client* client);
+	void RemoveClosedClients();
+
+	void HandleFrame(Client* client, uint8_t type, uint32_t id, const QByteArray& payload);
+	void SendFrame(Client* client, uint8_t type, uint32_t id, const QJsonObject& payload, int fd = -1);
+	void FlushClient(Client* client);
+
+	QJsonObject GetState();
+
+private slots:
+	void OnAccept();
+	void OnClientRead(int fd);
+	void OnClientWrite(int fd);
+	void OnUpdate();
+
+};
@@ -18,8 +18,21 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include "HTTPServer.h"
+#include "CommandLineOptions.h"
 #include "Logger.h"
 #include "PageRecord.h"
+#include "SessionManager.h"
+
+#include <QJsonArray>
+
+// 码率必须是正整数（kbit/s），CRF必须是0到51之间的整数
+// 0不能直接传给编码器，因为它表示“不修改”，负数会在转换为unsigned时溢出
+static bool IsValidVideoKBitRate(const QJsonValue& value) {
+    return value.isDouble() && value.toInt(0) > 0;
+}
+static bool IsValidVideoCRF(const QJsonValue& value) {
+    return value.isDouble() && value.toInt(-1) >= 0 && value.toInt(-1) <= 51;
+}
 
 HTTPServer::HTTPServer(PageRecord* page_record) {
     Logger::LogInfo("[HTTPServer::HTTPServer] " + Logger::tr("Creating HTTP server..."));
@@ -37,6 +50,18 @@ HTTPServer::HTTPServer(PageRecord* page_record) {
         }
         
         m_page_record = page_record;
+        m_session_manager = new SessionManager(this);
+
+        // 会话只能在这个目录中写文件
+        if (CommandLineOptions::GetSessionDir().isEmpty()) {
+            m_session_dir = GetApplicationUserDir("sessions");
+        } else {
+            m_session_dir = QDir::cleanPath(QDir(CommandLineOptions::GetSessionDir()).absolutePath());
+            if (!QDir::root().mkpath(m_session_dir)) {
+                Logger::LogError("[HTTPServer::HTTPServer] " + Logger::tr("Error: Can't create session directory '%1'!").arg(m_session_dir));
+                throw std::runtime_error("Could not create session directory");
+            }
+        }
         Logger::LogInfo("[HTTPServer::HTTPServer] " + Logger::tr("Connecting signals..."));
         
         // 检查信号和槽连接是否成功
@@ -58,16 +83,18 @@ HTTPServer::HTTPServer(PageRecord* page_record) {
 
 HTTPServer::~HTTPServer() {
     Stop();
+    delete m_session_manager; // waits for the sessions to finish
     delete m_server;
 }
 
 bool HTTPServer::Start(int port) {
-    if (!m_server->listen(QHostAddress::Any, port)) {
+    // 只监听本机地址：没有认证，而且API可以创建和删除文件
+    if (!m_server->listen(QHostAddress::LocalHost, port)) {
         Logger::LogError("[HTTPServer::Start] " + Logger::tr("Error: Could not start HTTP server on port %1!").arg(port));
         return false;
     }
     
-    Logger::LogInfo("[HTTPServer::Start] " + Logger::tr("HTTP server listening on port %1.").arg(port));
+    Logger::LogInfo("[HTTPServer::Start] " + Logger::tr("HTTP server listening on localhost port %1.").arg(port));
     return true;
 }
 
@@ -260,7 +287,11 @@ void HTTPServer::HandleRequest(QTcpSocket* socket, const QByteArray& request) {
                                "- /pause - Pause recording\n"
                                "- /save - Save recording\n"
                                "- /cancel - Cancel recording\n"
-                               "- /status - Get status information\n";
+                               "- /status - Get status information\n"
+                               "- /api/sessions/list - List independent recording sessions\n"
+                               "- /api/sessions/create - Start a new session (JSON body)\n"
+                               "- /api/sessions/{pause,resume,stop,cancel,remove} - Control a session ({\"id\": N})\n"
+                               "- /api/sessions/region - Change the recording area of a session ({\"id\": N, \"x\", \"y\", \"width\", \"height\"})\n";
             SendResponse(socket, 200, "text/plain", content);
             return;
         }
@@ -298,6 +329,10 @@ void HTTPServer::HandleRequest(QTcpSocket* socket, const QByteArray& request) {
 }
 
 void HTTPServer::HandleAPI(QTcpSocket* socket, const QString& path, const QJsonObject& json) {
+    SendJsonResponse(socket, 200, HandleCommand(path, json));
+}
+
+QJsonObject HTTPServer::HandleCommand(const QString& path, const QJsonObject& json) {
     QJsonObject response;
     
     if (path == "status") {
@@ -310,11 +345,21 @@ void HTTPServer::HandleAPI(QTcpSocket* socket, const QString& path, const QJsonO
         response = HandleAPICancelRecording();
     } else if (path == "record/save") {
         response = HandleAPISaveRecording();
+    } else if (path == "record/encoder") {
+        response = HandleAPIEncoderControl(json);
+    } else if (path == "record/region") {
+        response = HandleAPIRegionControl(json);
+    } else if (path == "sessions" || path == "sessions/list") {
+        response = HandleAPISessionList();
+    } else if (path == "sessions/create") {
+        response = HandleAPISessionCreate(json);
+    } else if (path.startsWith("sessions/")) {
+        response = HandleAPISessionAction(path.mid(9), json);
     } else {
         response = CreateErrorResponse("Unknown API endpoint");
     }
     
-    SendJsonResponse(socket, 200, response);
+    return response;
 }
 
 void HTTPServer::SendResponse(QTcpSocket* socket, int status, const QByteArray& content_type, const QByteArray& content) {
@@ -336,7 +381,6 @@ void HTTPServer::SendResponse(QTcpSocket* socket, int status, const QByteArray&
     response.append(QString("Content-Type: %1\r\n").arg(QString(content_type)).toUtf8());
     response.append(QString("Content-Length: %1\r\n").arg(content.size()).toUtf8());
     response.append("Connection: close\r\n");
-    response.append("Access-Control-Allow-Origin: *\r\n");
     
     // Empty line + body
     response.append("\r\n");
@@ -365,6 +409,8 @@ QJsonObject HTTPServer::HandleAPIStatus() {
         data["file_name"] = m_page_record->GetCurrentFileName();
         data["file_size"] = QString::number(m_page_record->GetCurrentFileSize());
         data["total_time"] = m_page_record->GetTotalTime();
+        data["keyframe_latency"] = (double) m_page_record->GetKeyframeLatency();
+        data["resume_latency"] = (double) m_page_record->GetResumeLatency();
     }
     
     return CreateSuccessResponse(data);
@@ -423,4 +469,254 @@ QJsonObject HTTPServer::HandleAPISaveRecording() {
     } else {
         return CreateErrorResponse("Not recording");
     }
-} 
\ No newline at end of file
+} 
+
+// 编码器控制：请求关键帧、修改码率、CRF或预设，在下一帧生效
+QJsonObject HTTPServer::HandleAPIEncoderControl(const QJsonObject& json) {
+    if (!m_page_record)
+        return CreateErrorResponse("No access to recording page");
+    if (!m_page_record->IsRecording())
+        return CreateErrorResponse("Not recording");
+
+    // 先检查所有参数，避免只应用了一部分修改
+    if (json.contains("video_kbit_rate") && !IsValidVideoKBitRate(json.value("video_kbit_rate")))
+        return CreateErrorResponse("Invalid 'video_kbit_rate', it must be a positive integer");
+    if (json.contains("crf") && !IsValidVideoCRF(json.value("crf")))
+        return CreateErrorResponse("Invalid 'crf', it must be an integer between 0 and 51");
+
+    QJsonObject data;
+    if (json.contains("video_kbit_rate")) {
+        unsigned int kbit_rate = json.value("video_kbit_rate").toInt();
+        if (!m_page_record->SetVideoBitRate(kbit_rate))
+            return CreateErrorResponse("Could not change the bit rate");
+        data["video_kbit_rate"] = (int) kbit_rate;
+    }
+    if (json.contains("crf")) {
+        unsigned int crf = json.value("crf").toInt();
+        if (!m_page_record->SetVideoCRF(crf))
+            return CreateErrorResponse("Could not change the constant rate factor");
+        data["crf"] = (int) crf;
+    }
+    if (json.contains("preset")) {
+        if (!m_page_record->SetVideoPreset(json.value("preset").toString()))
+            return CreateErrorResponse("Could not change the preset");
+        data["preset"] = json.value("preset").toString();
+    }
+    if (json.value("keyframe").toBool(false)) {
+        if (!m_page_record->RequestKeyframe())
+            return CreateErrorResponse("Could not request a keyframe");
+        data["keyframe"] = true;
+    }
+    data["keyframe_latency"] = (double) m_page_record->GetKeyframeLatency();
+    return CreateSuccessResponse(data);
+}
+
+// 录制区域控制：修改录制区域或缩放方式，输出尺寸不变，在下一帧生效
+QJsonObject HTTPServer::HandleAPIRegionControl(const QJsonObject& json) {
+    if (!m_page_record)
+        return CreateErrorResponse("No access to recording page");
+    if (!m_page_record->IsRecording() && !m_page_record->IsPaused())
+        return CreateErrorResponse("Not recording");
+
+    QJsonObject data;
+    if (json.contains("width") || json.contains("height")) {
+        int x = json.value("x").toInt(0), y = json.value("y").toInt(0);
+        int width = json.value("width").toInt(0), height = json.value("height").toInt(0);
+        if (x < 0 || y < 0 || width <= 0 || height <= 0)
+            return CreateErrorResponse("Invalid recording area");
+        // 返回实际使用的区域，超出屏幕的区域会被缩小或移动
+        unsigned int area_x = x, area_y = y, area_width = width, area_height = height;
+        if (!m_page_record->SetRecordingArea(&area_x, &area_y, &area_width, &area_height))
+            return CreateErrorResponse("Could not change the recording area");
+        data["x"] = (int) area_x;
+        data["y"] = (int) area_y;
+        data["width"] = (int) area_width;
+        data["height"] = (int) area_height;
+    }
+    if (json.contains("letterbox")) {
+        m_page_record->SetVideoLetterbox(json.value("letterbox").toBool(false));
+        data["letterbox"] = json.value("letterbox").toBool(false);
+    }
+    return CreateSuccessResponse(data);
+}
+
+QJsonObject HTTPServer::HandleAPISessionList() {
+    QJsonArray sessions;
+    for (const SessionManager::SessionInfo& info : m_session_manager->GetSessionInfo()) {
+        QJsonObject session;
+        session["id"] = (int) info.m_id;
+        session["state"] = SessionManager::StateToString(info.m_state);
+        session["file_name"] = info.m_file;
+        session["x"] = (int) info.m_x;
+        session["y"] = (int) info.m_y;
+        session["width"] = (int) info.m_width;
+        session["height"] = (int) info.m_height;
+        session["source"] = (int) info.m_source_index;
+        session["total_time"] = (double) info.m_total_time;
+        session["file_size"] = QString::number(info.m_total_bytes);
+        session["frame_rate"] = info.m_frame_rate;
+        session["bit_rate"] = info.m_bit_rate;
+        // 只包括SSR自己的线程，编码库的工作线程见 process_cpu_usage
+        session["thread_cpu_usage"] = info.m_thread_cpu_usage;
+        session["memory_usage"] = QString::number(info.m_memory_usage);
+        session["keyframe_latency"] = (double) info.m_keyframe_latency;
+        session["resume_latency"] = (double) info.m_resume_latency;
+        sessions.append(session);
+    }
+    QJsonObject data;
+    data["sessions"] = sessions;
+    data["sources"] = (int) m_session_manager->GetSourceCount();
+    data["process_cpu_usage"] = m_session_manager->GetProcessCPUUsage();
+    return CreateSuccessResponse(data);
+}
+
+QJsonObject HTTPServer::HandleAPISessionCreate(const QJsonObject& json) {
+    if (!json.contains("file") || !json.contains("width") || !json.contains("height"))
+        return CreateErrorResponse("Missing 'file', 'width' or 'height'");
+
+    // 解析会话参数，未指定的使用默认值
+    int x = json.value("x").toInt(0), y = json.value("y").toInt(0);
+    int width = json.value("width").toInt(0), height = json.value("height").toInt(0);
+    if (x < 0 || y < 0 || width <= 0 || height <= 0)
+        return CreateErrorResponse("Invalid recording area");
+    int output_width = json.value("output_width").toInt(0), output_height = json.value("output_height").toInt(0);
+    if (output_width < 0 || output_height < 0)
+        return CreateErrorResponse("Invalid output size");
+
+    SessionManager::SessionSettings settings;
+    settings.m_x = x;
+    settings.m_y = y;
+    settings.m_width = width;
+    settings.m_height = height;
+    settings.m_record_cursor = json.value("record_cursor").toBool(true);
+
+    OutputSettings &output_settings = settings.m_output_settings;
+    output_settings.file = GetSessionFilePath(json.value("file").toString());
+    if (output_settings.file.isEmpty())
+        return CreateErrorResponse("Invalid 'file', it must be a relative path inside the session directory");
+    output_settings.container_avname = json.value("container").toString("mp4");
+    output_settings.packet_journal = json.value("packet_journal").toBool(false);
+    output_settings.checksum_manifest = json.value("checksum_manifest").toBool(false);
+    output_settings.video_codec_avname = json.value("video_codec").toString("libx264");
+    output_settings.video_kbit_rate = json.value("video_kbit_rate").toInt(5000);
+    output_settings.video_width = output_width;
+    output_settings.video_height = output_height;
+    output_settings.video_frame_rate = json.value("frame_rate").toInt(30);
+    output_settings.video_time_base = 0.0;
+    output_settings.video_allow_frame_skipping = json.value("allow_frame_skipping").toBool(true);
+    output_settings.video_content_hints = json.value("content_hints").toBool(false);
+    output_settings.video_roi_cursor = json.value("roi_cursor").toBool(false);
+    output_settings.video_roi_window = json.value("roi_window").toBool(false);
+    output_settings.video_activity_index = json.value("activity_index").toBool(false);
+    output_settings.video_conversion_threads = std::max(-1, json.value("conversion_threads").toInt(-1));
+    output_settings.video_letterbox = json.value("letterbox").toBool(false);
+    if (json.value("video_options").isObject()) {
+        QJsonObject options = json.value("video_options").toObject();
+        for (auto it = options.begin(); it != options.end(); ++it) {
+            output_settings.video_options.push_back(std::make_pair(it.key(), it.value().toVariant().toString()));
+        }
+    } else if (output_settings.video_codec_avname == "libx264") {
+        output_settings.video_options.push_back(std::make_pair(QString("crf"), QString("23")));
+        output_settings.video_options.push_back(std::make_pair(QString("preset"), QString("superfast")));
+    }
+    output_settings.audio_codec_avname = QString(); // sessions are video-only
+    output_settings.audio_kbit_rate = 0;
+    output_settings.audio_channels = 0;
+    output_settings.audio_sample_rate = 0;
+    output_settings.audio_time_base = 0.0;
+
+    if (settings.m_width <= 0 || settings.m_height <= 0 || output_settings.file.isEmpty())
+        return CreateErrorResponse("Invalid session parameters");
+    if (json.contains("video_kbit_rate") && !IsValidVideoKBitRate(json.value("video_kbit_rate")))
+        return CreateErrorResponse("Invalid 'video_kbit_rate', it must be a positive integer");
+
+    try {
+        unsigned int id = m_session_manager->CreateSession(settings);
+        return CreateSuccessResponse({{"id", (int) id}});
+    } catch (const std::exception& e) {
+        return CreateErrorResponse(QString("Could not start session: %1").arg(e.what()));
+    } catch (...) {
+        return CreateErrorResponse("Could not start session");
+    }
+}
+
+QJsonObject HTTPServer::HandleAPISessionAction(const QString& action, const QJsonObject& json) {
+    if (!json.contains("id"))
+        return CreateErrorResponse("Missing session 'id'");
+    unsigned int id = json.value("id").toInt(0);
+
+    bool ok;
+    if (action == "pause") {
+        ok = m_session_manager->PauseSession(id);
+    } else if (action == "resume") {
+        ok = m_session_manager->ResumeSession(id);
+    } else if (action == "stop") {
+        ok = m_session_manager->StopSession(id, true);
+    } else if (action == "cancel") {
+        ok = m_session_manager->StopSession(id, false);
+    } else if (action == "remove") {
+        ok = m_session_manager->RemoveSession(id);
+    } else if (action == "keyframe") {
+        ok = m_session_manager->RequestSessionKeyframe(id);
+    } else if (action == "bitrate") {
+        if (!json.contains("video_kbit_rate"))
+            return CreateErrorResponse("Missing 'video_kbit_rate'");
+        if (!IsValidVideoKBitRate(json.value("video_kbit_rate")))
+            return CreateErrorResponse("Invalid 'video_kbit_rate', it must be a positive integer");
+        ok = m_session_manager->SetSessionVideoBitRate(id, json.value("video_kbit_rate").toInt());
+    } else if (action == "crf") {
+        if (!json.contains("crf"))
+            return CreateErrorResponse("Missing 'crf'");
+        if (!IsValidVideoCRF(json.value("crf")))
+            return CreateErrorResponse("Invalid 'crf', it must be an integer between 0 and 51");
+        ok = m_session_manager->SetSessionVideoCRF(id, json.value("crf").toInt());
+    } else if (action == "preset") {
+        if (!json.contains("preset"))
+            return CreateErrorResponse("Missing 'preset'");
+        ok = m_session_manager->SetSessionVideoPreset(id, json.value("preset").toString());
+    } else if (action == "region") {
+        // 修改会话的录制区域，返回实际使用的区域（共享输入的会话只能在该输入的区域内移动）
+        if (!json.contains("width") || !json.contains("height"))
+            return CreateErrorResponse("Missing 'width' or 'height'");
+        int x = json.value("x").toInt(0), y = json.value("y").toInt(0);
+        int width = json.value("width").toInt(0), height = json.value("height").toInt(0);
+        if (x < 0 || y < 0 || width <= 0 || height <= 0)
+            return CreateErrorResponse("Invalid recording area");
+        unsigned int area_x = x, area_y = y, area_width = width, area_height = height;
+        if (!m_session_manager->SetSessionRegion(id, &area_x, &area_y, &area_width, &area_height))
+            return CreateErrorResponse("Session does not exist or is in the wrong state, or the recording area is invalid");
+        return CreateSuccessResponse({{"id", (int) id}, {"action", action}, {"x", (int) area_x}, {"y", (int) area_y},
+                                      {"width", (int) area_width}, {"height", (int) area_height}});
+    } else {
+        return CreateErrorResponse("Unknown API endpoint");
+    }
+
+    if (!ok)
+        return CreateErrorResponse("Session does not exist or is in the wrong state");
+    return CreateSuccessResponse({{"id", (int) id}, {"action", action}});
+}
+
+QString HTTPServer::GetSessionFilePath(const QString& file) {
+    // 不允许空文件名、协议前缀（例如 'tcp:' 或 'file:'）和 '..'
+    if (file.isEmpty())
+        return QString();
+    int colon = file.indexOf(':');
+    if (colon > 0) {
+        bool protocol = true;
+        for (int i = 0; i < colon; ++i) {
+            QChar c = file[i];
+            if (!c.isLetterOrNumber() && c != '+' && c != '-' && c != '.')
+                protocol = false;
+        }
+        if (protocol)
+            return QString();
+    }
+    for (const QString& part : file.split('/')) {
+        if (part == "..")
+            return QString();
+    }
+    QString path = QDir::cleanPath((QDir::isAbsolutePath(file))? file : m_session_dir + "/" + file);
+    if (!path.startsWith(m_session_dir + "/"))
+        return QString();
+    return path;
+}
@@ -27,6 +27,7 @@ along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
 #include <QJsonDocument>
 
 class PageRecord;
+class SessionManager;
 
 class HTTPServer : public QObject {
     Q_OBJECT
@@ -34,6 +35,8 @@ class HTTPServer : public QObject {
 private:
     QTcpServer* m_server;
     PageRecord* m_page_record;
+    SessionManager* m_session_manager;
+    QString m_session_dir;
     QMap<QTcpSocket*, QByteArray> m_request_buffers;
 
 public:
@@ -43,6 +46,9 @@ public:
     bool Start(int port);
     void Stop();
 
+    // Runs an API command (the path without '/api/') and returns the response. This is also used by ControlSocket.
+    QJsonObject HandleCommand(const QString& path, const QJsonObject& json);
+
     static QJsonObject CreateSuccessResponse(const QJsonObject& data = QJsonObject());
     static QJsonObject CreateErrorResponse(const QString& message);
 
@@ -63,4 +69,14 @@ private:
     QJsonObject HandleAPIPauseRecording();
     QJsonObject HandleAPICancelRecording();
     QJsonObject HandleAPISaveRecording();
+    QJsonObject HandleAPIEncoderControl(const QJsonObject& json);
+    QJsonObject HandleAPIRegionControl(const QJsonObject& json);
+
+    // session API handlers (independent recordings, see SessionManager)
+    QJsonObject HandleAPISessionList();
+    QJsonObject HandleAPISessionCreate(const QJsonObject& json);
+    QJsonObject HandleAPISessionAction(const QString& action, const QJsonObject& json);
+
+    // Converts a file name from the API to a path inside the session directory. Returns an empty string if the name is not allowed.
+    QString GetSessionFilePath(const QString& file);
 }; 
\ No newline at end of file
@@ -0,0 +1,444 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "SessionManager.h"
+
+#include "Logger.h"
+#include "X11Input.h"
+#include "VideoCropper.h"
+#include "OutputManager.h"
+#include "ActivityIndex.h"
+#include "OutputChecksum.h"
+
+// The maximum number of sessions (including sessions that are done but haven't been removed yet).
+const unsigned int SessionManager::MAX_SESSIONS = 64;
+
+// The interval of the update timer that finishes sessions and calculates the statistics, in milliseconds.
+const int SessionManager::UPDATE_INTERVAL = 1000;
+
+static uint64_t EstimateFrameSize(const OutputFormat* format) {
+	uint64_t pixels = (uint64_t) format->m_video_width * (uint64_t) format->m_video_height;
+	switch(format->m_video_pixel_format) {
+		case AV_PIX_FMT_YUV420P:
+		case AV_PIX_FMT_NV12: return pixels * 3 / 2;
+		case AV_PIX_FMT_YUV422P: return pixels * 2;
+		case AV_PIX_FMT_YUV444P:
+		case AV_PIX_FMT_BGR24:
+		case AV_PIX_FMT_RGB24: return pixels * 3;
+		default: return pixels * 4;
+	}
+}
+
+SessionManager::SessionManager(QObject* parent)
+	: QObject(parent) {
+
+	m_next_session_id = 1;
+	m_next_source_index = 0;
+	m_stats_previous_time = hrt_time_micro();
+	m_stats_previous_process_cpu_time = process_cpu_time_micro();
+	m_stats_process_cpu_usage = 0.0;
+
+	m_timer_update = new QTimer(this);
+	connect(m_timer_update, SIGNAL(timeout()), this, SLOT(OnUpdate()));
+	m_timer_update->start(UPDATE_INTERVAL);
+
+}
+
+SessionManager::~SessionManager() {
+
+	// stop all sessions and wait for them to finish
+	for(std::unique_ptr<Session> &session : m_sessions) {
+		if(session->m_state == SESSION_STATE_RECORDING || session->m_state == SESSION_STATE_PAUSED)
+			StopSession(session->m_id, true);
+	}
+	for(std::unique_ptr<Session> &session : m_sessions) {
+		if(session->m_output_manager != NULL) {
+			Logger::LogInfo("[SessionManager::~SessionManager] " + Logger::tr("Waiting for session %1 to finish ...").arg(session->m_id));
+			session->m_output_manager->WaitFinished();
+			session->m_output_manager.reset();
+		}
+	}
+	m_sessions.clear();
+	m_sources.clear();
+
+}
+
+unsigned int SessionManager::CreateSession(const SessionSettings& settings) {
+
+	if(m_sessions.size() >= MAX_SESSIONS) {
+		Logger::LogError("[SessionManager::CreateSession] " + Logger::tr("Error: Too many sessions!"));
+		throw std::runtime_error("Too many sessions");
+	}
+	if(settings.m_width == 0 || settings.m_height == 0) {
+		Logger::LogError("[SessionManager::CreateSession] " + Logger::tr("Error: Width or height is zero!"));
+		throw std::runtime_error("Invalid recording area");
+	}
+
+	std::unique_ptr<Session> session(new Session());
+	session->m_id = m_next_session_id++;
+	session->m_settings = settings;
+	session->m_state = SESSION_STATE_RECORDING;
+	session->m_delete_file = false;
+	session->m_failed = false;
+	session->m_source = NULL;
+	session->m_total_time = 0;
+	session->m_total_bytes = 0;
+	session->m_stats_previous_cpu_time = 0;
+	session->m_stats_cpu_usage = 0.0;
+
+	// Only even width and height is allowed because some pixel formats (e.g. YUV420) require this.
+	OutputSettings &output_settings = session->m_settings.m_output_settings;
+	if(output_settings.video_width == 0 || output_settings.video_height == 0) {
+		output_settings.video_width = settings.m_width;
+		output_settings.video_height = settings.m_height;
+	}
+	output_settings.video_width = output_settings.video_width / 2 * 2;
+	output_settings.video_height = output_settings.video_height / 2 * 2;
+
+	Logger::LogInfo("[SessionManager::CreateSession] " + Logger::tr("Starting session %1 (%2x%3 at %4,%5, output file %6) ...")
+					.arg(session->m_id).arg(settings.m_width).arg(settings.m_height).arg(settings.m_x).arg(settings.m_y).arg(output_settings.file));
+
+	try {
+
+		// get a capture input
+		session->m_source = AcquireSource(settings.m_x, settings.m_y, settings.m_width, settings.m_height, settings.m_record_cursor);
+		session->m_video_cropper.reset(new VideoCropper(settings.m_x - session->m_source->m_x, settings.m_y - session->m_source->m_y, settings.m_width, settings.m_height));
+
+		// start the output
+		session->m_stats_slot.reset(new StatsSegment::Slot(session->m_id));
+		session->m_output_manager.reset(new OutputManager(output_settings, session->m_stats_slot->GetBlock()));
+
+		// connect everything
+		session->m_output_manager->GetSynchronizer()->ConnectVideoSource(session->m_video_cropper.get());
+		session->m_video_cropper->ConnectVideoSource(session->m_source->m_x11_input.get());
+
+	} catch(...) {
+		Logger::LogError("[SessionManager::CreateSession] " + Logger::tr("Error: Could not start session %1.").arg(session->m_id));
+		session->m_output_manager.reset();
+		session->m_stats_slot.reset();
+		session->m_video_cropper.reset();
+		if(session->m_source != NULL)
+			ReleaseSource(session->m_source);
+		throw;
+	}
+
+	unsigned int id = session->m_id;
+	m_sessions.push_back(std::move(session));
+	Logger::LogInfo("[SessionManager::CreateSession] " + Logger::tr("Started session %1, %2 session(s) using %3 input(s).").arg(id).arg(m_sessions.size()).arg(m_sources.size()));
+	return id;
+
+}
+
+bool SessionManager::PauseSession(unsigned int id) {
+	Session *session = FindSession(id);
+	if(session == NULL || session->m_state != SESSION_STATE_RECORDING)
+		return false;
+	session->m_output_manager->GetSynchronizer()->SetPaused(true);
+	session->m_state = SESSION_STATE_PAUSED;
+	Logger::LogInfo("[SessionManager::PauseSession] " + Logger::tr("Paused session %1.").arg(id));
+	return true;
+}
+
+bool SessionManager::ResumeSession(unsigned int id) {
+	Session *session = FindSession(id);
+	if(session == NULL || session->m_state != SESSION_STATE_PAUSED)
+		return false;
+	session->m_output_manager->GetSynchronizer()->SetPaused(false);
+	session->m_state = SESSION_STATE_RECORDING;
+	Logger::LogInfo("[SessionManager::ResumeSession] " + Logger::tr("Resumed session %1.").arg(id));
+	return true;
+}
+
+bool SessionManager::RequestSessionKeyframe(unsigned int id) {
+	Session *session = FindSession(id);
+	if(session == NULL || (session->m_state != SESSION_STATE_RECORDING && session->m_state != SESSION_STATE_PAUSED))
+		return false;
+	return session->m_output_manager->RequestVideoKeyframe();
+}
+
+bool SessionManager::SetSessionVideoBitRate(unsigned int id, unsigned int kbit_rate) {
+	Session *session = FindSession(id);
+	if(session == NULL || (session->m_state != SESSION_STATE_RECORDING && session->m_state != SESSION_STATE_PAUSED))
+		return false;
+	Logger::LogInfo("[SessionManager::SetSessionVideoBitRate] " + Logger::tr("Changing video bit rate of session %1 to %2 kbit/s.").arg(id).arg(kbit_rate));
+	return session->m_output_manager->RequestVideoBitRate(kbit_rate * 1000);
+}
+
+bool SessionManager::SetSessionVideoCRF(unsigned int id, unsigned int crf) {
+	Session *session = FindSession(id);
+	if(session == NULL || (session->m_state != SESSION_STATE_RECORDING && session->m_state != SESSION_STATE_PAUSED))
+		return false;
+	Logger::LogInfo("[SessionManager::SetSessionVideoCRF] " + Logger::tr("Changing video constant rate factor of session %1 to %2.").arg(id).arg(crf));
+	return session->m_output_manager->RequestVideoCRF(crf);
+}
+
+bool SessionManager::SetSessionVideoPreset(unsigned int id, const QString& preset) {
+	Session *session = FindSession(id);
+	if(session == NULL || (session->m_state != SESSION_STATE_RECORDING && session->m_state != SESSION_STATE_PAUSED))
+		return false;
+	Logger::LogInfo("[SessionManager::SetSessionVideoPreset] " + Logger::tr("Changing video preset of session %1 to %2.").arg(id).arg(preset));
+	return session->m_output_manager->RequestVideoPreset(preset);
+}
+
+bool SessionManager::SetSessionRegion(unsigned int id, unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height) {
+	Session *session = FindSession(id);
+	if(session == NULL || (session->m_state != SESSION_STATE_RECORDING && session->m_state != SESSION_STATE_PAUSED))
+		return false;
+	if(*width == 0 || *height == 0)
+		return false;
+	CaptureSource *source = session->m_source;
+	if(source->m_users == 1) {
+		// the input is only used by this session, so the input itself can be changed
+		if(!source->m_x11_input->SetRectangle(x, y, width, height))
+			return false;
+		source->m_x = *x;
+		source->m_y = *y;
+		source->m_width = *width;
+		source->m_height = *height;
+	} else {
+		// the other sessions still need the whole input, so only the cropped part can be changed
+		*width = std::min(*width, source->m_width);
+		*height = std::min(*height, source->m_height);
+		*x = clamp(*x, source->m_x, source->m_x + source->m_width - *width);
+		*y = clamp(*y, source->m_y, source->m_y + source->m_height - *height);
+	}
+	session->m_video_cropper->SetRectangle(*x - source->m_x, *y - source->m_y, *width, *height);
+	session->m_settings.m_x = *x;
+	session->m_settings.m_y = *y;
+	session->m_settings.m_width = *width;
+	session->m_settings.m_height = *height;
+	Logger::LogInfo("[SessionManager::SetSessionRegion] " + Logger::tr("Changing recording area of session %1 to %2x%3 at %4,%5.")
+					.arg(id).arg(*width).arg(*height).arg(*x).arg(*y));
+	return true;
+}
+
+bool SessionManager::StopSession(unsigned int id, bool save) {
+	Session *session = FindSession(id);
+	if(session == NULL || (session->m_state != SESSION_STATE_RECORDING && session->m_state != SESSION_STATE_PAUSED))
+		return false;
+	Logger::LogInfo("[SessionManager::StopSession] " + Logger::tr("Stopping session %1 ...").arg(id));
+	session->m_total_time = session->m_output_manager->GetSynchronizer()->GetTotalTime();
+	StopSessionPipeline(session);
+	session->m_delete_file = !save;
+	session->m_output_manager->Finish();
+	session->m_state = SESSION_STATE_FINISHING;
+	return true;
+}
+
+bool SessionManager::RemoveSession(unsigned int id) {
+	for(auto it = m_sessions.begin(); it != m_sessions.end(); ++it) {
+		if((*it)->m_id == id) {
+			if((*it)->m_state != SESSION_STATE_DONE && (*it)->m_state != SESSION_STATE_ERROR)
+				return false;
+			m_sessions.erase(it);
+			return true;
+		}
+	}
+	return false;
+}
+
+std::vector<SessionManager::SessionInfo> SessionManager::GetSessionInfo() {
+	std::vector<SessionInfo> infos;
+	for(std::unique_ptr<Session> &session : m_sessions) {
+		SessionInfo info;
+		info.m_id = session->m_id;
+		info.m_state = session->m_state;
+		info.m_file = session->m_settings.m_output_settings.file;
+		info.m_x = session->m_settings.m_x;
+		info.m_y = session->m_settings.m_y;
+		info.m_width = session->m_settings.m_width;
+		info.m_height = session->m_settings.m_height;
+		info.m_source_index = (session->m_source == NULL)? 0 : session->m_source->m_index;
+		info.m_total_time = session->m_total_time;
+		info.m_total_bytes = session->m_total_bytes;
+		info.m_frame_rate = 0.0;
+		info.m_bit_rate = 0.0;
+		info.m_thread_cpu_usage = session->m_stats_cpu_usage;
+		info.m_memory_usage = 0;
+		info.m_keyframe_latency = -1;
+		info.m_resume_latency = -1;
+		if(session->m_output_manager != NULL) {
+			if(session->m_output_manager->GetSynchronizer() != NULL)
+				info.m_total_time = session->m_output_manager->GetSynchronizer()->GetTotalTime();
+			info.m_total_bytes = session->m_output_manager->GetTotalBytes();
+			info.m_frame_rate = session->m_output_manager->GetActualFrameRate();
+			info.m_bit_rate = session->m_output_manager->GetActualBitRate();
+			info.m_memory_usage = (uint64_t) session->m_output_manager->GetTotalQueuedFrameCount() * EstimateFrameSize(session->m_output_manager->GetOutputFormat());
+			info.m_keyframe_latency = session->m_output_manager->GetVideoKeyframeLatency();
+			info.m_resume_latency = session->m_output_manager->GetVideoResumeLatency();
+		}
+		infos.push_back(info);
+	}
+	return infos;
+}
+
+QString SessionManager::StateToString(enum_session_state state) {
+	switch(state) {
+		case SESSION_STATE_RECORDING: return "recording";
+		case SESSION_STATE_PAUSED: return "paused";
+		case SESSION_STATE_FINISHING: return "finishing";
+		case SESSION_STATE_DONE: return "done";
+		case SESSION_STATE_ERROR: return "error";
+	}
+	return "unknown";
+}
+
+SessionManager::Session* SessionManager::FindSession(unsigned int id) {
+	for(std::unique_ptr<Session> &session : m_sessions) {
+		if(session->m_id == id)
+			return session.get();
+	}
+	return NULL;
+}
+
+SessionManager::CaptureSource* SessionManager::AcquireSource(unsigned int x, unsigned int y, unsigned int width, unsigned int height, bool record_cursor) {
+
+	// reuse an existing input if it covers the whole area
+	for(std::unique_ptr<CaptureSource> &source : m_sources) {
+		if(source->m_record_cursor == record_cursor && x >= source->m_x && y >= source->m_y &&
+				x + width <= source->m_x + source->m_width && y + height <= source->m_y + source->m_height) {
+			++source->m_users;
+			Logger::LogInfo("[SessionManager::AcquireSource] " + Logger::tr("Sharing input %1 (%2 users).").arg(source->m_index).arg(source->m_users));
+			return source.get();
+		}
+	}
+
+	// create a new input
+	std::unique_ptr<CaptureSource> source(new CaptureSource());
+	source->m_index = m_next_source_index++;
+	source->m_x = x;
+	source->m_y = y;
+	source->m_width = width;
+	source->m_height = height;
+	source->m_record_cursor = record_cursor;
+	source->m_x11_input.reset(new X11Input(x, y, width, height, record_cursor, false, false));
+	source->m_users = 1;
+	source->m_stats_previous_cpu_time = 0;
+	source->m_stats_cpu_usage = 0.0;
+	m_sources.push_back(std::move(source));
+	return m_sources.back().get();
+
+}
+
+void SessionManager::ReleaseSource(CaptureSource* source) {
+	assert(source->m_users > 0);
+	if(--source->m_users != 0)
+		return;
+	for(auto it = m_sources.begin(); it != m_sources.end(); ++it) {
+		if(it->get() == source) {
+			m_sources.erase(it);
+			return;
+		}
+	}
+}
+
+void SessionManager::StopSessionPipeline(Session* session) {
+	// disconnect the synchronizer before removing the cropper and the input
+	if(session->m_output_manager != NULL && session->m_output_manager->GetSynchronizer() != NULL)
+		session->m_output_manager->GetSynchronizer()->ConnectVideoSource(NULL);
+	session->m_video_cropper.reset();
+	if(session->m_source != NULL) {
+		ReleaseSource(session->m_source);
+		session->m_source = NULL;
+	}
+}
+
+void SessionManager::OnUpdate() {
+
+	int64_t time = hrt_time_micro();
+	double timedelta = (double) (time - m_stats_previous_time) * 1.0e-6;
+	m_stats_previous_time = time;
+
+	// calculate the CPU usage of the process
+	int64_t process_cpu_time = process_cpu_time_micro();
+	m_stats_process_cpu_usage = (timedelta > 0.0)? (double) (process_cpu_time - m_stats_previous_process_cpu_time) * 1.0e-6 / timedelta : 0.0;
+	m_stats_previous_process_cpu_time = process_cpu_time;
+
+	// calculate the CPU usage of the inputs
+	for(std::unique_ptr<CaptureSource> &source : m_sources) {
+		int64_t cpu_time = source->m_x11_input->GetCPUTime();
+		source->m_stats_cpu_usage = (timedelta > 0.0)? (double) (cpu_time - source->m_stats_previous_cpu_time) * 1.0e-6 / timedelta : 0.0;
+		source->m_stats_previous_cpu_time = cpu_time;
+	}
+
+	for(std::unique_ptr<Session> &session : m_sessions) {
+
+		// check for errors (in the input, the synchronizer, the encoders or the muxer)
+		// The output is still finished normally, so the file gets a trailer if the muxer is still working.
+		if(session->m_state == SESSION_STATE_RECORDING || session->m_state == SESSION_STATE_PAUSED) {
+			bool error = (session->m_source != NULL && session->m_source->m_x11_input->HasErrorOccurred()) ||
+						 session->m_output_manager->HasErrorOccurred();
+			if(error) {
+				Logger::LogError("[SessionManager::OnUpdate] " + Logger::tr("Error: Session %1 has failed, stopping it.").arg(session->m_id));
+				session->m_total_time = session->m_output_manager->GetSynchronizer()->GetTotalTime();
+				StopSessionPipeline(session.get());
+				session->m_failed = true;
+				session->m_output_manager->Finish();
+				session->m_state = SESSION_STATE_FINISHING;
+			}
+		}
+
+		// calculate the CPU usage
+		if(session->m_output_manager != NULL) {
+			int64_t cpu_time = session->m_output_manager->GetCPUTime();
+			double cpu_usage = (timedelta > 0.0)? (double) (cpu_time - session->m_stats_previous_cpu_time) * 1.0e-6 / timedelta : 0.0;
+			if(session->m_source != NULL)
+				cpu_usage += session->m_source->m_stats_cpu_usage / (double) session->m_source->m_users;
+			session->m_stats_cpu_usage = std::max(0.0, cpu_usage);
+			session->m_stats_previous_cpu_time = cpu_time;
+		} else {
+			session->m_stats_cpu_usage = 0.0;
+		}
+
+		// update the recording state in the shared stats
+		if(session->m_stats_slot != NULL && session->m_stats_slot->GetBlock() != NULL) {
+			StatsBlock *stats = session->m_stats_slot->GetBlock();
+			int64_t total_time = (session->m_state == SESSION_STATE_FINISHING)? session->m_total_time : session->m_output_manager->GetSynchronizer()->GetTotalTime();
+			StatsUpdate update(stats);
+			stats->capturing.Set(session->m_state == SESSION_STATE_RECORDING || session->m_state == SESSION_STATE_PAUSED);
+			stats->recording.Set(session->m_state == SESSION_STATE_RECORDING);
+			stats->total_time.Set(total_time);
+			stats->size_in_width.Set(session->m_settings.m_width);
+			stats->size_in_height.Set(session->m_settings.m_height);
+			stats->size_out_width.Set(session->m_settings.m_output_settings.video_width);
+			stats->size_out_height.Set(session->m_settings.m_output_settings.video_height);
+			stats->update_time.Set(hrt_time_micro());
+		}
+
+		// finish sessions
+		if(session->m_state == SESSION_STATE_FINISHING && session->m_output_manager->IsFinished()) {
+			session->m_total_bytes = session->m_output_manager->GetTotalBytes();
+			session->m_output_manager.reset();
+			session->m_stats_slot.reset();
+			if(session->m_delete_file) {
+				QFile(session->m_settings.m_output_settings.file).remove();
+				QFile(ActivityIndex::GetFileName(session->m_settings.m_output_settings.file)).remove();
+				QFile(OutputChecksum::GetFileName(session->m_settings.m_output_settings.file)).remove();
+				Logger::LogInfo("[SessionManager::OnUpdate] " + Logger::tr("Session %1 cancelled, deleted file.").arg(session->m_id));
+			} else if(session->m_failed) {
+				Logger::LogInfo("[SessionManager::OnUpdate] " + Logger::tr("Session %1 failed, kept what was recorded.").arg(session->m_id));
+			} else {
+				Logger::LogInfo("[SessionManager::OnUpdate] " + Logger::tr("Session %1 done, saved file.").arg(session->m_id));
+			}
+			session->m_state = (session->m_failed)? SESSION_STATE_ERROR : SESSION_STATE_DONE;
+		}
+
+	}
+
+}
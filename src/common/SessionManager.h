@@ -0,0 +1,159 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+#include "OutputSettings.h"
+#include "StatsSegment.h"
+
+class X11Input;
+class VideoCropper;
+class OutputManager;
+
+// Runs multiple independent recordings (capture, synchronizer, encoders and muxer) in one process.
+// Sessions that record regions of the same screen share one X11 input: each session gets a VideoCropper that selects its
+// region from the shared input. A new input is only created if no existing input covers the requested region.
+// Sessions are video-only. All functions must be called from the main thread.
+class SessionManager : public QObject {
+	Q_OBJECT
+
+public:
+	enum enum_session_state {
+		SESSION_STATE_RECORDING,
+		SESSION_STATE_PAUSED,
+		SESSION_STATE_FINISHING,
+		SESSION_STATE_DONE,
+		SESSION_STATE_ERROR
+	};
+	struct SessionSettings {
+		unsigned int m_x, m_y, m_width, m_height;
+		bool m_record_cursor;
+		OutputSettings m_output_settings;
+	};
+	struct SessionInfo {
+		unsigned int m_id;
+		enum_session_state m_state;
+		QString m_file;
+		unsigned int m_x, m_y, m_width, m_height;
+		unsigned int m_source_index; // sessions with the same source index share an input
+		int64_t m_total_time; // in microseconds
+		uint64_t m_total_bytes;
+		double m_frame_rate, m_bit_rate;
+		// CPU used by the threads and tasks of SSR itself (in cores), the input thread is split evenly between the sessions that use it.
+		// Threads created by the codec libraries (e.g. x264 worker threads) are not included, see GetProcessCPUUsage.
+		double m_thread_cpu_usage;
+		uint64_t m_memory_usage; // estimated size of the queued frames (in bytes)
+		int64_t m_keyframe_latency; // time between the last keyframe request and the keyframe (in microseconds), -1 if unknown
+		int64_t m_resume_latency; // time between the last resume and the first encoded frame (in microseconds), -1 if unknown
+	};
+
+private:
+	struct CaptureSource {
+		unsigned int m_index;
+		unsigned int m_x, m_y, m_width, m_height;
+		bool m_record_cursor;
+		std::unique_ptr<X11Input> m_x11_input;
+		unsigned int m_users;
+		int64_t m_stats_previous_cpu_time;
+		double m_stats_cpu_usage;
+	};
+	struct Session {
+		unsigned int m_id;
+		SessionSettings m_settings;
+		enum_session_state m_state;
+		bool m_delete_file;
+		bool m_failed; // the session is finishing because of an error, it goes to SESSION_STATE_ERROR when it is done
+		CaptureSource *m_source;
+		std::unique_ptr<VideoCropper> m_video_cropper;
+		std::unique_ptr<StatsSegment::Slot> m_stats_slot; // must outlive the output manager, released when the session is done
+		std::unique_ptr<OutputManager> m_output_manager;
+		int64_t m_total_time;
+		uint64_t m_total_bytes;
+		int64_t m_stats_previous_cpu_time;
+		double m_stats_cpu_usage;
+	};
+
+private:
+	static const unsigned int MAX_SESSIONS;
+	static const int UPDATE_INTERVAL;
+
+private:
+	std::vector<std::unique_ptr<CaptureSource> > m_sources;
+	std::vector<std::unique_ptr<Session> > m_sessions;
+	unsigned int m_next_session_id, m_next_source_index;
+	int64_t m_stats_previous_time;
+	int64_t m_stats_previous_process_cpu_time;
+	double m_stats_process_cpu_usage;
+
+	QTimer *m_timer_update;
+
+public:
+	SessionManager(QObject* parent = NULL);
+	~SessionManager();
+
+	// Creates and starts a new session and returns its id. Throws an exception if the session can't be started.
+	unsigned int CreateSession(const SessionSettings& settings);
+
+	// Pauses or resumes a session. Returns false if the session doesn't exist or is in the wrong state.
+	// The input and the encoder keep running while the session is paused, so resuming is nearly instant.
+	bool PauseSession(unsigned int id);
+	bool ResumeSession(unsigned int id);
+
+	// Asks the video encoder of a session for a keyframe, or changes its bit rate (in kbit/s) or constant rate factor.
+	// The change is applied at the next frame. Returns false if the session doesn't exist or is not running.
+	bool RequestSessionKeyframe(unsigned int id);
+	bool SetSessionVideoBitRate(unsigned int id, unsigned int kbit_rate);
+	bool SetSessionVideoCRF(unsigned int id, unsigned int crf);
+	bool SetSessionVideoPreset(unsigned int id, const QString& preset);
+
+	// Changes the recording area of a session. The output size doesn't change, the new frames are scaled to the existing size.
+	// If the session has its own input, the input is moved and resized (it has to stay inside the screen). If the input is shared
+	// with other sessions, the area has to stay inside the area of that input. The arguments are changed to the area that is
+	// actually recorded. Returns false if the session doesn't exist or is not running, or if the size is invalid.
+	bool SetSessionRegion(unsigned int id, unsigned int* x, unsigned int* y, unsigned int* width, unsigned int* height);
+
+	// Stops a session. The encoders are finished in the background, the session state changes to SESSION_STATE_DONE when the file is complete.
+	// If 'save' is false, the file is deleted afterwards. Returns false if the session doesn't exist or has already been stopped.
+	bool StopSession(unsigned int id, bool save);
+
+	// Removes a session that is done. Returns false if the session doesn't exist or is still running.
+	bool RemoveSession(unsigned int id);
+
+	// Returns information about all sessions.
+	std::vector<SessionInfo> GetSessionInfo();
+
+	// Returns the CPU usage of the whole process (in cores), including the threads of the codec libraries that can't be assigned to a session.
+	inline double GetProcessCPUUsage() { return m_stats_process_cpu_usage; }
+
+	// Returns the number of capture inputs (this can be lower than the number of sessions).
+	inline unsigned int GetSourceCount() { return m_sources.size(); }
+
+	static QString StateToString(enum_session_state state);
+
+private:
+	Session* FindSession(unsigned int id);
+	CaptureSource* AcquireSource(unsigned int x, unsigned int y, unsigned int width, unsigned int height, bool record_cursor);
+	void ReleaseSource(CaptureSource* source);
+	void StopSessionPipeline(Session* session);
+
+private slots:
+	void OnUpdate();
+
+};
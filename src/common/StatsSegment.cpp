@@ -0,0 +1,163 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "StatsSegment.h"
+
+#include "Logger.h"
+
+// 'SSRSTATS' in little-endian byte order, so the file is easy to recognize.
+const uint64_t StatsSegment::STATS_MAGIC = 0x5354415453525353ull;
+
+// Increase this when the layout of StatsHeader or StatsBlock changes in an incompatible way.
+const uint64_t StatsSegment::STATS_VERSION = 3;
+
+// The number of slots, i.e. the maximum number of recordings that can be reported at the same time.
+// This is the recording page plus the maximum number of sessions.
+const unsigned int StatsSegment::SLOT_COUNT = 65;
+
+StatsSegment *StatsSegment::s_instance = NULL;
+
+StatsSegment::Slot::Slot(uint64_t session_id) {
+	m_block = NULL;
+	if(!IsEnabled())
+		return;
+	StatsSegment *segment = GetInstance();
+	std::lock_guard<std::mutex> lock(segment->m_slot_mutex);
+	for(unsigned int i = 0; i < SLOT_COUNT; ++i) {
+		StatsBlock *block = segment->m_slots + i;
+		if(block->active.Get() == 0) {
+			// the sequence number has to keep increasing, otherwise a reader could miss the reset
+			uint64_t sequence = block->sequence.Get(), generation = block->generation.Get();
+			block->~StatsBlock();
+			m_block = new(block) StatsBlock();
+			m_block->sequence.Set(sequence + 2);
+			m_block->generation.Set(generation + 1);
+			m_block->session_id.Set(session_id);
+			m_block->update_time.Set(hrt_time_micro());
+			std::atomic_thread_fence(std::memory_order_release);
+			m_block->active.Set(1);
+			return;
+		}
+	}
+	Logger::LogWarning("[StatsSegment::Slot::Slot] " + Logger::tr("Warning: All shared statistics slots are in use, this recording will not be reported."));
+}
+
+StatsSegment::Slot::~Slot() {
+	if(m_block != NULL) {
+		std::lock_guard<std::mutex> lock(GetInstance()->m_slot_mutex);
+		StatsUpdate update(m_block);
+		m_block->active.Set(0);
+	}
+}
+
+StatsSegment::StatsSegment(const QString& file) {
+	assert(s_instance == NULL);
+
+	m_file = file;
+	m_fd = -1;
+	m_size = sizeof(StatsHeader) + sizeof(StatsBlock) * SLOT_COUNT;
+	m_header = NULL;
+	m_slots = NULL;
+
+	try {
+		Init();
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+	s_instance = this;
+
+}
+
+StatsSegment::~StatsSegment() {
+	assert(s_instance == this);
+	s_instance = NULL;
+	Free();
+}
+
+void StatsSegment::Init() {
+
+	// the values are shared with other processes, so the atomic operations must not use locks
+	static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_LONG_LOCK_FREE == 2, "64-bit atomics must be lock-free, otherwise they can't be shared with other processes.");
+	static_assert(sizeof(StatsField<double>) == sizeof(double) && sizeof(StatsField<uint64_t>) == sizeof(uint64_t), "StatsField must have the same layout as the plain type.");
+	{
+		std::atomic<double> test(0.0);
+		if(!test.is_lock_free()) {
+			Logger::LogError("[StatsSegment::Init] " + Logger::tr("Error: Atomic floating-point values are not lock-free on this platform!"));
+			throw StatsException();
+		}
+	}
+
+	// create the file
+	// Qt doesn't get the permissions right, so use POSIX functions (just like the text stats file).
+	QByteArray file = QFile::encodeName(m_file);
+	m_fd = open(file.constData(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+	if(m_fd == -1) {
+		Logger::LogError("[StatsSegment::Init] " + Logger::tr("Error: Can't create stats file '%1'!").arg(m_file));
+		throw StatsException();
+	}
+	if(ftruncate(m_fd, m_size) == -1) {
+		Logger::LogError("[StatsSegment::Init] " + Logger::tr("Error: Can't resize stats file!"));
+		throw StatsException();
+	}
+
+	// map the file
+	void *ptr = mmap(NULL, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if(ptr == MAP_FAILED) {
+		Logger::LogError("[StatsSegment::Init] " + Logger::tr("Error: Can't map stats file!"));
+		throw StatsException();
+	}
+	m_header = new(ptr) StatsHeader();
+	m_slots = (StatsBlock*) ((char*) ptr + sizeof(StatsHeader));
+	for(unsigned int i = 0; i < SLOT_COUNT; ++i) {
+		new(m_slots + i) StatsBlock();
+	}
+
+	// initialize the header (the file is new, so everything else is already zero)
+	// the magic number is written last so readers never see a half-initialized header
+	m_header->version = STATS_VERSION;
+	m_header->header_size = sizeof(StatsHeader);
+	m_header->slot_size = sizeof(StatsBlock);
+	m_header->slot_count = SLOT_COUNT;
+	m_header->pid = getpid();
+	std::atomic_thread_fence(std::memory_order_release);
+	m_header->magic = STATS_MAGIC;
+
+	Logger::LogInfo("[StatsSegment::Init] " + Logger::tr("Writing shared statistics to '%1'.").arg(m_file));
+
+}
+
+void StatsSegment::Free() {
+	if(m_header != NULL) {
+		for(unsigned int i = 0; i < SLOT_COUNT; ++i) {
+			m_slots[i].~StatsBlock();
+		}
+		m_header->~StatsHeader();
+		munmap(m_header, m_size);
+		m_header = NULL;
+		m_slots = NULL;
+	}
+	if(m_fd != -1) {
+		::close(m_fd);
+		m_fd = -1;
+		QByteArray file = QFile::encodeName(m_file);
+		unlink(file.constData());
+	}
+}
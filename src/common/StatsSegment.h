@@ -0,0 +1,182 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+class StatsException : public std::exception {
+public:
+	inline virtual const char* what() const throw() override {
+		return "StatsException";
+	}
+};
+
+// A single statistics value in shared memory. Values are written with relaxed atomic operations inside a StatsUpdate,
+// which makes related updates visible to readers together (see StatsBlock::sequence).
+// The layout is identical to a plain T (std::atomic is lock-free for all types that are used here).
+template<typename T>
+class StatsField {
+	friend class StatsUpdate;
+private:
+	std::atomic<T> m_value;
+public:
+	inline T Get() const { return m_value.load(std::memory_order_relaxed); }
+	inline void Set(T value) { m_value.store(value, std::memory_order_relaxed); }
+	inline void Add(T value) { m_value.fetch_add(value, std::memory_order_relaxed); }
+};
+
+// The binary layout of the shared statistics file. This is what external programs see when they map the file.
+// The file starts with a StatsHeader, followed by 'slot_count' slots of 'slot_size' bytes. Each recording (the recording page, or a
+// session created through the HTTP API) gets its own slot, so concurrent recordings don't overwrite each other's values.
+// All fields are 64-bit and naturally aligned, so the layout doesn't depend on the compiler. New fields can be appended
+// without changing the version (readers should check 'slot_size'), but any other change requires a new version number.
+struct alignas(64) StatsHeader {
+	uint64_t magic; // STATS_MAGIC, written last
+	uint64_t version; // STATS_VERSION
+	uint64_t header_size; // sizeof(StatsHeader)
+	uint64_t slot_size; // sizeof(StatsBlock)
+	uint64_t slot_count;
+	uint64_t pid;
+};
+
+// One slot. Slots are aligned to cache lines, so recordings running on different cores don't share cache lines.
+// Readers should ignore slots where 'active' is zero, and compare 'generation' to detect that a slot was reused by a new recording.
+// The slot is protected by a sequence lock: writers make 'sequence' odd while they update a group of values and even again when
+// they are done. To get a consistent snapshot, readers read 'sequence', copy the slot, read 'sequence' again, and retry if it
+// was odd or has changed in the meantime.
+struct alignas(64) StatsBlock {
+
+	// slot header (updated when the slot is acquired or released)
+	StatsField<uint64_t> sequence; // odd while an update is in progress
+	StatsField<uint64_t> active; // 1 while the slot is used by a recording
+	StatsField<uint64_t> generation; // incremented every time the slot is acquired
+	StatsField<uint64_t> session_id; // 0 for the recording page, otherwise the id of the session
+	StatsField<int64_t> update_time; // time of the last update of the recording state (hrt_time_micro, CLOCK_MONOTONIC in microseconds)
+
+	// recording state (updated by the recording page or the session manager)
+	StatsField<uint64_t> capturing, recording;
+	StatsField<int64_t> total_time; // in microseconds
+	StatsField<uint64_t> size_in_width, size_in_height;
+	StatsField<uint64_t> size_out_width, size_out_height;
+
+	// video input (updated by the synchronizer)
+	StatsField<uint64_t> video_frames_in; // frames received from the capture source
+	StatsField<uint64_t> video_frames_dropped; // frames dropped because they were too early or because the buffer was full
+	StatsField<uint64_t> video_frames_duplicated; // duplicate frames inserted to fill gaps
+	StatsField<double> video_fps_in;
+	StatsField<int64_t> video_input_latency; // time between capturing a frame and its arrival in the synchronizer (in microseconds)
+	StatsField<uint64_t> video_sync_queue; // frames waiting in the synchronizer
+
+	// audio input (updated by the synchronizer)
+	StatsField<uint64_t> audio_samples_in;
+	StatsField<uint64_t> audio_samples_dropped, audio_samples_inserted;
+	StatsField<double> audio_drift; // current audio/video drift (in seconds, positive means too many samples)
+	StatsField<uint64_t> audio_sync_queue; // samples waiting in the synchronizer
+
+	// encoders (updated by the encoder threads)
+	StatsField<uint64_t> video_frames_out; // frames sent to the encoder
+	StatsField<double> video_fps_out;
+	StatsField<uint64_t> video_encoder_queue, audio_encoder_queue; // frames waiting in the encoder queues
+	StatsField<uint64_t> video_encoder_latency, audio_encoder_latency; // frames inside the encoder (sent but not yet returned as a packet)
+
+	// muxer (updated by the muxer thread)
+	StatsField<uint64_t> video_packets_out, audio_packets_out;
+	StatsField<uint64_t> total_bytes;
+	StatsField<double> bit_rate;
+
+	// frames dropped because of overload (updated by the synchronizer)
+	StatsField<uint64_t> video_frames_dropped_similar; // dropped frames that were near-duplicates of the previous frame
+	StatsField<double> video_dropped_difference; // average difference between dropped frames and the previous frame (0 = identical, 255 = completely different)
+
+};
+
+// Updates a group of values in a StatsBlock, so readers see all of them or none of them. The block can be NULL.
+// Different threads can update the same block, updates are serialized by spinning on the sequence number. Updates
+// only take a few stores, so they should never wait for long. Updates can't be nested, and no other locks may be acquired
+// during an update (the pipeline threads hold their own locks while they update the stats, so this could deadlock).
+class StatsUpdate {
+private:
+	StatsBlock *m_block;
+	uint64_t m_sequence;
+public:
+	inline StatsUpdate(StatsBlock* block) {
+		m_block = block;
+		if(m_block == NULL)
+			return;
+		for( ; ; ) {
+			m_sequence = m_block->sequence.m_value.load(std::memory_order_relaxed);
+			if((m_sequence & 1) == 0 && m_block->sequence.m_value.compare_exchange_weak(m_sequence, m_sequence + 1, std::memory_order_relaxed))
+				break;
+			std::this_thread::yield();
+		}
+		std::atomic_thread_fence(std::memory_order_release);
+	}
+	inline ~StatsUpdate() {
+		if(m_block != NULL)
+			m_block->sequence.m_value.store(m_sequence + 2, std::memory_order_release);
+	}
+};
+
+// Shared memory statistics file. The file is created in /dev/shm by default and mapped into memory, the pipeline threads update it directly.
+// There can only be one instance, it should be created before and destroyed after the pipeline.
+class StatsSegment {
+
+public:
+	static const uint64_t STATS_MAGIC, STATS_VERSION;
+	static const unsigned int SLOT_COUNT;
+
+	// Reserves a slot for one recording, and releases it again when it is destroyed. The values are reset when the slot is acquired.
+	// If the stats segment doesn't exist or all slots are in use, GetBlock() returns NULL and the recording simply isn't reported.
+	// The slot must outlive the pipeline that writes to it. This class is not thread-safe, but different slots can be used by different threads.
+	class Slot {
+	private:
+		StatsBlock *m_block;
+	public:
+		Slot(uint64_t session_id);
+		~Slot();
+		inline StatsBlock* GetBlock() { return m_block; }
+	};
+
+private:
+	QString m_file;
+	int m_fd;
+	size_t m_size;
+	StatsHeader *m_header;
+	StatsBlock *m_slots;
+	std::mutex m_slot_mutex;
+
+	static StatsSegment *s_instance;
+
+public:
+	StatsSegment(const QString& file);
+	~StatsSegment();
+
+	// Returns whether the stats segment exists.
+	// This function is thread-safe.
+	inline static bool IsEnabled() { return (s_instance != NULL); }
+
+	inline static StatsSegment* GetInstance() { assert(s_instance != NULL); return s_instance; }
+	inline static const QString& GetFile() { return GetInstance()->m_file; }
+	inline static size_t GetSize() { return GetInstance()->m_size; }
+
+private:
+	void Init();
+	void Free();
+
+};
@@ -0,0 +1,291 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "TaskScheduler.h"
+
+#include "Logger.h"
+
+// The maximum number of worker threads that is used by default. Most of the work is done by the encoder, which has its own threads.
+static const unsigned int SCHEDULER_MAX_DEFAULT_THREADS = 8;
+
+TaskScheduler *TaskScheduler::s_instance = NULL;
+thread_local TaskScheduler::Worker *TaskScheduler::s_current_worker = NULL;
+
+TaskScheduler::Group::Group() {
+	m_running = 0;
+	m_cpu_time = 0;
+}
+
+TaskScheduler::Group::~Group() {
+	Wait();
+}
+
+void TaskScheduler::Group::Submit(Priority priority, const Task& task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_running;
+	}
+	TaskScheduler::GetInstance()->Submit(priority, Wrap(task));
+}
+
+void TaskScheduler::Group::SubmitDelayed(Priority priority, int64_t delay, const Task& task) {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		++m_running;
+	}
+	TaskScheduler::GetInstance()->AddDelayed(priority, delay, Wrap(task), this);
+}
+
+void TaskScheduler::Group::Wait() {
+	std::unique_lock<std::mutex> lock(m_mutex);
+	while(m_running != 0) {
+		m_condition.wait(lock);
+	}
+}
+
+TaskScheduler::Task TaskScheduler::Group::Wrap(const Task& task) {
+	return [this, task]() {
+		int64_t t1 = this_thread_cpu_time_micro();
+		try {
+			task();
+		} catch(const std::exception& e) {
+			Logger::LogError("[TaskScheduler::Group] " + Logger::tr("Exception '%1' in task.").arg(e.what()));
+		} catch(...) {
+			Logger::LogError("[TaskScheduler::Group] " + Logger::tr("Unknown exception in task."));
+		}
+		m_cpu_time += this_thread_cpu_time_micro() - t1;
+		// notify while holding the lock, because the group may be destroyed as soon as the lock is released
+		std::lock_guard<std::mutex> lock(m_mutex);
+		--m_running;
+		m_condition.notify_all();
+	};
+}
+
+// Called by the scheduler for delayed tasks that will never run because the scheduler is stopping.
+void TaskScheduler::Group::Discard() {
+	std::lock_guard<std::mutex> lock(m_mutex);
+	--m_running;
+	m_condition.notify_all();
+}
+
+TaskScheduler::TaskScheduler(unsigned int threads) {
+	assert(s_instance == NULL);
+
+	m_should_stop = false;
+	m_next_delayed_time = std::numeric_limits<int64_t>::max();
+	m_queued_tasks = 0;
+	m_next_worker = 0;
+	m_stats_tasks = 0;
+	m_stats_steals = 0;
+
+	try {
+		Init((threads == 0)? GetDefaultThreadCount() : threads);
+	} catch(...) {
+		Free();
+		throw;
+	}
+
+	s_instance = this;
+
+}
+
+TaskScheduler::~TaskScheduler() {
+	assert(s_instance == this);
+	s_instance = NULL;
+	Free();
+
+	Logger::LogInfo("[TaskScheduler::~TaskScheduler] " + Logger::tr("Task scheduler: %1 tasks on %2 threads, %3 stolen.")
+					.arg((uint64_t) m_stats_tasks).arg(m_workers.size()).arg((uint64_t) m_stats_steals));
+
+}
+
+void TaskScheduler::Init(unsigned int threads) {
+	Logger::LogInfo("[TaskScheduler::Init] " + Logger::tr("Starting %1 worker threads ...").arg(threads));
+	for(unsigned int i = 0; i < threads; ++i) {
+		m_workers.emplace_back(new Worker());
+	}
+	for(std::unique_ptr<Worker> &worker : m_workers) {
+		worker->m_thread = std::thread(&TaskScheduler::WorkerThread, this, worker.get());
+	}
+}
+
+void TaskScheduler::Free() {
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_should_stop = true;
+	}
+	m_condition.notify_all();
+	for(std::unique_ptr<Worker> &worker : m_workers) {
+		if(worker->m_thread.joinable())
+			worker->m_thread.join();
+	}
+
+	// delayed tasks that haven't started yet are dropped, but groups that are still waiting for them must not hang
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if(!m_delayed_tasks.empty()) {
+		Logger::LogWarning("[TaskScheduler::Free] " + Logger::tr("Warning: Discarding %1 delayed tasks.").arg(m_delayed_tasks.size()));
+		while(!m_delayed_tasks.empty()) {
+			if(m_delayed_tasks.top().m_group != NULL)
+				m_delayed_tasks.top().m_group->Discard();
+			m_delayed_tasks.pop();
+		}
+		m_next_delayed_time = std::numeric_limits<int64_t>::max();
+	}
+
+}
+
+void TaskScheduler::Submit(Priority priority, const Task& task) {
+	Worker *worker = s_current_worker;
+	if(worker == NULL)
+		worker = m_workers[m_next_worker++ % m_workers.size()].get();
+	Push(worker, priority, task);
+}
+
+void TaskScheduler::SubmitDelayed(Priority priority, int64_t delay, const Task& task) {
+	AddDelayed(priority, delay, task, NULL);
+}
+
+unsigned int TaskScheduler::GetDefaultThreadCount() {
+	unsigned int cores = std::thread::hardware_concurrency();
+	return clamp(cores, 2u, SCHEDULER_MAX_DEFAULT_THREADS);
+}
+
+void TaskScheduler::AddDelayed(Priority priority, int64_t delay, const Task& task, Group* group) {
+	if(delay <= 0) {
+		Submit(priority, task);
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		DelayedTask delayed;
+		delayed.m_time = hrt_time_micro() + delay;
+		delayed.m_priority = priority;
+		delayed.m_task = task;
+		delayed.m_group = group;
+		m_delayed_tasks.push(std::move(delayed));
+		m_next_delayed_time = m_delayed_tasks.top().m_time;
+	}
+	// one worker has to recalculate its timeout
+	m_condition.notify_one();
+}
+
+void TaskScheduler::Push(Worker* worker, Priority priority, const Task& task) {
+	{
+		std::lock_guard<std::mutex> lock(worker->m_mutex);
+		worker->m_queues[priority].push_back(task);
+	}
+	++m_queued_tasks;
+	// The counter is incremented before taking the lock, and sleeping workers check the counter while holding the lock,
+	// so the notification can't get lost.
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+	}
+	m_condition.notify_one();
+}
+
+// Takes the next task for the given worker. The worker takes the newest task from its own queue (it is most likely still
+// in the cache) and the oldest task from the other queues. Higher priorities come first.
+bool TaskScheduler::Pop(Worker* worker, Task* task) {
+	size_t index = 0;
+	while(m_workers[index].get() != worker) {
+		++index;
+	}
+	for(unsigned int p = 0; p < PRIORITY_COUNT; ++p) {
+		{
+			std::lock_guard<std::mutex> lock(worker->m_mutex);
+			if(!worker->m_queues[p].empty()) {
+				*task = std::move(worker->m_queues[p].back());
+				worker->m_queues[p].pop_back();
+				--m_queued_tasks;
+				return true;
+			}
+		}
+		for(size_t i = 1; i < m_workers.size(); ++i) {
+			Worker *victim = m_workers[(index + i) % m_workers.size()].get();
+			std::lock_guard<std::mutex> lock(victim->m_mutex);
+			if(!victim->m_queues[p].empty()) {
+				*task = std::move(victim->m_queues[p].front());
+				victim->m_queues[p].pop_front();
+				--m_queued_tasks;
+				++m_stats_steals;
+				return true;
+			}
+		}
+	}
+	return false;
+}
+
+// Moves all delayed tasks that are due to the queues of the given worker (other workers can steal them from there).
+// This is called before every Pop, otherwise delayed tasks would only start when the workers run out of other work.
+// The time of the earliest task is checked first without locking, so this is cheap when nothing is due.
+void TaskScheduler::PromoteDelayed(Worker* worker) {
+	int64_t time = hrt_time_micro();
+	if(m_next_delayed_time > time)
+		return;
+	std::vector<DelayedTask> due;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while(!m_delayed_tasks.empty() && m_delayed_tasks.top().m_time <= time) {
+			due.push_back(m_delayed_tasks.top());
+			m_delayed_tasks.pop();
+		}
+		m_next_delayed_time = (m_delayed_tasks.empty())? std::numeric_limits<int64_t>::max() : m_delayed_tasks.top().m_time;
+	}
+	for(DelayedTask &delayed : due) {
+		Push(worker, delayed.m_priority, delayed.m_task);
+	}
+}
+
+void TaskScheduler::WorkerThread(Worker* worker) {
+	s_current_worker = worker;
+	for( ; ; ) {
+
+		// start delayed tasks that are due, then run a task if there is one
+		PromoteDelayed(worker);
+		Task task;
+		if(Pop(worker, &task)) {
+			try {
+				task();
+			} catch(const std::exception& e) {
+				Logger::LogError("[TaskScheduler::WorkerThread] " + Logger::tr("Exception '%1' in task.").arg(e.what()));
+			} catch(...) {
+				Logger::LogError("[TaskScheduler::WorkerThread] " + Logger::tr("Unknown exception in task."));
+			}
+			++m_stats_tasks;
+			continue;
+		}
+
+		// wait for something to happen
+		std::unique_lock<std::mutex> lock(m_mutex);
+		int64_t time = hrt_time_micro();
+		if(!m_delayed_tasks.empty() && m_delayed_tasks.top().m_time <= time)
+			continue;
+		if(m_queued_tasks != 0)
+			continue;
+		if(m_should_stop)
+			break;
+		if(m_delayed_tasks.empty()) {
+			m_condition.wait(lock);
+		} else {
+			m_condition.wait_for(lock, std::chrono::microseconds(m_delayed_tasks.top().m_time - time));
+		}
+
+	}
+	s_current_worker = NULL;
+}
@@ -0,0 +1,140 @@
+/*
+Copyright (c) 2012-2020 Maarten Baert <maarten-baert@hotmail.com>
+
+This file is part of SimpleScreenRecorder.
+
+SimpleScreenRecorder is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+SimpleScreenRecorder is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with SimpleScreenRecorder.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#include "Global.h"
+
+// A small pool of worker threads shared by the whole program. Work is submitted as tasks with a priority. Each worker has its
+// own queues, and workers that run out of work steal tasks from the others, so the load is spread over the available cores
+// without a single contended queue. Higher priorities are always taken first, both from the own queues and when stealing.
+// Tasks should not block for long periods of time (e.g. waiting for I/O or for another task), otherwise they hold up the other
+// tasks. Capture threads and threads that spend most of their time waiting inside libraries are not suitable for this.
+class TaskScheduler {
+
+public:
+	enum Priority {
+		PRIORITY_HIGH, // latency-sensitive work that is part of the recording pipeline
+		PRIORITY_NORMAL, // periodic housekeeping
+		PRIORITY_LOW, // offline jobs that can wait
+		PRIORITY_COUNT // must be last
+	};
+
+	typedef std::function<void()> Task;
+
+	// Keeps track of the tasks submitted by one object, so the object can wait for them before it is destroyed.
+	// The group also measures the CPU time used by its tasks.
+	class Group {
+
+	private:
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		unsigned int m_running; // submitted tasks that haven't finished yet, including delayed tasks
+		std::atomic<int64_t> m_cpu_time;
+
+	public:
+		Group();
+		~Group();
+
+		// Submits a task that belongs to this group.
+		// This function is thread-safe.
+		void Submit(Priority priority, const Task& task);
+
+		// Submits a task that will be started after the given delay (in microseconds).
+		// This function is thread-safe.
+		void SubmitDelayed(Priority priority, int64_t delay, const Task& task);
+
+		// Waits until all tasks in this group have finished. This must not be called from a task in the same group.
+		// This function is thread-safe.
+		void Wait();
+
+		// Returns the CPU time used by the tasks in this group (in microseconds).
+		// This function is thread-safe.
+		inline int64_t GetCPUTime() { return m_cpu_time; }
+
+	private:
+		Task Wrap(const Task& task);
+		void Discard();
+
+		friend class TaskScheduler;
+
+	};
+
+private:
+	struct Worker {
+		std::mutex m_mutex;
+		std::deque<Task> m_queues[PRIORITY_COUNT];
+		std::thread m_thread;
+	};
+	struct DelayedTask {
+		int64_t m_time;
+		Priority m_priority;
+		Task m_task;
+		Group *m_group; // the group that has to be told if the task is discarded, or NULL
+		inline bool operator<(const DelayedTask& other) const { return (m_time > other.m_time); } // earliest task first
+	};
+
+private:
+	std::vector<std::unique_ptr<Worker> > m_workers;
+
+	std::mutex m_mutex; // protects the delayed tasks and the sleeping workers
+	std::condition_variable m_condition;
+	std::priority_queue<DelayedTask> m_delayed_tasks;
+	bool m_should_stop;
+	std::atomic<int64_t> m_next_delayed_time; // time of the earliest delayed task, so workers can check it without locking
+
+	std::atomic<unsigned int> m_queued_tasks, m_next_worker;
+	std::atomic<uint64_t> m_stats_tasks, m_stats_steals;
+
+	static TaskScheduler *s_instance;
+	static thread_local Worker *s_current_worker;
+
+public:
+	// Creates the scheduler with the given number of worker threads, or the default number if it is zero.
+	TaskScheduler(unsigned int threads);
+	~TaskScheduler();
+
+	inline static TaskScheduler* GetInstance() { assert(s_instance != NULL); return s_instance; }
+
+	// Returns the number of worker threads.
+	inline unsigned int GetThreadCount() { return m_workers.size(); }
+
+	// Submits a task. If this is called by a worker thread, the task goes to the queue of that worker, otherwise the workers
+	// take turns.
+	// This function is thread-safe.
+	void Submit(Priority priority, const Task& task);
+
+	// Submits a task that will be started after the given delay (in microseconds).
+	// This function is thread-safe.
+	void SubmitDelayed(Priority priority, int64_t delay, const Task& task);
+
+	// Returns the number of worker threads that is used if no number is specified.
+	static unsigned int GetDefaultThreadCount();
+
+private:
+	void Init(unsigned int threads);
+	void Free();
+
+	void AddDelayed(Priority priority, int64_t delay, const Task& task, Group* group);
+	void Push(Worker* worker, Priority priority, const Task& task);
+	bool Pop(Worker* worker, Task* task);
+	void PromoteDelayed(Worker* worker);
+
+	void WorkerThread(Worker* worker);
+
+};